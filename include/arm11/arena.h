@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define ARENA_CHUNK_SIZE  (1024u * 16) // 16 KiB. Bigger allocations get their own chunk.
+
+typedef struct ArenaChunk ArenaChunk;
+struct ArenaChunk
+{
+	ArenaChunk *next;
+	u32 used; // Bytes of data[] used.
+	u32 size; // Size of data[].
+	char data[];
+};
+
+// Growable bump allocator. Memory is only freed all at once.
+// Allocations are laid out in order within each chunk.
+typedef struct
+{
+	ArenaChunk *first;
+	ArenaChunk *last;
+	u32 total;         // Bytes allocated over all chunks.
+} Arena;
+
+
+
+static inline void arenaInit(Arena *const arena)
+{
+	arena->first = NULL;
+	arena->last  = NULL;
+	arena->total = 0;
+}
+
+// Returns NULL if out of memory. No alignment is applied.
+void* arenaAlloc(Arena *const arena, const u32 size);
+
+// Frees all chunks. The arena can be used again afterwards.
+void arenaFree(Arena *const arena);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
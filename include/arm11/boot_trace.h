@@ -0,0 +1,87 @@
+#pragma once
+
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "error_codes.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Boot timeline tracing. Compiled out in release builds.
+// Names must be string literals. They are stored as pointers.
+#ifndef NDEBUG
+#define TRACE_INIT()       traceInit()
+#define TRACE_BEGIN(name)  traceEvent((name), 'B')
+#define TRACE_END(name)    traceEvent((name), 'E')
+#define TRACE_DUMP(path)   traceDump(path)
+#else
+#define TRACE_INIT()       ((void)0)
+#define TRACE_BEGIN(name)  ((void)0)
+#define TRACE_END(name)    ((void)0)
+#define TRACE_DUMP(path)   ((void)0)
+#endif
+
+#define TRACE_MAX_EVENTS  (128u) // Ring buffer size. Oldest events are overwritten.
+#define TRACE_TICK_DIV    (64u)   // Cycle counter divider.
+#define TRACE_CPU_HZ      (268111856u)
+
+
+
+#ifndef TRACE_HOST_CLOCK
+// Enables the ARM11 MPCore cycle counter, resets it and sets the divider.
+static inline void traceStartClock(void)
+{
+	const u32 pmnc = 1u<<3 | 1u<<2 | 1u; // D, C, E.
+	__asm__ volatile("mcr p15, 0, %0, c15, c12, 0" : : "r" (pmnc) : );
+}
+
+// ARM11 MPCore cycle counter. Counts every 64 cycles
+// so it doesn't overflow for over 17 minutes.
+// Only running after traceInit().
+static inline u32 traceGetTicks(void)
+{
+	u32 ticks;
+	__asm__ volatile("mrc p15, 0, %0, c15, c12, 1" : "=r" (ticks) : : );
+	return ticks;
+}
+#else
+// Host builds (tools/hostStubs) provide a fake clock.
+void traceStartClock(void);
+u32 traceGetTicks(void);
+#endif
+
+static inline u32 traceTicksToUs(const u32 ticks)
+{
+	return (u64)ticks * TRACE_TICK_DIV * 1000000 / TRACE_CPU_HZ;
+}
+
+void traceInit(void);
+void traceEvent(const char *const name, const char phase);
+
+// Writes the events as Chrome trace JSON to buf. Returns the length without terminator.
+u32 traceSerialize(char *const buf, const u32 size);
+Result traceDump(const char *const path);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include "types.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// border.rle: 400x240 BGR8 border already in the GPU tiled layout
+// (8x8 Morton order tiles of the 240x400 framebuffer), RLE compressed.
+// Built by tools/borderConv. Raw border.bgr files still work.
+#define BORDER_RLE_PATH  "border.rle" // Relative to work dir.
+#define BORDER_MAGIC     (0x52445242u) // "BRDR"
+#define BORDER_VERSION   (1u)
+#define BORDER_RAW_SIZE  (240u * 400 * 3)
+
+// RLE tokens: Control byte c. If bit 7 is set the next pixel (3 bytes) is
+// repeated (c & 0x7F) + 1 times. Otherwise c + 1 literal pixels follow.
+typedef struct
+{
+	u32 magic;
+	u16 version;
+	u16 reserved;
+	u32 rawSize;  // Must be BORDER_RAW_SIZE.
+	u32 dataSize; // RLE data following the header.
+} BorderHeader;
+static_assert(sizeof(BorderHeader) == 16);
+
+
+
+// Decodes a border.rle file to out (BORDER_RAW_SIZE bytes).
+// Returns false if the file is invalid. out may be partially written in that case.
+bool borderDecode(const void *const file, const u32 fileSize, void *const out);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include "types.h"
+#include "error_codes.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Optional bundle of per-boot assets in the work dir.
+// Built by tools/bundle/bundle.py.
+#define OAF_BUNDLE_PATH     "bundle.bin" // Relative to work dir.
+#define BUNDLE_MAGIC        (0x4C444E42u) // "BNDL"
+#define BUNDLE_VERSION      (1u)
+#define BUNDLE_ALIGN        (512u)        // Payload alignment (SD sector size).
+#define BUNDLE_NAME_LEN     (24u)
+#define BUNDLE_MAX_ENTRIES  (64u)
+
+typedef struct
+{
+	u32 magic;
+	u16 version;
+	u16 numEntries;
+	u32 reserved[2];
+	// BundleEntry entries[numEntries];
+} BundleHeader;
+static_assert(sizeof(BundleHeader) == 16);
+
+typedef struct
+{
+	char name[BUNDLE_NAME_LEN]; // Zero padded. Entries are sorted by name.
+	u32 offset;                 // From the start of the file. BUNDLE_ALIGN aligned.
+	u32 size;
+} BundleEntry;
+static_assert(sizeof(BundleEntry) == 32);
+
+
+
+// Opens the bundle and loads its directory. The file stays open until bundleClose().
+// Returns RES_FR_NO_FILE if there is no bundle. Lookups fall back to loose files either way.
+Result bundleOpen(const char *const path);
+void bundleClose(void);
+
+// Same as fsQuickRead()/fsLoadPathFromFile() but served from the bundle if it contains name.
+Result bundleQuickRead(const char *const name, void *const buf, const u32 size);
+Result bundleLoadPathFromFile(const char *const name, char outPath[512]);
+
+// Reads up to size bytes for files of unknown size. bytesRead is the file size if it fits.
+Result bundleRead(const char *const name, void *const buf, const u32 size, u32 *const bytesRead);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
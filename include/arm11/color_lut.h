@@ -0,0 +1,70 @@
+#pragma once
+
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include "types.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define COLOR_LUT_SIZE     (4u * 32768) // 15 to 32 bit. Index is BGR555.
+
+#define LUT_CACHE_PATH     "color_lut.bin"
+#define LUT_CACHE_MAGIC    (0x54554C43u) // "CLUT"
+#define LUT_CACHE_VERSION  (1u)          // Bump when makeColorLut() output changes.
+#define LUT_CACHE_BUF_SIZE (sizeof(LutCacheHeader) + COLOR_LUT_SIZE)
+
+
+typedef struct
+{
+	float targetGamma;
+	float lum;
+	float  r, gr, br;
+	float rg,  g, bg;
+	float rb, gb,  b;
+	float displayGamma;
+} ColorProfile;
+
+typedef struct
+{
+	u32 magic;
+	u32 version;
+	u32 digest[5]; // SHA-1 over the key block followed by the lut.
+	u32 lutSize;
+} LutCacheHeader;
+static_assert(sizeof(LutCacheHeader) == 32);
+
+extern const ColorProfile g_colorProfiles[8]; // Config colorProfile - 1.
+
+
+
+// Uses contrast, brightness and saturation from g_oafConfig.
+void makeColorLut(const ColorProfile *const p, u32 *const lut);
+
+// Same as makeColorLut() but tries color_lut.bin first.
+// tmpBuf must hold LUT_CACHE_BUF_SIZE bytes.
+void loadColorLut(const ColorProfile *const p, u32 *const lut, void *const tmpBuf);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -40,6 +40,8 @@ typedef struct
 	bool directBoot;
 	bool useGbaDb;
 	bool useSavesFolder;
+	bool sortNatural;    // File browser.
+	bool sortIgnoreCase;
 
 	// [video]
 	u8 scaler;          // 0 = 1:1/none, 1 = bilinear (GPU) x1.5, 2 = matrix (hardware) x1.5.
@@ -0,0 +1,116 @@
+#pragma once
+
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "error_codes.h"
+#include "arm11/boot_trace.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Per frame gfx pipeline timings. Compiled out in release builds.
+// Uses the cycle counter started by TRACE_INIT().
+#ifndef NDEBUG
+#define GFXSTATS_STAMP(stamp)  (g_gfxStamps[(stamp)] = traceGetTicks())
+#define GFXSTATS_FRAME()       gfxStatsFrame(&g_gfxStats, g_gfxStamps)
+#define GFXSTATS_DUMP(path)    gfxStatsDump(path)
+#define GFXSTATS_QUEUE_DUMP()  gfxStatsQueueDump()
+#else
+#define GFXSTATS_STAMP(stamp)  ((void)0)
+#define GFXSTATS_FRAME()       ((void)0)
+#define GFXSTATS_DUMP(path)    ((void)0)
+#define GFXSTATS_QUEUE_DUMP()  ((void)0)
+#endif
+
+#define GFXSTATS_PATH     "gfx_stats.txt"
+#define GFXSTATS_BUCKETS  (176u) // 8 buckets per power of 2 up to 2^24 ticks.
+
+// GBA frame period in cycle counter ticks (59.7275 Hz).
+#define GFXSTATS_FRAME_TICKS  ((u32)((u64)TRACE_CPU_HZ / TRACE_TICK_DIV * 10000 / 597275))
+
+typedef enum
+{
+	GFX_STAMP_READY  = 0u, // Frame ready or conversion finished event.
+	GFX_STAMP_SUBMIT = 1u, // GX_processCommandList() returned.
+	GFX_STAMP_P3D    = 2u, // GFX_waitForP3D() returned.
+	GFX_STAMP_PPF    = 3u, // Display transfer finished.
+	GFX_STAMP_SWAP   = 4u, // GFX_swapBuffers() returned.
+	GFX_STAMP_NUM    = 5u
+} GfxStamp;
+
+typedef enum
+{
+	GFX_STAGE_SUBMIT   = 0u, // READY -> SUBMIT.
+	GFX_STAGE_P3D      = 1u, // SUBMIT -> P3D.
+	GFX_STAGE_PPF      = 2u, // P3D -> PPF.
+	GFX_STAGE_SWAP     = 3u, // PPF -> SWAP.
+	GFX_STAGE_TOTAL    = 4u, // READY -> SWAP.
+	GFX_STAGE_INTERVAL = 5u, // READY -> next READY.
+	GFX_STAGE_NUM      = 6u
+} GfxStage;
+
+typedef struct
+{
+	u32 count;
+	u32 min;
+	u32 max;
+	u64 sum;
+	u32 buckets[GFXSTATS_BUCKETS];
+} GfxHist;
+
+typedef struct
+{
+	GfxHist hist[GFX_STAGE_NUM];
+	u32 late;      // Frame interval over 1.5 GBA frames. A frame was shown twice.
+	u32 dup;       // Frame interval under 0.5 GBA frames. Same frame processed twice.
+	u32 lastReady; // READY stamp of the previous frame. 0 before the first frame.
+	u32 seq;       // Odd while gfxStatsFrame() runs. See gfxStatsSnapshot().
+} GfxStats;
+
+extern u32 g_gfxStamps[GFX_STAMP_NUM];
+extern GfxStats g_gfxStats;
+
+
+
+void gfxHistAdd(GfxHist *const hist, const u32 ticks);
+
+// permille is 0-1000. Returns the upper bound of the bucket in ticks clamped to max.
+u32 gfxHistPercentile(const GfxHist *const hist, const u32 permille);
+
+// Adds one frame worth of stamps.
+void gfxStatsFrame(GfxStats *const stats, const u32 stamps[GFX_STAMP_NUM]);
+
+// Copies stats as of the last completed frame. Retries if
+// gfxStatsFrame() ran during the copy.
+void gfxStatsSnapshot(const GfxStats *const stats, GfxStats *const out);
+
+// Writes a CSV table in µs to buf. Returns the length without terminator or 0 if buf is too small.
+u32 gfxStatsSerialize(const GfxStats *const stats, char *const buf, const u32 size);
+Result gfxStatsDump(const char *const path);
+
+// Dumps to GFXSTATS_PATH on the screenshot writer task. Use while the writer runs.
+void gfxStatsQueueDump(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -29,16 +29,21 @@ extern "C"
 #define GPU_RENDER_BUF_ADDR  (0x18180000)
 #define GPU_TEXTURE_ADDR     (0x18200000)
 #define GPU_TEXTURE2_ADDR    (0x18300000)
-#define GBA_INIT_LIST_SIZE   (1136)
-#define GBA_LIST2_SIZE       (448)
 
 
-extern u8 gbaGpuInitList[GBA_INIT_LIST_SIZE];
-extern u8 gbaGpuList2[GBA_LIST2_SIZE];
+typedef struct
+{
+	const u32 *initList; // First frame. Sets up the whole pipeline.
+	const u32 *list;     // Every following frame.
+	u32 initListSize;    // In bytes.
+	u32 listSize;
+} GbaGpuCmdLists;
 
 
 
-void patchGbaGpuCmdList(const u8 scaleType, const bool useSecondTexture);
+// Returns the prebuilt command lists for a scaler (config scaler value)
+// and texture (second texture = color corrected RGBA8 frame).
+const GbaGpuCmdLists* getGbaGpuCmdLists(const u8 scaleType, const bool useSecondTexture);
 
 #ifdef __cplusplus
 } // extern "C"
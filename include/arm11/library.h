@@ -0,0 +1,86 @@
+#pragma once
+
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include "types.h"
+#include "error_codes.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// ROM library index of all GBA ROMs on the SD card.
+// Format: LibHeader, LibEntry entries[numEntries] sorted by title, string pool.
+#define LIB_INDEX_PATH  "library.bin" // Relative to work dir.
+#define LIB_MAGIC       (0x5842494Cu) // "LIBX"
+#define LIB_VERSION     (1u)
+
+typedef struct
+{
+	u32 magic;
+	u16 version;
+	u16 entrySize;
+	u32 numEntries;
+	u32 poolSize;
+} LibHeader;
+static_assert(sizeof(LibHeader) == 16);
+
+typedef struct
+{
+	char title[12];   // From the ROM header. Not null terminated.
+	char gameCode[4];
+	char maker[2];
+	u16 reserved;
+	u32 dirOff;       // Offset of the directory path in the string pool.
+	u32 nameOff;      // Offset of the file name in the string pool.
+} LibEntry;
+static_assert(sizeof(LibEntry) == 28);
+
+typedef struct
+{
+	u32 num;
+	const LibEntry *entries;
+	const char *pool;
+	void *buf;        // Whole index file.
+} Library;
+
+// Called once per directory. Return false to abort.
+typedef bool (*LibProgressCb)(const u32 found, const char *const dir);
+
+
+
+// Walks root recursively and writes the index.
+Result libBuild(const char *const root, LibProgressCb progress);
+
+Result libLoad(Library *const lib);
+void libFree(Library *const lib);
+
+// Returns the index of the first entry with a title not ordered before prefix.
+// The search ignores case.
+u32 libFindPrefix(const Library *const lib, const char *const prefix);
+
+// Writes the full ROM path of entry i to path.
+void libGetPath(const Library *const lib, const u32 i, char path[512]);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
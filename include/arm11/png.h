@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Minimal PNG encoder for frame dumps. RGB8 output with an sBIT chunk
+// marking 5 significant bits per channel. Deflate uses a single fixed
+// Huffman block with greedy matching which is fast enough for the ARM11.
+
+// Buffer size for pngEncodeA1bgr5() including its work area.
+u32 pngMaxSize(const u32 width, const u32 height);
+
+// Encodes A1BGR5 pixels (R in bits 11-15, alpha bit ignored) to out.
+// out must be 4 byte aligned and hold pngMaxSize() bytes.
+// Returns the PNG file size. The PNG starts at out.
+u32 pngEncodeA1bgr5(const u16 *const src, const u32 width, const u32 height, void *const out);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "error_codes.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Everything we learn from hashing and scanning a ROM.
+typedef struct
+{
+	u64 sha1Prefix; // First u64 of the SHA1 over the padded ROM. Only valid if hasSha1.
+	u32 romSize;    // ROM size after padding.
+	u8 scanStrIdx;  // SDK save string index (SaveScanState.strIdx).
+	u8 dbSaveType;  // Save type from gba_db.bin or GBA_DB_SAVE_*.
+	bool hasSha1;   // The ROM is only hashed if gba_db.bin is used.
+} RomFingerprint;
+
+
+
+// Loads the cache and looks up the ROM. Returns true on hit.
+// Entries for a ROM with a different size or timestamp are misses.
+bool romCacheLookup(const char *const romPath, RomFingerprint *const fpOut);
+
+// Inserts/refreshes the entry of the ROM passed to romCacheLookup() and writes the cache.
+Result romCacheStore(const RomFingerprint *const fp);
+
+// Loads the cache once for romCachePeek().
+void romCacheLoad(void);
+
+// Looks up the ROM in the cache loaded by romCacheLoad(). Unlike romCacheLookup()
+// the ROM is only stat'ed if its path is cached and romCacheStore() is not affected.
+bool romCachePeek(const char *const romPath, RomFingerprint *const fpOut);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
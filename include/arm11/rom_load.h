@@ -0,0 +1,48 @@
+#pragma once
+
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "error_codes.h"
+#include "arm11/save_type.h"
+#include "drivers/lgy_common.h"
+
+
+// FCRAM right after the ROM area. Free for temporary use while a ROM is
+// loaded and patched. Only valid before LGY_prepareGbaMode().
+// Used by the BPS source backup and the UPS reader in patch.c.
+#define ROM_SCRATCH_LOC   (LGY_ROM_LOC + LGY_MAX_ROM_SIZE)
+#define ROM_SCRATCH_SIZE  (LGY_MAX_ROM_SIZE)
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Pads and mirrors the ROM at LGY_ROM_LOC. Returns the padded size.
+u32 fixRomPadding(const u32 romFileSize);
+
+// Loads the ROM to LGY_ROM_LOC and pads it. sha1Out and scan are optional.
+// The SHA1 covers the padded ROM and scan is finished on success.
+Result loadGbaRom(const char *const path, u32 *const romSizeOut, u64 sha1Out[3], SaveScanState *const scan);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -36,10 +36,49 @@ typedef struct
 } GbaDbEntry;
 static_assert(sizeof(GbaDbEntry) == 28, "Error: GBA DB entry struct is not packed!");
 
+// gba_db.bin with fan-out index. Legacy files are only the entries
+// sorted by the first u64 of the SHA1 (little endian).
+// Here entries are sorted by SHA1 bytes and the fan-out table
+// gives the entry range for each first SHA1 byte.
+#define GBA_DB_MAGIC    (0x42444247u) // "GBDB"
+#define GBA_DB_VERSION  (1u)
+
+typedef struct
+{
+	u32 magic;
+	u16 version;
+	u16 entrySize;
+	u32 numEntries;
+	u32 reserved;
+	u32 fanout[257]; // Index of the first entry with SHA1[0] >= i. fanout[256] = numEntries.
+	// GbaDbEntry entries[numEntries];
+} GbaDbHeader;
+static_assert(sizeof(GbaDbHeader) == 1044);
+
+// Save type from gba_db.bin when it's not a real save type.
+#define GBA_DB_SAVE_UNKNOWN    (0xFEu) // Not searched yet.
+#define GBA_DB_SAVE_NOT_FOUND  (0xFFu)
+
+// Bump when g_saveTypeLut in save_type.c changes.
+// SaveScanState.strIdx is an index into it and is cached in rom_cache.bin.
+#define SAVE_TYPE_LUT_VERSION  (1u)
+
+// State of the incremental SDK save string search.
+// Allows scanning the ROM while it's still being loaded.
+typedef struct
+{
+	u32 pos;   // ROM offset of the next word to check.
+	u8 node;   // Current string matcher node. 0 = no partial match.
+	u8 strIdx; // Index of the SDK save string found or 0xFF.
+} SaveScanState;
+
 
 
-u16 detectSaveType(const u32 romSize, const u16 defaultSave);
-u16 getSaveType(const OafConfig *const cfg, const u32 romSize, const char *const savePath);
+void saveScanInit(SaveScanState *const state);
+void saveScanUpdate(SaveScanState *const state, const u32 end, const bool last);
+u16 detectSaveType(const SaveScanState *const state, const u32 romSize, const u16 defaultSave);
+u16 getSaveType(const OafConfig *const cfg, const u32 romSize, const u16 autoSaveType, const u64 sha1Prefix,
+                u8 *const dbSaveType, const char *const savePath);
 
 #ifdef __cplusplus
 } // extern "C"
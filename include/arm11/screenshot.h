@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "error_codes.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SCREENSHOT_WIDTH   (240u)
+#define SCREENSHOT_HEIGHT  (160u)
+
+
+// Starts the low priority screenshot writer task.
+Result screenshotInit(void);
+
+// Waits for a pending screenshot and stops the writer task.
+void screenshotExit(void);
+
+// Copies a 240x160 A1BGR5 frame and queues it for PNG encoding.
+// Never touches the file system. Returns false if the writer is
+// still busy with the previous screenshot or not running.
+bool screenshotSubmit(const u16 *const frame, const char *const path);
+
+// Runs job on the writer task after any pending screenshot so its file
+// system access never overlaps a screenshot write. Returns false if
+// a job is still queued or the writer is not running.
+bool screenshotQueueJob(void (*const job)(void));
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
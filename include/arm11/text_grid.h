@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Bottom screen console size. The last column is left out
+// because the console inserts a newline after writing to it.
+#define TG_COLS  (53u - 1)
+#define TG_ROWS  (30u)
+
+// Cell colors. Console foreground color 0-7 and bright flag.
+#define TG_COLOR(c, bright)  ((c) | (bright)<<3)
+#define TG_WHITE             TG_COLOR(7, 0)
+#define TG_WHITE_BRIGHT      TG_COLOR(7, 1)
+#define TG_YELLOW_BRIGHT     TG_COLOR(3, 1)
+
+
+
+// Clears the console and the retained grid.
+void tgClear(void);
+
+// Starts a new frame. All cells are blank until printed to.
+void tgBeginFrame(void);
+
+// Prints up to TG_COLS - col characters of str into the frame. No control characters.
+void tgPrint(const u32 row, const u32 col, const u8 color, const char *str);
+
+// Tells the renderer the content of rows [top, bottom) moved up by one row.
+// Uses the console scroll if that's cheaper than redrawing the rows.
+void tgScrollUp(const u32 top, const u32 bottom);
+
+// Sends only the changed cells of the frame to the console.
+void tgPresent(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
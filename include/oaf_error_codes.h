@@ -34,8 +34,9 @@ enum
 	// Custom errors.
 	RES_ROM_TOO_BIG            = MAKE_CUSTOM_ERR(0u),
 	RES_INVALID_PATCH          = MAKE_CUSTOM_ERR(1u),
+	RES_PATCH_CHECKSUM         = MAKE_CUSTOM_ERR(2u),
 
-	MAX_OAF_RES_VALUE          = RES_ROM_TOO_BIG
+	MAX_OAF_RES_VALUE          = RES_PATCH_CHECKSUM
 };
 
 #undef MAKE_CUSTOM_ERR
@@ -0,0 +1,60 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include "types.h"
+#include "arm11/arena.h"
+
+
+
+void* arenaAlloc(Arena *const arena, const u32 size)
+{
+	ArenaChunk *chunk = arena->last;
+	if(chunk == NULL || chunk->size - chunk->used < size)
+	{
+		const u32 chunkSize = (size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE);
+		chunk = (ArenaChunk*)malloc(sizeof(ArenaChunk) + chunkSize);
+		if(chunk == NULL) return NULL;
+
+		chunk->next = NULL;
+		chunk->used = 0;
+		chunk->size = chunkSize;
+		if(arena->last != NULL) arena->last->next = chunk;
+		else                    arena->first = chunk;
+		arena->last = chunk;
+	}
+
+	void *const ptr = &chunk->data[chunk->used];
+	chunk->used += size;
+	arena->total += size;
+
+	return ptr;
+}
+
+void arenaFree(Arena *const arena)
+{
+	ArenaChunk *chunk = arena->first;
+	while(chunk != NULL)
+	{
+		ArenaChunk *const next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+
+	arenaInit(arena);
+}
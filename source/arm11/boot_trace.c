@@ -0,0 +1,87 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include "types.h"
+#include "arm11/boot_trace.h"
+#include "arm11/fmt.h"
+#include "fsutil.h"
+
+
+#define TRACE_NAME_MAX    (32u)              // Longest allowed event name.
+#define TRACE_EVENT_JSON  (TRACE_NAME_MAX + 64) // Worst case JSON size per event.
+
+
+typedef struct
+{
+	const char *name;
+	u32 ticks;
+	char phase; // 'B' or 'E'.
+} TraceEvent;
+
+static TraceEvent g_traceEvents[TRACE_MAX_EVENTS];
+static u32 g_traceCount = 0; // Total number of events. Wraps into the ring buffer.
+
+
+
+void traceInit(void)
+{
+	traceStartClock();
+	g_traceCount = 0;
+}
+
+void traceEvent(const char *const name, const char phase)
+{
+	TraceEvent *const event = &g_traceEvents[g_traceCount % TRACE_MAX_EVENTS];
+	event->name  = name;
+	event->ticks = traceGetTicks();
+	event->phase = phase;
+	g_traceCount++;
+}
+
+u32 traceSerialize(char *const buf, const u32 size)
+{
+	if(size < 32 + TRACE_MAX_EVENTS * TRACE_EVENT_JSON) return 0;
+
+	const u32 count = g_traceCount;
+	const u32 first = (count > TRACE_MAX_EVENTS ? count - TRACE_MAX_EVENTS : 0);
+	u32 len = ee_sprintf(buf, "{\"traceEvents\":[\n");
+	for(u32 i = first; i < count; i++)
+	{
+		const TraceEvent *const event = &g_traceEvents[i % TRACE_MAX_EVENTS];
+		const u32 us = traceTicksToUs(event->ticks);
+		len += ee_sprintf(&buf[len], "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%" PRIu32 ",\"pid\":0,\"tid\":0}%s\n",
+		                  event->name, event->phase, us, (i + 1 < count ? "," : ""));
+	}
+	len += ee_sprintf(&buf[len], "]}\n");
+
+	return len;
+}
+
+Result traceDump(const char *const path)
+{
+	const u32 size = 32 + TRACE_MAX_EVENTS * TRACE_EVENT_JSON;
+	char *const buf = (char*)malloc(size);
+	if(buf == NULL) return RES_OUT_OF_MEM;
+
+	const u32 len = traceSerialize(buf, size);
+	const Result res = fsQuickWrite(path, buf, len);
+	free(buf);
+
+	return res;
+}
@@ -0,0 +1,73 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "types.h"
+#include "arm11/border.h"
+
+
+
+bool borderDecode(const void *const file, const u32 fileSize, void *const out)
+{
+	const BorderHeader *const header = (const BorderHeader*)file;
+	if(fileSize < sizeof(BorderHeader) || header->magic != BORDER_MAGIC ||
+	   header->version != BORDER_VERSION || header->rawSize != BORDER_RAW_SIZE ||
+	   header->dataSize > fileSize - sizeof(BorderHeader))
+	{
+		return false;
+	}
+
+	const u8 *in = (const u8*)file + sizeof(BorderHeader);
+	const u8 *const inEnd = in + header->dataSize;
+	u8 *dst = (u8*)out;
+	u8 *const dstEnd = dst + BORDER_RAW_SIZE;
+	while(in < inEnd)
+	{
+		const u32 ctrl = *in++;
+		const u32 pixels = (ctrl & 0x7Fu) + 1;
+		const u32 bytes = pixels * 3;
+		if((u32)(dstEnd - dst) < bytes) return false;
+
+		if(ctrl & 0x80u)
+		{
+			if(inEnd - in < 3) return false;
+
+			const u8 b = in[0];
+			const u8 g = in[1];
+			const u8 r = in[2];
+			in += 3;
+			for(u32 i = 0; i < pixels; i++)
+			{
+				dst[0] = b;
+				dst[1] = g;
+				dst[2] = r;
+				dst += 3;
+			}
+		}
+		else
+		{
+			if((u32)(inEnd - in) < bytes) return false;
+
+			memcpy(dst, in, bytes);
+			in += bytes;
+			dst += bytes;
+		}
+	}
+
+	return dst == dstEnd;
+}
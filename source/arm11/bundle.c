@@ -0,0 +1,182 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "arm11/bundle.h"
+#include "fs.h"
+#include "fsutil.h"
+
+
+static FHandle g_bundleFile;
+static u32 g_numEntries;
+static BundleEntry *g_entries; // NULL if no bundle is open.
+
+
+
+Result bundleOpen(const char *const path)
+{
+	bundleClose();
+
+	FHandle f;
+	Result res = fOpen(&f, path, FA_OPEN_EXISTING | FA_READ);
+	if(res != RES_OK) return res;
+
+	BundleEntry *entries = NULL;
+	do
+	{
+		BundleHeader header;
+		u32 read;
+		res = fRead(f, &header, sizeof(header), &read);
+		if(res == RES_OK && read != sizeof(header)) res = RES_INVALID_ARG;
+		if(res != RES_OK) break;
+
+		const u32 numEntries = header.numEntries;
+		if(header.magic != BUNDLE_MAGIC || header.version != BUNDLE_VERSION ||
+		   numEntries == 0 || numEntries > BUNDLE_MAX_ENTRIES)
+		{
+			res = RES_INVALID_ARG;
+			break;
+		}
+
+		entries = (BundleEntry*)malloc(sizeof(BundleEntry) * numEntries);
+		if(entries == NULL)
+		{
+			res = RES_OUT_OF_MEM;
+			break;
+		}
+
+		res = fRead(f, entries, sizeof(BundleEntry) * numEntries, &read);
+		if(res == RES_OK && read != sizeof(BundleEntry) * numEntries) res = RES_INVALID_ARG;
+		if(res != RES_OK) break;
+
+		// Reject entries pointing outside of the file and directories
+		// findEntry() can't binary search (unsorted or duplicate names).
+		const u32 fileSize = fSize(f);
+		for(u32 i = 0; i < numEntries; i++)
+		{
+			const BundleEntry *const e = &entries[i];
+			if(e->offset > fileSize || e->size > fileSize - e->offset ||
+			   (i > 0 && memcmp(entries[i - 1].name, e->name, BUNDLE_NAME_LEN) >= 0))
+			{
+				res = RES_INVALID_ARG;
+				break;
+			}
+		}
+		if(res != RES_OK) break;
+
+		g_bundleFile = f;
+		g_numEntries = numEntries;
+		g_entries    = entries;
+	} while(0);
+
+	if(res != RES_OK)
+	{
+		free(entries);
+		fClose(f);
+	}
+
+	return res;
+}
+
+void bundleClose(void)
+{
+	if(g_entries == NULL) return;
+
+	fClose(g_bundleFile);
+	free(g_entries);
+	g_entries    = NULL;
+	g_numEntries = 0;
+}
+
+static const BundleEntry* findEntry(const char *const name)
+{
+	if(g_entries == NULL) return NULL;
+
+	// Names are zero padded so comparing the whole field sorts like strcmp().
+	char key[BUNDLE_NAME_LEN] = {0};
+	const size_t nameLen = strlen(name);
+	if(nameLen > BUNDLE_NAME_LEN) return NULL;
+	memcpy(key, name, nameLen);
+
+	u32 lo = 0;
+	u32 hi = g_numEntries;
+	while(lo < hi)
+	{
+		const u32 mid = (lo + hi) / 2;
+		const int cmp = memcmp(key, g_entries[mid].name, BUNDLE_NAME_LEN);
+		if(cmp == 0) return &g_entries[mid];
+
+		if(cmp < 0) hi = mid;
+		else        lo = mid + 1;
+	}
+
+	return NULL;
+}
+
+static Result readEntry(const BundleEntry *const e, void *const buf, const u32 size, u32 *const bytesRead)
+{
+	const u32 readSize = (size < e->size ? size : e->size);
+	u32 read = 0;
+	Result res = fLseek(g_bundleFile, e->offset);
+	if(res == RES_OK) res = fRead(g_bundleFile, buf, readSize, &read);
+	if(res == RES_OK && read != readSize) res = RES_INVALID_ARG;
+	if(bytesRead != NULL) *bytesRead = read;
+
+	return res;
+}
+
+Result bundleQuickRead(const char *const name, void *const buf, const u32 size)
+{
+	const BundleEntry *const e = findEntry(name);
+	if(e == NULL) return fsQuickRead(name, buf, size);
+
+	return readEntry(e, buf, size, NULL);
+}
+
+Result bundleRead(const char *const name, void *const buf, const u32 size, u32 *const bytesRead)
+{
+	const BundleEntry *const e = findEntry(name);
+	if(e != NULL) return readEntry(e, buf, size, bytesRead);
+
+	FHandle f;
+	Result res = fOpen(&f, name, FA_OPEN_EXISTING | FA_READ);
+	if(res != RES_OK) return res;
+
+	res = fRead(f, buf, size, bytesRead);
+	fClose(f);
+
+	return res;
+}
+
+Result bundleLoadPathFromFile(const char *const name, char outPath[512])
+{
+	const BundleEntry *const e = findEntry(name);
+	if(e == NULL) return fsLoadPathFromFile(name, outPath);
+
+	u32 pathLen;
+	const Result res = readEntry(e, outPath, 511, &pathLen);
+	if(res != RES_OK) return res;
+
+	// Cut off the line ending if any.
+	outPath[pathLen] = '\0';
+	outPath[strcspn(outPath, "\r\n")] = '\0';
+
+	return RES_OK;
+}
@@ -0,0 +1,298 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "types.h"
+#include "arm11/color_lut.h"
+#include "arm11/config.h"
+#include "arm11/fmt.h"
+#include "drivers/cache.h"
+#include "drivers/sha.h"
+#include "fsutil.h"
+#include "util.h"
+
+
+#define LUT_FRAC_BITS  (24u) // Fixed-point fraction bits of the color matrix stage.
+
+
+
+// libretro shader values. Credits: hunterk and Pokefan531.
+// Last updated 2014-12-03.
+const ColorProfile g_colorProfiles[8] =
+{
+	{ // libretro GBA color (sRGB).
+		2.2f + (0.3f * 1.6f), // Darken screen. Default 0. Modified to 0.3.
+		0.91f,
+		0.905f,  0.195f,  -0.1f,
+		0.1f,    0.65f,    0.25f,
+		0.1575f, 0.1425f,  0.7f,
+		1.f / 2.2f
+	},
+	{ // libretro GB micro color (sRGB).
+		2.2f,
+		0.9f,
+		0.8025f, 0.31f,   -0.1125f,
+		0.1f,    0.6875f,  0.2125f,
+		0.1225f, 0.1125f,  0.765f,
+		1.f / 2.2f
+	},
+	{ // libretro GBA SP (AGS-101) color (sRGB).
+		2.2f,
+		0.935f,
+		0.96f,    0.11f, -0.07f,
+		0.0325f,  0.89f,  0.0775f,
+		0.001f,  -0.03f,  1.029f,
+		1.f / 2.2f
+	},
+	{ // libretro NDS color (sRGB).
+		2.2f,
+		0.905f,
+		0.835f, 0.27f,   -0.105f,
+		0.1f,   0.6375f,  0.2625f,
+		0.105f, 0.175f,   0.72f,
+		1.f / 2.2f
+	},
+	{ // libretro NDS lite color (sRGB).
+		2.2f,
+		0.935f,
+		0.93f,   0.14f, -0.07f,
+		0.025f,  0.9f,   0.075f,
+		0.008f, -0.03f,  1.022f,
+		1.f / 2.2f
+	},
+	{ // libretro Nintendo Switch Online color (sRGB).
+		2.2f + 0.8f, // Darken screen. Default 0.8.
+		1.f,
+		0.865f,  0.1225f, 0.0125f,
+		0.0575f, 0.925f,  0.0125f,
+		0.0575f, 0.1225f, 0.82f,
+		1.f / 2.2f
+	},
+	{ // libretro Visual Boy Advance/No$GBA full color.
+		1.45f + 1.f, // Darken screen. Default 1.
+		1.f,
+		0.73f,   0.27f,   0.f,
+		0.0825f, 0.6775f, 0.24f,
+		0.0825f, 0.24f,   0.6775f,
+		1.f / 1.45f
+	},
+	{ // Identity.
+		1.f,
+		1.f,
+		1.f, 0.f, 0.f,
+		0.f, 1.f, 0.f,
+		0.f, 0.f, 1.f,
+		1.f / 1.f
+	}
+};
+
+ALWAYS_INLINE float clamp_float(const float x, const float min, const float max)
+{
+	return (x < min ? min : (x > max ? max : x));
+}
+
+static u8 displayLevel(const s32 x, const float targetContrast, const float displayGamma)
+{
+	// Same math as the per entry float path. x is in fixed-point.
+	const float tmp = powf(targetContrast * ((float)x * (1.f / (1u<<LUT_FRAC_BITS))), displayGamma);
+	return clamp_s32(lroundf(tmp * 255), 0, 255);
+}
+
+static void makeDisplayThresholds(s32 thresholds[256], const float targetContrast, const float displayGamma)
+{
+	// thresholds[k] is the smallest fixed-point value mapping to output level k or above.
+	// Display gamma and contrast are monotonic so a binary search per level is enough.
+	thresholds[0] = INT32_MIN;
+	s32 lo = 0;
+	for(u32 k = 1; k < 256; k++)
+	{
+		s32 hi = INT32_MAX;
+		if(displayLevel(hi, targetContrast, displayGamma) >= k)
+		{
+			while(lo < hi)
+			{
+				const s32 mid = lo + (hi - lo) / 2;
+				if(displayLevel(mid, targetContrast, displayGamma) >= k) hi = mid;
+				else                                                     lo = mid + 1;
+			}
+		}
+		thresholds[k] = hi;
+		lo = hi;
+	}
+}
+
+ALWAYS_INLINE u32 quantizeDisplay(const s32 thresholds[256], const s32 x)
+{
+	// Branchless binary search for the highest level <= x.
+	u32 level = 0;
+	for(u32 step = 128; step > 0; step >>= 1)
+		level += (thresholds[level + step] <= x ? step : 0);
+
+	return level;
+}
+
+void makeColorLut(const ColorProfile *const p, u32 *const lut)
+{
+	const float targetGamma    = p->targetGamma;
+	const float contrast       = g_oafConfig.contrast;
+	const float brightness     = g_oafConfig.brightness / contrast;
+	const float targetContrast = powf(contrast, targetGamma);
+
+	// Calculate saturation weights.
+	// Note: We are using the Rec. 709 luminance vector here.
+	const float sat   = g_oafConfig.saturation;
+	const float rwgt  = (1.f - sat) * 0.2126f;
+	const float gwgt  = (1.f - sat) * 0.7152f;
+	const float bwgt  = (1.f - sat) * 0.0722f;
+
+	// Every channel only has 32 possible values. Convert them
+	// to linear gamma with brightness and luminance applied.
+	float lin[32];
+	for(u32 i = 0; i < 32; i++)
+	{
+		float x = powf((float)rgbFive2Eight(i) / 255 + brightness, targetGamma);
+		x = x * p->lum;
+		lin[i] = (x > 0.f ? (x < 1.f ? x : 1.f) : 0.f); // Also catches NaN.
+	}
+
+	/*
+	 *               Input
+	 *                [r]
+	 *                [g]
+	 *                [b]
+	 *
+	 * Correction    Output
+	 * [ r][gr][br]   [r]
+	 * [rg][ g][bg]   [g]
+	 * [rb][gb][ b]   [b]
+	 *
+	 * Fold saturation into the correction matrix.
+	*/
+	const float satMatrix[3][3] =
+	{
+		{rwgt + sat, gwgt,       bwgt},
+		{rwgt,       gwgt + sat, bwgt},
+		{rwgt,       gwgt,       bwgt + sat}
+	};
+	const float corrMatrix[3][3] =
+	{
+		{p->r,  p->gr, p->br},
+		{p->rg, p->g,  p->bg},
+		{p->rb, p->gb, p->b}
+	};
+
+	// The matrix is applied by summing precomputed fixed-point
+	// products of each input channel. Index [output][input][value].
+	s32 products[3][3][32];
+	for(u32 o = 0; o < 3; o++)
+	{
+		for(u32 in = 0; in < 3; in++)
+		{
+			const float coeff = satMatrix[o][0] * corrMatrix[0][in] +
+			                    satMatrix[o][1] * corrMatrix[1][in] +
+			                    satMatrix[o][2] * corrMatrix[2][in];
+			for(u32 i = 0; i < 32; i++)
+			{
+				// Clamp so the sum of 3 products can't overflow.
+				float tmp = coeff * lin[i] * (1u<<LUT_FRAC_BITS);
+				tmp = clamp_float(tmp, (float)(INT32_MIN / 4), (float)(INT32_MAX / 4));
+				products[o][in][i] = lroundf(tmp);
+			}
+		}
+	}
+
+	// Convert to display gamma via thresholds for all 256 output levels.
+	s32 thresholds[256];
+	makeDisplayThresholds(thresholds, targetContrast, p->displayGamma);
+
+	u32 *colorLut = lut;
+	for(u32 r = 0; r < 32; r++)
+	{
+		for(u32 g = 0; g < 32; g++)
+		{
+			const s32 rgR = products[0][0][r] + products[0][1][g];
+			const s32 rgG = products[1][0][r] + products[1][1][g];
+			const s32 rgB = products[2][0][r] + products[2][1][g];
+			for(u32 b = 0; b < 32; b++)
+			{
+				// Convert to ABGR8 and write lut.
+				u32 entry = 255; // Alpha.
+				entry |= quantizeDisplay(thresholds, rgB + products[2][2][b])<<8;
+				entry |= quantizeDisplay(thresholds, rgG + products[1][2][b])<<16;
+				entry |= quantizeDisplay(thresholds, rgR + products[0][2][b])<<24;
+				*colorLut++ = entry;
+			}
+		}
+	}
+
+	flushDCacheRange(lut, COLOR_LUT_SIZE);
+}
+
+static void hashColorLut(const ColorProfile *const p, const u32 *const lut, u32 digest[5])
+{
+	// Everything makeColorLut() depends on. Padded to whole SHA blocks.
+	alignas(4) u8 key[128];
+	memset(key, 0, sizeof(key));
+	const u32 version = LUT_CACHE_VERSION;
+	memcpy(&key[0], &version, 4);
+	memcpy(&key[4], &g_oafConfig.contrast, 4);
+	memcpy(&key[8], &g_oafConfig.brightness, 4);
+	memcpy(&key[12], &g_oafConfig.saturation, 4);
+	memcpy(&key[16], p, sizeof(ColorProfile));
+
+	SHA_start(SHA_IN_BIG | SHA_1_MODE);
+	SHA_update((u32*)key, sizeof(key));
+	SHA_update(lut, COLOR_LUT_SIZE);
+	SHA_finish(digest, SHA_OUT_BIG);
+}
+
+void loadColorLut(const ColorProfile *const p, u32 *const lut, void *const tmpBuf)
+{
+	// The cached lut is only valid if the digest over the current
+	// settings and the stored lut matches. Catches corruption too.
+	LutCacheHeader *const header = (LutCacheHeader*)tmpBuf;
+	u32 *const cachedLut = (u32*)((u8*)tmpBuf + sizeof(LutCacheHeader));
+	Result res = fsQuickRead(LUT_CACHE_PATH, tmpBuf, sizeof(LutCacheHeader) + COLOR_LUT_SIZE);
+	if(res == RES_OK && header->magic == LUT_CACHE_MAGIC &&
+	   header->version == LUT_CACHE_VERSION && header->lutSize == COLOR_LUT_SIZE)
+	{
+		u32 digest[5];
+		hashColorLut(p, cachedLut, digest);
+		if(memcmp(digest, header->digest, sizeof(digest)) == 0)
+		{
+			memcpy(lut, cachedLut, COLOR_LUT_SIZE);
+			flushDCacheRange(lut, COLOR_LUT_SIZE);
+			return;
+		}
+	}
+
+	// Cache miss. Generate and write back.
+	makeColorLut(p, lut);
+	header->magic   = LUT_CACHE_MAGIC;
+	header->version = LUT_CACHE_VERSION;
+	header->lutSize = COLOR_LUT_SIZE;
+	memcpy(cachedLut, lut, COLOR_LUT_SIZE);
+	hashColorLut(p, cachedLut, header->digest);
+	res = fsQuickWrite(LUT_CACHE_PATH, tmpBuf, sizeof(LutCacheHeader) + COLOR_LUT_SIZE);
+	if(res != RES_OK)
+	{
+		// Not fatal. We just regenerate next time.
+		ee_printf("Failed to write color lut cache: %s\n", result2String(res));
+	}
+}
@@ -16,82 +16,165 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include "types.h"
 #include "arm11/config.h"
+#include "arm11/fmt.h"
 #include "inih/ini.h"
 #include "util.h"
 #include "fsutil.h"
+#include "arm11/bundle.h"
 
 
-#define INI_BUF_SIZE    (1024u)
-#define DEFAULT_CONFIG  "[general]\n"             \
-                        "backlight=64\n"          \
-                        "backlightSteps=5\n"      \
-                        "directBoot=false\n"      \
-                        "useGbaDb=true\n"         \
-                        "useSavesFolder=true\n\n" \
-                                                  \
-                        "[video]\n"               \
-                        "scaler=matrix\n"         \
-                        "colorProfile=none\n"     \
-                        "contrast=1.0\n"          \
-                        "brightness=0.0\n"        \
-                        "saturation=1.0\n\n"      \
-                                                  \
-                        "[audio]\n"               \
-                        "audioOut=auto\n"         \
-                        "volume=127\n\n"          \
-                                                  \
-                        "[advanced]\n"            \
-                        "saveOverride=false\n"    \
-                        "defaultSave=sram_256k"
+#define INI_BUF_SIZE  (1024u)
 
 
+typedef enum
+{
+	CFG_TYPE_U8    = 0u,
+	CFG_TYPE_S8    = 1u,
+	CFG_TYPE_BOOL  = 2u, // Only "true" enables it.
+	CFG_TYPE_BOOLF = 3u, // Anything except "false" enables it.
+	CFG_TYPE_FLOAT = 4u,
+	CFG_TYPE_ENUM  = 5u  // u8 or u16 field.
+} CfgType;
+
+// Option is written to new config files even if it has the default value.
+#define CFG_FLAG_NEW  (1u)
+
+typedef struct
+{
+	const char *str;
+	u8 val;
+} CfgEnumVal;
+
+typedef struct
+{
+	const char *key;
+	u8 keyLen;                  // strlen(key). Compared before the key itself.
+	u8 type;                    // CfgType.
+	u8 flags;
+	u8 size;                    // Field size in bytes.
+	u16 offset;                 // offsetof(OafConfig, field).
+	s16 min;                    // Integer range. Values outside are clamped.
+	s16 max;
+	const CfgEnumVal *enumVals; // Terminated by a NULL string.
+} CfgOption;
+
+typedef struct
+{
+	const char *name;
+	const CfgOption *options;
+	u8 nameLen;
+	u8 numOptions;
+} CfgSection;
+
+
+
+static const CfgEnumVal g_scalerVals[] =
+{
+	{"none", 0}, {"bilinear", 1}, {"matrix", 2}, {NULL, 0}
+};
+
+static const CfgEnumVal g_colorProfileVals[] =
+{
+	{"none", 0}, {"gba", 1}, {"gb_micro", 2}, {"gba_sp101", 3}, {"nds", 4},
+	{"ds_lite", 5}, {"nso", 6}, {"vba", 7}, {"identity", 8},
+	//{"custom", 9}, // TODO: Implement user provided profile.
+	{NULL, 0}
+};
+
+static const CfgEnumVal g_audioOutVals[] =
+{
+	{"auto", 0}, {"speakers", 1}, {"headphones", 2}, {NULL, 0}
+};
+
+// defaultSave uses this without the "auto" entry.
+static const CfgEnumVal g_saveTypeVals[] =
+{
+	{"auto", 255},
+	{"eeprom_8k", 0}, {"rom_256m_eeprom_8k", 1}, {"eeprom_64k", 2}, {"rom_256m_eeprom_64k", 3},
+	{"flash_512k_atmel_rtc", 4}, {"flash_512k_atmel", 5}, {"flash_512k_sst_rtc", 6}, {"flash_512k_sst", 7},
+	{"flash_512k_panasonic_rtc", 8}, {"flash_512k_panasonic", 9}, {"flash_1m_macronix_rtc", 10},
+	{"flash_1m_macronix", 11}, {"flash_1m_sanyo_rtc", 12}, {"flash_1m_sanyo", 13}, {"sram_256k", 14},
+	{"none", 15}, {NULL, 0}
+};
+
+// Config schema. Options are written in this order.
+// X(field, type, default, min, max, enumVals, flags)
+#define CFG_GENERAL(X)                                                              \
+	X(backlight,      CFG_TYPE_U8,    64,    0, 255, NULL,               CFG_FLAG_NEW) \
+	X(backlightSteps, CFG_TYPE_U8,    5,     0, 255, NULL,               CFG_FLAG_NEW) \
+	X(directBoot,     CFG_TYPE_BOOLF, false, 0, 1,   NULL,               CFG_FLAG_NEW) \
+	X(sortIgnoreCase, CFG_TYPE_BOOL,  false, 0, 1,   NULL,               0)            \
+	X(sortNatural,    CFG_TYPE_BOOL,  false, 0, 1,   NULL,               0)            \
+	X(useGbaDb,       CFG_TYPE_BOOL,  true,  0, 1,   NULL,               CFG_FLAG_NEW) \
+	X(useSavesFolder, CFG_TYPE_BOOL,  true,  0, 1,   NULL,               CFG_FLAG_NEW)
+
+#define CFG_VIDEO(X)                                                                \
+	X(brightness,     CFG_TYPE_FLOAT, 0.f,   0, 0,   NULL,               CFG_FLAG_NEW) \
+	X(colorProfile,   CFG_TYPE_ENUM,  0,     0, 0,   g_colorProfileVals, CFG_FLAG_NEW) \
+	X(contrast,       CFG_TYPE_FLOAT, 1.f,   0, 0,   NULL,               CFG_FLAG_NEW) \
+	X(saturation,     CFG_TYPE_FLOAT, 1.f,   0, 0,   NULL,               CFG_FLAG_NEW) \
+	X(scaler,         CFG_TYPE_ENUM,  2,     0, 0,   g_scalerVals,       CFG_FLAG_NEW)
+
+#define CFG_AUDIO(X)                                                                  \
+	X(audioOut,       CFG_TYPE_ENUM,  0,     0,    0,   g_audioOutVals,    CFG_FLAG_NEW) \
+	X(volume,         CFG_TYPE_S8,    127,   -128, 127, NULL,              CFG_FLAG_NEW) /* Control via volume slider. */
+
+#define CFG_GAME(X)                                                                 \
+	X(saveSlot,       CFG_TYPE_U8,    0,     0, 9,   NULL,               0)            \
+	X(saveType,       CFG_TYPE_ENUM,  255,   0, 0,   g_saveTypeVals,     0)
+
+#define CFG_ADVANCED(X)                                                             \
+	X(defaultSave,    CFG_TYPE_ENUM,  14,    0, 0,   &g_saveTypeVals[1], CFG_FLAG_NEW) \
+	X(saveOverride,   CFG_TYPE_BOOLF, false, 0, 1,   NULL,               CFG_FLAG_NEW)
+
+#define CFG_INIT(field, type, def, min, max, enumVals, flags)  .field = def,
+#define CFG_OPTION(field, type, def, min, max, enumVals, flags)                                              \
+	{#field, sizeof(#field) - 1, type, flags, sizeof(((OafConfig*)0)->field), offsetof(OafConfig, field), min, max, enumVals},
+
+static const CfgOption g_generalOptions[]  = {CFG_GENERAL(CFG_OPTION)};
+static const CfgOption g_videoOptions[]    = {CFG_VIDEO(CFG_OPTION)};
+static const CfgOption g_audioOptions[]    = {CFG_AUDIO(CFG_OPTION)};
+static const CfgOption g_gameOptions[]     = {CFG_GAME(CFG_OPTION)};
+static const CfgOption g_advancedOptions[] = {CFG_ADVANCED(CFG_OPTION)};
+
+// In the order they are written. [input] has no options and is handled separately.
+static const CfgSection g_cfgSections[] =
+{
+	{"general",  g_generalOptions,   sizeof("general") - 1,   arrayEntries(g_generalOptions)},
+	{"video",    g_videoOptions,     sizeof("video") - 1,     arrayEntries(g_videoOptions)},
+	{"audio",    g_audioOptions,     sizeof("audio") - 1,     arrayEntries(g_audioOptions)},
+	{"input",    NULL,               sizeof("input") - 1,     0},
+	{"game",     g_gameOptions,      sizeof("game") - 1,      arrayEntries(g_gameOptions)},
+	{"advanced", g_advancedOptions,  sizeof("advanced") - 1,  arrayEntries(g_advancedOptions)}
+};
+
+#define CFG_DEFAULTS                \
+{                                   \
+	CFG_GENERAL(CFG_INIT)           \
+	CFG_VIDEO(CFG_INIT)             \
+	CFG_AUDIO(CFG_INIT)             \
+	.buttonMaps = {0}, /* [input] */ \
+	CFG_GAME(CFG_INIT)              \
+	CFG_ADVANCED(CFG_INIT)          \
+}
+
+static const OafConfig g_defaultConfig = CFG_DEFAULTS;
 
 // Default config.
-OafConfig g_oafConfig =
+OafConfig g_oafConfig = CFG_DEFAULTS;
+
+static const char *const g_buttonStrLut[32] =
 {
-	// [general]
-	64,    // backlight
-	5,     // backlightSteps
-	false, // directBoot
-	true,  // useGbaDb
-	true,  // useSavesFolder
-
-	// [video]
-	2,     // scaler
-	0,     // colorProfile
-	1.f,   // contrast
-	0.f,   // brightness
-	1.f,   // saturation
-
-	// [audio]
-	0,     // Automatic audio output.
-	127,   // Control via volume slider.
-
-	// [input]
-	{      // buttonMaps
-		0, // A
-		0, // B
-		0, // Select
-		0, // Start
-		0, // Right
-		0, // Left
-		0, // Up
-		0, // Down
-		0, // R
-		0  // L
-	},
-
-	// [game]
-	0,     // saveSlot
-	255,   // saveType
-
-	// [advanced]
-	false, // saveOverride
-	14     // defaultSave
+	"A", "B", "SELECT", "START", "RIGHT", "LEFT", "UP", "DOWN",
+	"R", "L", "X", "Y", "", "", "ZL", "ZR",
+	"", "", "", "", "TOUCH", "", "", "",
+	"CS_RIGHT", "CS_LEFT", "CS_UP", "CS_DOWN", "CP_RIGHT", "CP_LEFT", "CP_UP", "CP_DOWN"
 };
 
 
@@ -105,13 +188,6 @@ static u32 parseButtons(const char *str)
 	strncpy(buf, str, 31);
 
 	char *bufPtr = buf;
-	static const char *const buttonStrLut[32] =
-	{
-		"A", "B", "SELECT", "START", "RIGHT", "LEFT", "UP", "DOWN",
-		"R", "L", "X", "Y", "", "", "ZL", "ZR",
-		"", "", "", "", "TOUCH", "", "", "",
-		"CS_RIGHT", "CS_LEFT", "CS_UP", "CS_DOWN", "CP_RIGHT", "CP_LEFT", "CP_UP", "CP_DOWN"
-	};
 	u32 map = 0;
 	while(1)
 	{
@@ -119,7 +195,7 @@ static u32 parseButtons(const char *str)
 		if(nextDelimiter != NULL) *nextDelimiter = '\0';
 
 		unsigned i = 0;
-		while(i < 32 && strcmp(buttonStrLut[i], bufPtr) != 0) ++i;
+		while(i < 32 && strcmp(g_buttonStrLut[i], bufPtr) != 0) ++i;
 		if(i == 32) break;
 		map |= 1u<<i;
 
@@ -132,192 +208,267 @@ static u32 parseButtons(const char *str)
 	return map & ~(1u<<12);
 }
 
-static int cfgIniCallback(void *user, const char *section, const char *name, const char *value)
+// Both lookups compare the precomputed length first. Few names share a length
+// so this is mostly a byte compare per entry and at most a couple memcmp().
+static const CfgSection* findSection(const char *const name)
 {
-	OafConfig *const config = (OafConfig*)user;
+	const size_t len = strlen(name);
+	for(unsigned i = 0; i < arrayEntries(g_cfgSections); i++)
+	{
+		const CfgSection *const sect = &g_cfgSections[i];
+		if(sect->nameLen == len && memcmp(sect->name, name, len) == 0) return sect;
+	}
 
-	if(strcmp(section, "general") == 0)
+	return NULL;
+}
+
+static const CfgOption* findOption(const CfgSection *const section, const char *const key)
+{
+	const size_t len = strlen(key);
+	const CfgOption *const options = section->options;
+	for(unsigned i = 0; i < section->numOptions; i++)
 	{
-		if(strcmp(name, "backlight") == 0)
-			config->backlight = (u8)strtoul(value, NULL, 10);
-		else if(strcmp(name, "backlightSteps") == 0)
-			config->backlightSteps = (u8)strtoul(value, NULL, 10);
-		else if(strcmp(name, "directBoot") == 0)
-			config->directBoot = (strcmp(value, "false") == 0 ? false : true);
-		else if(strcmp(name, "useGbaDb") == 0)
-			config->useGbaDb = (strcmp(value, "true") == 0 ? true : false);
-		else if(strcmp(name, "useSavesFolder") == 0)
-			config->useSavesFolder = (strcmp(value, "true") == 0 ? true : false);
+		if(options[i].keyLen == len && memcmp(options[i].key, key, len) == 0) return &options[i];
 	}
-	else if(strcmp(section, "video") == 0)
+
+	return NULL;
+}
+
+#ifndef NDEBUG
+// findOption() returns the first match so a duplicate key would never be parsed.
+static bool optionsUnique(const CfgSection *const section)
+{
+	for(unsigned i = 1; i < section->numOptions; i++)
 	{
-		if(strcmp(name, "scaler") == 0)
+		for(unsigned j = 0; j < i; j++)
 		{
-			if(strcmp(value, "none") == 0)
-				config->scaler = 0;
-			else if(strcmp(value, "bilinear") == 0)
-				config->scaler = 1;
-			else if(strcmp(value, "matrix") == 0)
-				config->scaler = 2;
+			if(strcmp(section->options[j].key, section->options[i].key) == 0) return false;
 		}
-		else if(strcmp(name, "colorProfile") == 0)
-		{
-			if(strcmp(value, "none") == 0)
-				config->colorProfile = 0;
-			else if(strcmp(value, "gba") == 0)
-				config->colorProfile = 1;
-			else if(strcmp(value, "gb_micro") == 0)
-				config->colorProfile = 2;
-			else if(strcmp(value, "gba_sp101") == 0)
-				config->colorProfile = 3;
-			else if(strcmp(value, "nds") == 0)
-				config->colorProfile = 4;
-			else if(strcmp(value, "ds_lite") == 0)
-				config->colorProfile = 5;
-			else if(strcmp(value, "nso") == 0)
-				config->colorProfile = 6;
-			else if(strcmp(value, "vba") == 0)
-				config->colorProfile = 7;
-			else if(strcmp(value, "identity") == 0)
-				config->colorProfile = 8;
-			//else if(strcmp(value, "custom") == 0) // TODO: Implement user provided profile.
-			//	config->colorProfile = 9;
-		}
-		else if(strcmp(name, "contrast") == 0)
-			config->contrast = str2float(value);
-		else if(strcmp(name, "brightness") == 0)
-			config->brightness = str2float(value);
-		else if(strcmp(name, "saturation") == 0)
-			config->saturation = str2float(value);
 	}
-	else if(strcmp(section, "audio") == 0)
+
+	return true;
+}
+#endif
+
+static void setField(void *const field, const u8 size, const u32 val)
+{
+	if(size == 1) *(u8*)field = (u8)val;
+	else          *(u16*)field = (u16)val;
+}
+
+static u32 getField(const void *const field, const u8 size)
+{
+	return (size == 1 ? *(const u8*)field : *(const u16*)field);
+}
+
+static void parseOption(const CfgOption *const opt, OafConfig *const config, const char *const value)
+{
+	void *const field = (u8*)config + opt->offset;
+	switch(opt->type)
 	{
-		if(strcmp(name, "audioOut") == 0)
-		{
-			if(strcmp(value, "auto") == 0)
-				config->audioOut = 0;
-			else if(strcmp(value, "speakers") == 0)
-				config->audioOut = 1;
-			else if(strcmp(value, "headphones") == 0)
-				config->audioOut = 2;
-		}
-		else if(strcmp(name, "volume") == 0)
-			config->volume = (s8)strtol(value, NULL, 10);
+		case CFG_TYPE_U8:
+			*(u8*)field = (u8)clamp_s32(strtoul(value, NULL, 10), opt->min, opt->max);
+			break;
+		case CFG_TYPE_S8:
+			*(s8*)field = (s8)clamp_s32(strtol(value, NULL, 10), opt->min, opt->max);
+			break;
+		case CFG_TYPE_BOOL:
+			*(bool*)field = (strcmp(value, "true") == 0);
+			break;
+		case CFG_TYPE_BOOLF:
+			*(bool*)field = (strcmp(value, "false") != 0);
+			break;
+		case CFG_TYPE_FLOAT:
+			*(float*)field = str2float(value);
+			break;
+		case CFG_TYPE_ENUM:
+			// Unknown strings keep the old value.
+			for(const CfgEnumVal *e = opt->enumVals; e->str != NULL; e++)
+			{
+				if(strcmp(e->str, value) == 0)
+				{
+					setField(field, opt->size, e->val);
+					break;
+				}
+			}
+			break;
 	}
-	else if(strcmp(section, "input") == 0)
+}
+
+static int cfgIniCallback(void *user, const char *section, const char *name, const char *value)
+{
+	OafConfig *const config = (OafConfig*)user;
+
+	const CfgSection *const sect = findSection(section);
+	if(sect == NULL) return 0; // Error.
+
+	if(sect->options == NULL) // [input]
 	{
 		const u32 button = parseButtons(name) & 0x3FFu; // Only allow GBA buttons.
 		if(button != 0)
 		{
 			// If the config option happens to abuse parseButtons() we will only use the highest bit.
-			const u32 shift = 31u - __builtin_clzl(button);
+			const u32 shift = 31u - __builtin_clz(button);
 			const u32 map   = parseButtons(value);
 			config->buttonMaps[shift] = map;
 		}
 	}
-	else if(strcmp(section, "game") == 0)
+	else
 	{
-		if(strcmp(name, "saveSlot") == 0)
-			config->saveSlot = (u8)strtoul(value, NULL, 10);
-		if(strcmp(name, "saveType") == 0)
+		const CfgOption *const opt = findOption(sect, name);
+		if(opt != NULL) parseOption(opt, config, value);
+	}
+
+	return 1; // 1 is no error? Really?
+}
+
+// Appends to buf without overflowing it. Returns false if the string didn't fit.
+static bool appendStr(char *const buf, u32 *const len, const char *const str)
+{
+	const u32 strLen = strlen(str);
+	if(*len + strLen >= INI_BUF_SIZE) return false;
+
+	memcpy(&buf[*len], str, strLen + 1);
+	*len += strLen;
+
+	return true;
+}
+
+// Formats a float with up to 3 decimal places without relying on printf float support.
+static void float2str(char *const out, const float val)
+{
+	const bool neg = val < 0.f;
+	const u32 fixed = (u32)((neg ? -val : val) * 1000.f + 0.5f);
+	u32 len = ee_sprintf(out, "%s%lu.%03lu", (neg ? "-" : ""), fixed / 1000, fixed % 1000);
+
+	// Strip trailing zeros but keep at least one decimal.
+	while(out[len - 1] == '0' && out[len - 2] != '.') out[--len] = '\0';
+}
+
+static void formatOption(char *const out, const CfgOption *const opt, const OafConfig *const config)
+{
+	const void *const field = (const u8*)config + opt->offset;
+	switch(opt->type)
+	{
+		case CFG_TYPE_U8:
+			ee_sprintf(out, "%u", *(const u8*)field);
+			break;
+		case CFG_TYPE_S8:
+			ee_sprintf(out, "%d", *(const s8*)field);
+			break;
+		case CFG_TYPE_BOOL:
+		case CFG_TYPE_BOOLF:
+			strcpy(out, (*(const bool*)field ? "true" : "false"));
+			break;
+		case CFG_TYPE_FLOAT:
+			float2str(out, *(const float*)field);
+			break;
+		case CFG_TYPE_ENUM:
 		{
-			if(strcmp(value, "eeprom_8k") == 0)
-				config->saveType = 0;
-			if(strcmp(value, "rom_256m_eeprom_8k") == 0)
-				config->saveType = 1;
-			if(strcmp(value, "eeprom_64k") == 0)
-				config->saveType = 2;
-			if(strcmp(value, "rom_256m_eeprom_64k") == 0)
-				config->saveType = 3;
-			if(strcmp(value, "flash_512k_atmel_rtc") == 0)
-				config->saveType = 4;
-			if(strcmp(value, "flash_512k_atmel") == 0)
-				config->saveType = 5;
-			if(strcmp(value, "flash_512k_sst_rtc") == 0)
-				config->saveType = 6;
-			if(strcmp(value, "flash_512k_sst") == 0)
-				config->saveType = 7;
-			if(strcmp(value, "flash_512k_panasonic_rtc") == 0)
-				config->saveType = 8;
-			if(strcmp(value, "flash_512k_panasonic") == 0)
-				config->saveType = 9;
-			if(strcmp(value, "flash_1m_macronix_rtc") == 0)
-				config->saveType = 10;
-			if(strcmp(value, "flash_1m_macronix") == 0)
-				config->saveType = 11;
-			if(strcmp(value, "flash_1m_sanyo_rtc") == 0)
-				config->saveType = 12;
-			if(strcmp(value, "flash_1m_sanyo") == 0)
-				config->saveType = 13;
-			if(strcmp(value, "sram_256k") == 0)
-				config->saveType = 14;
-			if(strcmp(value, "none") == 0)
-				config->saveType = 15;
-			if(strcmp(value, "auto") == 0)
-				config->saveType = 255;
+			const u32 val = getField(field, opt->size);
+			const CfgEnumVal *e = opt->enumVals;
+			while(e->str != NULL && e->val != val) e++;
+			// Values without a name can't be written. Fall back to the default.
+			if(e->str == NULL)
+			{
+				const u32 def = getField((const u8*)&g_defaultConfig + opt->offset, opt->size);
+				e = opt->enumVals;
+				while(e->str != NULL && e->val != def) e++;
+			}
+			strcpy(out, (e->str != NULL ? e->str : ""));
+			break;
 		}
 	}
-	else if(strcmp(section, "advanced") == 0)
+}
+
+static void formatButtons(char *const out, const u32 map)
+{
+	char *ptr = out;
+	*ptr = '\0';
+	for(unsigned i = 0; i < 32; i++)
+	{
+		if((map & (1u<<i)) == 0 || *g_buttonStrLut[i] == '\0') continue;
+
+		if(ptr != out) *ptr++ = ',';
+		strcpy(ptr, g_buttonStrLut[i]);
+		ptr += strlen(ptr);
+	}
+}
+
+// Options in new configs and options not at their default value are written.
+static Result writeConfig(const char *const path, const OafConfig *const config)
+{
+	char *const iniBuf = (char*)malloc(INI_BUF_SIZE);
+	if(iniBuf == NULL) return RES_OUT_OF_MEM;
+
+	u32 len = 0;
+	bool fits = true;
+	iniBuf[0] = '\0';
+	for(unsigned s = 0; s < arrayEntries(g_cfgSections); s++)
 	{
-		if(strcmp(name, "saveOverride") == 0)
-			config->saveOverride = (strcmp(value, "false") == 0 ? false : true);
-		if(strcmp(name, "defaultSave") == 0)
+		const CfgSection *const sect = &g_cfgSections[s];
+		bool headerDone = false;
+		char line[64];
+
+		const unsigned numLines = (sect->options != NULL ? sect->numOptions : arrayEntries(config->buttonMaps));
+		for(unsigned i = 0; i < numLines; i++)
 		{
-			if(strcmp(value, "eeprom_8k") == 0)
-				config->defaultSave = 0;
-			if(strcmp(value, "rom_256m_eeprom_8k") == 0)
-				config->defaultSave = 1;
-			if(strcmp(value, "eeprom_64k") == 0)
-				config->defaultSave = 2;
-			if(strcmp(value, "rom_256m_eeprom_64k") == 0)
-				config->defaultSave = 3;
-			if(strcmp(value, "flash_512k_atmel_rtc") == 0)
-				config->defaultSave = 4;
-			if(strcmp(value, "flash_512k_atmel") == 0)
-				config->defaultSave = 5;
-			if(strcmp(value, "flash_512k_sst_rtc") == 0)
-				config->defaultSave = 6;
-			if(strcmp(value, "flash_512k_sst") == 0)
-				config->defaultSave = 7;
-			if(strcmp(value, "flash_512k_panasonic_rtc") == 0)
-				config->defaultSave = 8;
-			if(strcmp(value, "flash_512k_panasonic") == 0)
-				config->defaultSave = 9;
-			if(strcmp(value, "flash_1m_macronix_rtc") == 0)
-				config->defaultSave = 10;
-			if(strcmp(value, "flash_1m_macronix") == 0)
-				config->defaultSave = 11;
-			if(strcmp(value, "flash_1m_sanyo_rtc") == 0)
-				config->defaultSave = 12;
-			if(strcmp(value, "flash_1m_sanyo") == 0)
-				config->defaultSave = 13;
-			if(strcmp(value, "sram_256k") == 0)
-				config->defaultSave = 14;
-			if(strcmp(value, "none") == 0)
-				config->defaultSave = 15;
+			char value[160]; // Enough for all button names.
+			const char *key;
+			if(sect->options != NULL)
+			{
+				const CfgOption *const opt = &sect->options[i];
+				const bool changed = memcmp((const u8*)config + opt->offset,
+				                            (const u8*)&g_defaultConfig + opt->offset, opt->size) != 0;
+				if(!changed && (opt->flags & CFG_FLAG_NEW) == 0) continue;
+
+				key = opt->key;
+				formatOption(value, opt, config);
+			}
+			else
+			{
+				if(config->buttonMaps[i] == 0) continue;
+
+				key = g_buttonStrLut[i];
+				formatButtons(value, config->buttonMaps[i]);
+			}
+
+			if(!headerDone)
+			{
+				ee_sprintf(line, "%s[%s]\n", (len > 0 ? "\n" : ""), sect->name);
+				fits &= appendStr(iniBuf, &len, line);
+				headerDone = true;
+			}
+
+			ee_sprintf(line, "%s=", key);
+			fits &= appendStr(iniBuf, &len, line);
+			fits &= appendStr(iniBuf, &len, value);
+			fits &= appendStr(iniBuf, &len, "\n");
 		}
 	}
-	else return 0; // Error.
 
-	return 1; // 1 is no error? Really?
+	// Don't write configs which would be cut off when parsing them.
+	Result res = RES_OUT_OF_RANGE;
+	if(fits) res = fsQuickWrite(path, iniBuf, len);
+
+	free(iniBuf);
+
+	return res;
 }
 
-// TODO: Instead of writing a hardcoded string turn default config into a string.
 Result parseOafConfig(const char *const path, OafConfig *cfg, const bool newCfgOnError)
 {
 	char *iniBuf = (char*)calloc(INI_BUF_SIZE, 1);
 	if(iniBuf == NULL) return RES_OUT_OF_MEM;
 
+	for(unsigned s = 0; s < arrayEntries(g_cfgSections); s++) assert(optionsUnique(&g_cfgSections[s]));
+
 	cfg = (cfg != NULL ? cfg : &g_oafConfig);
-	Result res = fsQuickRead(path, iniBuf, INI_BUF_SIZE - 1);
+	Result res = bundleQuickRead(path, iniBuf, INI_BUF_SIZE - 1);
 	if(res == RES_OK) ini_parse_string(iniBuf, cfgIniCallback, cfg);
-	else if(newCfgOnError)
-	{
-		const char *const defaultConfig = DEFAULT_CONFIG;
-		res = fsQuickWrite(path, defaultConfig, strlen(defaultConfig));
-	}
+	else if(newCfgOnError) res = writeConfig(path, &g_defaultConfig);
 
 	free(iniBuf);
 
 	return res;
-}
\ No newline at end of file
+}
@@ -0,0 +1,89 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "arm11/crc32.h"
+
+
+#define CRC32_POLY  (0xEDB88320u) // Reversed.
+
+
+// Slice-by-8 tables. Built on first use to save binary size.
+static u32 g_crc32Table[8][256];
+static bool g_crc32TableBuilt = false;
+
+
+
+static void buildCrc32Table(void)
+{
+	for(u32 i = 0; i < 256; i++)
+	{
+		u32 crc = i;
+		for(u32 j = 0; j < 8; j++) crc = (crc>>1) ^ (crc & 1u ? CRC32_POLY : 0);
+		g_crc32Table[0][i] = crc;
+	}
+
+	// Table n is the CRC of a byte followed by n zero bytes.
+	for(u32 i = 0; i < 256; i++)
+	{
+		u32 crc = g_crc32Table[0][i];
+		for(u32 n = 1; n < 8; n++)
+		{
+			crc = (crc>>8) ^ g_crc32Table[0][crc & 0xFFu];
+			g_crc32Table[n][i] = crc;
+		}
+	}
+
+	g_crc32TableBuilt = true;
+}
+
+u32 crc32(u32 crc, const void *data, u32 size)
+{
+	if(!g_crc32TableBuilt) buildCrc32Table();
+
+	const u32 (*const t)[256] = g_crc32Table;
+	const u8 *ptr = (const u8*)data;
+	crc = ~crc;
+
+	// Align to word boundary first.
+	while(size > 0 && ((uintptr_t)ptr & 3u) != 0)
+	{
+		crc = (crc>>8) ^ t[0][(crc ^ *ptr++) & 0xFFu];
+		size--;
+	}
+
+	// 8 bytes at a time. Little endian only.
+	const u32 *ptr32 = (const u32*)ptr;
+	while(size >= 8)
+	{
+		const u32 one = *ptr32++ ^ crc;
+		const u32 two = *ptr32++;
+		crc = t[7][one & 0xFFu] ^ t[6][(one>>8) & 0xFFu] ^ t[5][(one>>16) & 0xFFu] ^ t[4][one>>24] ^
+		      t[3][two & 0xFFu] ^ t[2][(two>>8) & 0xFFu] ^ t[1][(two>>16) & 0xFFu] ^ t[0][two>>24];
+		size -= 8;
+	}
+
+	ptr = (const u8*)ptr32;
+	while(size > 0)
+	{
+		crc = (crc>>8) ^ t[0][(crc ^ *ptr++) & 0xFFu];
+		size--;
+	}
+
+	return ~crc;
+}
@@ -16,124 +16,1169 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include "types.h"
 #include "error_codes.h"
+#include "oaf_error_codes.h"
 #include "fs.h"
 #include "util.h"
+#include "arm11/arena.h"
+#include "arm11/config.h"
+#include "arm11/crc32.h"
+#include "arm11/library.h"
+#include "arm11/rom_cache.h"
+#include "arm11/save_type.h"
 #include "arm11/drivers/hid.h"
 #include "arm11/fmt.h"
+#include "arm11/text_grid.h"
 #include "drivers/gfx.h"
 
 
-// Notes on these settings:
-// MAX_ENT_BUF_SIZE should be big enough to hold the average file/dir name length * MAX_DIR_ENTRIES.
-#define MAX_ENT_BUF_SIZE  (1024u * 196) // 196 KiB.
-#define MAX_DIR_ENTRIES   (1000u)
 #define DIR_READ_BLOCKS   (10u)
+#define DIR_SCAN_STEP     (8u)      // fReadDir() calls per frame while browsing.
 #define SCREEN_COLS       (53u - 1) // - 1 because the console inserts a newline after the last line otherwise.
 #define SCREEN_ROWS       (24u)
+#define LIB_ROWS          (SCREEN_ROWS - 2) // Library view list rows below the search line.
+#define PREVIEW_ROW       (SCREEN_ROWS + 1)
+#define PREVIEW_DELAY     (15u)             // Frames the cursor must rest on a ROM before reading its header.
+#define PREVIEW_LRU_SIZE  (16u)
 
 #define ENT_TYPE_FILE  (0)
 #define ENT_TYPE_DIR   (1)
 
+// Sort options.
+#define SORT_NATURAL      (1u)    // "Game 2" before "Game 10".
+#define SORT_IGNORE_CASE  (1u<<1)
+#define SORT_RADIX_MIN    (64u)   // Fewer entries are sorted with qsort().
+
+// Directory listing cache. One file per directory in the work dir.
+#define DIR_CACHE_DIR      "dircache" // Relative to work dir.
+#define DIR_CACHE_MAGIC    (0x43524944u) // "DIRC"
+#define DIR_CACHE_VERSION  (2u)
+#define DIR_CACHE_MAX      (64u)         // Max cache files. The least recently written ones are deleted.
+#define DIR_CACHE_EVICT    (8u)          // Max cache files deleted at once.
+
 
 typedef struct
 {
-	u32 num;                       // Total number of entries.
-	char entBuf[MAX_ENT_BUF_SIZE]; // Format: char entryType; char name[X]; // null terminated.
-	char *ptrs[MAX_DIR_ENTRIES];   // For fast sorting.
+	Arena arena; // Entries. Format: char entryType; char name[X]; // null terminated.
+	u32 num;     // Number of sorted entries.
+	u32 cap;     // Capacity of ptrs.
+	char **ptrs; // For fast sorting. Unsorted entries may follow the sorted ones while scanning.
 } DirList;
 
+// Identifies a directory state. FAT does not update the
+// dir timestamp when entries are added, removed or renamed
+// so the raw entry count and a hash over all names are checked too.
+typedef struct
+{
+	u32 fatTime;  // fdate<<16 | ftime. 0 for the root dir.
+	u32 rawCount; // All entries returned by fReadDir() including filtered ones.
+	u32 nameHash; // FNV-1a over all raw entry names.
+} DirStamp;
+
+// Sort record with the entry type and the start of the normalized name inline.
+typedef struct
+{
+	u64 key;
+	char *ent;
+	u32 type; // 0 = dir, 1 = file.
+} SortRec;
+
+typedef struct
+{
+	u32 magic;
+	u16 version;
+	u16 sortFlags;  // Sort options the list was sorted with.
+	u64 pathHash;
+	DirStamp stamp;
+	u32 num;        // Number of entries in the list.
+	u32 entBufSize; // Entry buffer bytes following the header in sorted order.
+	u32 entBufCrc;  // CRC-32 of the entry buffer.
+} DirCacheHeader;
+static_assert(sizeof(DirCacheHeader) == 40);
+
+// Directory enumeration interleaved with the VBlank waits in browseFiles().
+enum
+{
+	SCAN_IDLE  = 0u,
+	SCAN_CHECK = 1u, // Checking the list loaded from the cache.
+	SCAN_BUILD = 2u  // Building a list.
+};
+
+typedef struct
+{
+	u8 mode;
+	bool shadow;        // Building shadowList while the stale cached list is shown.
+	bool truncated;     // Out of memory or read error. The list is not cached.
+	DHandle dh;
+	u32 pending;        // Unsorted entries after list->num.
+	const char *filter;
+	DirStamp cached;    // Stamp of the list loaded from the cache.
+	DirStamp stamp;     // Stamp being built from the directory.
+	DirList *list;      // List being built.
+	DirList shadowList;
+	FILINFO *fis;
+} DirScan;
+
+// ROM header preview of the highlighted entry.
+typedef struct
+{
+	u64 pathHash;
+	u32 lastUse;      // 0 = free slot.
+	bool valid;       // ROM header could be read.
+	u8 version;
+	u8 dbSaveType;    // From the ROM cache or GBA_DB_SAVE_UNKNOWN.
+	char title[12];   // Not null terminated.
+	char gameCode[4];
+	char maker[2];
+} RomPreview;
+
+// Preview fetch split into one FS call per frame so input is never blocked for long.
+enum
+{
+	FETCH_IDLE = 0u,
+	FETCH_OPEN = 1u, // Opening the ROM once the cursor rested on it.
+	FETCH_READ = 2u, // Reading the header.
+	FETCH_STAT = 3u  // Looking up the db save type in the ROM cache.
+};
+
+// Small LRU of previews keyed by path hash plus the fetch scheduler state.
+typedef struct
+{
+	RomPreview entries[PREVIEW_LRU_SIZE];
+	u32 useCounter;
+	const char *entry;        // Highlighted entry.
+	const RomPreview *shown;  // Preview of the highlighted entry or NULL.
+	u8 fetchState;            // Highlighted entry is a ROM without preview yet if not FETCH_IDLE.
+	FHandle f;                // Open while fetchState is FETCH_READ.
+	RomPreview fetched;       // Preview being fetched.
+	u32 idleFrames;           // Frames since the highlighted entry changed.
+	char path[512];           // Path of the highlighted entry.
+} PreviewCache;
+
+static u8 g_sortFlags = 0;
+
 
 
+static inline bool isDigit(const u32 c)
+{
+	return c - '0' < 10;
+}
+
+// Skips leading zeros of a digit run and returns the number of remaining digits.
+static u32 digitRun(const u8 **const str)
+{
+	const u8 *s = *str;
+	while(*s == '0' && isDigit(s[1])) s++;
+	*str = s;
+
+	u32 len = 0;
+	while(isDigit(s[len])) len++;
+
+	return len;
+}
+
+// Compares names with the sort options applied.
+// Natural ordering compares digit runs by value. A digit run compared
+// against anything else counts as its length ('1'-'9', capped).
+static int compareNames(const u8 *a, const u8 *b)
+{
+	const u8 flags = g_sortFlags;
+	while(1)
+	{
+		u32 ca = *a;
+		u32 cb = *b;
+		if(flags & SORT_NATURAL)
+		{
+			if(isDigit(ca) && isDigit(cb))
+			{
+				const u32 lenA = digitRun(&a);
+				const u32 lenB = digitRun(&b);
+				if(lenA != lenB) return (lenA < lenB ? -1 : 1);
+
+				const int res = memcmp(a, b, lenA);
+				if(res != 0) return res;
+
+				a += lenA;
+				b += lenB;
+				continue;
+			}
+			if(isDigit(ca))
+			{
+				const u32 len = digitRun(&a);
+				ca = '0' + (len < 9 ? len : 9);
+			}
+			if(isDigit(cb))
+			{
+				const u32 len = digitRun(&b);
+				cb = '0' + (len < 9 ? len : 9);
+			}
+		}
+		if(flags & SORT_IGNORE_CASE)
+		{
+			if(ca - 'A' < 26) ca += 'a' - 'A';
+			if(cb - 'A' < 26) cb += 'a' - 'A';
+		}
+
+		if(ca != cb) return (int)ca - (int)cb;
+		if(ca == '\0') return 0;
+		a++;
+		b++;
+	}
+}
+
+// Packs the first 8 bytes of the normalized name big endian.
+// Comparing keys gives the same order as compareNames() except for ties.
+static u64 makeSortKey(const u8 *name)
+{
+	const u8 flags = g_sortFlags;
+	u64 key = 0;
+	u32 n = 0;
+	while(n < 8 && *name != '\0')
+	{
+		u32 c = *name;
+		if((flags & SORT_NATURAL) && isDigit(c))
+		{
+			const u32 len = digitRun(&name);
+			key = key<<8 | ('0' + (len < 9 ? len : 9));
+			n++;
+			if(len >= 9) break; // Longer numbers are resolved by compareNames().
+
+			for(u32 i = 0; i < len && n < 8; i++, n++) key = key<<8 | name[i];
+			name += len;
+			continue;
+		}
+		if((flags & SORT_IGNORE_CASE) && c - 'A' < 26) c += 'a' - 'A';
+
+		key = key<<8 | c;
+		n++;
+		name++;
+	}
+
+	return (n > 0 ? key<<(8 * (8 - n)) : 0);
+}
+
 int dlistCompare(const void *a, const void *b)
 {
-	const char *entA = *(char**)a;
-	const char *entB = *(char**)b;
+	const u8 *entA = *(const u8**)a;
+	const u8 *entB = *(const u8**)b;
 
 	// Compare the entry type. Dirs have priority over files.
 	if(*entA != *entB) return (int)*entB - *entA;
 
 	// Compare the string.
-	int res;
+	const int res = compareNames(&entA[1], &entB[1]);
+	if(res != 0 || g_sortFlags == 0) return res;
+
+	// Names only differing in case or leading zeros. Keep the order deterministic.
+	return strcmp((const char*)&entA[1], (const char*)&entB[1]);
+}
+
+static int sortRecCompare(const void *a, const void *b)
+{
+	const SortRec *const recA = (const SortRec*)a;
+	const SortRec *const recB = (const SortRec*)b;
+
+	if(recA->type != recB->type) return (recA->type < recB->type ? -1 : 1);
+	if(recA->key != recB->key)   return (recA->key < recB->key ? -1 : 1);
+
+	return dlistCompare(&recA->ent, &recB->ent);
+}
+
+// Sorts entries by their inline type and key prefix.
+// The full names are only compared for equal prefixes.
+static void sortEntries(char **const ptrs, const u32 num)
+{
+	if(num < 2) return;
+
+	SortRec *recs = (SortRec*)malloc(sizeof(SortRec) * num * 2);
+	if(recs == NULL)
+	{
+		qsort(ptrs, num, sizeof(char*), dlistCompare);
+		return;
+	}
+
+	static u32 hist[9][256];
+	memset(hist, 0, sizeof(hist));
+	for(u32 i = 0; i < num; i++)
+	{
+		SortRec *const rec = &recs[i];
+		const u8 *const entry = (const u8*)ptrs[i];
+		rec->key  = makeSortKey(&entry[1]);
+		rec->ent  = ptrs[i];
+		rec->type = (*entry == ENT_TYPE_DIR ? 0 : 1);
+
+		for(u32 b = 0; b < 8; b++) hist[b][(u8)(rec->key>>(b * 8))]++;
+		hist[8][rec->type]++;
+	}
+
+	if(num < SORT_RADIX_MIN) qsort(recs, num, sizeof(SortRec), sortRecCompare);
+	else
+	{
+		// LSD radix sort over the 8 key bytes and then the type.
+		// Passes where all records have the same byte are skipped.
+		SortRec *src = recs;
+		SortRec *dst = &recs[num];
+		for(u32 pass = 0; pass < 9; pass++)
+		{
+			u32 *const count = hist[pass];
+			const u32 first = (pass < 8 ? (u8)(src[0].key>>(pass * 8)) : src[0].type);
+			if(count[first] == num) continue;
+
+			u32 sum = 0;
+			for(u32 i = 0; i < 256; i++)
+			{
+				const u32 tmp = count[i];
+				count[i] = sum;
+				sum += tmp;
+			}
+
+			for(u32 i = 0; i < num; i++)
+			{
+				const u32 digit = (pass < 8 ? (u8)(src[i].key>>(pass * 8)) : src[i].type);
+				dst[count[digit]++] = src[i];
+			}
+
+			SortRec *const tmp = src;
+			src = dst;
+			dst = tmp;
+		}
+
+		// Order runs of equal prefixes by full name.
+		for(u32 i = 0; i < num;)
+		{
+			u32 end = i + 1;
+			while(end < num && src[end].key == src[i].key && src[end].type == src[i].type) end++;
+			if(end - i > 1) qsort(&src[i], end - i, sizeof(SortRec), sortRecCompare);
+			i = end;
+		}
+
+		if(src != recs) memcpy(recs, src, sizeof(SortRec) * num);
+	}
+
+	for(u32 i = 0; i < num; i++) ptrs[i] = recs[i].ent;
+
+	free(recs);
+}
+
+static u32 hashName(u32 hash, const char *str)
+{
+	// FNV-1a.
 	do
 	{
-		res = *++entA - *++entB;
-	} while(res == 0 && *entA != '\0' && *entB != '\0');
+		hash ^= (u8)*str;
+		hash *= 0x01000193u;
+	} while(*str++ != '\0');
 
-	return res;
+	return hash;
 }
 
-static Result scanDir(const char *const path, DirList *const dList, const char *const filter)
+static u64 hashDirPath(const char *str)
 {
-	FILINFO *const fis = (FILINFO*)malloc(sizeof(FILINFO) * DIR_READ_BLOCKS);
-	if(fis == NULL) return RES_OUT_OF_MEM;
+	// FNV-1a.
+	u64 hash = 0xCBF29CE484222325u;
+	while(*str != '\0')
+	{
+		hash ^= (u8)*str++;
+		hash *= 0x100000001B3u;
+	}
 
-	dList->num = 0;
+	return hash;
+}
 
-	Result res;
+static void stampInit(const char *const path, DirStamp *const stamp)
+{
+	// fStat() fails on drive roots. They have no timestamp anyway.
+	FILINFO fi;
+	stamp->fatTime  = (fStat(path, &fi) == RES_OK ? (u32)fi.fdate<<16 | fi.ftime : 0);
+	stamp->rawCount = 0;
+	stamp->nameHash = 0x811C9DC5u;
+}
+
+static void stampUpdate(DirStamp *const stamp, const FILINFO *const fis, const u32 num)
+{
+	u32 nameHash = stamp->nameHash;
+	for(u32 i = 0; i < num; i++) nameHash = hashName(nameHash, fis[i].fname);
+
+	stamp->rawCount += num;
+	stamp->nameHash = nameHash;
+}
+
+static void dlistInit(DirList *const dList)
+{
+	arenaInit(&dList->arena);
+	dList->num  = 0;
+	dList->cap  = 0;
+	dList->ptrs = NULL;
+}
+
+static void dlistFree(DirList *const dList)
+{
+	arenaFree(&dList->arena);
+	free(dList->ptrs);
+	dlistInit(dList);
+}
+
+// Builds the pointer array by walking the entries in the arena.
+// Returns false if the entries are malformed or there are not exactly num entries.
+static bool dlistBuildPtrs(DirList *const dList, const u32 num)
+{
+	free(dList->ptrs);
+	dList->num  = 0;
+	dList->cap  = (num > 0 ? num : 1);
+	dList->ptrs = (char**)malloc(sizeof(char*) * dList->cap);
+	if(dList->ptrs == NULL)
+	{
+		dList->cap = 0;
+		return false;
+	}
+
+	u32 i = 0;
+	for(ArenaChunk *chunk = dList->arena.first; chunk != NULL; chunk = chunk->next)
+	{
+		char *const data = chunk->data;
+		const u32 used = chunk->used;
+		u32 pos = 0;
+		while(pos + 1 < used && i < num)
+		{
+			// Skip the entry type. ENT_TYPE_FILE is 0.
+			const char *const entEnd = memchr(&data[pos + 1], '\0', used - pos - 1);
+			if(entEnd == NULL) return false;
+
+			dList->ptrs[i++] = &data[pos];
+			pos = entEnd - data + 1;
+		}
+		if(pos != used) return false;
+	}
+	if(i != num) return false;
+
+	dList->num = num;
+
+	return true;
+}
+
+static bool isListed(const FILINFO *const fi, const char *const filter)
+{
+	if(fi->fattrib & AM_DIR) return true;
+
+	const u32 nameLen = strlen(fi->fname);
+	const u32 filterLen = strlen(filter);
+	return nameLen > filterLen && strcmp(filter, fi->fname + nameLen - filterLen) == 0 && fi->fname[0] != '.';
+}
+
+// Appends an unsorted entry after the sorted and pending ones.
+static bool dlistPush(DirList *const dList, const u32 pending, const FILINFO *const fi)
+{
+	const u32 used = dList->num + pending;
+	if(used == dList->cap)
+	{
+		const u32 newCap = (used > 0 ? used * 2 : 64);
+		char **const ptrs = (char**)realloc(dList->ptrs, sizeof(char*) * newCap);
+		if(ptrs == NULL) return false;
+
+		dList->ptrs = ptrs;
+		dList->cap  = newCap;
+	}
+
+	// nameLen does not include the entry type and NULL termination.
+	const u32 nameLen = strlen(fi->fname);
+	char *const entry = (char*)arenaAlloc(&dList->arena, nameLen + 2);
+	if(entry == NULL) return false;
+
+	*entry = (fi->fattrib & AM_DIR ? ENT_TYPE_DIR : ENT_TYPE_FILE);
+	memcpy(&entry[1], fi->fname, nameLen + 1);
+	dList->ptrs[used] = entry;
+
+	return true;
+}
+
+// Sorts the pending entries and merges them into the sorted ones.
+static void dlistMerge(DirList *const dList, const u32 pending)
+{
+	if(pending == 0) return;
+
+	char **const ptrs = dList->ptrs;
+	char **const tmp = (char**)malloc(sizeof(char*) * pending);
+	if(tmp == NULL)
+	{
+		// Sort everything in place instead.
+		dList->num += pending;
+		sortEntries(ptrs, dList->num);
+		return;
+	}
+
+	sortEntries(&ptrs[dList->num], pending);
+	memcpy(tmp, &ptrs[dList->num], sizeof(char*) * pending);
+
+	// Merge from the back so sorted entries are moved before being overwritten.
+	u32 a = dList->num;
+	u32 b = pending;
+	u32 out = a + b;
+	while(b > 0)
+	{
+		if(a > 0 && dlistCompare(&ptrs[a - 1], &tmp[b - 1]) > 0) ptrs[--out] = ptrs[--a];
+		else                                                     ptrs[--out] = tmp[--b];
+	}
+	free(tmp);
+
+	dList->num += pending;
+}
+
+// Returns the index of the first sorted entry not ordered before entry.
+static u32 dlistFind(const DirList *const dList, const char *const entry)
+{
+	u32 lo = 0;
+	u32 hi = dList->num;
+	while(lo < hi)
+	{
+		const u32 mid = lo + (hi - lo) / 2;
+		if(dlistCompare(&dList->ptrs[mid], &entry) < 0) lo = mid + 1;
+		else                                            hi = mid;
+	}
+
+	return lo;
+}
+
+static void makeDirCachePath(const char *const path, char cachePath[32])
+{
+	const u64 pathHash = hashDirPath(path);
+	ee_sprintf(cachePath, DIR_CACHE_DIR "/%08lX%08lX.bin", (u32)(pathHash>>32), (u32)pathHash);
+}
+
+static bool loadDirCache(const char *const path, DirList *const dList, DirStamp *const stamp)
+{
+	char cachePath[32];
+	makeDirCachePath(path, cachePath);
+
+	FHandle f;
+	if(fOpen(&f, cachePath, FA_OPEN_EXISTING | FA_READ) != RES_OK) return false;
+
+	bool loaded = false;
+	DirCacheHeader hdr;
+	u32 read;
+	if(fRead(f, &hdr, sizeof(hdr), &read) == RES_OK && read == sizeof(hdr) &&
+	   hdr.magic == DIR_CACHE_MAGIC && hdr.version == DIR_CACHE_VERSION &&
+	   hdr.sortFlags == g_sortFlags && hdr.pathHash == hashDirPath(path) && hdr.entBufSize == fSize(f) - sizeof(hdr))
+	{
+		// Entries are stored in sorted order in a single block.
+		dlistFree(dList);
+		char *const entBuf = (char*)arenaAlloc(&dList->arena, hdr.entBufSize);
+		if(entBuf != NULL && fRead(f, entBuf, hdr.entBufSize, &read) == RES_OK && read == hdr.entBufSize &&
+		   crc32(0, entBuf, hdr.entBufSize) == hdr.entBufCrc && dlistBuildPtrs(dList, hdr.num))
+		{
+			*stamp = hdr.stamp;
+			loaded = true;
+		}
+		else dlistFree(dList);
+	}
+
+	fClose(f);
+
+	return loaded;
+}
+
+// Deletes the least recently written cache files if there are DIR_CACHE_MAX or more.
+static void evictDirCache(FILINFO *const fis)
+{
 	DHandle dh;
-	if((res = fOpenDir(&dh, path)) == RES_OK)
+	if(fOpenDir(&dh, DIR_CACHE_DIR) != RES_OK) return;
+
+	// Oldest first.
+	struct
 	{
-		u32 read;           // Number of entries read by fReadDir().
-		u32 numEntries = 0; // Total number of processed entries.
-		u32 entBufPos = 0;  // Entry buffer position/number of bytes used.
-		const u32 filterLen = strlen(filter);
-		do
+		u32 fatTime;
+		char name[24];
+	} oldest[DIR_CACHE_EVICT];
+	u32 numOldest = 0;
+	u32 count = 0;
+	u32 read;
+	do
+	{
+		if(fReadDir(dh, fis, DIR_READ_BLOCKS, &read) != RES_OK) break;
+
+		for(u32 i = 0; i < read; i++)
+		{
+			const FILINFO *const fi = &fis[i];
+			if(fi->fattrib & AM_DIR || strlen(fi->fname) >= sizeof(oldest[0].name)) continue;
+			count++;
+
+			const u32 fatTime = (u32)fi->fdate<<16 | fi->ftime;
+			u32 pos = numOldest;
+			while(pos > 0 && oldest[pos - 1].fatTime > fatTime) pos--;
+			if(pos == DIR_CACHE_EVICT) continue;
+
+			if(numOldest < DIR_CACHE_EVICT) numOldest++;
+			memmove(&oldest[pos + 1], &oldest[pos], sizeof(oldest[0]) * (numOldest - 1 - pos));
+			oldest[pos].fatTime = fatTime;
+			strcpy(oldest[pos].name, fi->fname);
+		}
+	} while(read == DIR_READ_BLOCKS);
+	fCloseDir(dh);
+
+	// Make room for one more. Any leftovers are deleted on the next save.
+	u32 excess = (count >= DIR_CACHE_MAX ? count - DIR_CACHE_MAX + 1 : 0);
+	if(excess > numOldest) excess = numOldest;
+	for(u32 i = 0; i < excess; i++)
+	{
+		char cachePath[32];
+		ee_sprintf(cachePath, DIR_CACHE_DIR "/%s", oldest[i].name);
+		fUnlink(cachePath);
+	}
+}
+
+static void saveDirCache(const char *const path, const DirList *const dList, const DirStamp *const stamp, FILINFO *const fis)
+{
+	char cachePath[32];
+	makeDirCachePath(path, cachePath);
+
+	// Truncated lists are not cached. Also delete the stale one.
+	if(stamp->rawCount == 0)
+	{
+		fUnlink(cachePath);
+		return;
+	}
+
+	// Fails if it already exists. Only new cache files count towards the limit.
+	if(fMkdir(DIR_CACHE_DIR) != RES_OK && fStat(cachePath, fis) != RES_OK) evictDirCache(fis);
+
+	FHandle f;
+	if(fOpen(&f, cachePath, FA_CREATE_ALWAYS | FA_WRITE) != RES_OK) return;
+
+	// The entries are not contiguous in sorted order. Write them one by one.
+	DirCacheHeader hdr;
+	hdr.magic     = DIR_CACHE_MAGIC;
+	hdr.version   = DIR_CACHE_VERSION;
+	hdr.sortFlags = g_sortFlags;
+	hdr.pathHash  = hashDirPath(path);
+	hdr.stamp     = *stamp;
+	hdr.num       = dList->num;
+	u32 entBufSize = 0;
+	u32 entBufCrc = 0;
+	for(u32 i = 0; i < dList->num; i++)
+	{
+		const char *const entry = dList->ptrs[i];
+		const u32 entSize = strlen(&entry[1]) + 2;
+		entBufSize += entSize;
+		entBufCrc = crc32(entBufCrc, entry, entSize);
+	}
+	hdr.entBufSize = entBufSize;
+	hdr.entBufCrc  = entBufCrc;
+
+	Result res = fWrite(f, &hdr, sizeof(hdr), NULL);
+	for(u32 i = 0; i < dList->num && res == RES_OK; i++)
+	{
+		const char *const entry = dList->ptrs[i];
+		res = fWrite(f, entry, strlen(&entry[1]) + 2, NULL);
+	}
+
+	fClose(f);
+	if(res != RES_OK) fUnlink(cachePath);
+}
+
+static void scanStop(DirScan *const scan)
+{
+	if(scan->mode != SCAN_IDLE) fCloseDir(scan->dh);
+	scan->mode = SCAN_IDLE;
+
+	if(scan->shadow)
+	{
+		dlistFree(&scan->shadowList);
+		scan->shadow = false;
+	}
+}
+
+static Result scanStart(DirScan *const scan, const char *const path, DirList *const list, const u8 mode)
+{
+	const Result res = fOpenDir(&scan->dh, path);
+	if(res != RES_OK) return res;
+
+	stampInit(path, &scan->stamp);
+	scan->mode      = mode;
+	scan->truncated = false;
+	scan->pending   = 0;
+	scan->list      = list;
+
+	return RES_OK;
+}
+
+// Reads up to blocks * DIR_READ_BLOCKS entries. Returns true if dList changed.
+// cursorPos is moved to keep pointing at the same entry.
+static bool scanStep(DirScan *const scan, const char *const path, DirList *const dList, u32 blocks, u32 *const cursorPos)
+{
+	if(scan->mode == SCAN_IDLE) return false;
+
+	FILINFO *const fis = scan->fis;
+	DirList *const list = scan->list;
+	bool done;
+	do
+	{
+		u32 read;
+		if(fReadDir(scan->dh, fis, DIR_READ_BLOCKS, &read) != RES_OK)
 		{
-			if((res = fReadDir(dh, fis, DIR_READ_BLOCKS, &read)) != RES_OK) break;
-			read = (read <= MAX_DIR_ENTRIES - numEntries ? read : MAX_DIR_ENTRIES - numEntries);
+			read = 0;
+			scan->truncated = true;
+		}
+		stampUpdate(&scan->stamp, fis, read);
 
+		if(scan->mode == SCAN_BUILD)
+		{
 			for(u32 i = 0; i < read; i++)
 			{
-				const char entType = (fis[i].fattrib & AM_DIR ? ENT_TYPE_DIR : ENT_TYPE_FILE);
-				const u32 nameLen = strlen(fis[i].fname);
-				if(entType == ENT_TYPE_FILE)
+				if(!isListed(&fis[i], scan->filter)) continue;
+				if(!dlistPush(list, scan->pending, &fis[i]))
 				{
-					if(nameLen <= filterLen || strcmp(filter, fis[i].fname + nameLen - filterLen) != 0
-					   || fis[i].fname[0] == '.')
-						continue;
+					// Out of memory. Show what we have.
+					scan->truncated = true;
+					read = 0;
+					break;
 				}
+				scan->pending++;
+			}
+		}
+
+		done = read < DIR_READ_BLOCKS;
+	} while(!done && --blocks > 0);
+
+	if(!done)
+	{
+		// Merge in bursts so the total merge cost stays O(n log n).
+		if(scan->mode != SCAN_BUILD || scan->shadow ||
+		   scan->pending < SCREEN_ROWS || scan->pending < list->num / 4) return false;
+	}
+	else
+	{
+		fCloseDir(scan->dh);
+		const u8 mode = scan->mode;
+		scan->mode = SCAN_IDLE;
+
+		if(mode == SCAN_CHECK)
+		{
+			if(memcmp(&scan->stamp, &scan->cached, sizeof(DirStamp)) == 0) return false;
+
+			// Stale. Keep showing the cached list until the new one is complete.
+			dlistInit(&scan->shadowList);
+			scan->shadow = scanStart(scan, path, &scan->shadowList, SCAN_BUILD) == RES_OK;
+			return false;
+		}
+	}
+
+	const char *const curEnt = (dList->num > 0 ? dList->ptrs[*cursorPos] : NULL);
+	dlistMerge(list, scan->pending);
+	scan->pending = 0;
+
+	if(done)
+	{
+		if(scan->truncated) scan->stamp.rawCount = 0; // Don't cache.
+		saveDirCache(path, list, &scan->stamp, scan->fis);
+	}
+
+	u32 newPos = (curEnt != NULL ? dlistFind(list, curEnt) : 0);
+	if(newPos >= list->num) newPos = (list->num > 0 ? list->num - 1 : 0);
+	*cursorPos = newPos;
+
+	if(scan->shadow)
+	{
+		dlistFree(dList);
+		*dList = *list;
+		dlistInit(&scan->shadowList);
+		scan->shadow = false;
+	}
+
+	return true;
+}
+
+// Shows the directory from the cache if possible and starts a background
+// check. Otherwise scans until the first page of the directory can be shown.
+static Result openDir(const char *const path, DirList *const dList, DirScan *const scan)
+{
+	scanStop(scan);
+
+	DirStamp stamp;
+	if(loadDirCache(path, dList, &stamp))
+	{
+		scan->cached = stamp;
+		if(scanStart(scan, path, dList, SCAN_CHECK) == RES_OK)
+		{
+			if(scan->stamp.fatTime == stamp.fatTime) return RES_OK;
+
+			scanStop(scan); // Timestamp changed. Rebuild now.
+		}
+	}
 
-				// nameLen does not include the entry type and NULL termination.
-				if(entBufPos + nameLen + 2 > MAX_ENT_BUF_SIZE) goto scanEnd;
+	dlistFree(dList);
+	const Result res = scanStart(scan, path, dList, SCAN_BUILD);
+	if(res != RES_OK) return res;
 
-				char *const entry = &dList->entBuf[entBufPos];
-				*entry = entType;
-				safeStrcpy(&entry[1], fis[i].fname, 256);
-				dList->ptrs[numEntries++] = entry;
-				entBufPos += nameLen + 2;
+	u32 cursorPos = 0;
+	while(scan->mode == SCAN_BUILD && dList->num < SCREEN_ROWS)
+		scanStep(scan, path, dList, 1, &cursorPos);
+
+	return RES_OK;
+}
+
+static RomPreview* previewLookup(PreviewCache *const cache, const u64 pathHash)
+{
+	for(u32 i = 0; i < PREVIEW_LRU_SIZE; i++)
+	{
+		RomPreview *const entry = &cache->entries[i];
+		if(entry->lastUse != 0 && entry->pathHash == pathHash)
+		{
+			entry->lastUse = ++cache->useCounter;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+// Copies the preview into the least recently used slot.
+static const RomPreview* previewInsert(PreviewCache *const cache, const RomPreview *const preview)
+{
+	RomPreview *lru = &cache->entries[0];
+	for(u32 i = 1; i < PREVIEW_LRU_SIZE; i++)
+	{
+		RomPreview *const entry = &cache->entries[i];
+		if(entry->lastUse < lru->lastUse) lru = entry;
+	}
+
+	*lru = *preview;
+	lru->lastUse = ++cache->useCounter;
+
+	return lru;
+}
+
+// Does one FS call of the preview fetch. Returns true once the preview is shown.
+static bool fetchStep(PreviewCache *const cache)
+{
+	RomPreview *const fetched = &cache->fetched;
+	switch(cache->fetchState)
+	{
+		case FETCH_OPEN:
+		{
+			const Result res = fOpen(&cache->f, cache->path, FA_OPEN_EXISTING | FA_READ);
+			cache->fetchState = (res == RES_OK ? FETCH_READ : FETCH_STAT);
+			return false;
+		}
+		case FETCH_READ:
+		{
+			u8 hdr[0xC0];
+			u32 read;
+			if(fRead(cache->f, hdr, sizeof(hdr), &read) != RES_OK) read = 0;
+			fClose(cache->f);
+			cache->fetchState = FETCH_STAT;
+
+			// 0xB2 is the fixed value 0x96 in valid headers.
+			fetched->valid = read == sizeof(hdr) && hdr[0xB2] == 0x96;
+			if(fetched->valid)
+			{
+				memcpy(fetched->title, &hdr[0xA0], sizeof(fetched->title));
+				memcpy(fetched->gameCode, &hdr[0xAC], sizeof(fetched->gameCode));
+				memcpy(fetched->maker, &hdr[0xB0], sizeof(fetched->maker));
+				fetched->version = hdr[0xBC];
 			}
-		} while(read == DIR_READ_BLOCKS);
+			return false;
+		}
+		case FETCH_STAT:
+		{
+			// The db save type is only known for ROMs launched before.
+			RomFingerprint fp;
+			fetched->dbSaveType = (romCachePeek(cache->path, &fp) ? fp.dbSaveType : GBA_DB_SAVE_UNKNOWN);
+			cache->fetchState = FETCH_IDLE;
+			cache->shown = previewInsert(cache, fetched);
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+static bool joinEntryPath(char out[512], const char *const dir, const char *const name)
+{
+	const u32 dirLen = strlen(dir);
+	const u32 nameLen = strlen(name);
+	const bool slash = dir[dirLen - 1] != '/';
+	if(dirLen + slash + nameLen >= 512) return false;
 
-scanEnd:
-		dList->num = numEntries;
+	memcpy(out, dir, dirLen);
+	if(slash) out[dirLen] = '/';
+	memcpy(&out[dirLen + slash], name, nameLen + 1);
 
-		fCloseDir(dh);
+	return true;
+}
+
+static void previewReset(PreviewCache *const cache)
+{
+	if(cache->fetchState == FETCH_READ) fClose(cache->f);
+	cache->fetchState = FETCH_IDLE;
+	cache->entry = NULL;
+	cache->shown = NULL;
+}
+
+// Tracks the highlighted entry and fetches its preview once the cursor rested on it.
+// Returns true if the shown preview changed.
+static bool previewStep(PreviewCache *const cache, const char *const curDir, const DirList *const dList, const u32 cursorPos)
+{
+	const char *const entry = (dList->num > 0 ? dList->ptrs[cursorPos] : NULL);
+	if(entry != cache->entry)
+	{
+		// Cached previews are shown right away. Moving on cancels the fetch.
+		const bool wasShown = cache->shown != NULL;
+		previewReset(cache);
+		cache->entry      = entry;
+		cache->idleFrames = 0;
+		if(entry != NULL && *entry == ENT_TYPE_FILE && joinEntryPath(cache->path, curDir, &entry[1]))
+		{
+			const u64 pathHash = hashDirPath(cache->path);
+			cache->shown = previewLookup(cache, pathHash);
+			if(cache->shown == NULL)
+			{
+				memset(&cache->fetched, 0, sizeof(RomPreview));
+				cache->fetched.pathHash = pathHash;
+				cache->fetchState = FETCH_OPEN;
+			}
+		}
+
+		return wasShown || cache->shown != NULL;
 	}
 
-	free(fis);
+	if(cache->fetchState == FETCH_IDLE || ++cache->idleFrames < PREVIEW_DELAY) return false;
 
-	qsort(dList->ptrs, dList->num, sizeof(char*), dlistCompare);
+	return fetchStep(cache);
+}
 
-	return res;
+static void printPreview(const RomPreview *const preview)
+{
+	if(preview == NULL) return;
+	if(!preview->valid)
+	{
+		tgPrint(PREVIEW_ROW, 0, TG_WHITE, "No valid ROM header");
+		return;
+	}
+
+	// Header strings are not null terminated and may contain garbage.
+	char id[12 + 1 + 4 + 1 + 2 + 1];
+	memset(id, ' ', sizeof(id) - 1);
+	id[sizeof(id) - 1] = '\0';
+	for(u32 i = 0; i < 12 && preview->title[i] != '\0'; i++)
+		id[i] = (preview->title[i] >= ' ' && preview->title[i] <= '~' ? preview->title[i] : '?');
+	for(u32 i = 0; i < 4 + 2; i++)
+	{
+		const char c = (i < 4 ? preview->gameCode[i] : preview->maker[i - 4]);
+		id[13 + i + (i >= 4)] = (c >= ' ' && c <= '~' ? c : '?');
+	}
+
+	static const char *const saveTypeStrs[16] =
+	{
+		"EEPROM 8k", "EEPROM 8k", "EEPROM 64k", "EEPROM 64k", "Flash 512k RTC", "Flash 512k",
+		"Flash 512k RTC", "Flash 512k", "Flash 512k RTC", "Flash 512k", "Flash 1m RTC", "Flash 1m",
+		"Flash 1m RTC", "Flash 1m", "SRAM 256k", "None"
+	};
+	const u8 saveType = preview->dbSaveType;
+	const char *saveStr;
+	if(saveType < 16)                          saveStr = saveTypeStrs[saveType];
+	else if(saveType == GBA_DB_SAVE_NOT_FOUND) saveStr = "Not in gba_db.bin";
+	else                                       saveStr = "Not launched yet";
+
+	char line[TG_COLS + 1];
+	ee_sprintf(line, "%s v%u", id, preview->version);
+	tgPrint(PREVIEW_ROW, 0, TG_YELLOW_BRIGHT, line);
+	ee_sprintf(line, "Save type: %s", saveStr);
+	tgPrint(PREVIEW_ROW + 1, 0, TG_WHITE, line);
 }
 
-static void showDirList(const DirList *const dList, u32 start)
+static void showDirList(const DirList *const dList, const u32 start, const u32 cursorPos, const RomPreview *const preview)
 {
-	// Clear screen.
-	ee_printf("\x1b[2J");
+	tgBeginFrame();
+	printPreview(preview);
 
 	const u32 listLength = (dList->num - start > SCREEN_ROWS ? start + SCREEN_ROWS : dList->num);
 	for(u32 i = start; i < listLength; i++)
 	{
-		const char *const printStr =
-			(*dList->ptrs[i] == ENT_TYPE_FILE ? "\x1b[%lu;H\x1b[37;1m %.52s" : "\x1b[%lu;H\x1b[33;1m %.52s");
+		const u32 row = i - start;
+		if(i == cursorPos) tgPrint(row, 0, TG_WHITE, ">");
+		tgPrint(row, 1, (*dList->ptrs[i] == ENT_TYPE_FILE ? TG_WHITE_BRIGHT : TG_YELLOW_BRIGHT), &dList->ptrs[i][1]);
+	}
+
+	tgPresent();
+	GFX_flushBuffers();
+}
+
+static bool showIndexProgress(const u32 found, const char *const dir)
+{
+	char line[32];
+	ee_sprintf(line, "%lu ROMs found", found);
+
+	tgBeginFrame();
+	tgPrint(0, 0, TG_YELLOW_BRIGHT, "Building ROM library...");
+	tgPrint(1, 0, TG_WHITE, line);
+	tgPrint(2, 0, TG_WHITE, dir);
+	tgPrint(4, 0, TG_WHITE, "B: Cancel");
+	tgPresent();
+	GFX_flushBuffers();
+
+	hidScanInput();
+	return !(hidKeysDown() & KEY_B) && !(hidGetExtraKeys(0) & (KEY_POWER_HELD | KEY_POWER));
+}
+
+static Result buildLibrary(Library *const lib)
+{
+	libFree(lib);
+	tgClear();
+	Result res = libBuild("sdmc:/", showIndexProgress);
+	tgClear();
+	if(res == RES_OK) res = libLoad(lib);
+
+	return res;
+}
+
+static void showLibrary(const Library *const lib, const u32 start, const u32 cursorPos, const char *const prefix)
+{
+	char line[TG_COLS + 1];
+	tgBeginFrame();
+
+	ee_sprintf(line, "Library: %lu ROMs  Search: %s_", lib->num, prefix);
+	tgPrint(0, 0, TG_YELLOW_BRIGHT, line);
+
+	const u32 listLength = (lib->num - start > LIB_ROWS ? start + LIB_ROWS : lib->num);
+	for(u32 i = start; i < listLength; i++)
+	{
+		const LibEntry *const entry = &lib->entries[i];
+		const u32 row = 1 + i - start;
+
+		// Title and game code are not null terminated and may contain garbage.
+		char text[12 + 1 + 4 + 1];
+		memset(text, ' ', sizeof(text) - 1);
+		text[sizeof(text) - 1] = '\0';
+		for(u32 c = 0; c < 12 && entry->title[c] != '\0'; c++)
+			text[c] = (entry->title[c] >= ' ' && entry->title[c] <= '~' ? entry->title[c] : '?');
+		for(u32 c = 0; c < 4 && entry->gameCode[c] != '\0'; c++)
+			text[13 + c] = (entry->gameCode[c] >= ' ' && entry->gameCode[c] <= '~' ? entry->gameCode[c] : '?');
 
-		ee_printf(printStr, i - start + 1, &dList->ptrs[i][1]);
+		if(i == cursorPos) tgPrint(row, 0, TG_WHITE, ">");
+		tgPrint(row, 1, TG_YELLOW_BRIGHT, text);
+		tgPrint(row, 2 + sizeof(text) - 1, TG_WHITE_BRIGHT, &lib->pool[entry->nameOff]);
 	}
+
+	tgPrint(LIB_ROWS + 2, 0, TG_WHITE, "A: Start  B: Back  START: Rescan SD card");
+	tgPrint(LIB_ROWS + 3, 0, TG_WHITE, "X: Add letter  Y: Remove letter  L/R: Change letter");
+	tgPresent();
+	GFX_flushBuffers();
+}
+
+// Returns true if a ROM was selected.
+static bool browseLibrary(char selected[512])
+{
+	static const char searchChars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 -";
+
+	Library lib;
+	Result res = libLoad(&lib);
+	if(res != RES_OK) res = buildLibrary(&lib);
+	if(res != RES_OK)
+	{
+		tgClear();
+		ee_puts("Could not build the ROM library! Press any button to continue.");
+		printErrorWaitInput(res, 0);
+		tgClear();
+		return false;
+	}
+
+	char prefix[13] = "";
+	u32 prefixLen = 0;
+	u32 charIdx = 0;      // Index of the last prefix char in searchChars.
+	s32 cursorPos = 0;
+	u32 windowPos = 0;
+	bool picked = false;
+	tgClear();
+	while(1)
+	{
+		showLibrary(&lib, windowPos, cursorPos, prefix);
+
+		u32 kDown;
+		do
+		{
+			GFX_waitForVBlank0();
+
+			hidScanInput();
+			if(hidGetExtraKeys(0) & (KEY_POWER_HELD | KEY_POWER)) goto end;
+			kDown = hidKeysDown();
+		} while(kDown == 0);
+
+		const u32 num = lib.num;
+		if(kDown & KEY_B) break;
+		if(kDown & KEY_A && num != 0)
+		{
+			libGetPath(&lib, cursorPos, selected);
+			picked = *selected != '\0';
+			if(picked) break;
+		}
+		if(kDown & KEY_START)
+		{
+			if(buildLibrary(&lib) != RES_OK) break;
+			cursorPos = 0;
+			windowPos = 0;
+			continue;
+		}
+
+		// Incremental prefix search.
+		bool search = false;
+		if((kDown & KEY_X) && prefixLen < sizeof(prefix) - 1)
+		{
+			charIdx = 0;
+			prefix[prefixLen++] = searchChars[0];
+			search = true;
+		}
+		if((kDown & KEY_Y) && prefixLen > 0)
+		{
+			prefix[--prefixLen] = '\0';
+			if(prefixLen > 0) charIdx = strchr(searchChars, prefix[prefixLen - 1]) - searchChars;
+			search = true;
+		}
+		if((kDown & (KEY_L | KEY_R)) && prefixLen > 0)
+		{
+			const u32 numChars = sizeof(searchChars) - 1;
+			charIdx = (kDown & KEY_R ? charIdx + 1 : charIdx + numChars - 1) % numChars;
+			prefix[prefixLen - 1] = searchChars[charIdx];
+			search = true;
+		}
+		if(search)
+		{
+			cursorPos = libFindPrefix(&lib, prefix);
+			if((u32)cursorPos >= num) cursorPos = (num > 0 ? num - 1 : 0);
+			windowPos = cursorPos;
+			continue;
+		}
+
+		if(num != 0)
+		{
+			if(kDown & KEY_DRIGHT)
+			{
+				cursorPos += LIB_ROWS;
+				if((u32)cursorPos > num) cursorPos = num - 1;
+			}
+			if(kDown & KEY_DLEFT)
+			{
+				cursorPos -= LIB_ROWS;
+				if(cursorPos < -1) cursorPos = 0;
+			}
+			if(kDown & KEY_DUP)    cursorPos -= 1;
+			if(kDown & KEY_DDOWN)  cursorPos += 1;
+		}
+
+		if(cursorPos < 0)              cursorPos = num - 1; // Wrap to end of list.
+		if((u32)cursorPos > (num - 1)) cursorPos = 0;       // Wrap to start of list.
+
+		if((u32)cursorPos < windowPos)             windowPos = cursorPos;
+		if((u32)cursorPos >= windowPos + LIB_ROWS) windowPos = cursorPos - (LIB_ROWS - 1);
+	}
+
+end:
+	libFree(&lib);
+	tgClear();
+
+	return picked;
 }
 
 Result browseFiles(const char *const basePath, char selected[512])
@@ -145,27 +1190,67 @@ Result browseFiles(const char *const basePath, char selected[512])
 	if(curDir == NULL) return RES_OUT_OF_MEM;
 	safeStrcpy(curDir, basePath, 512);
 
-	DirList *const dList = (DirList*)malloc(sizeof(DirList));
-	if(dList == NULL) return RES_OUT_OF_MEM;
+	g_sortFlags = (g_oafConfig.sortNatural ? SORT_NATURAL : 0) | (g_oafConfig.sortIgnoreCase ? SORT_IGNORE_CASE : 0);
+
+	DirList list;
+	DirList *const dList = &list;
+	dlistInit(dList);
+
+	DirScan scan = {.mode = SCAN_IDLE, .shadow = false, .filter = ".gba"};
+	scan.fis = (FILINFO*)malloc(sizeof(FILINFO) * DIR_READ_BLOCKS);
+	if(scan.fis == NULL)
+	{
+		free(curDir);
+		return RES_OUT_OF_MEM;
+	}
+
+	PreviewCache *const preview = (PreviewCache*)calloc(1, sizeof(PreviewCache));
+	if(preview == NULL)
+	{
+		free(scan.fis);
+		free(curDir);
+		return RES_OUT_OF_MEM;
+	}
+
+	// Db save types for the previews. Loaded once instead of per preview.
+	romCacheLoad();
+
+	tgClear();
 
 	Result res;
-	if((res = scanDir(curDir, dList, ".gba")) != RES_OK) goto end;
-	showDirList(dList, 0);
+	if((res = openDir(curDir, dList, &scan)) != RES_OK) goto end;
 
-	s32 cursorPos = 0; // Within the entire list.
-	u32 windowPos = 0; // Window start position within the list.
-	s32 oldCursorPos = 0;
+	s32 cursorPos = 0;           // Within the entire list.
+	u32 windowPos = 0;           // Window start position within the list.
+	u32 shownWindow = UINT32_MAX; // Window position on screen. UINT32_MAX = list changed.
 	while(1)
 	{
-		ee_printf("\x1b[%lu;H ", oldCursorPos - windowPos + 1);      // Clear old cursor.
-		ee_printf("\x1b[%lu;H\x1b[37m>", cursorPos - windowPos + 1); // Draw cursor.
-		GFX_flushBuffers();
+		// Scrolling down by one moves the rows on screen instead of redrawing them.
+		if(shownWindow != UINT32_MAX && windowPos == shownWindow + 1) tgScrollUp(0, SCREEN_ROWS);
+		shownWindow = windowPos;
+		showDirList(dList, windowPos, cursorPos, preview->shown);
 
 		u32 kDown;
 		do
 		{
 			GFX_waitForVBlank0();
 
+			// Scan or check the directory while idle.
+			u32 newPos = cursorPos;
+			if(scanStep(&scan, curDir, dList, DIR_SCAN_STEP, &newPos))
+			{
+				// Keep the cursor on the same entry and screen row if possible.
+				const u32 row = cursorPos - windowPos;
+				windowPos = (newPos > row ? newPos - row : 0);
+				cursorPos = newPos;
+				shownWindow = windowPos;
+				showDirList(dList, windowPos, cursorPos, preview->shown);
+			}
+
+			// Show the header of the highlighted ROM once the cursor rests on it.
+			if(previewStep(preview, curDir, dList, cursorPos))
+				showDirList(dList, windowPos, cursorPos, preview->shown);
+
 			hidScanInput();
 			if(hidGetExtraKeys(0) & (KEY_POWER_HELD | KEY_POWER)) goto end;
 			kDown = hidKeysDown();
@@ -174,7 +1259,6 @@ Result browseFiles(const char *const basePath, char selected[512])
 		const u32 num = dList->num;
 		if(num != 0)
 		{
-			oldCursorPos = cursorPos;
 			if(kDown & KEY_DRIGHT)
 			{
 				cursorPos += SCREEN_ROWS;
@@ -192,15 +1276,15 @@ Result browseFiles(const char *const basePath, char selected[512])
 		if(cursorPos < 0)              cursorPos = num - 1; // Wrap to end of list.
 		if((u32)cursorPos > (num - 1)) cursorPos = 0;       // Wrap to start of list.
 
-		if((u32)cursorPos < windowPos)
-		{
-			windowPos = cursorPos;
-			showDirList(dList, windowPos);
-		}
-		if((u32)cursorPos >= windowPos + SCREEN_ROWS)
+		if((u32)cursorPos < windowPos)                windowPos = cursorPos;
+		if((u32)cursorPos >= windowPos + SCREEN_ROWS) windowPos = cursorPos - (SCREEN_ROWS - 1);
+
+		if(kDown & KEY_SELECT)
 		{
-			windowPos = cursorPos - (SCREEN_ROWS - 1);
-			showDirList(dList, windowPos);
+			// Library view of all ROMs on the SD card.
+			if(browseLibrary(selected)) break;
+			shownWindow = UINT32_MAX;
+			continue;
 		}
 
 		if(kDown & (KEY_A | KEY_B))
@@ -227,19 +1311,23 @@ Result browseFiles(const char *const basePath, char selected[512])
 				*tmpPathPtr = '\0';
 			}
 
-			if((res = scanDir(curDir, dList, ".gba")) != RES_OK) break;
+			previewReset(preview);
+			if((res = openDir(curDir, dList, &scan)) != RES_OK) break;
 			cursorPos = 0;
 			windowPos = 0;
-			showDirList(dList, 0);
+			shownWindow = UINT32_MAX;
 		}
 	}
 
 end:
-	free(dList);
+	scanStop(&scan);
+	previewReset(preview);
+	free(preview);
+	free(scan.fis);
+	dlistFree(dList);
 	free(curDir);
 
-	// Clear screen.
-	ee_printf("\x1b[2J");
+	tgClear();
 
 	return res;
 }
\ No newline at end of file
@@ -0,0 +1,177 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "arm11/gfx_stats.h"
+#include "arm11/screenshot.h"
+#include "arm11/fmt.h"
+#include "fsutil.h"
+
+
+#define SUB_BITS        (3u) // 8 buckets per power of 2. 12.5% worst case error.
+#define SUB_BUCKETS     (1u<<SUB_BITS)
+#define LINE_MAX        (96u) // Worst case size of one CSV line.
+#define SERIALIZE_SIZE  (LINE_MAX * (GFX_STAGE_NUM + 3))
+
+
+u32 g_gfxStamps[GFX_STAMP_NUM];
+GfxStats g_gfxStats;
+
+static const char *const g_stageNames[GFX_STAGE_NUM] =
+{
+	"submit", "p3d", "ppf", "swap", "total", "interval"
+};
+
+
+
+// Log-linear buckets. Values below 8 get their own bucket.
+static u32 ticksToBucket(const u32 ticks)
+{
+	if(ticks < SUB_BUCKETS) return ticks;
+
+	const u32 exp = 31 - __builtin_clz(ticks);
+	const u32 bucket = (exp - SUB_BITS + 1) * SUB_BUCKETS + (ticks>>(exp - SUB_BITS) & (SUB_BUCKETS - 1));
+
+	return (bucket < GFXSTATS_BUCKETS ? bucket : GFXSTATS_BUCKETS - 1);
+}
+
+static u32 bucketUpperBound(const u32 bucket)
+{
+	if(bucket < SUB_BUCKETS) return bucket;
+
+	const u32 shift = bucket / SUB_BUCKETS - 1;
+	const u32 lower = (SUB_BUCKETS + bucket % SUB_BUCKETS)<<shift;
+
+	return lower + (1u<<shift) - 1;
+}
+
+void gfxHistAdd(GfxHist *const hist, const u32 ticks)
+{
+	if(hist->count == 0 || ticks < hist->min) hist->min = ticks;
+	if(ticks > hist->max) hist->max = ticks;
+	hist->sum += ticks;
+	hist->count++;
+	hist->buckets[ticksToBucket(ticks)]++;
+}
+
+u32 gfxHistPercentile(const GfxHist *const hist, const u32 permille)
+{
+	if(hist->count == 0) return 0;
+
+	// Rank of the wanted sample (1-based, rounded up).
+	const u32 rank = ((u64)hist->count * permille + 999) / 1000;
+	u32 seen = 0;
+	for(u32 i = 0; i < GFXSTATS_BUCKETS; i++)
+	{
+		seen += hist->buckets[i];
+		if(seen >= rank && seen > 0)
+		{
+			// The last bucket also holds everything above its range.
+			const u32 upper = (i < GFXSTATS_BUCKETS - 1 ? bucketUpperBound(i) : hist->max);
+			return (upper < hist->max ? upper : hist->max);
+		}
+	}
+
+	return hist->max;
+}
+
+void gfxStatsFrame(GfxStats *const stats, const u32 stamps[GFX_STAMP_NUM])
+{
+	// Readers copy without locking. An odd seq means a frame is half added.
+	const u32 seq = stats->seq;
+	__atomic_store_n(&stats->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	// Counter differences are wrap safe.
+	GfxHist *const hist = stats->hist;
+	gfxHistAdd(&hist[GFX_STAGE_SUBMIT], stamps[GFX_STAMP_SUBMIT] - stamps[GFX_STAMP_READY]);
+	gfxHistAdd(&hist[GFX_STAGE_P3D], stamps[GFX_STAMP_P3D] - stamps[GFX_STAMP_SUBMIT]);
+	gfxHistAdd(&hist[GFX_STAGE_PPF], stamps[GFX_STAMP_PPF] - stamps[GFX_STAMP_P3D]);
+	gfxHistAdd(&hist[GFX_STAGE_SWAP], stamps[GFX_STAMP_SWAP] - stamps[GFX_STAMP_PPF]);
+	gfxHistAdd(&hist[GFX_STAGE_TOTAL], stamps[GFX_STAMP_SWAP] - stamps[GFX_STAMP_READY]);
+
+	const u32 ready = stamps[GFX_STAMP_READY];
+	if(stats->lastReady != 0)
+	{
+		const u32 interval = ready - stats->lastReady;
+		gfxHistAdd(&hist[GFX_STAGE_INTERVAL], interval);
+		if(interval > GFXSTATS_FRAME_TICKS + GFXSTATS_FRAME_TICKS / 2) stats->late++;
+		else if(interval < GFXSTATS_FRAME_TICKS / 2)                   stats->dup++;
+	}
+	stats->lastReady = (ready != 0 ? ready : 1);
+
+	__atomic_store_n(&stats->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void gfxStatsSnapshot(const GfxStats *const stats, GfxStats *const out)
+{
+	u32 seq;
+	do
+	{
+		seq = __atomic_load_n(&stats->seq, __ATOMIC_ACQUIRE);
+		memcpy(out, stats, sizeof(GfxStats));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while((seq & 1) != 0 || __atomic_load_n(&stats->seq, __ATOMIC_RELAXED) != seq);
+}
+
+u32 gfxStatsSerialize(const GfxStats *const stats, char *const buf, const u32 size)
+{
+	if(size < SERIALIZE_SIZE) return 0;
+
+	u32 len = ee_sprintf(buf, "stage,count,min_us,avg_us,p99_us,max_us\n");
+	for(u32 i = 0; i < GFX_STAGE_NUM; i++)
+	{
+		const GfxHist *const hist = &stats->hist[i];
+		const u32 avg = (hist->count > 0 ? hist->sum / hist->count : 0);
+		len += ee_sprintf(&buf[len], "%s,%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n",
+		                  g_stageNames[i], hist->count, traceTicksToUs(hist->min), traceTicksToUs(avg),
+		                  traceTicksToUs(gfxHistPercentile(hist, 990)), traceTicksToUs(hist->max));
+	}
+	len += ee_sprintf(&buf[len], "late,%" PRIu32 "\ndup,%" PRIu32 "\n", stats->late, stats->dup);
+
+	return len;
+}
+
+Result gfxStatsDump(const char *const path)
+{
+	// Snapshot first. The gfx handler keeps adding frames meanwhile.
+	GfxStats *const snapshot = (GfxStats*)malloc(sizeof(GfxStats) + SERIALIZE_SIZE);
+	if(snapshot == NULL) return RES_OUT_OF_MEM;
+	gfxStatsSnapshot(&g_gfxStats, snapshot);
+
+	char *const buf = (char*)(snapshot + 1);
+	const u32 len = gfxStatsSerialize(snapshot, buf, SERIALIZE_SIZE);
+	const Result res = fsQuickWrite(path, buf, len);
+	free(snapshot);
+
+	return res;
+}
+
+static void dumpJob(void)
+{
+	const Result res = gfxStatsDump(GFXSTATS_PATH);
+	if(res != RES_OK) ee_printf("Failed to write gfx stats: %s\n", result2String(res));
+}
+
+void gfxStatsQueueDump(void)
+{
+	// Dropped if the previous dump is still queued.
+	screenshotQueueJob(dumpJob);
+}
@@ -0,0 +1,462 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <initializer_list>
+#include "types.h"
+#include "arm11/gpu_cmd_lists.h"
+
+
+// All GPU command lists are built at compile time. There is one fully
+// specialized list pair per scaler and texture so nothing is patched at runtime.
+namespace
+{
+
+// PICA200 registers used by the lists.
+enum class Reg : u16
+{
+	FINALIZE                       = 0x010,
+	FACECULLING_CONFIG             = 0x040,
+	VIEWPORT_WIDTH                 = 0x041, // WIDTH, INVW, HEIGHT, INVH.
+	DEPTHMAP_SCALE                 = 0x04D, // SCALE, OFFSET.
+	SH_OUTMAP_TOTAL                = 0x04F, // TOTAL, O0-O6.
+	EARLYDEPTH_FUNC                = 0x061,
+	EARLYDEPTH_TEST1               = 0x062,
+	EARLYDEPTH_CLEAR               = 0x063,
+	SH_OUTATTR_MODE                = 0x064,
+	SCISSORTEST_MODE               = 0x065, // MODE, POS, DIM.
+	VIEWPORT_XY                    = 0x068,
+	EARLYDEPTH_DATA                = 0x06A,
+	DEPTHMAP_ENABLE                = 0x06D,
+	RENDERBUF_DIM                  = 0x06E,
+	SH_OUTATTR_CLOCK               = 0x06F,
+	TEXUNIT_CONFIG                 = 0x080,
+	TEXUNIT0_BORDER_COLOR          = 0x081, // BORDER_COLOR, DIM, PARAM, LOD, ADDR1.
+	TEXUNIT0_SHADOW                = 0x08B,
+	TEXUNIT0_TYPE                  = 0x08E,
+	TEXENV0_SOURCE                 = 0x0C0, // SOURCE, OPERAND, COMBINER, COLOR, SCALE.
+	TEXENV_UPDATE_BUFFER           = 0x0E0,
+	FOG_COLOR                      = 0x0E1,
+	TEXENV_BUFFER_COLOR            = 0x0FD,
+	COLOR_OPERATION                = 0x100,
+	BLEND_FUNC                     = 0x101,
+	LOGIC_OP                       = 0x102,
+	BLEND_COLOR                    = 0x103,
+	FRAGOP_ALPHA_TEST              = 0x104, // ALPHA_TEST, STENCIL_TEST, STENCIL_OP, DEPTH_COLOR_MASK.
+	FRAMEBUFFER_INVALIDATE         = 0x110,
+	FRAMEBUFFER_FLUSH              = 0x111,
+	COLORBUFFER_READ               = 0x112, // COLORBUFFER_READ/WRITE, DEPTHBUFFER_READ/WRITE.
+	DEPTHBUFFER_FORMAT             = 0x116,
+	COLORBUFFER_FORMAT             = 0x117,
+	EARLYDEPTH_TEST2               = 0x118,
+	FRAMEBUFFER_BLOCK32            = 0x11B,
+	DEPTHBUFFER_LOC                = 0x11C, // DEPTHBUFFER_LOC, COLORBUFFER_LOC, FRAMEBUFFER_DIM.
+	GAS_DELTAZ_DEPTH               = 0x126,
+	FRAGOP_SHADOW                  = 0x130,
+	ATTRIBBUFFERS_FORMAT_LOW       = 0x201, // LOW, HIGH.
+	INDEXBUFFER_CONFIG             = 0x227,
+	GEOSTAGE_CONFIG                = 0x229,
+	VTX_FUNC                       = 0x231,
+	FIXEDATTRIB_INDEX              = 0x232,
+	FIXEDATTRIB_DATA0              = 0x233,
+	VSH_NUM_ATTR                   = 0x242,
+	VSH_COM_MODE                   = 0x244,
+	START_DRAW_FUNC0               = 0x245,
+	VSH_OUTMAP_TOTAL1              = 0x24A,
+	VSH_OUTMAP_TOTAL2              = 0x251,
+	GSH_MISC0                      = 0x252,
+	GEOSTAGE_CONFIG2               = 0x253,
+	GSH_MISC1                      = 0x254,
+	PRIMITIVE_CONFIG               = 0x25E,
+	RESTART_PRIMITIVE              = 0x25F,
+	GSH_INPUTBUFFER_CONFIG         = 0x289,
+	VSH_BOOLUNIFORM                = 0x2B0,
+	VSH_INPUTBUFFER_CONFIG         = 0x2B9,
+	VSH_ENTRYPOINT                 = 0x2BA,
+	VSH_ATTRIBUTES_PERMUTATION_LOW = 0x2BB, // LOW, HIGH.
+	VSH_OUTMAP_MASK                = 0x2BD,
+	VSH_CODETRANSFER_END           = 0x2BF,
+	VSH_FLOATUNIFORM_CONFIG        = 0x2C0,
+	VSH_FLOATUNIFORM_DATA          = 0x2C1,
+	VSH_CODETRANSFER_CONFIG        = 0x2CB,
+	VSH_CODETRANSFER_DATA          = 0x2CC,
+	VSH_OPDESCS_CONFIG             = 0x2D5,
+	VSH_OPDESCS_DATA               = 0x2D6
+};
+
+// Byte enable masks.
+constexpr u8 MASK_ALL   = 0xF;
+constexpr u8 MASK_BYTE0 = 0x1;
+constexpr u8 MASK_BYTE1 = 0x2;
+
+// GPUREG_TEXUNIT0_PARAM.
+constexpr u32 TEX_FILTER_NEAREST = 0;
+constexpr u32 TEX_MAG_LINEAR     = 1u<<1;
+
+// GPUREG_TEXUNIT0_TYPE.
+constexpr u32 TEX_FMT_RGBA8  = 0;
+constexpr u32 TEX_FMT_RGB5A1 = 2;
+
+constexpr u32 TEX_DIM = 512; // Both textures are 512x512.
+
+// Top screen render buffer in GPU orientation.
+constexpr u32 FB_WIDTH  = 240;
+constexpr u32 FB_HEIGHT = 400;
+
+
+constexpr u32 f32ToF24(const float f)
+{
+	const u32 bits = std::bit_cast<u32>(f);
+	const u32 sign = bits>>31;
+	if((bits & 0x7FFFFFFFu) == 0) return sign<<23;
+
+	const u32 exp = ((bits>>23) & 0xFFu) - 127 + 63;
+	return sign<<23 | exp<<16 | (bits & 0x7FFFFFu)>>7;
+}
+
+constexpr u32 f32ToF31(const float f)
+{
+	const u32 bits = std::bit_cast<u32>(f);
+	const u32 sign = bits>>31;
+	if((bits & 0x7FFFFFFFu) == 0) return sign<<30;
+
+	const u32 exp = ((bits>>23) & 0xFFu) - 127 + 63;
+	return sign<<30 | exp<<23 | (bits & 0x7FFFFFu);
+}
+
+struct Vec4 final
+{
+	float x, y, z, w;
+};
+
+// 4 float24 packed into 3 words (w, z, y, x from the top).
+constexpr std::array<u32, 3> packF24(const Vec4 v)
+{
+	const u32 x = f32ToF24(v.x);
+	const u32 y = f32ToF24(v.y);
+	const u32 z = f32ToF24(v.z);
+	const u32 w = f32ToF24(v.w);
+	return {w<<8 | z>>16, (z & 0xFFFFu)<<16 | y>>8, (y & 0xFFu)<<24 | x};
+}
+
+class CmdList final
+{
+	static constexpr std::size_t MAX_WORDS = 320;
+
+	u32 m_buf[MAX_WORDS]{};
+	std::size_t m_size{};
+
+
+	constexpr void writeCmd(const Reg reg, const u32 *const params, const std::size_t num, const u8 mask, const bool seq)
+	{
+		m_buf[m_size++] = params[0];
+		m_buf[m_size++] = (seq ? 1u<<31 : 0u) | (u32)(num - 1)<<20 | (u32)mask<<16 | static_cast<u16>(reg);
+		for(std::size_t i = 1; i < num; i++) m_buf[m_size++] = params[i];
+		if(m_size & 1u) m_buf[m_size++] = 0; // Commands are 8 bytes aligned.
+	}
+
+public:
+	constexpr std::size_t size(void) const { return m_size; }
+	constexpr u32 operator [](const std::size_t i) const { return m_buf[i]; }
+
+	// Single register write.
+	constexpr void write(const Reg reg, const u32 val, const u8 mask = MASK_ALL)
+	{
+		writeCmd(reg, &val, 1, mask, false);
+	}
+
+	// Writes consecutive registers starting at reg.
+	constexpr void writeSeq(const Reg reg, const std::initializer_list<u32> vals, const u8 mask = MASK_ALL)
+	{
+		writeCmd(reg, vals.begin(), vals.size(), mask, true);
+	}
+
+	// Writes all values to the same register (data ports).
+	constexpr void writeRepeat(const Reg reg, const std::initializer_list<u32> vals, const u8 mask = MASK_ALL)
+	{
+		writeCmd(reg, vals.begin(), vals.size(), mask, false);
+	}
+
+	// Color buffer, depth buffer and dimensions.
+	constexpr void framebuffer(const u32 colorAddr, const u32 depthAddr, const u32 w, const u32 h)
+	{
+		const u32 dim = 1u<<24 | (h - 1)<<12 | w;
+		writeSeq(Reg::DEPTHBUFFER_LOC, {depthAddr>>3, colorAddr>>3, dim});
+		write(Reg::RENDERBUF_DIM, dim);
+	}
+
+	constexpr void viewport(const u32 w, const u32 h)
+	{
+		writeSeq(Reg::VIEWPORT_WIDTH, {f32ToF24(w / 2.f), f32ToF31(2.f / w)<<1, f32ToF24(h / 2.f), f32ToF31(2.f / h)<<1});
+	}
+
+	constexpr void depthMap(const float scale, const float offset)
+	{
+		writeSeq(Reg::DEPTHMAP_SCALE, {f32ToF24(scale), f32ToF24(offset)});
+	}
+
+	constexpr void texUnit0(const u32 addr, const u32 w, const u32 h, const u32 param, const u32 fmt)
+	{
+		writeSeq(Reg::TEXUNIT0_BORDER_COLOR, {0, w<<16 | h, param, 0, addr>>3});
+		write(Reg::TEXUNIT0_TYPE, fmt);
+	}
+
+	constexpr void texEnv(const unsigned stage, const u32 source, const u32 operand, const u32 combiner, const u32 color)
+	{
+		// Stage 4 and 5 are after the update buffer/fog registers.
+		const u16 base = static_cast<u16>(Reg::TEXENV0_SOURCE) + (stage < 4 ? stage * 8 : 0x30 + (stage - 4) * 8);
+		writeSeq(static_cast<Reg>(base), {source, operand, combiner, color, 0});
+	}
+
+	constexpr void floatUniformF24(const u8 index, const Vec4 v)
+	{
+		const auto packed = packF24(v);
+		writeSeq(Reg::VSH_FLOATUNIFORM_CONFIG, {index, packed[0], packed[1], packed[2]});
+	}
+
+	// float32 uniform upload. Each vector is sent as w, z, y, x.
+	constexpr void floatUniformsF32(const u8 index, const std::array<Vec4, 4> &m)
+	{
+		write(Reg::VSH_FLOATUNIFORM_CONFIG, 1u<<31 | index);
+		writeRepeat(Reg::VSH_FLOATUNIFORM_DATA, {
+			std::bit_cast<u32>(m[0].w), std::bit_cast<u32>(m[0].z), std::bit_cast<u32>(m[0].y), std::bit_cast<u32>(m[0].x),
+			std::bit_cast<u32>(m[1].w), std::bit_cast<u32>(m[1].z), std::bit_cast<u32>(m[1].y), std::bit_cast<u32>(m[1].x),
+			std::bit_cast<u32>(m[2].w), std::bit_cast<u32>(m[2].z), std::bit_cast<u32>(m[2].y), std::bit_cast<u32>(m[2].x),
+			std::bit_cast<u32>(m[3].w), std::bit_cast<u32>(m[3].z), std::bit_cast<u32>(m[3].y), std::bit_cast<u32>(m[3].x)
+		});
+	}
+
+	// Immediate mode vertex (position + texcoord).
+	constexpr void vertex(const Vec4 pos, const Vec4 texCoord)
+	{
+		const auto p = packF24(pos);
+		const auto t = packF24(texCoord);
+		writeSeq(Reg::FIXEDATTRIB_DATA0, {p[0], p[1], p[2]});
+		writeSeq(Reg::FIXEDATTRIB_DATA0, {t[0], t[1], t[2]});
+	}
+
+	// Textured triangle strip quad. Rectangle in screen pixels, texture size in texels.
+	constexpr void drawQuad(const float x0, const float y0, const float x1, const float y1, const u32 texW, const u32 texH)
+	{
+		const float u = (float)texW / TEX_DIM;
+		const float v = 1.f - (float)texH / TEX_DIM; // Textures start at the bottom.
+
+		write(Reg::PRIMITIVE_CONFIG, 1u<<8, MASK_BYTE1); // Triangle strip.
+		write(Reg::RESTART_PRIMITIVE, 1);
+		write(Reg::INDEXBUFFER_CONFIG, 1u<<31);
+		write(Reg::GEOSTAGE_CONFIG2, 1, MASK_BYTE0);
+		write(Reg::START_DRAW_FUNC0, 0, MASK_BYTE0);
+		write(Reg::FIXEDATTRIB_INDEX, 0xF);
+		vertex({x0, y0, 0.5f, 1.f}, {0.f, v, 0.f, 0.f});
+		vertex({x1, y0, 0.5f, 1.f}, {u, v, 0.f, 0.f});
+		vertex({x0, y1, 0.5f, 1.f}, {0.f, 1.f, 0.f, 0.f});
+		vertex({x1, y1, 0.5f, 1.f}, {u, 1.f, 0.f, 0.f});
+		write(Reg::START_DRAW_FUNC0, 1, MASK_BYTE0);
+		write(Reg::GEOSTAGE_CONFIG2, 0, MASK_BYTE0);
+		write(Reg::VTX_FUNC, 1);
+	}
+
+	// Ends the list. Pads it to 16 bytes for GX_processCommandList().
+	constexpr void finalize(void)
+	{
+		do
+		{
+			write(Reg::FINALIZE, 0x12345678);
+		} while(m_size & 3u);
+	}
+};
+
+// Passthrough vertex shader (position * projection, texcoord).
+constexpr std::initializer_list<u32> g_vshCode =
+{
+	0x4E000000, 0x4E07F001, 0x08020802, 0x08021803, 0x08022804, 0x08023805, 0x4C201006, 0x88000000
+};
+constexpr std::initializer_list<u32> g_vshOpdescs =
+{
+	0x0000036E, 0x00000AA1, 0x0006C368, 0x0006C364, 0x0006C362, 0x0006C361, 0x0000036F
+};
+
+// Orthographic projection for the rotated 400x240 top screen.
+constexpr std::array<Vec4, 4> g_projection =
+{{
+	{0.f,          2.f / 240, 0.f, -1.f},
+	{-2.f / 400,   0.f,       0.f,  1.f},
+	{0.f,          0.f,       1.f, -1.f},
+	{0.f,          0.f,       0.f,  1.f}
+}};
+
+struct Scaling final
+{
+	float x0, y0, x1, y1; // Output rectangle.
+	u32 texW, texH;       // Captured frame size.
+	u32 texParam;
+};
+
+constexpr Scaling getScaling(const u8 scaleType)
+{
+	switch(scaleType)
+	{
+		case 0:  return {80.f, 40.f, 320.f, 200.f, 240, 160, TEX_FILTER_NEAREST}; // 240x160 centered.
+		case 1:  return {20.f, 0.f, 380.f, 240.f, 240, 160, TEX_MAG_LINEAR};      // Bilinear x1.5 on the GPU.
+		default: return {20.f, 0.f, 380.f, 240.f, 360, 240, TEX_FILTER_NEAREST};  // Already scaled by LgyCap.
+	}
+}
+
+// State set at the start of every frame.
+constexpr void frameSetup(CmdList &l)
+{
+	l.write(Reg::FRAMEBUFFER_INVALIDATE, 1);
+	l.framebuffer(GPU_RENDER_BUF_ADDR, GPU_TEXTURE2_ADDR, FB_WIDTH, FB_HEIGHT);
+	l.write(Reg::DEPTHBUFFER_FORMAT, 3);
+	l.write(Reg::COLORBUFFER_FORMAT, 0x00010001); // RGB8.
+	l.write(Reg::FRAMEBUFFER_BLOCK32, 0);
+	l.writeSeq(Reg::COLORBUFFER_READ, {0xF, 0xF, 3, 3});
+	l.viewport(FB_WIDTH, FB_HEIGHT);
+	l.write(Reg::VIEWPORT_XY, 0);
+	l.writeSeq(Reg::SCISSORTEST_MODE, {0, 0, 0});
+}
+
+// Full pipeline setup. Only needed for the first frame.
+constexpr void pipelineSetup(CmdList &l, const Scaling &s, const bool useSecondTexture)
+{
+	// Vertex shader.
+	l.write(Reg::GEOSTAGE_CONFIG, 0, 0x3);
+	l.write(Reg::GEOSTAGE_CONFIG2, 0, 0x3);
+	l.write(Reg::VSH_COM_MODE, 0, MASK_BYTE0);
+	l.write(Reg::VSH_CODETRANSFER_CONFIG, 0);
+	l.writeRepeat(Reg::VSH_CODETRANSFER_DATA, g_vshCode);
+	l.write(Reg::VSH_CODETRANSFER_END, 1);
+	l.write(Reg::VSH_OPDESCS_CONFIG, 0);
+	l.writeRepeat(Reg::VSH_OPDESCS_DATA, g_vshOpdescs);
+	l.write(Reg::VSH_ENTRYPOINT, 0x7FFF0000);
+	l.write(Reg::VSH_OUTMAP_MASK, 3);
+	l.write(Reg::VSH_OUTMAP_TOTAL1, 1);
+	l.write(Reg::VSH_OUTMAP_TOTAL2, 1);
+	l.write(Reg::PRIMITIVE_CONFIG, 1, MASK_BYTE0);
+	// o0 = position, o1 = texcoord0.
+	l.writeSeq(Reg::SH_OUTMAP_TOTAL, {2, 0x03020100, 0x1F1F0D0C, 0x1F1F1F1F, 0x1F1F1F1F, 0x1F1F1F1F, 0x1F1F1F1F, 0x1F1F1F1F});
+	l.write(Reg::SH_OUTATTR_MODE, 1);
+	l.write(Reg::SH_OUTATTR_CLOCK, 0x101);
+	l.write(Reg::GEOSTAGE_CONFIG, 0, 0xA);
+	l.write(Reg::GSH_MISC0, 0);
+	l.write(Reg::GSH_MISC1, 0);
+	l.write(Reg::GSH_INPUTBUFFER_CONFIG, 0xA0000000);
+	l.writeSeq(Reg::ATTRIBBUFFERS_FORMAT_LOW, {0x7B, 0x1FFC0000});
+	l.write(Reg::VSH_INPUTBUFFER_CONFIG, 0xA0000001, 0xB);
+	l.write(Reg::VSH_NUM_ATTR, 1);
+	l.writeSeq(Reg::VSH_ATTRIBUTES_PERMUTATION_LOW, {0x10, 0});
+
+	// Rasterizer and fragment operations.
+	l.write(Reg::DEPTHMAP_ENABLE, 1);
+	l.write(Reg::FACECULLING_CONFIG, 2);
+	l.depthMap(-1.f, 0.f);
+	l.writeSeq(Reg::FRAGOP_ALPHA_TEST, {0x10, 0x10, 0, 0xF10});
+	l.write(Reg::GAS_DELTAZ_DEPTH, 0, 0x8);
+	l.write(Reg::BLEND_COLOR, 0);
+	l.write(Reg::BLEND_FUNC, 0x76760000);
+	l.write(Reg::LOGIC_OP, 0);
+	l.write(Reg::COLOR_OPERATION, 0x00E40100, 0x7);
+	l.write(Reg::FRAGOP_SHADOW, 0x80003C00);
+	l.write(Reg::EARLYDEPTH_TEST1, 0, MASK_BYTE0);
+	l.write(Reg::EARLYDEPTH_TEST2, 0);
+	l.write(Reg::EARLYDEPTH_FUNC, 0, MASK_BYTE0);
+	l.write(Reg::EARLYDEPTH_DATA, 0, 0x7);
+
+	// Texture. The color converted frame is RGBA8 in the second texture.
+	if(useSecondTexture) l.texUnit0(GPU_TEXTURE2_ADDR, TEX_DIM, TEX_DIM, s.texParam, TEX_FMT_RGBA8);
+	else                 l.texUnit0(GPU_TEXTURE_ADDR, TEX_DIM, TEX_DIM, s.texParam, TEX_FMT_RGB5A1);
+	l.write(Reg::TEXUNIT_CONFIG, 0x00011001, 0xB);
+	l.write(Reg::TEXUNIT_CONFIG, 0x00010000, 0x4);
+	l.write(Reg::TEXUNIT0_SHADOW, 1);
+
+	// Output the texture color. All other stages pass through.
+	l.write(Reg::TEXENV_UPDATE_BUFFER, 0, 0x7);
+	l.write(Reg::TEXENV_BUFFER_COLOR, 0xFFFFFFFF);
+	l.write(Reg::FOG_COLOR, 0);
+	l.texEnv(0, 0x00030003, 0, 0, 0xFFFFFFFF);
+	for(unsigned i = 1; i < 6; i++) l.texEnv(i, 0x000F000F, 0, 0, 0xFFFFFFFF);
+
+	l.floatUniformF24(95, {0.f, 1.f, -1.f, 0.5f}); // Shader constants.
+}
+
+constexpr CmdList buildGbaList(const u8 scaleType, const bool useSecondTexture, const bool init)
+{
+	const Scaling s = getScaling(scaleType);
+	CmdList l;
+	frameSetup(l);
+	if(init) pipelineSetup(l, s, useSecondTexture);
+	l.floatUniformsF32(0, g_projection);
+	if(init) l.write(Reg::VSH_BOOLUNIFORM, 0x7FFF0000);
+	l.drawQuad(s.x0, s.y0, s.x1, s.y1, s.texW, s.texH);
+	l.write(Reg::FRAMEBUFFER_FLUSH, 1);
+	l.write(Reg::FRAMEBUFFER_INVALIDATE, 1);
+	l.write(Reg::EARLYDEPTH_CLEAR, 1);
+	l.finalize();
+
+	return l;
+}
+
+template<std::size_t N>
+constexpr std::array<u32, N> toArray(const CmdList &l)
+{
+	std::array<u32, N> out{};
+	for(std::size_t i = 0; i < N; i++) out[i] = l[i];
+
+	return out;
+}
+
+template<u8 ScaleType, bool UseSecondTexture>
+struct GbaInitList final
+{
+	static constexpr CmdList list = buildGbaList(ScaleType, UseSecondTexture, true);
+	alignas(16) static constexpr std::array<u32, list.size()> data = toArray<list.size()>(list);
+};
+
+// The per frame list doesn't touch the texture unit.
+template<u8 ScaleType>
+struct GbaFrameList final
+{
+	static constexpr CmdList list = buildGbaList(ScaleType, false, false);
+	alignas(16) static constexpr std::array<u32, list.size()> data = toArray<list.size()>(list);
+};
+
+template<u8 ScaleType, bool UseSecondTexture>
+constexpr GbaGpuCmdLists makeLists(void)
+{
+	using Init  = GbaInitList<ScaleType, UseSecondTexture>;
+	using Frame = GbaFrameList<ScaleType>;
+	return {Init::data.data(), Frame::data.data(), sizeof(Init::data), sizeof(Frame::data)};
+}
+
+constexpr GbaGpuCmdLists g_gbaGpuCmdLists[3][2] =
+{
+	{makeLists<0, false>(), makeLists<0, true>()},
+	{makeLists<1, false>(), makeLists<1, true>()},
+	{makeLists<2, false>(), makeLists<2, true>()}
+};
+
+} // namespace
+
+
+
+const GbaGpuCmdLists* getGbaGpuCmdLists(const u8 scaleType, const bool useSecondTexture)
+{
+	return &g_gbaGpuCmdLists[(scaleType < 2 ? scaleType : 2)][useSecondTexture];
+}
@@ -0,0 +1,370 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "arm11/library.h"
+#include "arm11/arena.h"
+#include "fs.h"
+#include "util.h"
+
+
+#define LIB_READ_BLOCKS  (10u)
+#define GBA_HEADER_SIZE  (0xC0u)
+
+
+typedef struct
+{
+	Arena pool;        // String pool in file order. Offsets are arena.total before adding.
+	Arena scratch;     // Paths of directories left to scan.
+	LibEntry *entries;
+	u32 num;
+	u32 cap;
+	char **dirs;       // Stack of directories left to scan.
+	u32 numDirs;
+	u32 capDirs;
+} LibBuilder;
+
+
+
+static inline u32 foldCase(const u32 c)
+{
+	return (c - 'a' < 26 ? c - ('a' - 'A') : c);
+}
+
+// Compares up to n chars of 2 titles ignoring case.
+static int titleCompare(const char *const a, const char *const b, const u32 n)
+{
+	for(u32 i = 0; i < n; i++)
+	{
+		const u32 ca = foldCase((u8)a[i]);
+		const u32 cb = foldCase((u8)b[i]);
+		if(ca != cb) return (int)ca - (int)cb;
+		if(ca == '\0') break;
+	}
+
+	return 0;
+}
+
+static int libEntryCompare(const void *a, const void *b)
+{
+	const LibEntry *const entA = (const LibEntry*)a;
+	const LibEntry *const entB = (const LibEntry*)b;
+
+	const int res = titleCompare(entA->title, entB->title, sizeof(entA->title));
+	if(res != 0) return res;
+	if(entA->dirOff != entB->dirOff) return (entA->dirOff < entB->dirOff ? -1 : 1);
+
+	return (entA->nameOff < entB->nameOff ? -1 : (entA->nameOff > entB->nameOff));
+}
+
+// Returns the pool offset of the copy or UINT32_MAX if out of memory.
+static u32 poolAdd(Arena *const pool, const char *const str)
+{
+	const u32 off = pool->total;
+	const u32 size = strlen(str) + 1;
+	char *const copy = (char*)arenaAlloc(pool, size);
+	if(copy == NULL) return UINT32_MAX;
+	memcpy(copy, str, size);
+
+	return off;
+}
+
+static bool pushDir(LibBuilder *const b, const char *const path)
+{
+	if(b->numDirs == b->capDirs)
+	{
+		const u32 newCap = (b->capDirs > 0 ? b->capDirs * 2 : 32);
+		char **const dirs = (char**)realloc(b->dirs, sizeof(char*) * newCap);
+		if(dirs == NULL) return false;
+
+		b->dirs    = dirs;
+		b->capDirs = newCap;
+	}
+
+	const u32 size = strlen(path) + 1;
+	char *const copy = (char*)arenaAlloc(&b->scratch, size);
+	if(copy == NULL) return false;
+	memcpy(copy, path, size);
+	b->dirs[b->numDirs++] = copy;
+
+	return true;
+}
+
+static LibEntry* newEntry(LibBuilder *const b)
+{
+	if(b->num == b->cap)
+	{
+		const u32 newCap = (b->cap > 0 ? b->cap * 2 : 256);
+		LibEntry *const entries = (LibEntry*)realloc(b->entries, sizeof(LibEntry) * newCap);
+		if(entries == NULL) return NULL;
+
+		b->entries = entries;
+		b->cap     = newCap;
+	}
+
+	return &b->entries[b->num++];
+}
+
+static bool joinPath(char out[512], const char *const dir, const char *const name)
+{
+	const u32 dirLen = strlen(dir);
+	const u32 nameLen = strlen(name);
+	const bool slash = dirLen > 0 && dir[dirLen - 1] != '/';
+	if(dirLen + slash + nameLen >= 512) return false;
+
+	memcpy(out, dir, dirLen);
+	if(slash) out[dirLen] = '/';
+	memcpy(&out[dirLen + slash], name, nameLen + 1);
+
+	return true;
+}
+
+static bool isGbaFile(const char *const name)
+{
+	const u32 len = strlen(name);
+	return len > 4 && strcmp(&name[len - 4], ".gba") == 0 && name[0] != '.';
+}
+
+static void fillEntry(LibEntry *const entry, const char *const romPath, const char *const name)
+{
+	memset(entry, 0, sizeof(LibEntry));
+
+	u8 hdr[GBA_HEADER_SIZE];
+	FHandle f;
+	u32 read = 0;
+	if(fOpen(&f, romPath, FA_OPEN_EXISTING | FA_READ) == RES_OK)
+	{
+		if(fRead(f, hdr, sizeof(hdr), &read) != RES_OK) read = 0;
+		fClose(f);
+	}
+
+	// 0xB2 is the fixed value 0x96 in valid headers.
+	if(read == sizeof(hdr) && hdr[0xB2] == 0x96)
+	{
+		memcpy(entry->title, &hdr[0xA0], sizeof(entry->title));
+		memcpy(entry->gameCode, &hdr[0xAC], sizeof(entry->gameCode));
+		memcpy(entry->maker, &hdr[0xB0], sizeof(entry->maker));
+	}
+	else
+	{
+		// No usable header. Sort by file name instead.
+		const u32 len = strlen(name) - 4;
+		for(u32 i = 0; i < len && i < sizeof(entry->title); i++) entry->title[i] = foldCase((u8)name[i]);
+	}
+}
+
+static Result scanLibDir(LibBuilder *const b, const char *const dir, FILINFO *const fis, const bool isRoot)
+{
+	DHandle dh;
+	Result res = fOpenDir(&dh, dir);
+	if(res != RES_OK) return res;
+
+	char path[512];
+	u32 dirOff = UINT32_MAX; // Only added to the pool once a ROM is found.
+	u32 read;
+	do
+	{
+		if((res = fReadDir(dh, fis, LIB_READ_BLOCKS, &read)) != RES_OK) break;
+
+		for(u32 i = 0; i < read; i++)
+		{
+			const char *const name = fis[i].fname;
+			if(name[0] == '.' || !joinPath(path, dir, name)) continue;
+
+			if(fis[i].fattrib & AM_DIR)
+			{
+				// Skip the huge 3DS data folder.
+				if(isRoot && strcmp(name, "Nintendo 3DS") == 0) continue;
+				if(!pushDir(b, path)) goto oom;
+			}
+			else if(isGbaFile(name) && fis[i].fsize >= GBA_HEADER_SIZE)
+			{
+				if(dirOff == UINT32_MAX && (dirOff = poolAdd(&b->pool, dir)) == UINT32_MAX) goto oom;
+
+				LibEntry *const entry = newEntry(b);
+				if(entry == NULL) goto oom;
+				fillEntry(entry, path, name);
+				entry->dirOff  = dirOff;
+				entry->nameOff = poolAdd(&b->pool, name);
+				if(entry->nameOff == UINT32_MAX) goto oom;
+			}
+		}
+	} while(read == LIB_READ_BLOCKS);
+
+	fCloseDir(dh);
+
+	return res;
+
+oom:
+	fCloseDir(dh);
+
+	return RES_OUT_OF_MEM;
+}
+
+static Result writeIndex(const LibBuilder *const b)
+{
+	FHandle f;
+	Result res = fOpen(&f, LIB_INDEX_PATH, FA_CREATE_ALWAYS | FA_WRITE);
+	if(res != RES_OK) return res;
+
+	const LibHeader hdr = {LIB_MAGIC, LIB_VERSION, sizeof(LibEntry), b->num, b->pool.total};
+	res = fWrite(f, &hdr, sizeof(hdr), NULL);
+	if(res == RES_OK && b->num > 0) res = fWrite(f, b->entries, sizeof(LibEntry) * b->num, NULL);
+
+	// The pool chunks are in offset order.
+	for(const ArenaChunk *chunk = b->pool.first; chunk != NULL && res == RES_OK; chunk = chunk->next)
+		res = fWrite(f, chunk->data, chunk->used, NULL);
+
+	fClose(f);
+	if(res != RES_OK) fUnlink(LIB_INDEX_PATH);
+
+	return res;
+}
+
+Result libBuild(const char *const root, LibProgressCb progress)
+{
+	FILINFO *const fis = (FILINFO*)malloc(sizeof(FILINFO) * LIB_READ_BLOCKS);
+	if(fis == NULL) return RES_OUT_OF_MEM;
+
+	LibBuilder b;
+	memset(&b, 0, sizeof(b));
+	arenaInit(&b.pool);
+	arenaInit(&b.scratch);
+
+	Result res = scanLibDir(&b, root, fis, true);
+	bool aborted = false;
+	while(res == RES_OK && b.numDirs > 0)
+	{
+		const char *const dir = b.dirs[--b.numDirs];
+		if(progress != NULL && !progress(b.num, dir))
+		{
+			aborted = true;
+			break;
+		}
+
+		// Unreadable directories are skipped.
+		res = scanLibDir(&b, dir, fis, false);
+		if(res != RES_OUT_OF_MEM) res = RES_OK;
+	}
+	free(fis);
+
+	if(res == RES_OK && !aborted)
+	{
+		qsort(b.entries, b.num, sizeof(LibEntry), libEntryCompare);
+		res = writeIndex(&b);
+	}
+
+	free(b.dirs);
+	free(b.entries);
+	arenaFree(&b.scratch);
+	arenaFree(&b.pool);
+
+	return res;
+}
+
+Result libLoad(Library *const lib)
+{
+	memset(lib, 0, sizeof(Library));
+
+	FHandle f;
+	Result res = fOpen(&f, LIB_INDEX_PATH, FA_OPEN_EXISTING | FA_READ);
+	if(res != RES_OK) return res;
+
+	const u32 size = fSize(f);
+	u8 *const buf = (u8*)malloc(size > 0 ? size : 1);
+	if(buf == NULL)
+	{
+		fClose(f);
+		return RES_OUT_OF_MEM;
+	}
+
+	u32 read;
+	res = fRead(f, buf, size, &read);
+	fClose(f);
+	if(res == RES_OK && read != size) res = RES_INVALID_ARG;
+
+	// Validate everything so the browser can trust the offsets.
+	if(res == RES_OK)
+	{
+		const LibHeader *const hdr = (const LibHeader*)buf;
+		const u32 entriesSize = (size >= sizeof(LibHeader) ? hdr->numEntries * sizeof(LibEntry) : 0);
+		if(size < sizeof(LibHeader) || hdr->magic != LIB_MAGIC || hdr->version != LIB_VERSION ||
+		   hdr->entrySize != sizeof(LibEntry) || hdr->numEntries > (size - sizeof(LibHeader)) / sizeof(LibEntry) ||
+		   size != sizeof(LibHeader) + entriesSize + hdr->poolSize ||
+		   (hdr->poolSize > 0 && buf[size - 1] != '\0'))
+		{
+			res = RES_INVALID_ARG;
+		}
+		else
+		{
+			const LibEntry *const entries = (const LibEntry*)&buf[sizeof(LibHeader)];
+			for(u32 i = 0; i < hdr->numEntries; i++)
+			{
+				if(entries[i].dirOff >= hdr->poolSize || entries[i].nameOff >= hdr->poolSize)
+				{
+					res = RES_INVALID_ARG;
+					break;
+				}
+			}
+
+			lib->num     = hdr->numEntries;
+			lib->entries = entries;
+			lib->pool    = (const char*)&buf[sizeof(LibHeader) + entriesSize];
+		}
+	}
+
+	if(res != RES_OK)
+	{
+		free(buf);
+		memset(lib, 0, sizeof(Library));
+	}
+	else lib->buf = buf;
+
+	return res;
+}
+
+void libFree(Library *const lib)
+{
+	free(lib->buf);
+	memset(lib, 0, sizeof(Library));
+}
+
+u32 libFindPrefix(const Library *const lib, const char *const prefix)
+{
+	u32 len = strlen(prefix);
+	if(len > sizeof(lib->entries->title)) len = sizeof(lib->entries->title);
+
+	u32 lo = 0;
+	u32 hi = lib->num;
+	while(lo < hi)
+	{
+		const u32 mid = lo + (hi - lo) / 2;
+		if(titleCompare(lib->entries[mid].title, prefix, len) < 0) lo = mid + 1;
+		else                                                       hi = mid;
+	}
+
+	return lo;
+}
+
+void libGetPath(const Library *const lib, const u32 i, char path[512])
+{
+	const LibEntry *const entry = &lib->entries[i];
+	if(!joinPath(path, &lib->pool[entry->dirOff], &lib->pool[entry->nameOff])) *path = '\0';
+}
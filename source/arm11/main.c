@@ -25,12 +25,16 @@
 #include "arm11/drivers/codec.h"
 #include "arm11/drivers/hid.h"
 #include "arm11/power.h"
+#include "arm11/boot_trace.h"
 
 
 
 int main(void)
 {
+	TRACE_INIT();
+	TRACE_BEGIN("oafParseConfigEarly");
 	Result res = oafParseConfigEarly();
+	TRACE_END("oafParseConfigEarly");
 	GFX_init(GFX_BGR8, GFX_BGR565, GFX_TOP_2D);
 	changeBacklight(0); // Apply backlight config.
 	consoleInit(GFX_LCD_BOT, NULL);
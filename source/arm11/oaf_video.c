@@ -16,7 +16,6 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <math.h>
 #include <string.h>
 #include "types.h"
 #include "arm11/config.h"
@@ -25,11 +24,14 @@
 #include "util.h"
 #include "oaf_error_codes.h"
 #include "arm11/drivers/lgycap.h"
-#include "arm11/bitmap.h"
 #include "drivers/gfx.h"
 #include "arm11/drivers/mcu.h"
 #include "arm11/fmt.h"
 #include "fsutil.h"
+#include "arm11/bundle.h"
+#include "arm11/border.h"
+#include "arm11/screenshot.h"
+#include "arm11/gfx_stats.h"
 #include "kernel.h"
 #include "kevent.h"
 #include "arm11/drivers/hid.h"
@@ -37,12 +39,14 @@
 #include "arm11/gpu_cmd_lists.h"
 #include "system.h"
 #include "arm11/fast_frame_convert.h"
+#include "arm11/color_lut.h"
 
 
 #define COLOR_LUT_ADDR (0x1FF00000u)
 
 
 static KHandle g_convFinishedEvent = 0;
+static const GbaGpuCmdLists *g_gpuCmdLists = NULL;
 static const u32 g_topLcdCurveCorrect[73] =
 {
 	// Curve correction from 3DS top LCD gamma to 2.2 gamma for all channels.
@@ -116,167 +120,6 @@ static void adjustGammaTableForGba(void)
 	} while(decoded < 256);
 }
 
-typedef struct
-{
-	float targetGamma;
-	float lum;
-	float  r, gr, br;
-	float rg,  g, bg;
-	float rb, gb,  b;
-	float displayGamma;
-} ColorProfile;
-
-// libretro shader values. Credits: hunterk and Pokefan531.
-// Last updated 2014-12-03.
-static const ColorProfile g_colorProfiles[8] =
-{
-	{ // libretro GBA color (sRGB).
-		2.2f + (0.3f * 1.6f), // Darken screen. Default 0. Modified to 0.3.
-		0.91f,
-		0.905f,  0.195f,  -0.1f,
-		0.1f,    0.65f,    0.25f,
-		0.1575f, 0.1425f,  0.7f,
-		1.f / 2.2f
-	},
-	{ // libretro GB micro color (sRGB).
-		2.2f,
-		0.9f,
-		0.8025f, 0.31f,   -0.1125f,
-		0.1f,    0.6875f,  0.2125f,
-		0.1225f, 0.1125f,  0.765f,
-		1.f / 2.2f
-	},
-	{ // libretro GBA SP (AGS-101) color (sRGB).
-		2.2f,
-		0.935f,
-		0.96f,    0.11f, -0.07f,
-		0.0325f,  0.89f,  0.0775f,
-		0.001f,  -0.03f,  1.029f,
-		1.f / 2.2f
-	},
-	{ // libretro NDS color (sRGB).
-		2.2f,
-		0.905f,
-		0.835f, 0.27f,   -0.105f,
-		0.1f,   0.6375f,  0.2625f,
-		0.105f, 0.175f,   0.72f,
-		1.f / 2.2f
-	},
-	{ // libretro NDS lite color (sRGB).
-		2.2f,
-		0.935f,
-		0.93f,   0.14f, -0.07f,
-		0.025f,  0.9f,   0.075f,
-		0.008f, -0.03f,  1.022f,
-		1.f / 2.2f
-	},
-	{ // libretro Nintendo Switch Online color (sRGB).
-		2.2f + 0.8f, // Darken screen. Default 0.8.
-		1.f,
-		0.865f,  0.1225f, 0.0125f,
-		0.0575f, 0.925f,  0.0125f,
-		0.0575f, 0.1225f, 0.82f,
-		1.f / 2.2f
-	},
-	{ // libretro Visual Boy Advance/No$GBA full color.
-		1.45f + 1.f, // Darken screen. Default 1.
-		1.f,
-		0.73f,   0.27f,   0.f,
-		0.0825f, 0.6775f, 0.24f,
-		0.0825f, 0.24f,   0.6775f,
-		1.f / 1.45f
-	},
-	{ // Identity.
-		1.f,
-		1.f,
-		1.f, 0.f, 0.f,
-		0.f, 1.f, 0.f,
-		0.f, 0.f, 1.f,
-		1.f / 1.f
-	}
-};
-
-ALWAYS_INLINE float clamp_float(const float x, const float min, const float max)
-{
-	return (x < min ? min : (x > max ? max : x));
-}
-
-void makeColorLut(const ColorProfile *const p)
-{
-	const float targetGamma    = p->targetGamma;
-	const float contrast       = g_oafConfig.contrast;
-	const float brightness     = g_oafConfig.brightness / contrast;
-	const float targetContrast = powf(contrast, targetGamma);
-
-	// Calculate saturation weights.
-	// Note: We are using the Rec. 709 luminance vector here.
-	const float sat   = g_oafConfig.saturation;
-	const float rwgt  = (1.f - sat) * 0.2126f;
-	const float gwgt  = (1.f - sat) * 0.7152f;
-	const float bwgt  = (1.f - sat) * 0.0722f;
-
-	u32 *const colorLut = (u32*)COLOR_LUT_ADDR;
-	for(u32 i = 0; i < 32768; i++)
-	{
-		// Convert to 8-bit and normalize.
-		float b = (float)rgbFive2Eight(i & 31u) / 255;
-		float g = (float)rgbFive2Eight((i>>5) & 31u) / 255;
-		float r = (float)rgbFive2Eight(i>>10) / 255;
-
-		// Convert to linear gamma.
-		b = powf(b + brightness, targetGamma);
-		g = powf(g + brightness, targetGamma);
-		r = powf(r + brightness, targetGamma);
-
-		// Apply luminance.
-		const float lum = p->lum;
-		b = clamp_float(b * lum, 0.f, 1.f);
-		g = clamp_float(g * lum, 0.f, 1.f);
-		r = clamp_float(r * lum, 0.f, 1.f);
-
-		/*
-		 *               Input
-		 *                [r]
-		 *                [g]
-		 *                [b]
-		 *
-		 * Correction    Output
-		 * [ r][gr][br]   [r]
-		 * [rg][ g][bg]   [g]
-		 * [rb][gb][ b]   [b]
-		*/
-		// Assuming no alpha channel in original calculation.
-		float tmpB = p->rb * r + p->gb * g + p->b  * b;
-		float tmpG = p->rg * r + p->g  * g + p->bg * b;
-		float tmpR = p->r  * r + p->gr * g + p->br * b;
-
-		// Apply saturation.
-		// Note: Some duplicated muls here. gcc optimizes them out.
-		b = rwgt         * tmpR + gwgt         * tmpG + (bwgt + sat) * tmpB;
-		g = rwgt         * tmpR + (gwgt + sat) * tmpG + bwgt         * tmpB;
-		r = (rwgt + sat) * tmpR + gwgt         * tmpG + bwgt         * tmpB;
-
-		b = (b < 0.f ? 0.f : b);
-		g = (g < 0.f ? 0.f : g);
-		r = (r < 0.f ? 0.f : r);
-
-		// Convert to display gamma.
-		const float displayGamma = p->displayGamma;
-		b = powf(targetContrast * b, displayGamma);
-		g = powf(targetContrast * g, displayGamma);
-		r = powf(targetContrast * r, displayGamma);
-
-		// Denormalize, clamp, convert to ABGR8 and write lut.
-		u32 entry = 255; // Alpha.
-		entry |= clamp_s32(lroundf(b * 255), 0, 255)<<8;
-		entry |= clamp_s32(lroundf(g * 255), 0, 255)<<16;
-		entry |= clamp_s32(lroundf(r * 255), 0, 255)<<24;
-		colorLut[i] = entry;
-	}
-
-	flushDCacheRange(colorLut, 4 * 32768);
-}
-
 static Result dumpFrameTex(void)
 {
 	// Capture a single frame in native resolution.
@@ -284,54 +127,26 @@ static Result dumpFrameTex(void)
 	if(LGYCAP_captureFrameUnscaled(LGYCAP_DEV_TOP) != KRES_OK)
 		return RES_INVALID_ARG;
 
-	// A1BGR5 format (alpha ignored).
-	constexpr u32 alignment = 0x80; // Make PPF happy.
-	alignas(4) static const BmpV1WithMasks bmpHeaders =
-	{
-		{
-			.magic       = 0x4D42,
-			.fileSize    = alignment + 240 * 160 * 2,
-			.reserved    = 0,
-			.reserved2   = 0,
-			.pixelOffset = alignment
-		},
-		{
-			.headerSize      = sizeof(Bitmapinfoheader),
-			.width           = 240,
-			.height          = -160,
-			.colorPlanes     = 1,
-			.bitsPerPixel    = 16,
-			.compression     = BI_BITFIELDS,
-			.imageSize       = 240 * 160 * 2,
-			.xPixelsPerMeter = 0,
-			.yPixelsPerMeter = 0,
-			.colorsUsed      = 0,
-			.colorsImportant = 0
-		},
-		.rMask = 0xF800,
-		.gMask = 0x07C0,
-		.bMask = 0x003E
-	};
-
-	// Transfer frame data out of the 512x512 texture.
+	// Transfer frame data (A1BGR5) out of the 512x512 texture.
 	// We will use the currently hidden frame buffer as temporary buffer.
 	// Note: This is a race with the currently displaying frame buffer
 	//       because we just swapped buffers in the gfx handler function.
 	u32 *const tmpBuf = GFX_getBuffer(GFX_LCD_TOP, GFX_SIDE_LEFT);
-	GX_displayTransfer((u32*)GPU_TEXTURE_ADDR, PPF_DIM(512, 160), tmpBuf + (alignment / 4), PPF_DIM(240, 160),
+	GX_displayTransfer((u32*)GPU_TEXTURE_ADDR, PPF_DIM(512, 160), tmpBuf, PPF_DIM(SCREENSHOT_WIDTH, SCREENSHOT_HEIGHT),
 	                   PPF_O_FMT(GX_A1BGR5) | PPF_I_FMT(GX_A1BGR5) | PPF_CROP_EN);
-	memcpy(tmpBuf, &bmpHeaders, sizeof(bmpHeaders));
 	GFX_waitForPPF();
 
 	// Get current date & time.
 	RtcTimeDate td;
 	MCU_getRtcTimeDate(&td);
 
-	// Construct file path from date & time. Then write the file.
+	// Construct file path from date & time. The writer task
+	// encodes and writes the file so we never wait for the SD card.
 	char fn[36];
-	ee_sprintf(fn, OAF_SCREENSHOT_DIR "/%04X_%02X_%02X_%02X_%02X_%02X.bmp",
+	ee_sprintf(fn, OAF_SCREENSHOT_DIR "/%04X_%02X_%02X_%02X_%02X_%02X.png",
 	           td.year + 0x2000, td.mon, td.day, td.hour, td.min, td.sec);
-	const Result res = fsQuickWrite(fn, tmpBuf, bmpHeaders.header.fileSize);
+	invalidateDCacheRange(tmpBuf, SCREENSHOT_WIDTH * SCREENSHOT_HEIGHT * 2);
+	const Result res = (screenshotSubmit((const u16*)tmpBuf, fn) ? RES_OK : RES_INVALID_ARG);
 
 	// Clear overwritten texture area in case we overwrote padding (different resolution).
 	// This is important because padding pixels must be fully transparent to get sharp edges when the GPU renders.
@@ -357,8 +172,10 @@ static void gbaGfxHandler(void *args)
 	{
 		if(waitForEvent(event) != KRES_OK) break;
 		clearEvent(event);
+		GFXSTATS_STAMP(GFX_STAMP_READY);
 
 		// All measurements are the worst timings in ~30 seconds of runtime.
+		// Debug builds record these per frame. See gfx_stats.h.
 		// Measured with timer prescaler 1.
 		// BGR8:
 		// 240x160 no scaling:    ~184 µs
@@ -370,26 +187,32 @@ static void gbaGfxHandler(void *args)
 		// 240x160 bilinear x1.5: ~407 µs (54619 ticks)
 		// 360x240 no scaling:    ~400 µs (53725 ticks)
 		static bool inited = false;
+		const GbaGpuCmdLists *const lists = g_gpuCmdLists;
 		u32 listSize;
 		const u32 *list;
 		if(inited == false)
 		{
 			inited = true;
 
-			listSize = sizeof(gbaGpuInitList);
-			list = (u32*)gbaGpuInitList;
+			listSize = lists->initListSize;
+			list = lists->initList;
 		}
 		else
 		{
-			listSize = sizeof(gbaGpuList2);
-			list = (u32*)gbaGpuList2;
+			listSize = lists->listSize;
+			list = lists->list;
 		}
 		GX_processCommandList(listSize, list);
+		GFXSTATS_STAMP(GFX_STAMP_SUBMIT);
 		GFX_waitForP3D();
+		GFXSTATS_STAMP(GFX_STAMP_P3D);
 		GX_displayTransfer((u32*)GPU_RENDER_BUF_ADDR, PPF_DIM(240, 400), GFX_getBuffer(GFX_LCD_TOP, GFX_SIDE_LEFT),
 		                   PPF_DIM(240, 400), PPF_O_FMT(GX_BGR8) | PPF_I_FMT(GX_BGR8));
 		GFX_waitForPPF();
+		GFXSTATS_STAMP(GFX_STAMP_PPF);
 		GFX_swapBuffers();
+		GFXSTATS_STAMP(GFX_STAMP_SWAP);
+		GFXSTATS_FRAME();
 
 		// Trigger only if both are held and at least one is detected as newly pressed down.
 		if(hidKeysHeld() == (KEY_Y | KEY_SELECT) && hidKeysDown() != 0)
@@ -421,7 +244,7 @@ static KHandle setupFrameCapture(const u8 scaler, const bool colorCorrectionEnab
 		      0,       0,       0,       0,       0,       0,       0,       0
 	};
 
-	const Result res = fsQuickRead("gba_scaler_matrix.bin", matrix, sizeof(matrix));
+	const Result res = bundleQuickRead("gba_scaler_matrix.bin", matrix, sizeof(matrix));
 	if(res != RES_OK && res != RES_FR_NO_FILE)
 	{
 		ee_printf("Failed to load hardware scaling matrix: %s\n", result2String(res));
@@ -464,11 +287,12 @@ KHandle OAF_videoInit(void)
 		convFinishedEvent = createEvent(false);
 		g_convFinishedEvent = convFinishedEvent;
 
-		// Patch GPU cmd list with texture location 2.
-		patchGbaGpuCmdList(scaler, true);
+		// GPU cmd lists with texture location 2.
+		g_gpuCmdLists = getGbaGpuCmdLists(scaler, true);
 
-		// Compute the (linear) 3D lookup table.
-		makeColorLut(&g_colorProfiles[colorProfile - 1]);
+		// Load the (linear) 3D lookup table from cache or compute it.
+		// Abuse currently invisible frame buffer as temporary buffer.
+		loadColorLut(&g_colorProfiles[colorProfile - 1], (u32*)COLOR_LUT_ADDR, GFX_getBuffer(GFX_LCD_TOP, GFX_SIDE_LEFT));
 
 		// Register IPI handler and start core 1 for color conversion.
 		IRQ_registerIsr(IRQ_IPI15, 13, 0, convFinishedHandler);
@@ -479,10 +303,13 @@ KHandle OAF_videoInit(void)
 		// Start capture hardware.
 		frameReadyEvent = setupFrameCapture(scaler, false);
 
-		// Patch GPU cmd list with texture location 1.
-		patchGbaGpuCmdList(scaler, false);
+		// GPU cmd lists with texture location 1.
+		g_gpuCmdLists = getGbaGpuCmdLists(scaler, false);
 	}
 
+	// Screenshots are optional. Without the writer task SELECT+Y does nothing.
+	if(screenshotInit() != RES_OK) ee_puts("Failed to start screenshot writer.");
+
 	// Start frame handler.
 	createTask(0x800, 3, gbaGfxHandler, (void*)(colorProfile > 0 ? convFinishedEvent : frameReadyEvent));
 
@@ -493,8 +320,15 @@ KHandle OAF_videoInit(void)
 	if(scaler == 0) // No borders for scaled modes.
 	{
 		// Abuse currently invisible frame buffer as temporary buffer.
+		// Pre-tiled borders are decoded straight into the GPU render buffer.
 		void *const borderBuf = GFX_getBuffer(GFX_LCD_TOP, GFX_SIDE_LEFT);
-		if(fsQuickRead("border.bgr", borderBuf, 400 * 240 * 3) == RES_OK)
+		u32 borderSize;
+		if(bundleRead(BORDER_RLE_PATH, borderBuf, BORDER_RAW_SIZE, &borderSize) == RES_OK &&
+		   borderDecode(borderBuf, borderSize, (void*)GPU_RENDER_BUF_ADDR))
+		{
+			flushDCacheRange((void*)GPU_RENDER_BUF_ADDR, BORDER_RAW_SIZE);
+		}
+		else if(bundleQuickRead("border.bgr", borderBuf, BORDER_RAW_SIZE) == RES_OK)
 		{
 			// Copy border in swizzled form to GPU render buffer.
 			GX_displayTransfer(borderBuf, PPF_DIM(240, 400), (u32*)GPU_RENDER_BUF_ADDR,
@@ -516,4 +350,5 @@ void OAF_videoExit(void)
 		deleteEvent(g_convFinishedEvent);
 		g_convFinishedEvent = 0;
 	}
+	screenshotExit();
 }
\ No newline at end of file
@@ -16,11 +16,11 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include "types.h"
 #include "util.h"
-#include "arm11/fast_rom_padding.h"
 #include "oaf_error_codes.h"
 #include "fs.h"
 #include "arm11/fmt.h"
@@ -31,73 +31,45 @@
 #include "arm11/filebrowser.h"
 #include "arm11/config.h"
 #include "arm11/save_type.h"
+#include "arm11/rom_load.h"
+#include "arm11/rom_cache.h"
+#include "arm11/boot_trace.h"
+#include "arm11/gfx_stats.h"
+#include "arm11/bundle.h"
 #include "arm11/patch.h"
 #include "arm11/drivers/codec.h"
 #include "drivers/lgy_common.h"
 #include "arm11/oaf_video.h"
 #include "arm11/drivers/lgy11.h"
+#include "drivers/sha.h"
 #include "kernel.h"
 #include "kevent.h"
+#include "mem_map.h"
 
 
-static KHandle g_frameReadyEvent = 0;
-
+// ROM loading and patching use FCRAM past the ROM area until LGY_prepareGbaMode().
+static_assert(ROM_SCRATCH_LOC + ROM_SCRATCH_SIZE <= FCRAM_BASE + FCRAM_SIZE);
 
 
-static u32 fixRomPadding(const u32 romFileSize)
-{
-	// Pad unused ROM area with 0xFFs (trimmed ROMs).
-	// Smallest retail ROM chip is 8 Mbit (1 MiB).
-	u32 romSize = nextPow2(romFileSize);
-	romSize = (romSize < 0x100000 ? 0x100000 : romSize);
-	const uintptr_t romLoc = LGY_ROM_LOC;
-	memset((void*)(romLoc + romFileSize), 0xFF, romSize - romFileSize);
-
-	u32 mirroredSize = romSize;
-	if(romSize == 0x100000) // 1 MiB.
-	{
-		// ROM mirroring for Classic NES Series/others with 8 Mbit ROM.
-		// The ROM is mirrored exactly 4 times.
-		// Thanks to endrift for discovering this.
-		mirroredSize = 0x400000; // 4 MiB.
-		uintptr_t mirrorLoc = romLoc + romSize;
-		do
-		{
-			memcpy((void*)mirrorLoc, (void*)romLoc, romSize);
-			mirrorLoc += romSize;
-		} while(mirrorLoc < romLoc + mirroredSize);
-	}
+static KHandle g_frameReadyEvent = 0;
 
-	// Fake "open bus" padding.
-	if(romSize < LGY_MAX_ROM_SIZE)
-		makeOpenBusPaddingFast((u32*)(romLoc + mirroredSize));
 
-	// We don't return the mirrored size because the db hashes are over unmirrored dumps.
-	return romSize;
-}
 
-static Result loadGbaRom(const char *const path, u32 *const romSizeOut)
+// Slow path for stale cache entries. The ROM is already loaded.
+static void fingerprintLoadedRom(const u32 romSize, const bool hashRom, RomFingerprint *const fp)
 {
-	FHandle f;
-	Result res = fOpen(&f, path, FA_OPEN_EXISTING | FA_READ);
-	if(res == RES_OK)
-	{
-		u32 fileSize = fSize(f);
-		if(fileSize > LGY_MAX_ROM_SIZE)
-		{
-			fileSize = LGY_MAX_ROM_SIZE;
-			ee_puts("Warning: ROM file is too big. Expect crashes.");
-		}
-
-		u32 read;
-		res = fRead(f, (void*)LGY_ROM_LOC, fileSize, &read);
-		fClose(f);
-
-		if(read == fileSize) *romSizeOut = fixRomPadding(fileSize);
-
-	}
-
-	return res;
+	u64 sha1[3] = {0};
+	if(hashRom) sha((u32*)LGY_ROM_LOC, romSize, (u32*)sha1, SHA_IN_BIG | SHA_1_MODE, SHA_OUT_BIG);
+
+	SaveScanState scan;
+	saveScanInit(&scan);
+	saveScanUpdate(&scan, romSize, true);
+
+	fp->sha1Prefix = sha1[0];
+	fp->romSize    = romSize;
+	fp->scanStrIdx = scan.strIdx;
+	fp->dbSaveType = GBA_DB_SAVE_UNKNOWN;
+	fp->hasSha1    = hashRom;
 }
 
 void changeBacklight(s16 amount)
@@ -138,6 +110,11 @@ static void updateBacklight(void)
 		if(kHeld == (KEY_X | KEY_DDOWN))
 			changeBacklight(-steps);
 
+		// Dump gfx pipeline timings (debug builds only).
+		// Written by the screenshot writer task. The FS isn't thread safe.
+		if(kHeld == (KEY_X | KEY_SELECT))
+			GFXSTATS_QUEUE_DUMP();
+
 		// Disable backlight switching in debug builds on 2DS.
 		const GfxBl lcd = (MCU_getSystemModel() != SYS_MODEL_2DS ? GFX_BL_TOP : GFX_BL_BOT);
 #ifndef NDEBUG
@@ -266,6 +243,12 @@ Result oafParseConfigEarly(void)
 		res = fMkdir(OAF_SCREENSHOT_DIR);
 		if(res != RES_OK && res != RES_FR_EXIST) break;
 
+		// Serve per-boot assets from the bundle if there is one.
+		// Everything falls back to loose files without it.
+		const Result bundleRes = bundleOpen(OAF_BUNDLE_PATH);
+		if(bundleRes != RES_OK && bundleRes != RES_FR_NO_FILE)
+			debug_printf("Failed to open bundle: %s\n", result2String(bundleRes));
+
 		// Parse the config.
 		res = parseOafConfig("config.ini", &g_oafConfig, true);
 	} while(0);
@@ -283,7 +266,7 @@ Result oafInitAndRun(void)
 		{
 			// Try to load the ROM path from autoboot.txt.
 			// If this file doesn't exist show the file browser.
-			res = fsLoadPathFromFile("autoboot.txt", filePath);
+			res = bundleLoadPathFromFile("autoboot.txt", filePath);
 			if(res == RES_FR_NO_FILE)
 			{
 				res = showFileBrowser(filePath);
@@ -297,27 +280,59 @@ Result oafInitAndRun(void)
 			if(romFilePath == NULL) { res = RES_OUT_OF_MEM; break; }
 			strcpy(romFilePath, filePath);
 
-			// Load the ROM file.
-			u32 romSize;
-			res = loadGbaRom(filePath, &romSize);
-			if(res != RES_OK) break;
-
 			// Load the per-game config.
+			// This decides whether we need to hash and scan the ROM while loading it.
 			rom2GameCfgPath(filePath);
 			res = parseOafConfig(filePath, &g_oafConfig, false);
-			if(res != RES_OK && res != RES_FR_NO_FILE) break;
+			if(res != RES_OK && res != RES_FR_NO_FILE) { free(romFilePath); break; }
+
+			// Load the ROM file.
+			// Hashing and scanning is skipped if the ROM fingerprint is cached.
+			// The SHA1 is only needed for gba_db.bin.
+			const bool autoSaveType = g_oafConfig.saveType == 0xFF;
+			const bool useDb = autoSaveType && (g_oafConfig.useGbaDb || g_oafConfig.saveOverride);
+			RomFingerprint fp;
+			const bool cached = autoSaveType && romCacheLookup(romFilePath, &fp) && (fp.hasSha1 || !useDb);
+			const bool fingerprint = autoSaveType && !cached;
+			u32 romSize;
+			u64 sha1[3];
+			SaveScanState scan;
+			TRACE_BEGIN("loadGbaRom");
+			res = loadGbaRom(romFilePath, &romSize, (fingerprint && useDb ? sha1 : NULL), (fingerprint ? &scan : NULL));
+			TRACE_END("loadGbaRom");
+			if(res != RES_OK) { free(romFilePath); break; }
 
 			// Adjust the path for the save file and get save type.
 			gameCfg2SavePath(filePath, g_oafConfig.saveSlot);
 			u16 saveType;
-			if(g_oafConfig.saveType != 0xFF)
+			if(!autoSaveType)
 				saveType = g_oafConfig.saveType;
-			else if(g_oafConfig.useGbaDb || g_oafConfig.saveOverride)
-				saveType = getSaveType(&g_oafConfig, romSize, filePath);
 			else
-				saveType = detectSaveType(romSize, g_oafConfig.defaultSave);
+			{
+				if(fingerprint)
+				{
+					fp.sha1Prefix = (useDb ? sha1[0] : 0);
+					fp.romSize    = romSize;
+					fp.scanStrIdx = scan.strIdx;
+					fp.dbSaveType = GBA_DB_SAVE_UNKNOWN;
+					fp.hasSha1    = useDb;
+				}
+				else if(fp.romSize != romSize) fingerprintLoadedRom(romSize, useDb, &fp);
+				scan.strIdx = fp.scanStrIdx;
 
+				saveType = detectSaveType(&scan, romSize, g_oafConfig.defaultSave);
+				TRACE_BEGIN("getSaveType");
+				if(useDb) saveType = getSaveType(&g_oafConfig, romSize, saveType, fp.sha1Prefix, &fp.dbSaveType, filePath);
+				TRACE_END("getSaveType");
+
+				// Not fatal. We will just hash the ROM again next time.
+				const Result cacheRes = romCacheStore(&fp);
+				if(cacheRes != RES_OK) debug_printf("Failed to write ROM cache: %s\n", result2String(cacheRes));
+			}
+
+			TRACE_BEGIN("patchRom");
 			patchRom(romFilePath, &romSize);
+			TRACE_END("patchRom");
 			free(romFilePath);
 
 			// Set audio output and volume.
@@ -325,11 +340,15 @@ Result oafInitAndRun(void)
 			CODEC_setVolumeOverride(g_oafConfig.volume);
 
 			// Prepare ARM9 for GBA mode + save loading.
+			TRACE_BEGIN("LGY_prepareGbaMode");
 			res = LGY_prepareGbaMode(g_oafConfig.directBoot, saveType, filePath);
+			TRACE_END("LGY_prepareGbaMode");
 			if(res == RES_OK)
 			{
 				// Initialize video output (frame capture, post processing ect.).
+				TRACE_BEGIN("OAF_videoInit");
 				g_frameReadyEvent = OAF_videoInit();
+				TRACE_END("OAF_videoInit");
 
 				// Setup button overrides.
 				const u32 *const maps = g_oafConfig.buttonMaps;
@@ -341,12 +360,15 @@ Result oafInitAndRun(void)
 				// Sync LgyCap start with LCD VBlank.
 				GFX_waitForVBlank0();
 				LGY11_switchMode();
+
+				TRACE_DUMP("boot_trace.json");
 			}
 		} while(0);
 	}
 	else res = RES_OUT_OF_MEM;
 
 	free(filePath);
+	bundleClose(); // Boot assets are loaded.
 
 	return res;
 }
@@ -374,5 +396,6 @@ void oafFinish(void)
 	// frameReadyEvent deleted by this function.
 	OAF_videoExit();
 	g_frameReadyEvent = 0;
+	GFXSTATS_DUMP(GFXSTATS_PATH); // Writer task and gfx handler are stopped now.
 	LGY11_deinit();
 }
\ No newline at end of file
@@ -24,213 +24,703 @@
 #include "arm11/drivers/hid.h"
 #include "drivers/lgy_common.h"
 #include "arm11/fmt.h"
+#include "drivers/gfx.h"
 #include "fs.h"
 #include "arm11/patch.h"
+#include "arm11/rom_load.h"
 #include "arm11/power.h"
 #include "drivers/sha.h"
+#include "arm11/crc32.h"
 
 
 #define min(a, b)  ((size_t) (a) <= (size_t) (b) ? (size_t) (a) : (size_t) (b))
 
+#define PATCH_BUF_SIZE     (1024u * 32)
+#define PATCH_DIRECT_READ  (1024u * 4)  // Reads this big bypass the buffer.
 
+#define BPS_BLOCK_SHIFT    (10u) // Source backup granularity (1 KiB).
+#define BPS_NUM_BLOCKS     (LGY_MAX_ROM_SIZE>>BPS_BLOCK_SHIFT)
+
+
+// Buffered sequential patch reader.
 typedef struct
 {
-	u8 *buffer;
-	u16 cacheSize;
-	u16 cacheOffset;
-	u16 maxCacheSize;
-} Cache;
+	FHandle f;
+	u8 *buf;
+	u32 pos;  // Read position in buf.
+	u32 len;  // Valid bytes in buf.
+	u32 left; // Bytes left in the file after the buffered ones.
+	bool calcCrc;
+	bool inMemory; // buf is the whole patch and not owned by the reader.
+	u32 crc;  // CRC32 of everything read so far if calcCrc is set.
+} PatchReader;
+
+
+
+static void readerReset(PatchReader *const r, const u32 end, const bool calcCrc) {
+	r->pos     = 0;
+	r->len     = 0;
+	r->left    = end - fTell(r->f);
+	r->calcCrc = calcCrc;
+	r->crc     = 0;
+}
+
+static Result readerInit(PatchReader *const r, const FHandle f, const u32 end, const bool calcCrc) {
+	r->buf = (u8*)malloc(PATCH_BUF_SIZE);
+	if(r->buf == NULL) return RES_OUT_OF_MEM;
+
+	r->f        = f;
+	r->inMemory = false;
+	readerReset(r, end, calcCrc);
+
+	return RES_OK;
+}
+
+// Reads the patch up to end to mem in one go for patches read twice.
+// The CRC is calculated over everything at once.
+static Result readerInitMemory(PatchReader *const r, const FHandle f, const u32 end, u8 *const mem) {
+	const Result res = fRead(f, mem, end, NULL);
+	if(res != RES_OK) return res;
+
+	r->f        = f;
+	r->buf      = mem;
+	r->pos      = 0;
+	r->len      = end;
+	r->left     = 0;
+	r->calcCrc  = false;
+	r->inMemory = true;
+	r->crc      = crc32(0, mem, end);
+
+	return RES_OK;
+}
+
+// Starts over at the beginning of the patch for another pass without CRC.
+static Result readerRewind(PatchReader *const r, const u32 end) {
+	if(r->inMemory)
+	{
+		r->pos = 0;
+		return RES_OK;
+	}
+
+	const Result res = fLseek(r->f, 0);
+	if(res == RES_OK) readerReset(r, end, false);
+
+	return res;
+}
+
+static void readerFree(PatchReader *const r) {
+	if(!r->inMemory) free(r->buf);
+	r->buf = NULL;
+}
+
+static Result readerFill(PatchReader *const r) {
+	const u32 size = min(r->left, PATCH_BUF_SIZE);
+	const Result res = fRead(r->f, r->buf, size, NULL);
+	if(res != RES_OK) return res;
+	if(r->calcCrc) r->crc = crc32(r->crc, r->buf, size);
+
+	r->pos   = 0;
+	r->len   = size;
+	r->left -= size;
+
+	return RES_OK;
+}
+
+ALWAYS_INLINE u32 readerAvail(const PatchReader *const r) {
+	return r->len - r->pos + r->left;
+}
+
+// Fails with RES_INVALID_PATCH if the patch ends early.
+static Result readerRead(PatchReader *const r, void *dst, u32 size) {
+	u32 buffered = r->len - r->pos;
+	if(size > buffered)
+	{
+		if(size > buffered + r->left) return RES_INVALID_PATCH;
 
+		memcpy(dst, &r->buf[r->pos], buffered);
+		dst = (u8*)dst + buffered;
+		size -= buffered;
+		r->pos = r->len;
 
+		// Big reads go straight to the destination.
+		if(size >= PATCH_DIRECT_READ)
+		{
+			const Result res = fRead(r->f, dst, size, NULL);
+			if(r->calcCrc) r->crc = crc32(r->crc, dst, size);
+			r->left -= size;
+			return res;
+		}
+
+		const Result res = readerFill(r);
+		if(res != RES_OK) return res;
+	}
+
+	memcpy(dst, &r->buf[r->pos], size);
+	r->pos += size;
+
+	return RES_OK;
+}
+
+static Result readerSkip(PatchReader *const r, u32 size) {
+	while(size > 0)
+	{
+		if(r->pos == r->len)
+		{
+			if(r->left == 0) return RES_INVALID_PATCH;
+			const Result res = readerFill(r);
+			if(res != RES_OK) return res;
+		}
+
+		const u32 num = min(size, r->len - r->pos);
+		r->pos += num;
+		size   -= num;
+	}
 
-static u8 readCache(const FHandle patchHandle, Cache *cache, Result *res) {
-	u8 result = (cache->buffer)[(cache->cacheOffset)++];
-	if((cache->cacheOffset) >= (cache->cacheSize)) {
-		(cache->cacheSize) = min((cache->maxCacheSize), ((fSize(patchHandle)-12) - fTell(patchHandle)));
-		*res = fRead(patchHandle, (cache->buffer), (cache->cacheSize), NULL);
-		(cache->cacheOffset) = 0;
+	return RES_OK;
+}
+
+ALWAYS_INLINE Result readerByte(PatchReader *const r, u8 *const out) {
+	if(r->pos == r->len)
+	{
+		if(r->left == 0) return RES_INVALID_PATCH;
+		const Result res = readerFill(r);
+		if(res != RES_OK) return res;
 	}
+	*out = r->buf[r->pos++];
+
+	return RES_OK;
+}
+
+static u32 readBigEndian(const u8 *const data, const u32 size) {
+	u32 result = 0;
+	for(u32 i = 0; i < size; i++) result = result<<8 | data[i];
 
 	return result;
 }
 
-static Result patchIPS(const FHandle patchHandle) {
+// Supports IPS32 and the truncation extension.
+static Result patchIPS(const FHandle patchHandle, u32 *romSize) {
 	ee_puts("IPS patch found! Patching...");
 
-	const u16 bufferSize = 512;
-	char *buffer = (char*)calloc(bufferSize, 1);
-	if(buffer == NULL) return RES_OUT_OF_MEM;
+	PatchReader reader;
+	Result res = readerInit(&reader, patchHandle, fSize(patchHandle), false);
+	if(res != RES_OK) return res;
 
-	// Verify patch is IPS (magic number "PATCH").
-	Result res = fRead(patchHandle, buffer, 5, NULL);
-	if(res != RES_OK || memcmp("PATCH", buffer, 5) != 0)
+	// Verify patch is IPS (magic number "PATCH") or IPS32 ("IPS32").
+	u8 buffer[5];
+	u32 offsetSize; // 3 or 4 bytes.
+	const char *eofMarker;
+	res = readerRead(&reader, buffer, 5);
+	if(res == RES_OK && memcmp("PATCH", buffer, 5) == 0)
 	{
-		free(buffer);
+		offsetSize = 3;
+		eofMarker  = "EOF";
+	}
+	else if(res == RES_OK && memcmp("IPS32", buffer, 5) == 0)
+	{
+		offsetSize = 4;
+		eofMarker  = "EEOF";
+	}
+	else
+	{
+		readerFree(&reader);
 		return RES_INVALID_PATCH;
 	}
 
-	u32 offset = 0;
-	u16 length = 0;
-	while(res == RES_OK)
+	// Data beyond the ROM end is padding. Hunks beyond it grow the ROM
+	// and gaps between them are zero filled.
+	const u32 oldRomSize = *romSize;
+	u32 romEnd = oldRomSize;
+	while(1)
 	{
 		// Read offset.
-		res = fRead(patchHandle, buffer, 3, NULL);
-		if(res != RES_OK || memcmp("EOF", buffer, 3) == 0) break;
-		offset = (buffer[0] << 16) + (buffer[1] << 8) + buffer[2];
+		res = readerRead(&reader, buffer, offsetSize);
+		if(res != RES_OK || memcmp(eofMarker, buffer, offsetSize) == 0) break;
+		const u32 offset = readBigEndian(buffer, offsetSize);
 
-		// Read length.
-		res = fRead(patchHandle, buffer, 2, NULL);
+		// Read length. Zero means RLE hunk with the real length following.
+		res = readerRead(&reader, buffer, 2);
 		if(res != RES_OK) break;
-		length = (buffer[0] << 8) + buffer[1];
-
-		// RLE hunk.
-		if(length == 0)
+		u32 length = readBigEndian(buffer, 2);
+		const bool isRle = length == 0;
+		if(isRle)
 		{
-			res = fRead(patchHandle, buffer, 3, NULL);
+			res = readerRead(&reader, buffer, 3);
 			if(res != RES_OK) break;
+			length = readBigEndian(buffer, 2);
+		}
 
-			length = (buffer[0] << 8) + buffer[1];
-			memset((void*)(LGY_ROM_LOC + offset), buffer[2], length * sizeof(char));
-
-			continue;
+		if(offset > LGY_MAX_ROM_SIZE || length > LGY_MAX_ROM_SIZE - offset)
+		{
+			res = RES_ROM_TOO_BIG;
+			break;
 		}
+		if(offset > romEnd) memset((void*)(LGY_ROM_LOC + romEnd), 0, offset - romEnd);
+		if(offset + length > romEnd) romEnd = offset + length;
 
-		// Regular hunks.
-		u16 fullCount = length / bufferSize;
-		for(u16 i = 0; i < fullCount; ++i)
+		// memset() uses wide stores and the hunk payload is read straight into the ROM.
+		if(isRle) memset((void*)(LGY_ROM_LOC + offset), buffer[2], length);
+		else      res = readerRead(&reader, (void*)(LGY_ROM_LOC + offset), length);
+		if(res != RES_OK) break;
+	}
+
+	if(res == RES_OK)
+	{
+		// Truncation extension. The new ROM size follows the EOF marker.
+		u32 newSize = (romEnd > oldRomSize ? romEnd : 0);
+		if(readerAvail(&reader) >= offsetSize)
 		{
-			res = fRead(patchHandle, buffer, bufferSize, NULL);
-			if(res != RES_OK) break;
+			res = readerRead(&reader, buffer, offsetSize);
+			newSize = readBigEndian(buffer, offsetSize);
+			if(newSize > LGY_MAX_ROM_SIZE) res = RES_ROM_TOO_BIG;
+		}
 
-			for(u16 j = 0; j < bufferSize; ++j)
-			{
-				*(char*)(LGY_ROM_LOC + offset + (bufferSize * i) + j) = buffer[j];
-			}
+		if(res == RES_OK && newSize != 0)
+		{
+			if(newSize > romEnd) memset((void*)(LGY_ROM_LOC + romEnd), 0, newSize - romEnd);
+			*romSize = fixRomPadding(newSize);
+			debug_printf("New ROM size: 0x%" PRIX32 "\n", newSize);
 		}
+	}
 
-		u16 remaining = length % bufferSize;
-		if(remaining == 0) continue;
+	readerFree(&reader);
 
-		res = fRead(patchHandle, buffer, remaining, NULL);
-		if(res != RES_OK) break;
+	return res;
+}
 
-		for(u16 j = 0; j < remaining; ++j)
+// BPS/UPS variable length number. Also used for the BPS signed relative offsets.
+static Result readPatchNumber(PatchReader *const r, u32 *const out) {
+	u64 data = 0;
+	u64 shift = 1;
+	for(u32 i = 0; i < 5; i++)
+	{
+		u8 x;
+		const Result res = readerByte(r, &x);
+		if(res != RES_OK) return res;
+
+		data += (x & 0x7Fu) * shift;
+		if(x & 0x80u)
 		{
-			*(char*)(LGY_ROM_LOC + offset + (bufferSize * fullCount) + j) = buffer[j];
+			if(data > 0xFFFFFFFFu) break;
+			*out = data;
+			return RES_OK;
 		}
+		shift <<= 7;
+		data += shift;
 	}
 
-	free(buffer);
+	return RES_INVALID_PATCH;
+}
+
+static Result readBpsOffset(PatchReader *const r, u32 *const rel) {
+	u32 data;
+	const Result res = readPatchNumber(r, &data);
+	if(res == RES_OK) *rel += (data & 1u ? -(data>>1) : data>>1);
 
 	return res;
 }
 
-//based on code from http://fileformats.archiveteam.org/wiki/UPS_(binary_patch_format) (CC0, No copyright)
-static uintmax_t read_vuint(const FHandle patchFile, Result *res, Cache *cache) {
-	uintmax_t result = 0, shift = 0;
-
-	uint8_t octet = 0;
-	for (;;) {
-		//*res = fRead(patchFile, &octet, 1, NULL);
-		octet = readCache(patchFile, cache, res);
-		if(*res != RES_OK) break;
-		if(octet & 0x80) {
-			result += (octet & 0x7f) << shift;
-			break;
+static Result readBpsHeader(PatchReader *const r, u32 *const sourceSize, u32 *const targetSize) {
+	u8 magic[4];
+	Result res = readerRead(r, magic, 4);
+	if(res != RES_OK) return res;
+	if(memcmp(magic, "BPS1", 4) != 0) return RES_INVALID_PATCH;
+
+	u32 metadataSize;
+	if((res = readPatchNumber(r, sourceSize)) != RES_OK) return res;
+	if((res = readPatchNumber(r, targetSize)) != RES_OK) return res;
+	if((res = readPatchNumber(r, &metadataSize)) != RES_OK) return res;
+
+	return readerSkip(r, metadataSize);
+}
+
+// Validates all actions and marks source blocks which are read after
+// the output overwrote them. Output is written strictly in order so only
+// SourceCopy actions reading behind the output position are affected.
+static Result scanBps(PatchReader *const r, const u32 sourceSize, const u32 targetSize, u32 *const backupMap) {
+	u32 outputOffset = 0;
+	u32 sourceRel = 0;
+	u32 targetRel = 0;
+	while(readerAvail(r) > 0)
+	{
+		u32 data;
+		Result res = readPatchNumber(r, &data);
+		if(res != RES_OK) return res;
+
+		const u32 length = (data>>2) + 1;
+		if(length > targetSize - outputOffset) return RES_INVALID_PATCH;
+
+		switch(data & 3u)
+		{
+			case 0: // SourceRead.
+				if(outputOffset + length > sourceSize) return RES_INVALID_PATCH;
+				break;
+			case 1: // TargetRead.
+				res = readerSkip(r, length);
+				break;
+			case 2: // SourceCopy.
+				if((res = readBpsOffset(r, &sourceRel)) != RES_OK) return res;
+				if(sourceRel > sourceSize || length > sourceSize - sourceRel) return RES_INVALID_PATCH;
+				if(sourceRel < outputOffset)
+				{
+					const u32 last = (sourceRel + length - 1)>>BPS_BLOCK_SHIFT;
+					for(u32 blk = sourceRel>>BPS_BLOCK_SHIFT; blk <= last; blk++)
+						backupMap[blk / 32] |= 1u<<(blk % 32);
+				}
+				sourceRel += length;
+				break;
+			case 3: // TargetCopy.
+				if((res = readBpsOffset(r, &targetRel)) != RES_OK) return res;
+				if(targetRel >= outputOffset) return RES_INVALID_PATCH;
+				targetRel += length;
+				break;
 		}
-		result += (octet | 0x80) << shift;
-		shift += 7;
+		if(res != RES_OK) return res;
+
+		outputOffset += length;
 	}
 
-	return result;
+	return (outputOffset == targetSize ? RES_OK : RES_INVALID_PATCH);
 }
 
-static Result patchUPS(const FHandle patchHandle, u32 *romSize) {
-	Result res = RES_OK;
+// Copies the marked source blocks to scratch memory. The block index table goes first.
+static Result backupBpsSource(const u32 *const backupMap) {
+	u32 *const blockOffsets = (u32*)ROM_SCRATCH_LOC;
+	uintptr_t backupPtr = ROM_SCRATCH_LOC + sizeof(u32) * BPS_NUM_BLOCKS;
+	for(u32 blk = 0; blk < BPS_NUM_BLOCKS; blk++)
+	{
+		if((backupMap[blk / 32] & 1u<<(blk % 32)) == 0) continue;
 
-	Cache cache = {
-		(u8*)calloc(512, 1), //buffer
-		0,                   //cache size
-		0,                   //cache offset
-		512                  //max cache size
-	};
-	if(cache.buffer == NULL) {
-		return RES_OUT_OF_MEM;
+		if(backupPtr + (1u<<BPS_BLOCK_SHIFT) > ROM_SCRATCH_LOC + ROM_SCRATCH_SIZE) return RES_OUT_OF_MEM;
+		memcpy((void*)backupPtr, (void*)(LGY_ROM_LOC + (blk<<BPS_BLOCK_SHIFT)), 1u<<BPS_BLOCK_SHIFT);
+		blockOffsets[blk] = backupPtr - ROM_SCRATCH_LOC;
+		backupPtr += 1u<<BPS_BLOCK_SHIFT;
 	}
 
-	//read data into cache for first time
-	cache.cacheSize = min(cache.maxCacheSize, (fSize(patchHandle)-12)-fTell(patchHandle));
-	res = fRead(patchHandle, cache.buffer, cache.cacheSize, NULL);
-	if(res != RES_OK) { free(cache.buffer); return res; }
-
-	ee_puts("UPS patch found! Patching...");
+	return RES_OK;
+}
 
-	//verify patch is UPS (magic number is "UPS1")
-	u8 magic[] = {0x00, 0x00, 0x00, 0x00}; 
-	bool isValidPatch = false;
-	for(u8 i=0; i<4; i++) {
-		magic[i] = readCache(patchHandle, &cache, &res);
-		if(res != RES_OK) break;
+static void copyBpsBackup(u8 *dst, u32 src, u32 length) {
+	const u32 *const blockOffsets = (u32*)ROM_SCRATCH_LOC;
+	const u32 blockMask = (1u<<BPS_BLOCK_SHIFT) - 1;
+	while(length > 0)
+	{
+		const u32 inBlock = src & blockMask;
+		const u32 num = min(length, blockMask + 1 - inBlock);
+		memcpy(dst, (u8*)ROM_SCRATCH_LOC + blockOffsets[src>>BPS_BLOCK_SHIFT] + inBlock, num);
+		dst    += num;
+		src    += num;
+		length -= num;
 	}
+}
 
-	if(res == RES_OK) {
-		if(memcmp(&magic, "UPS1", 4) == 0) {
-			isValidPatch = true;
-		} else {
-			res = RES_INVALID_PATCH;
+static Result applyBps(PatchReader *const r) {
+	u8 *const rom = (u8*)LGY_ROM_LOC;
+	u32 outputOffset = 0;
+	u32 sourceRel = 0;
+	u32 targetRel = 0;
+	while(readerAvail(r) > 0)
+	{
+		u32 data;
+		Result res = readPatchNumber(r, &data);
+		if(res != RES_OK) return res;
+
+		const u32 length = (data>>2) + 1;
+		switch(data & 3u)
+		{
+			case 0: // SourceRead. Source and target are the same memory.
+				break;
+			case 1: // TargetRead.
+				res = readerRead(r, &rom[outputOffset], length);
+				break;
+			case 2: // SourceCopy.
+				res = readBpsOffset(r, &sourceRel);
+				if(sourceRel >= outputOffset) memmove(&rom[outputOffset], &rom[sourceRel], length);
+				else                          copyBpsBackup(&rom[outputOffset], sourceRel, length);
+				sourceRel += length;
+				break;
+			case 3: // TargetCopy.
+			{
+				// Overlapping copies repeat a pattern. Copy in non-overlapping pieces.
+				res = readBpsOffset(r, &targetRel);
+				const u32 dist = outputOffset - targetRel;
+				u32 copied = 0;
+				while(copied < length)
+				{
+					const u32 num = min(length - copied, dist);
+					memcpy(&rom[outputOffset + copied], &rom[targetRel + copied], num);
+					copied += num;
+				}
+				targetRel += length;
+				break;
+			}
 		}
+		if(res != RES_OK) return res;
+
+		outputOffset += length;
 	}
 
-	if(isValidPatch) {
-		//get rom size
-		u32 baseRomSize = (u32)read_vuint(patchHandle, &res, &cache);
-		if(res != RES_OK) { free(cache.buffer); return res; }
-		//get patched rom size
-		u32 patchedRomSize = (u32)read_vuint(patchHandle, &res, &cache);
-		if(res != RES_OK) { free(cache.buffer); return res; }
-
-		debug_printf("Base size:    0x%lx\nPatched size: 0x%lx\n", baseRomSize, patchedRomSize);
-
-		if(patchedRomSize > baseRomSize) {
-			//scale up rom
-			*romSize = nextPow2(patchedRomSize);
-			//check if upscaled rom is too big
-			if(*romSize > LGY_MAX_ROM_SIZE) {
-				ee_puts("Patched ROM exceeds 32MB! Skipping patching...");
-				free(cache.buffer);
-				return RES_INVALID_PATCH; 
-			}
+	return RES_OK;
+}
 
-			memset((char*)(LGY_ROM_LOC + baseRomSize), 0xFFu, *romSize - baseRomSize); //fill out extra rom space
-			memset((char*)(LGY_ROM_LOC + baseRomSize), 0x00u, patchedRomSize - baseRomSize); //fill new patch area with 0's
+// Returns true if the user wants to apply a patch made for a different ROM anyway.
+static bool confirmWrongBaseRom(void) {
+	ee_puts("The patch was made for a different ROM!\n\nPress Y+UP to patch anyway or B to skip");
+	while(1){
+		GFX_waitForVBlank0();
+		hidScanInput();
+		if(hidKeysHeld() == (KEY_Y | KEY_DUP) && hidKeysDown() != 0) return true;
+		if(hidKeysDown() & KEY_B) return false;
+		if(hidGetExtraKeys(0) & (KEY_POWER_HELD | KEY_POWER)) power_off();
+	}
+}
+
+// Patches in place. Source data still needed after being overwritten is backed up first.
+static Result patchBPS(const FHandle patchHandle, u32 *romSize) {
+	ee_puts("BPS patch found! Patching...");
+
+	const u32 patchSize = fSize(patchHandle);
+	if(patchSize < 4 + 3 + 12) return RES_INVALID_PATCH;
+	const u32 actionsEnd = patchSize - 12;
+
+	PatchReader reader;
+	Result res = readerInit(&reader, patchHandle, actionsEnd, true);
+	if(res != RES_OK) return res;
+
+	u32 *const backupMap = (u32*)calloc(BPS_NUM_BLOCKS / 32, sizeof(u32));
+	u32 sourceSize, targetSize;
+	u32 footer[3]; // Source, target and patch CRC32.
+	do
+	{
+		if(backupMap == NULL) { res = RES_OUT_OF_MEM; break; }
+
+		// Pass 1: Validate the patch and find source data to back up.
+		res = readBpsHeader(&reader, &sourceSize, &targetSize);
+		if(res != RES_OK) break;
+		if(sourceSize > *romSize) { res = RES_INVALID_PATCH; break; }
+		if(targetSize > LGY_MAX_ROM_SIZE) { res = RES_ROM_TOO_BIG; break; }
+
+		res = scanBps(&reader, sourceSize, targetSize, backupMap);
+		if(res != RES_OK) break;
+
+		res = fRead(patchHandle, footer, 12, NULL);
+		if(res != RES_OK) break;
+		if(crc32(reader.crc, footer, 8) != footer[2])
+		{
+			ee_puts("BPS patch is corrupted!");
+			res = RES_INVALID_PATCH;
+			break;
+		}
+		const bool baseRomOk = crc32(0, (void*)LGY_ROM_LOC, sourceSize) == footer[0];
+		if(!baseRomOk && !confirmWrongBaseRom())
+		{
+			res = RES_INVALID_PATCH;
+			break;
 		}
 
-		uintmax_t patchFileSize = fSize(patchHandle);
+		res = backupBpsSource(backupMap);
+		if(res != RES_OK) break;
 
-		uintmax_t offset = 0;
-		u8 readByte = 0;
-		u8 *romBytes = ((u8*)LGY_ROM_LOC);
+		// Pass 2: Apply. The patch was validated so this can't go out of bounds.
+		res = fLseek(patchHandle, 0);
+		if(res != RES_OK) break;
+		readerReset(&reader, actionsEnd, false);
+		res = readBpsHeader(&reader, &sourceSize, &targetSize);
+		if(res != RES_OK) break;
+		res = applyBps(&reader);
+		if(res != RES_OK) break;
 
-		while(fTell(patchHandle) < (patchFileSize-12) && res==RES_OK) {
-			offset += read_vuint(patchHandle, &res, &cache);
-			if(res != RES_OK) break;
+		// The target can't match if the user forced a different ROM.
+		if(baseRomOk && crc32(0, (void*)LGY_ROM_LOC, targetSize) != footer[1]) res = RES_PATCH_CHECKSUM;
+		*romSize = fixRomPadding(targetSize);
+	} while(0);
 
-			while(offset<*romSize) {
-				readByte = readCache(patchHandle, &cache, &res);
-				if(res != RES_OK) break;
+	free(backupMap);
+	readerFree(&reader);
 
-				if(readByte == 0x00) {
-					offset++;
-					break; 
-				}
-				romBytes[offset] ^= readByte;
-				offset++;
+	return res;
+}
+
+// XORs one UPS hunk into the ROM. Hunks end with a zero byte.
+// Data past the output end is ignored. It happens when the output is smaller than the input.
+static Result xorUpsHunk(PatchReader *const r, u32 *const offset, const u32 outputSize) {
+	u8 *const rom = (u8*)LGY_ROM_LOC;
+	u32 out = *offset;
+	while(1)
+	{
+		if(r->pos == r->len)
+		{
+			if(r->left == 0) return RES_INVALID_PATCH;
+			const Result res = readerFill(r);
+			if(res != RES_OK) return res;
+		}
+
+		const u8 *const start = &r->buf[r->pos];
+		const u8 *src = start;
+		u32 avail = r->len - r->pos;
+
+		// A word at a time while it contains no zero byte.
+		while(avail >= 4 && out < outputSize && outputSize - out >= 4)
+		{
+			u32 x;
+			memcpy(&x, src, 4);
+			if(((x - 0x01010101u) & ~x & 0x80808080u) != 0) break;
+
+			u32 data;
+			memcpy(&data, &rom[out], 4);
+			data ^= x;
+			memcpy(&rom[out], &data, 4);
+			src   += 4;
+			out   += 4;
+			avail -= 4;
+		}
+
+		// Finish the word containing the terminator or the end of the buffer.
+		while(avail > 0)
+		{
+			const u8 x = *src++;
+			avail--;
+			if(x == 0)
+			{
+				r->pos += src - start;
+				*offset = out + 1; // The terminator stands for an unchanged byte.
+				return RES_OK;
 			}
+			if(out < outputSize) rom[out] ^= x;
+			out++;
 		}
+		r->pos += src - start;
+	}
+}
 
+// Skips one UPS hunk without applying it. Used to validate the patch.
+static Result skipUpsHunk(PatchReader *const r, u32 *const offset) {
+	while(1)
+	{
+		if(r->pos == r->len)
+		{
+			if(r->left == 0) return RES_INVALID_PATCH;
+			const Result res = readerFill(r);
+			if(res != RES_OK) return res;
+		}
+
+		const u8 *const start = &r->buf[r->pos];
+		const u8 *const end = (const u8*)memchr(start, 0, r->len - r->pos);
+		if(end != NULL)
+		{
+			const u32 num = end - start + 1; // Including the terminator.
+			r->pos  += num;
+			*offset += num;
+			return RES_OK;
+		}
+		*offset += r->len - r->pos;
+		r->pos = r->len;
 	}
+}
+
+static Result readUpsHeader(PatchReader *const r, u32 *const inputSize, u32 *const outputSize) {
+	// Verify patch is UPS (magic number is "UPS1").
+	u8 magic[4];
+	Result res = readerRead(r, magic, 4);
+	if(res != RES_OK) return res;
+	if(memcmp(magic, "UPS1", 4) != 0) return RES_INVALID_PATCH;
 
-	free(cache.buffer);
+	if((res = readPatchNumber(r, inputSize)) != RES_OK) return res;
+	return readPatchNumber(r, outputSize);
+}
+
+// Walks all hunks and XORs them into the ROM if apply is set.
+static Result processUpsHunks(PatchReader *const r, const u32 maxSize, const u32 outputSize, const bool apply) {
+	u32 offset = 0;
+	while(readerAvail(r) > 0)
+	{
+		u32 skip;
+		Result res = readPatchNumber(r, &skip);
+		if(res != RES_OK) return res;
+
+		// The terminator of the last hunk may be past the end.
+		if(offset > maxSize || skip > maxSize - offset) return RES_INVALID_PATCH;
+		offset += skip;
+
+		if(apply) res = xorUpsHunk(r, &offset, outputSize);
+		else      res = skipUpsHunk(r, &offset);
+		if(res != RES_OK) return res;
+	}
+
+	return RES_OK;
+}
+
+// Patches in place. The patch is validated before the ROM is touched.
+static Result patchUPS(const FHandle patchHandle, u32 *romSize) {
+	ee_puts("UPS patch found! Patching...");
+
+	// Footer with input, output and patch CRC32.
+	const u32 patchSize = fSize(patchHandle);
+	if(patchSize < 4 + 2 + 12) return RES_INVALID_PATCH;
+	const u32 hunksEnd = patchSize - 12;
+	u32 footer[3];
+	Result res = fLseek(patchHandle, hunksEnd);
+	if(res == RES_OK) res = fRead(patchHandle, footer, 12, NULL);
+	if(res == RES_OK) res = fLseek(patchHandle, 0);
+	if(res != RES_OK) return res;
+
+	// Patches are read twice. Keep them in scratch memory if possible.
+	PatchReader reader;
+	if(hunksEnd <= ROM_SCRATCH_SIZE) res = readerInitMemory(&reader, patchHandle, hunksEnd, (u8*)ROM_SCRATCH_LOC);
+	else                               res = readerInit(&reader, patchHandle, hunksEnd, true);
+	if(res != RES_OK) return res;
+
+	do
+	{
+		// Pass 1: Validate the patch. Read only.
+		u32 inputSize, outputSize;
+		res = readUpsHeader(&reader, &inputSize, &outputSize);
+		if(res != RES_OK) break;
+		debug_printf("Base size:    0x%" PRIX32 "\nPatched size: 0x%" PRIX32 "\n", inputSize, outputSize);
+
+		if(inputSize > LGY_MAX_ROM_SIZE) { res = RES_INVALID_PATCH; break; }
+		if(outputSize > LGY_MAX_ROM_SIZE)
+		{
+			ee_puts("Patched ROM exceeds 32MB! Skipping patching...");
+			res = RES_INVALID_PATCH;
+			break;
+		}
+
+		const u32 maxSize = (inputSize > outputSize ? inputSize : outputSize);
+		res = processUpsHunks(&reader, maxSize, outputSize, false);
+		if(res != RES_OK) break;
+		if(crc32(reader.crc, footer, 8) != footer[2])
+		{
+			ee_puts("UPS patch is corrupted!");
+			res = RES_INVALID_PATCH;
+			break;
+		}
+
+		const bool baseRomOk = crc32(0, (void*)LGY_ROM_LOC, inputSize) == footer[0];
+		if(!baseRomOk && !confirmWrongBaseRom())
+		{
+			res = RES_INVALID_PATCH;
+			break;
+		}
+
+		// UPS treats data past the end of the input as zeros.
+		if(outputSize > inputSize)
+			memset((void*)(LGY_ROM_LOC + inputSize), 0, outputSize - inputSize);
+
+		// Pass 2: Apply.
+		res = readerRewind(&reader, hunksEnd);
+		if(res != RES_OK) break;
+		res = readUpsHeader(&reader, &inputSize, &outputSize);
+		if(res == RES_OK) res = processUpsHunks(&reader, maxSize, outputSize, true);
+		if(res == RES_INVALID_PATCH) res = RES_PATCH_CHECKSUM; // Only if the file changed. The ROM is already modified.
+		if(res != RES_OK) break;
+
+		// Also checked for a wrong base ROM so the user is warned if the result is broken.
+		if(crc32(0, (void*)LGY_ROM_LOC, outputSize) != footer[1]) res = RES_PATCH_CHECKSUM;
+		*romSize = fixRomPadding(outputSize);
+	} while(0);
+
+	readerFree(&reader);
 
 	return res;
 }
@@ -258,7 +748,26 @@ Result patchRom(const char *const gamePath, u32 *romSize) {
 		//check if patch file is present. If so, call appropriate patching function
 		if((res = fOpen(&f, strcat(patchPathBase, "ips"), FA_OPEN_EXISTING | FA_READ)) == RES_OK)
 		{
-			res = patchIPS(f);
+			res = patchIPS(f, romSize);
+
+			if(res != RES_OK && res != RES_INVALID_PATCH) {
+				ee_puts("An error has occurred while patching.\nContinuing is NOT recommended!\n\nPress Y+UP to proceed");
+				while(1){
+					hidScanInput();
+					if(hidKeysHeld() == (KEY_Y | KEY_DUP) && hidKeysDown() != 0) break;
+					if(hidGetExtraKeys(0) & (KEY_POWER_HELD | KEY_POWER)) power_off();
+				}
+			}
+
+			fClose(f);
+			goto cleanup;
+		}
+		//reset patchPathBase
+		memset(patchPathBase+extensionOffset, '\0', 3);
+
+		if((res = fOpen(&f, strcat(patchPathBase, "bps"), FA_OPEN_EXISTING | FA_READ)) == RES_OK)
+		{
+			res = patchBPS(f, romSize);
 
 			if(res != RES_OK && res != RES_INVALID_PATCH) {
 				ee_puts("An error has occurred while patching.\nContinuing is NOT recommended!\n\nPress Y+UP to proceed");
@@ -0,0 +1,278 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "types.h"
+#include "arm11/png.h"
+#include "arm11/crc32.h"
+
+
+#define ADLER_MOD         (65521u)
+#define ADLER_NMAX        (5552u) // Max bytes before the sums can overflow.
+#define HASH_BITS         (12u)
+#define HASH_SIZE         (1u<<HASH_BITS)
+#define WINDOW_SIZE       (32768u)
+#define MIN_MATCH         (3u)
+#define MAX_MATCH         (258u)
+
+
+typedef struct
+{
+	u8 *out;
+	u32 bitBuf;
+	u32 bitCnt;
+} BitWriter;
+
+static const u16 g_lenBase[29] =
+{
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const u8 g_lenExtra[29] =
+{
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const u16 g_distBase[30] =
+{
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const u8 g_distExtra[30] =
+{
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+
+
+static void putBe32(u8 *const p, const u32 val)
+{
+	p[0] = val>>24;
+	p[1] = val>>16;
+	p[2] = val>>8;
+	p[3] = val;
+}
+
+static u32 rawSize(const u32 width, const u32 height)
+{
+	return height * (1 + width * 3); // Filter byte per row.
+}
+
+// Output bound of the deflate stream plus the raw image and hash table behind it.
+u32 pngMaxSize(const u32 width, const u32 height)
+{
+	const u32 raw = rawSize(width, height);
+
+	// Signature, IHDR, sBIT, IDAT (zlib header + deflate + Adler32) and IEND.
+	// Fixed Huffman codes never need more than 9 bits per byte.
+	const u32 pngSize = 8 + (12 + 13) + (12 + 3) + (12 + 2 + raw + raw / 8 + 8 + 4) + 12;
+
+	return ((pngSize + 3) & ~3u) + HASH_SIZE * 4 + raw;
+}
+
+static u32 adler32(const u8 *data, u32 size)
+{
+	u32 a = 1;
+	u32 b = 0;
+	while(size > 0)
+	{
+		u32 n = (size < ADLER_NMAX ? size : ADLER_NMAX);
+		size -= n;
+		do
+		{
+			a += *data++;
+			b += a;
+		} while(--n);
+
+		a %= ADLER_MOD;
+		b %= ADLER_MOD;
+	}
+
+	return b<<16 | a;
+}
+
+// Deflate bits are stored LSB first.
+static void putBits(BitWriter *const bw, const u32 val, const u32 cnt)
+{
+	bw->bitBuf |= val<<bw->bitCnt;
+	bw->bitCnt += cnt;
+	while(bw->bitCnt >= 8)
+	{
+		*bw->out++ = bw->bitBuf;
+		bw->bitBuf >>= 8;
+		bw->bitCnt -= 8;
+	}
+}
+
+// Huffman codes are stored MSB first so they need to be reversed.
+static void putCode(BitWriter *const bw, u32 code, const u32 len)
+{
+	u32 rev = 0;
+	for(u32 i = 0; i < len; i++)
+	{
+		rev = rev<<1 | (code & 1u);
+		code >>= 1;
+	}
+
+	putBits(bw, rev, len);
+}
+
+// Fixed Huffman literal/length alphabet (RFC 1951 3.2.6).
+static void putLitLen(BitWriter *const bw, const u32 sym)
+{
+	if(sym < 144)      putCode(bw, 0x30 + sym, 8);
+	else if(sym < 256) putCode(bw, 0x190 + sym - 144, 9);
+	else if(sym < 280) putCode(bw, sym - 256, 7);
+	else               putCode(bw, 0xC0 + sym - 280, 8);
+}
+
+static void putMatch(BitWriter *const bw, const u32 len, const u32 dist)
+{
+	u32 l = 28;
+	while(g_lenBase[l] > len) l--;
+	putLitLen(bw, 257 + l);
+	putBits(bw, len - g_lenBase[l], g_lenExtra[l]);
+
+	u32 d = 29;
+	while(g_distBase[d] > dist) d--;
+	putCode(bw, d, 5);
+	putBits(bw, dist - g_distBase[d], g_distExtra[d]);
+}
+
+static inline u32 hash3(const u8 *const p)
+{
+	return ((u32)p[0]<<16 | (u32)p[1]<<8 | p[2]) * 2654435761u >> (32 - HASH_BITS);
+}
+
+// Single fixed Huffman block with greedy matching and one probe per position.
+// Emulator frames are mostly flat areas and repeated tiles so this is
+// most of the gain at a fraction of the cost of a real deflate.
+static u8* deflateFixed(const u8 *const raw, const u32 size, u32 *const head, u8 *const out)
+{
+	BitWriter bw = {out, 0, 0};
+	putBits(&bw, 1, 1); // BFINAL.
+	putBits(&bw, 1, 2); // BTYPE 01 (fixed Huffman).
+
+	for(u32 i = 0; i < HASH_SIZE; i++) head[i] = UINT32_MAX;
+
+	u32 pos = 0;
+	while(pos < size)
+	{
+		u32 len = 0;
+		u32 dist = 0;
+		if(size - pos >= MIN_MATCH)
+		{
+			const u32 h = hash3(&raw[pos]);
+			const u32 cand = head[h];
+			head[h] = pos;
+			if(cand != UINT32_MAX && pos - cand <= WINDOW_SIZE)
+			{
+				const u32 maxLen = (size - pos < MAX_MATCH ? size - pos : MAX_MATCH);
+				while(len < maxLen && raw[cand + len] == raw[pos + len]) len++;
+				dist = pos - cand;
+			}
+		}
+
+		if(len >= MIN_MATCH)
+		{
+			putMatch(&bw, len, dist);
+
+			// Keep the hash chain heads up to date inside the match.
+			const u32 end = pos + len;
+			for(pos++; pos < end; pos++)
+			{
+				if(size - pos >= MIN_MATCH) head[hash3(&raw[pos])] = pos;
+			}
+		}
+		else putLitLen(&bw, raw[pos++]);
+	}
+
+	putLitLen(&bw, 256); // End of block.
+	putBits(&bw, 0, 7);  // Flush to a byte boundary.
+
+	return bw.out;
+}
+
+// Chunk data must already be at p + 8. Returns the pointer after the chunk.
+static u8* finishChunk(u8 *const p, const char type[4], const u32 size)
+{
+	putBe32(p, size);
+	memcpy(p + 4, type, 4);
+	putBe32(p + 8 + size, crc32(0, p + 4, 4 + size));
+
+	return p + 12 + size;
+}
+
+u32 pngEncodeA1bgr5(const u16 *const src, const u32 width, const u32 height, void *const out)
+{
+	static const u8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	u8 *p = (u8*)out;
+	memcpy(p, signature, 8);
+	p += 8;
+
+	u8 *const ihdr = p + 8;
+	putBe32(&ihdr[0], width);
+	putBe32(&ihdr[4], height);
+	ihdr[8]  = 8; // Bit depth.
+	ihdr[9]  = 2; // Truecolor.
+	ihdr[10] = 0; // Deflate.
+	ihdr[11] = 0; // Adaptive filtering.
+	ihdr[12] = 0; // No interlace.
+	p = finishChunk(p, "IHDR", 13);
+
+	u8 *const sbit = p + 8;
+	sbit[0] = sbit[1] = sbit[2] = 5;
+	p = finishChunk(p, "sBIT", 3);
+
+	// The raw image is built behind the PNG. Deflate output never catches up.
+	const u32 raw = rawSize(width, height);
+	u8 *const work = (u8*)out + pngMaxSize(width, height) - raw - HASH_SIZE * 4;
+	u32 *const head = (u32*)work;
+	u8 *const rawBuf = work + HASH_SIZE * 4;
+	const u16 *pixels = src;
+	u8 *rowPtr = rawBuf;
+	for(u32 y = 0; y < height; y++)
+	{
+		*rowPtr++ = 0; // Filter type none.
+		for(u32 x = 0; x < width; x++)
+		{
+			// Expand 5 bit to 8 bit. The top bits come back with >>3.
+			const u32 c = *pixels++;
+			const u32 r = c>>11 & 0x1Fu;
+			const u32 g = c>>6 & 0x1Fu;
+			const u32 b = c>>1 & 0x1Fu;
+			*rowPtr++ = r<<3 | r>>2;
+			*rowPtr++ = g<<3 | g>>2;
+			*rowPtr++ = b<<3 | b>>2;
+		}
+	}
+
+	u8 *const idat = p;
+	u8 *zlib = idat + 8;
+	zlib[0] = 0x78; // Deflate, 32 KiB window.
+	zlib[1] = 0x01; // No preset dict, fastest. Header is a multiple of 31.
+	zlib = deflateFixed(rawBuf, raw, head, zlib + 2);
+	putBe32(zlib, adler32(rawBuf, raw));
+	zlib += 4;
+	p = finishChunk(idat, "IDAT", zlib - (idat + 8));
+
+	p = finishChunk(p, "IEND", 0);
+
+	return p - (u8*)out;
+}
@@ -0,0 +1,215 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include "types.h"
+#include "arm11/rom_cache.h"
+#include "arm11/config.h"
+#include "arm11/save_type.h"
+#include "fs.h"
+#include "fsutil.h"
+
+
+#define ROM_CACHE_PATH     OAF_SAVE_DIR "/rom_cache.bin"
+#define ROM_CACHE_MAGIC    (0x434D4F52u) // "ROMC"
+#define ROM_CACHE_VERSION  (1u)
+#define ROM_CACHE_ENTRIES  (64u)
+
+
+typedef struct
+{
+	u64 pathHash;
+	u64 sha1Prefix;
+	u32 fileSize;
+	u32 fatTime;    // fdate<<16 | ftime.
+	u32 romSize;
+	u8 scanStrIdx;
+	u8 dbSaveType;
+	u8 hasSha1;
+	u8 reserved;
+} RomCacheEntry;
+static_assert(sizeof(RomCacheEntry) == 32);
+
+typedef struct
+{
+	u32 magic;
+	u16 version;
+	u16 numEntries;
+	u32 dbSize;     // gba_db.bin size and timestamp the db save types are from.
+	u32 dbFatTime;
+	u32 lutVersion; // SAVE_TYPE_LUT_VERSION the scanStrIdx values are from.
+	u32 reserved;
+	RomCacheEntry entries[ROM_CACHE_ENTRIES]; // Most recently used first.
+} RomCache;
+static_assert(offsetof(RomCache, entries) == 24);
+
+static RomCache g_romCache;
+static RomCacheEntry g_romKey; // Key of the ROM looked up last.
+static u32 g_romIdx;           // Index of the ROM in the cache or ROM_CACHE_ENTRIES.
+
+
+
+static u64 hashPath(const char *str)
+{
+	// FNV-1a.
+	u64 hash = 0xCBF29CE484222325u;
+	while(*str != '\0')
+	{
+		hash ^= (u8)*str++;
+		hash *= 0x100000001B3u;
+	}
+
+	return hash;
+}
+
+static void loadRomCache(void)
+{
+	RomCache *const cache = &g_romCache;
+
+	FHandle f;
+	u32 bytesRead = 0;
+	Result res = fOpen(&f, ROM_CACHE_PATH, FA_OPEN_EXISTING | FA_READ);
+	if(res == RES_OK)
+	{
+		res = fRead(f, cache, sizeof(RomCache), &bytesRead);
+		fClose(f);
+	}
+
+	// Start over on any error or corruption.
+	if(res != RES_OK || bytesRead < offsetof(RomCache, entries) || cache->magic != ROM_CACHE_MAGIC ||
+	   cache->version != ROM_CACHE_VERSION || cache->lutVersion != SAVE_TYPE_LUT_VERSION ||
+	   cache->numEntries > ROM_CACHE_ENTRIES ||
+	   bytesRead != offsetof(RomCache, entries) + sizeof(RomCacheEntry) * cache->numEntries)
+	{
+		memset(cache, 0, offsetof(RomCache, entries));
+		cache->magic      = ROM_CACHE_MAGIC;
+		cache->version    = ROM_CACHE_VERSION;
+		cache->lutVersion = SAVE_TYPE_LUT_VERSION;
+	}
+
+	// The db save types are only valid for the gba_db.bin they came from.
+	FILINFO fi;
+	u32 dbSize = 0;
+	u32 dbFatTime = 0;
+	if(fStat("gba_db.bin", &fi) == RES_OK)
+	{
+		dbSize    = fi.fsize;
+		dbFatTime = (u32)fi.fdate<<16 | fi.ftime;
+	}
+	if(cache->dbSize != dbSize || cache->dbFatTime != dbFatTime)
+	{
+		for(u32 i = 0; i < cache->numEntries; i++)
+			cache->entries[i].dbSaveType = GBA_DB_SAVE_UNKNOWN;
+
+		cache->dbSize    = dbSize;
+		cache->dbFatTime = dbFatTime;
+	}
+}
+
+// Returns the index of the entry for pathHash or ROM_CACHE_ENTRIES.
+static u32 findEntry(const u64 pathHash)
+{
+	const RomCache *const cache = &g_romCache;
+	for(u32 i = 0; i < cache->numEntries; i++)
+	{
+		if(cache->entries[i].pathHash == pathHash) return i;
+	}
+
+	return ROM_CACHE_ENTRIES;
+}
+
+// Same path but a different file is stale.
+static bool entryToFp(const RomCacheEntry *const entry, const FILINFO *const fi, RomFingerprint *const fpOut)
+{
+	if(entry->fileSize != fi->fsize || entry->fatTime != ((u32)fi->fdate<<16 | fi->ftime)) return false;
+
+	fpOut->sha1Prefix = entry->sha1Prefix;
+	fpOut->romSize    = entry->romSize;
+	fpOut->scanStrIdx = entry->scanStrIdx;
+	fpOut->dbSaveType = entry->dbSaveType;
+	fpOut->hasSha1    = entry->hasSha1;
+
+	return true;
+}
+
+bool romCacheLookup(const char *const romPath, RomFingerprint *const fpOut)
+{
+	loadRomCache();
+
+	RomCacheEntry *const key = &g_romKey;
+	memset(key, 0, sizeof(RomCacheEntry));
+	g_romIdx = ROM_CACHE_ENTRIES;
+
+	FILINFO fi;
+	if(fStat(romPath, &fi) != RES_OK) return false;
+	key->pathHash = hashPath(romPath);
+	key->fileSize = fi.fsize;
+	key->fatTime  = (u32)fi.fdate<<16 | fi.ftime;
+
+	// Stale entries are overwritten by romCacheStore().
+	g_romIdx = findEntry(key->pathHash);
+	if(g_romIdx == ROM_CACHE_ENTRIES) return false;
+
+	return entryToFp(&g_romCache.entries[g_romIdx], &fi, fpOut);
+}
+
+Result romCacheStore(const RomFingerprint *const fp)
+{
+	// No key if romCacheLookup() failed to stat the ROM.
+	RomCacheEntry *const key = &g_romKey;
+	if(key->pathHash == 0) return RES_OK;
+
+	key->sha1Prefix = (fp->hasSha1 ? fp->sha1Prefix : 0);
+	key->romSize    = fp->romSize;
+	key->scanStrIdx = fp->scanStrIdx;
+	key->dbSaveType = fp->dbSaveType;
+	key->hasSha1    = fp->hasSha1;
+
+	// Move the entry to the front. If it's new the least recently used entry drops out.
+	RomCache *const cache = &g_romCache;
+	u32 idx = g_romIdx;
+	if(idx == 0 && memcmp(&cache->entries[0], key, sizeof(RomCacheEntry)) == 0) return RES_OK;
+	if(idx == ROM_CACHE_ENTRIES)
+	{
+		if(cache->numEntries < ROM_CACHE_ENTRIES) cache->numEntries++;
+		idx = cache->numEntries - 1;
+	}
+	memmove(&cache->entries[1], &cache->entries[0], sizeof(RomCacheEntry) * idx);
+	memcpy(&cache->entries[0], key, sizeof(RomCacheEntry));
+	g_romIdx = 0;
+
+	return fsQuickWrite(ROM_CACHE_PATH, cache, offsetof(RomCache, entries) + sizeof(RomCacheEntry) * cache->numEntries);
+}
+
+void romCacheLoad(void)
+{
+	loadRomCache();
+}
+
+bool romCachePeek(const char *const romPath, RomFingerprint *const fpOut)
+{
+	const u32 idx = findEntry(hashPath(romPath));
+	if(idx == ROM_CACHE_ENTRIES) return false;
+
+	FILINFO fi;
+	if(fStat(romPath, &fi) != RES_OK) return false;
+
+	return entryToFp(&g_romCache.entries[idx], &fi, fpOut);
+}
@@ -0,0 +1,202 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include "types.h"
+#include "arm11/rom_load.h"
+#include "arm11/fast_rom_padding.h"
+#include "arm11/boot_trace.h"
+#include "arm11/fmt.h"
+#include "drivers/lgy_common.h"
+#include "drivers/sha.h"
+#include "fs.h"
+#include "kernel.h"
+#include "kevent.h"
+#include "util.h"
+
+
+#define ROM_LOAD_CHUNK_SIZE  (1024u * 512) // Must be a multiple of 64 (SHA block size).
+
+
+typedef struct
+{
+	KHandle dataEvent;   // Signaled whenever a new chunk has been loaded.
+	KHandle doneEvent;   // Signaled when the worker processed everything.
+	vu32 loaded;         // Number of bytes loaded so far.
+	volatile bool last;  // Set after the last chunk has been loaded.
+	bool hashRom;
+	u32 hashed;          // Number of bytes hashed so far.
+	SaveScanState *scan; // NULL if the save type is not needed.
+} RomLoadPipe;
+
+
+
+u32 fixRomPadding(const u32 romFileSize)
+{
+	// Pad unused ROM area with 0xFFs (trimmed ROMs).
+	// Smallest retail ROM chip is 8 Mbit (1 MiB).
+	u32 romSize = nextPow2(romFileSize);
+	romSize = (romSize < 0x100000 ? 0x100000 : romSize);
+	const uintptr_t romLoc = LGY_ROM_LOC;
+	memset((void*)(romLoc + romFileSize), 0xFF, romSize - romFileSize);
+
+	u32 mirroredSize = romSize;
+	if(romSize == 0x100000) // 1 MiB.
+	{
+		// ROM mirroring for Classic NES Series/others with 8 Mbit ROM.
+		// The ROM is mirrored exactly 4 times.
+		// Thanks to endrift for discovering this.
+		mirroredSize = 0x400000; // 4 MiB.
+		uintptr_t mirrorLoc = romLoc + romSize;
+		do
+		{
+			memcpy((void*)mirrorLoc, (void*)romLoc, romSize);
+			mirrorLoc += romSize;
+		} while(mirrorLoc < romLoc + mirroredSize);
+	}
+
+	// Fake "open bus" padding.
+	if(romSize < LGY_MAX_ROM_SIZE)
+		makeOpenBusPaddingFast((u32*)(romLoc + mirroredSize));
+
+	// We don't return the mirrored size because the db hashes are over unmirrored dumps.
+	return romSize;
+}
+
+static void processRomChunk(RomLoadPipe *const pipe, const u32 loaded)
+{
+	// The SHA engine wants full blocks. The tail is hashed after padding.
+	if(pipe->hashRom)
+	{
+		const u32 hashEnd = loaded & ~63u;
+		const u32 hashed = pipe->hashed;
+		if(hashEnd > hashed)
+		{
+			SHA_update((u32*)(LGY_ROM_LOC + hashed), hashEnd - hashed);
+			pipe->hashed = hashEnd;
+		}
+	}
+
+	if(pipe->scan != NULL) saveScanUpdate(pipe->scan, loaded, false);
+}
+
+static void romLoadWorker(void *args)
+{
+	RomLoadPipe *const pipe = (RomLoadPipe*)args;
+
+	u32 processed = 0;
+	while(1)
+	{
+		// Read the last flag first. Once it's set loaded is final.
+		const bool last = pipe->last;
+		const u32 loaded = pipe->loaded;
+		if(loaded > processed)
+		{
+			processRomChunk(pipe, loaded);
+			processed = loaded;
+		}
+		else if(last) break;
+		else
+		{
+			waitForEvent(pipe->dataEvent);
+			clearEvent(pipe->dataEvent);
+		}
+	}
+
+	signalEvent(pipe->doneEvent, false);
+	taskExit();
+}
+
+// Loads the ROM in chunks while hashing and scanning
+// the already loaded part in a lower priority task.
+// If the SD driver blocks while waiting for the card the task can
+// use that time. This way we only touch the ROM once for all 3 steps.
+Result loadGbaRom(const char *const path, u32 *const romSizeOut, u64 sha1Out[3], SaveScanState *const scan)
+{
+	FHandle f;
+	Result res = fOpen(&f, path, FA_OPEN_EXISTING | FA_READ);
+	if(res != RES_OK) return res;
+
+	u32 fileSize = fSize(f);
+	if(fileSize > LGY_MAX_ROM_SIZE)
+	{
+		fileSize = LGY_MAX_ROM_SIZE;
+		ee_puts("Warning: ROM file is too big. Expect crashes.");
+	}
+
+	RomLoadPipe pipe = {0};
+	pipe.hashRom = sha1Out != NULL;
+	pipe.scan    = scan;
+	if(pipe.hashRom) SHA_start(SHA_IN_BIG | SHA_1_MODE);
+	if(scan != NULL) saveScanInit(scan);
+
+	// Without events or task we process every chunk right after reading it.
+	KHandle worker = 0;
+	if(pipe.hashRom || scan != NULL)
+	{
+		pipe.dataEvent = createEvent(false);
+		pipe.doneEvent = createEvent(false);
+		if(pipe.dataEvent != 0 && pipe.doneEvent != 0)
+			worker = createTask(0x800, 1, romLoadWorker, &pipe);
+	}
+
+	u32 loaded = 0;
+	while(loaded < fileSize)
+	{
+		const u32 chunkSize = (fileSize - loaded < ROM_LOAD_CHUNK_SIZE ? fileSize - loaded : ROM_LOAD_CHUNK_SIZE);
+		u32 read;
+		res = fRead(f, (void*)(LGY_ROM_LOC + loaded), chunkSize, &read);
+		if(res != RES_OK || read != chunkSize) break;
+		loaded += chunkSize;
+
+		if(worker != 0)
+		{
+			pipe.loaded = loaded;
+			signalEvent(pipe.dataEvent, false);
+		}
+		else if(pipe.hashRom || scan != NULL) processRomChunk(&pipe, loaded);
+	}
+	fClose(f);
+
+	if(worker != 0)
+	{
+		pipe.last = true;
+		signalEvent(pipe.dataEvent, false);
+		waitForEvent(pipe.doneEvent);
+	}
+	if(pipe.dataEvent != 0) deleteEvent(pipe.dataEvent);
+	if(pipe.doneEvent != 0) deleteEvent(pipe.doneEvent);
+
+	if(loaded == fileSize)
+	{
+		TRACE_BEGIN("fixRomPadding");
+		const u32 romSize = fixRomPadding(fileSize);
+		TRACE_END("fixRomPadding");
+		*romSizeOut = romSize;
+
+		// Hash the remaining data including padding.
+		if(pipe.hashRom)
+		{
+			SHA_update((u32*)(LGY_ROM_LOC + pipe.hashed), romSize - pipe.hashed);
+			SHA_finish((u32*)sha1Out, SHA_OUT_BIG);
+		}
+		if(scan != NULL) saveScanUpdate(scan, romSize, true);
+	}
+	else if(pipe.hashRom) SHA_finish((u32*)sha1Out, SHA_OUT_BIG); // Leave the engine in a sane state.
+
+	return res;
+}
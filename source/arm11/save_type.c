@@ -16,15 +16,15 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
 #include <string.h>
 #include "types.h"
 #include "arm11/save_type.h"
 #include "drivers/lgy_common.h"
 #include "arm11/fmt.h"
 #include "fs.h"
-#include "drivers/sha.h"
 #include "oaf_error_codes.h"
-#include "arm11/console.h"
+#include "arm11/text_grid.h"
 #include "drivers/gfx.h"
 #include "arm11/drivers/hid.h"
 
@@ -45,7 +45,213 @@ static u16 checkSaveOverride(const u32 gameCode) // Save type overrides for mode
 	return 0xFF;
 }
 
-u16 detectSaveType(const u32 romSize, const u16 defaultSave)
+// Code based on: https://github.com/Gericom/GBARunner2/blob/master/arm9/source/save/Save.vram.cpp
+// Changes to this table need a SAVE_TYPE_LUT_VERSION bump.
+static const struct
+{
+	const char *str;
+	u16 saveType;
+} g_saveTypeLut[25] =
+{
+	// EEPROM
+	// Assume common sizes for popular games to aid ROM hacks.
+	{"EEPROM_V111", SAVE_TYPE_EEPROM_8k},
+	{"EEPROM_V120", SAVE_TYPE_EEPROM_8k},
+	{"EEPROM_V121", SAVE_TYPE_EEPROM_64k},
+	{"EEPROM_V122", SAVE_TYPE_EEPROM_8k},
+	{"EEPROM_V124", SAVE_TYPE_EEPROM_64k},
+	{"EEPROM_V125", SAVE_TYPE_EEPROM_8k},
+	{"EEPROM_V126", SAVE_TYPE_EEPROM_8k},
+
+	// FLASH
+	// Assume they all have RTC.
+	{"FLASH_V120",    SAVE_TYPE_FLASH_512k_PSC_RTC},
+	{"FLASH_V121",    SAVE_TYPE_FLASH_512k_PSC_RTC},
+	{"FLASH_V123",    SAVE_TYPE_FLASH_512k_PSC_RTC},
+	{"FLASH_V124",    SAVE_TYPE_FLASH_512k_PSC_RTC},
+	{"FLASH_V125",    SAVE_TYPE_FLASH_512k_PSC_RTC},
+	{"FLASH_V126",    SAVE_TYPE_FLASH_512k_PSC_RTC},
+	{"FLASH512_V130", SAVE_TYPE_FLASH_512k_PSC_RTC},
+	{"FLASH512_V131", SAVE_TYPE_FLASH_512k_PSC_RTC},
+	{"FLASH512_V133", SAVE_TYPE_FLASH_512k_PSC_RTC},
+	{"FLASH1M_V102",  SAVE_TYPE_FLASH_1m_MRX_RTC},
+	{"FLASH1M_V103",  SAVE_TYPE_FLASH_1m_MRX_RTC},
+
+	// FRAM & SRAM
+	{"SRAM_F_V100", SAVE_TYPE_SRAM_256k},
+	{"SRAM_F_V102", SAVE_TYPE_SRAM_256k},
+	{"SRAM_F_V103", SAVE_TYPE_SRAM_256k},
+
+	{"SRAM_V110",   SAVE_TYPE_SRAM_256k},
+	{"SRAM_V111",   SAVE_TYPE_SRAM_256k},
+	{"SRAM_V112",   SAVE_TYPE_SRAM_256k},
+	{"SRAM_V113",   SAVE_TYPE_SRAM_256k}
+};
+
+// Word based trie over the SDK save strings.
+// All strings start word aligned so the ROM is matched a word at a time.
+// The last word of a string may be partial and is compared with a mask.
+#define TRIE_MAX_EDGES  (64u)
+#define TRIE_NONE       (0xFFu)
+#define TRIE_ROOT_WORDS (3u)   // Distinct first words. "EEPR", "FLAS" and "SRAM".
+
+typedef struct
+{
+	u32 word;
+	u32 mask;
+	u8 sibling; // Next edge of the same node or TRIE_NONE.
+	u8 strIdx;  // Save string index if this edge completes a string or TRIE_NONE.
+} TrieEdge;
+
+static TrieEdge g_trieEdges[TRIE_MAX_EDGES];
+static u8 g_trieFirstEdge[TRIE_MAX_EDGES + 1]; // Node 0 is the root. Edge n leads to node n + 1.
+static u32 g_trieRootWords[TRIE_ROOT_WORDS];   // First words of all strings. Unused slots repeat one.
+static bool g_trieBuilt = false;
+
+static void buildSaveStrTrie(void)
+{
+	memset(g_trieFirstEdge, TRIE_NONE, sizeof(g_trieFirstEdge));
+
+	u32 numEdges = 0;
+	for(u32 i = 0; i < 25; i++)
+	{
+		const char *const str = g_saveTypeLut[i].str;
+		const u32 len = strlen(str);
+
+		u32 node = 0;
+		for(u32 offset = 0; offset < len; offset += 4)
+		{
+			const u32 n = (len - offset < 4 ? len - offset : 4);
+			u32 word = 0;
+			memcpy(&word, &str[offset], n);
+			const u32 mask = (n < 4 ? (1u<<(n * 8)) - 1 : 0xFFFFFFFFu);
+			const u8 strIdx = (offset + 4 >= len ? i : TRIE_NONE);
+
+			// Share prefixes. New edges are appended to keep the lut priority order.
+			u8 *link = &g_trieFirstEdge[node];
+			u32 e = *link;
+			while(e != TRIE_NONE)
+			{
+				const TrieEdge *const edge = &g_trieEdges[e];
+				if(edge->word == word && edge->mask == mask &&
+				   edge->strIdx == TRIE_NONE && strIdx == TRIE_NONE) break;
+
+				link = &g_trieEdges[e].sibling;
+				e = *link;
+			}
+			if(e == TRIE_NONE)
+			{
+				e = numEdges++;
+				g_trieEdges[e] = (TrieEdge){word, mask, TRIE_NONE, strIdx};
+				*link = e;
+			}
+
+			node = e + 1;
+		}
+	}
+
+	// All strings are longer than 4 chars so root edges are full words.
+	u32 numRootWords = 0;
+	for(u32 e = g_trieFirstEdge[0]; e != TRIE_NONE; e = g_trieEdges[e].sibling)
+	{
+		assert(numRootWords < TRIE_ROOT_WORDS);
+		g_trieRootWords[numRootWords++] = g_trieEdges[e].word;
+	}
+	while(numRootWords < TRIE_ROOT_WORDS) g_trieRootWords[numRootWords++] = g_trieRootWords[0];
+
+	g_trieBuilt = true;
+}
+
+// Returns the next node. On a mismatch the word is retried at the root.
+// This is enough because no word of a save string other than
+// the first can start another save string.
+static u32 trieStep(u32 node, const u32 word, u8 *const strIdx)
+{
+	while(1)
+	{
+		for(u32 e = g_trieFirstEdge[node]; e != TRIE_NONE; e = g_trieEdges[e].sibling)
+		{
+			const TrieEdge *const edge = &g_trieEdges[e];
+			if((word & edge->mask) == edge->word)
+			{
+				if(edge->strIdx != TRIE_NONE)
+				{
+					*strIdx = edge->strIdx;
+					return 0;
+				}
+
+				return e + 1;
+			}
+		}
+
+		if(node == 0) return 0;
+		node = 0;
+	}
+}
+
+void saveScanInit(SaveScanState *const state)
+{
+	if(!g_trieBuilt) buildSaveStrTrie();
+
+	state->pos    = 0xE4; // Skip headers.
+	state->node   = 0;
+	state->strIdx = 0xFF;
+}
+
+void saveScanUpdate(SaveScanState *const state, const u32 end, const bool last)
+{
+	if(state->strIdx != 0xFF) return;
+
+	// The matcher state carries over so we can scan right up to the
+	// data loaded so far. On the last update words overlapping the end count too.
+	u8 strIdx = 0xFF;
+	u32 node = state->node;
+	const u32 root0 = g_trieRootWords[0];
+	const u32 root1 = g_trieRootWords[1];
+	const u32 root2 = g_trieRootWords[2];
+	const u32 *romPtr = (u32*)(LGY_ROM_LOC + state->pos);
+	const u32 *const romEnd = (u32*)(LGY_ROM_LOC + (last ? (end + 3) & ~3u : end & ~3u));
+	while(romPtr < romEnd)
+	{
+		// Fast path. Almost no word starts a save string.
+		if(node == 0)
+		{
+			u32 tmp;
+			do
+			{
+				tmp = *romPtr;
+				if(tmp == root0 || tmp == root1 || tmp == root2) break;
+			} while(++romPtr < romEnd);
+			if(romPtr == romEnd) break;
+		}
+
+		node = trieStep(node, *romPtr++, &strIdx);
+		if(strIdx != 0xFF)
+		{
+			state->strIdx = strIdx;
+			return;
+		}
+	}
+
+	// Finish a partial match reaching past the end. Strings are max 4 words long.
+	if(last)
+	{
+		while(node != 0)
+		{
+			node = trieStep(node, *romPtr++, &strIdx);
+			if(strIdx != 0xFF)
+			{
+				state->strIdx = strIdx;
+				return;
+			}
+		}
+	}
+
+	state->pos  = (uintptr_t)romPtr - LGY_ROM_LOC;
+	state->node = node;
+}
+
+u16 detectSaveType(const SaveScanState *const state, const u32 romSize, const u16 defaultSave)
 {
 	const u32 *romPtr = (u32*)LGY_ROM_LOC;
 	u16 saveType = checkSaveOverride(romPtr[0xAC / 4]);
@@ -56,93 +262,34 @@ u16 detectSaveType(const u32 romSize, const u16 defaultSave)
 		return saveType;
 	}
 
-	// Code based on: https://github.com/Gericom/GBARunner2/blob/master/arm9/source/save/Save.vram.cpp
-	romPtr += 0xE4 / 4; // Skip headers.
-	if(defaultSave > SAVE_TYPE_NONE)
-		saveType = SAVE_TYPE_NONE;
-	else
-		saveType = defaultSave;
-
-	for(; romPtr < (u32*)(LGY_ROM_LOC + romSize); romPtr++)
+	const u8 strIdx = state->strIdx;
+	if(strIdx != 0xFF)
 	{
-		u32 tmp = *romPtr;
-
-		// "EEPR" "FLAS" "SRAM"
-		if(tmp == 0x52504545u || tmp == 0x53414C46u || tmp == 0x4D415253u)
+		saveType = g_saveTypeLut[strIdx].saveType;
+		if(saveType == SAVE_TYPE_EEPROM_8k || saveType == SAVE_TYPE_EEPROM_64k)
 		{
-			static const struct
-			{
-				const char *str;
-				u16 saveType;
-			} saveTypeLut[25] =
-			{
-				// EEPROM
-				// Assume common sizes for popular games to aid ROM hacks.
-				{"EEPROM_V111", SAVE_TYPE_EEPROM_8k},
-				{"EEPROM_V120", SAVE_TYPE_EEPROM_8k},
-				{"EEPROM_V121", SAVE_TYPE_EEPROM_64k},
-				{"EEPROM_V122", SAVE_TYPE_EEPROM_8k},
-				{"EEPROM_V124", SAVE_TYPE_EEPROM_64k},
-				{"EEPROM_V125", SAVE_TYPE_EEPROM_8k},
-				{"EEPROM_V126", SAVE_TYPE_EEPROM_8k},
-
-				// FLASH
-				// Assume they all have RTC.
-				{"FLASH_V120",    SAVE_TYPE_FLASH_512k_PSC_RTC},
-				{"FLASH_V121",    SAVE_TYPE_FLASH_512k_PSC_RTC},
-				{"FLASH_V123",    SAVE_TYPE_FLASH_512k_PSC_RTC},
-				{"FLASH_V124",    SAVE_TYPE_FLASH_512k_PSC_RTC},
-				{"FLASH_V125",    SAVE_TYPE_FLASH_512k_PSC_RTC},
-				{"FLASH_V126",    SAVE_TYPE_FLASH_512k_PSC_RTC},
-				{"FLASH512_V130", SAVE_TYPE_FLASH_512k_PSC_RTC},
-				{"FLASH512_V131", SAVE_TYPE_FLASH_512k_PSC_RTC},
-				{"FLASH512_V133", SAVE_TYPE_FLASH_512k_PSC_RTC},
-				{"FLASH1M_V102",  SAVE_TYPE_FLASH_1m_MRX_RTC},
-				{"FLASH1M_V103",  SAVE_TYPE_FLASH_1m_MRX_RTC},
-
-				// FRAM & SRAM
-				{"SRAM_F_V100", SAVE_TYPE_SRAM_256k},
-				{"SRAM_F_V102", SAVE_TYPE_SRAM_256k},
-				{"SRAM_F_V103", SAVE_TYPE_SRAM_256k},
-
-				{"SRAM_V110",   SAVE_TYPE_SRAM_256k},
-				{"SRAM_V111",   SAVE_TYPE_SRAM_256k},
-				{"SRAM_V112",   SAVE_TYPE_SRAM_256k},
-				{"SRAM_V113",   SAVE_TYPE_SRAM_256k}
-			};
-
-			for(u32 i = 0; i < 25; i++)
-			{
-				const char *const str = saveTypeLut[i].str;
-				u16 tmpSaveType = saveTypeLut[i].saveType;
-
-				if(memcmp(romPtr, str, strlen(str)) == 0)
-				{
-					if(tmpSaveType == SAVE_TYPE_EEPROM_8k || tmpSaveType == SAVE_TYPE_EEPROM_64k)
-					{
-						// If ROM bigger than 16 MiB --> SAVE_TYPE_EEPROM_8k_2 or SAVE_TYPE_EEPROM_64k_2.
-						if(romSize > 0x1000000) tmpSaveType++;
-					}
-					debug_printf("SDK save string: %s\n"
-					             "saveType: %u\n", str, tmpSaveType);
-					return tmpSaveType;
-				}
-			}
+			// If ROM bigger than 16 MiB --> SAVE_TYPE_EEPROM_8k_2 or SAVE_TYPE_EEPROM_64k_2.
+			if(romSize > 0x1000000) saveType++;
 		}
+		debug_printf("SDK save string: %s\n"
+		             "saveType: %u\n", g_saveTypeLut[strIdx].str, saveType);
+		return saveType;
 	}
 
+	if(defaultSave > SAVE_TYPE_NONE)
+		saveType = SAVE_TYPE_NONE;
+	else
+		saveType = defaultSave;
+
 	debug_printf("saveType: %u\n", saveType);
 	return saveType;
 }
 
+// Legacy headerless gba_db.bin.
 // Search for the entry with first u64 of the SHA1 = x using binary search.
 // Note: Loading the whole db to memory first is still slower.
-static Result searchGbaDb(const u64 x, GbaDbEntry *const db)
+static Result searchGbaDbLegacy(const FHandle f, const u64 x, GbaDbEntry *const db)
 {
-	FHandle f;
-	Result res = fOpen(&f, "gba_db.bin", FA_OPEN_EXISTING | FA_READ);
-	if(res != RES_OK) return res;
-
 	u32 l = 0;
 	u32 r = fSize(f) / sizeof(GbaDbEntry);
 	while(l < r)
@@ -150,18 +297,10 @@ static Result searchGbaDb(const u64 x, GbaDbEntry *const db)
 		const u32 m = l + (r - l) / 2;
 		//debug_printf("l: %" PRIu32 " m: %" PRIu32 " r: %" PRIu32 "\n", l, m, r);
 
-		res = fLseek(f, sizeof(GbaDbEntry) * m);
-		if(res != RES_OK)
-		{
-			fClose(f);
-			return res;
-		}
+		Result res = fLseek(f, sizeof(GbaDbEntry) * m);
+		if(res != RES_OK) return res;
 		res = fRead(f, db, sizeof(GbaDbEntry), NULL);
-		if(res != RES_OK)
-		{
-			fClose(f);
-			return res;
-		}
+		if(res != RES_OK) return res;
 
 		u64 tmp;
 		memcpy(&tmp, db->sha1, 8);
@@ -173,80 +312,171 @@ static Result searchGbaDb(const u64 x, GbaDbEntry *const db)
 		{
 			r = m;
 		}
-		else
+		else return RES_OK;
+	}
+
+	return RES_NOT_FOUND;
+}
+
+// Reads the bucket of all entries starting with the same SHA1 byte.
+// The header is not needed afterwards and doubles as read buffer.
+static Result searchGbaDbBucket(const FHandle f, GbaDbHeader *const header, const u64 x, GbaDbEntry *const db)
+{
+	const u32 bucket = x & 0xFFu; // First SHA1 byte.
+	u32 l = header->fanout[bucket];
+	const u32 r = header->fanout[bucket + 1];
+	if(l >= r) return RES_NOT_FOUND;
+
+	Result res = fLseek(f, sizeof(GbaDbHeader) + sizeof(GbaDbEntry) * l);
+	if(res != RES_OK) return res;
+
+	// Buckets are usually much smaller than the buffer.
+	GbaDbEntry *const entries = (GbaDbEntry*)header;
+	const u32 bufEntries = sizeof(GbaDbHeader) / sizeof(GbaDbEntry);
+	while(l < r)
+	{
+		const u32 num = (r - l < bufEntries ? r - l : bufEntries);
+		res = fRead(f, entries, sizeof(GbaDbEntry) * num, NULL);
+		if(res != RES_OK) return res;
+
+		for(u32 i = 0; i < num; i++)
 		{
-			fClose(f);
-			return RES_OK;
+			u64 tmp;
+			memcpy(&tmp, entries[i].sha1, 8);
+			if(tmp == x)
+			{
+				memcpy(db, &entries[i], sizeof(GbaDbEntry));
+				return RES_OK;
+			}
 		}
+
+		l += num;
+	}
+
+	return RES_NOT_FOUND;
+}
+
+static bool isGbaDbHeaderValid(const GbaDbHeader *const header, const u32 fileSize)
+{
+	if(header->magic != GBA_DB_MAGIC || header->version != GBA_DB_VERSION ||
+	   header->entrySize != sizeof(GbaDbEntry)) return false;
+
+	const u32 numEntries = header->numEntries;
+	if(header->fanout[0] != 0 || header->fanout[256] != numEntries ||
+	   fileSize != sizeof(GbaDbHeader) + sizeof(GbaDbEntry) * numEntries) return false;
+
+	for(u32 i = 0; i < 256; i++)
+	{
+		if(header->fanout[i] > header->fanout[i + 1]) return false;
+	}
+
+	return true;
+}
+
+// Search for the entry with first u64 of the SHA1 = x.
+static Result searchGbaDb(const u64 x, GbaDbEntry *const db)
+{
+	FHandle f;
+	Result res = fOpen(&f, "gba_db.bin", FA_OPEN_EXISTING | FA_READ);
+	if(res != RES_OK) return res;
+
+	// A legacy db is at least as big as the header so this read also works for it.
+	// Legacy dbs never pass the header check because of the file size.
+	GbaDbHeader header;
+	u32 bytesRead;
+	res = fRead(f, &header, sizeof(header), &bytesRead);
+	if(res == RES_OK)
+	{
+		if(bytesRead == sizeof(header) && isGbaDbHeaderValid(&header, fSize(f)))
+			res = searchGbaDbBucket(f, &header, x, db);
+		else
+			res = searchGbaDbLegacy(f, x, db);
 	}
 
 	fClose(f);
 
-	return RES_NOT_FOUND;
+	return res;
 }
 
-u16 getSaveType(const OafConfig *const cfg, const u32 romSize, const char *const savePath)
+u16 getSaveType(const OafConfig *const cfg, const u32 romSize, const u16 autoSaveType, const u64 sha1Prefix,
+                u8 *const dbSaveType, const char *const savePath)
 {
 	FILINFO fi;
 	const bool saveOverride = cfg->saveOverride;
-	const u16 autoSaveType = detectSaveType(romSize, cfg->defaultSave);
 	const bool saveExists = fStat(savePath, &fi) == RES_OK;
 
-	u64 sha1[3];
-	sha((u32*)LGY_ROM_LOC, romSize, (u32*)sha1, SHA_IN_BIG | SHA_1_MODE, SHA_OUT_BIG);
+	// Only search the db if the result is not known already.
+	Result res = RES_OK;
+	u16 saveType = *dbSaveType;
+	if(saveType == GBA_DB_SAVE_UNKNOWN)
+	{
+		GbaDbEntry dbEntry;
+		res = searchGbaDb(sha1Prefix, &dbEntry);
+		if(res == RES_OK) saveType = dbEntry.attr & 0xFu;
+		else if(res == RES_NOT_FOUND) saveType = GBA_DB_SAVE_NOT_FOUND;
+		else
+		{
+			ee_puts("Could not access gba_db.bin! Press any button to continue.");
+			printErrorWaitInput(res, 0);
+			return autoSaveType;
+		}
+		*dbSaveType = saveType;
+	}
 
-	Result res;
-	GbaDbEntry dbEntry;
-	u16 saveType = SAVE_TYPE_NONE;
-	res = searchGbaDb(*sha1, &dbEntry);
-	if(res == RES_OK) saveType = dbEntry.attr & 0xFu;
-	else if(!saveOverride && res == RES_NOT_FOUND) return autoSaveType;
-	else if(res != RES_NOT_FOUND)
+	if(saveType == GBA_DB_SAVE_NOT_FOUND)
 	{
-		ee_puts("Could not access gba_db.bin! Press any button to continue.");
-		printErrorWaitInput(res, 0);
-		return autoSaveType;
+		if(!saveOverride) return autoSaveType;
+		res = RES_NOT_FOUND;
+		saveType = SAVE_TYPE_NONE;
 	}
 	debug_printf("saveType: %u\n", saveType);
 
 	if(!saveOverride) goto end;
 
-	consoleClear();
-	ee_printf("==Save Type Override Menu==\n"
-	          "Save file: %s\n"
-	          "Save type (autodetected): %u\n"
-			  "Save type (from gba_db.bin): ", (saveExists ? "Found" : "Not found"), autoSaveType);
-	if(res == RES_NOT_FOUND)
-		ee_puts("Not found");
-	else
-		ee_printf("%u\n", saveType);
-	ee_puts("\n"
-	        "=Save Types=\n"
-	        " EEPROM 8k (0, 1)\n"
-	        " EEPROM 64k (2, 3)\n"
-	        " Flash 512k RTC (4, 6, 8)\n"
-	        " Flash 512k (5, 7, 9)\n"
-	        " Flash 1m RTC (10, 12)\n"
-	        " Flash 1m (11, 13)\n"
-	        " SRAM 256k (14)\n"
-	        " None (15)\n\n"
-	        "=Controls=\n"
-	        "Up/Down: Navigate\n"
-	        "A: Select\n"
-	        "X: Delete save file");
+	static const char *const menuLines[] =
+	{
+		"=Save Types=",
+		" EEPROM 8k (0, 1)",
+		" EEPROM 64k (2, 3)",
+		" Flash 512k RTC (4, 6, 8)",
+		" Flash 512k (5, 7, 9)",
+		" Flash 1m RTC (10, 12)",
+		" Flash 1m (11, 13)",
+		" SRAM 256k (14)",
+		" None (15)",
+		"",
+		"=Controls=",
+		"Up/Down: Navigate",
+		"A: Select",
+		"X: Delete save file"
+	};
+	char autoLine[32];
+	char dbLine[48];
+	ee_sprintf(autoLine, "Save type (autodetected): %u", autoSaveType);
+	if(res == RES_NOT_FOUND) ee_sprintf(dbLine, "Save type (from gba_db.bin): Not found");
+	else                     ee_sprintf(dbLine, "Save type (from gba_db.bin): %u", saveType);
+	const char *saveFileStr = (saveExists ? "Found" : "Not found");
 
 	static const u8 saveTypeCursorLut[16] = {0, 0, 1, 1, 2, 3, 2, 3, 2, 3, 4, 5, 4, 5, 6, 7};
-	u8 oldCursor = 0;
 	u8 cursor;
 	if(!cfg->useGbaDb || res == RES_NOT_FOUND)
 		cursor = saveTypeCursorLut[autoSaveType];
 	else
 		cursor = saveTypeCursorLut[saveType];
+
+	tgClear();
 	while(1)
 	{
-		ee_printf("\x1b[%u;H ", oldCursor + 7);
-		ee_printf("\x1b[%u;H>", cursor + 7);
-		oldCursor = cursor;
+		// Only the changed cells are sent to the console.
+		tgBeginFrame();
+		tgPrint(0, 0, TG_WHITE, "==Save Type Override Menu==");
+		tgPrint(1, 0, TG_WHITE, "Save file: ");
+		tgPrint(1, 11, TG_WHITE, saveFileStr);
+		tgPrint(2, 0, TG_WHITE, autoLine);
+		tgPrint(3, 0, TG_WHITE, dbLine);
+		for(u32 i = 0; i < sizeof(menuLines) / sizeof(*menuLines); i++) tgPrint(5 + i, 0, TG_WHITE, menuLines[i]);
+		tgPrint(6 + cursor, 0, TG_WHITE, ">");
+		tgPresent();
 		GFX_flushBuffers();
 
 		u32 kDown;
@@ -264,7 +494,7 @@ u16 getSaveType(const OafConfig *const cfg, const u32 romSize, const char *const
 		else if(kDown & KEY_X)
 		{
 			fUnlink(savePath);
-			ee_printf("\x1b[1;11HDeleted  ");
+			saveFileStr = "Deleted";
 		}
 		else if(kDown & KEY_A) break;
 	}
@@ -0,0 +1,157 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "arm11/screenshot.h"
+#include "arm11/png.h"
+#include "arm11/fmt.h"
+#include "oaf_error_codes.h"
+#include "fsutil.h"
+#include "kernel.h"
+#include "kevent.h"
+
+
+#define FRAME_SIZE  (SCREENSHOT_WIDTH * SCREENSHOT_HEIGHT * 2)
+
+
+typedef struct
+{
+	KHandle dataEvent;
+	KHandle doneEvent;
+	u16 *frame;
+	void (*volatile job)(void); // Set by screenshotQueueJob(), cleared by the writer.
+	volatile bool busy;         // Set by submit, cleared by the writer.
+	volatile bool quit;
+	char path[40];
+} ScreenshotWriter;
+
+static ScreenshotWriter g_writer = {0};
+
+
+
+// Runs at the lowest priority so SD latency never stalls the gfx handler.
+static void screenshotWriter(UNUSED void *args)
+{
+	ScreenshotWriter *const w = &g_writer;
+
+	while(1)
+	{
+		waitForEvent(w->dataEvent);
+		clearEvent(w->dataEvent);
+
+		if(w->busy)
+		{
+			// Only allocated while encoding. Most sessions never take a screenshot.
+			Result res = RES_OUT_OF_MEM;
+			u8 *const png = (u8*)malloc(pngMaxSize(SCREENSHOT_WIDTH, SCREENSHOT_HEIGHT));
+			if(png != NULL)
+			{
+				const u32 size = pngEncodeA1bgr5(w->frame, SCREENSHOT_WIDTH, SCREENSHOT_HEIGHT, png);
+				res = fsQuickWrite(w->path, png, size);
+				free(png);
+			}
+			if(res != RES_OK) ee_printf("Failed to write screenshot: %s\n", result2String(res));
+
+			w->busy = false;
+		}
+
+		// Other file writes during gameplay run here so they can't overlap a screenshot.
+		void (*const job)(void) = w->job;
+		if(job != NULL)
+		{
+			job();
+			w->job = NULL;
+		}
+
+		// Pending work is finished first.
+		if(w->quit) break;
+	}
+
+	signalEvent(w->doneEvent, false);
+	taskExit();
+}
+
+Result screenshotInit(void)
+{
+	ScreenshotWriter *const w = &g_writer;
+	if(w->frame != NULL) return RES_OK;
+
+	w->job = NULL;
+	w->busy = false;
+	w->quit = false;
+	w->frame = (u16*)malloc(FRAME_SIZE);
+	w->dataEvent = createEvent(false);
+	w->doneEvent = createEvent(false);
+	if(w->frame == NULL || w->dataEvent == 0 || w->doneEvent == 0 ||
+	   createTask(0x800, 1, screenshotWriter, NULL) == 0)
+	{
+		// The writer never started so nobody else owns these.
+		if(w->dataEvent != 0) deleteEvent(w->dataEvent);
+		if(w->doneEvent != 0) deleteEvent(w->doneEvent);
+		free(w->frame);
+		memset(w, 0, sizeof(ScreenshotWriter));
+
+		return RES_OUT_OF_MEM;
+	}
+
+	return RES_OK;
+}
+
+void screenshotExit(void)
+{
+	ScreenshotWriter *const w = &g_writer;
+	if(w->frame == NULL) return;
+
+	// A pending screenshot is finished first so the file
+	// system is idle before it gets unmounted.
+	w->quit = true;
+	signalEvent(w->dataEvent, false);
+	waitForEvent(w->doneEvent);
+
+	deleteEvent(w->dataEvent);
+	deleteEvent(w->doneEvent);
+	free(w->frame);
+	memset(w, 0, sizeof(ScreenshotWriter));
+}
+
+bool screenshotSubmit(const u16 *const frame, const char *const path)
+{
+	ScreenshotWriter *const w = &g_writer;
+	if(w->frame == NULL || w->busy) return false;
+
+	memcpy(w->frame, frame, FRAME_SIZE);
+	strncpy(w->path, path, sizeof(w->path) - 1);
+	w->path[sizeof(w->path) - 1] = '\0';
+	w->busy = true;
+	signalEvent(w->dataEvent, false);
+
+	return true;
+}
+
+bool screenshotQueueJob(void (*const job)(void))
+{
+	ScreenshotWriter *const w = &g_writer;
+	if(w->frame == NULL || w->job != NULL) return false;
+
+	w->job = job;
+	signalEvent(w->dataEvent, false);
+
+	return true;
+}
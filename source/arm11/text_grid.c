@@ -0,0 +1,156 @@
+/*
+ *   This file is part of open_agb_firm
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "types.h"
+#include "arm11/text_grid.h"
+#include "arm11/fmt.h"
+
+
+typedef struct
+{
+	char text[TG_ROWS][TG_COLS];
+	u8 color[TG_ROWS][TG_COLS];
+} TextFrame;
+
+static TextFrame g_shown;          // What is on the console.
+static TextFrame g_next;           // Frame being built.
+static u8 g_conColor = 0xFF;       // Current console color. 0xFF = unknown.
+static u32 g_conPos = UINT32_MAX;  // Console cursor row<<8 | col. UINT32_MAX = unknown.
+
+
+
+static void clearFrame(TextFrame *const frame)
+{
+	memset(frame->text, ' ', sizeof(frame->text));
+	memset(frame->color, TG_WHITE, sizeof(frame->color));
+}
+
+void tgClear(void)
+{
+	ee_printf("\x1b[2J");
+	clearFrame(&g_shown);
+	clearFrame(&g_next);
+	g_conColor = 0xFF;
+	g_conPos   = UINT32_MAX;
+}
+
+void tgBeginFrame(void)
+{
+	clearFrame(&g_next);
+}
+
+void tgPrint(const u32 row, const u32 col, const u8 color, const char *str)
+{
+	if(row >= TG_ROWS) return;
+
+	char *const text = g_next.text[row];
+	u8 *const colors = g_next.color[row];
+	for(u32 i = col; i < TG_COLS && *str != '\0'; i++)
+	{
+		text[i]   = *str++;
+		colors[i] = color;
+	}
+}
+
+static bool rowsDiffer(const u32 a, const u32 b)
+{
+	return memcmp(g_shown.text[a], g_shown.text[b], TG_COLS) != 0 ||
+	       memcmp(g_shown.color[a], g_shown.color[b], TG_COLS) != 0;
+}
+
+static bool isBlankRow(const u32 row)
+{
+	for(u32 col = 0; col < TG_COLS; col++)
+		if(g_shown.text[row][col] != ' ') return false;
+
+	return true;
+}
+
+void tgScrollUp(const u32 top, const u32 bottom)
+{
+	if(top + 1 >= bottom || bottom > TG_ROWS) return;
+
+	// The console can only scroll the whole screen. A newline on the last row does it.
+	// Rows outside of [top, bottom) that change by scrolling must be redrawn
+	// afterwards. Only scroll if that's less work than redrawing the region.
+	u32 redraw = 0;
+	for(u32 row = 0; row < top; row++) redraw += rowsDiffer(row, row + 1);
+	for(u32 row = bottom; row < TG_ROWS - 1; row++) redraw += rowsDiffer(row, row + 1);
+	if(bottom < TG_ROWS) redraw += !isBlankRow(TG_ROWS - 1);
+	if(redraw >= bottom - top - 1) return;
+
+	ee_printf("\x1b[%lu;1H\n", TG_ROWS);
+	g_conPos = (TG_ROWS - 1)<<8;
+	memmove(g_shown.text[0], g_shown.text[1], sizeof(g_shown.text[0]) * (TG_ROWS - 1));
+	memmove(g_shown.color[0], g_shown.color[1], sizeof(g_shown.color[0]) * (TG_ROWS - 1));
+	memset(g_shown.text[TG_ROWS - 1], ' ', TG_COLS);
+	memset(g_shown.color[TG_ROWS - 1], TG_WHITE, TG_COLS);
+}
+
+void tgPresent(void)
+{
+	// Worst case: position + a color change for every cell.
+	char buf[16 + TG_COLS * 12];
+	for(u32 row = 0; row < TG_ROWS; row++)
+	{
+		const char *const text = g_next.text[row];
+		const u8 *const colors = g_next.color[row];
+		char *const shownText = g_shown.text[row];
+		u8 *const shownColors = g_shown.color[row];
+
+		// Find the changed span of the row. Blank cells don't care about their color.
+		u32 first = TG_COLS;
+		u32 last = 0;
+		for(u32 col = 0; col < TG_COLS; col++)
+		{
+			if(text[col] != shownText[col] || (text[col] != ' ' && colors[col] != shownColors[col]))
+			{
+				if(first == TG_COLS) first = col;
+				last = col;
+			}
+		}
+		if(first == TG_COLS) continue;
+
+		// Skip moving the cursor if it's already there or a newline does it.
+		u32 pos = 0;
+		if(g_conPos != (row<<8 | first))
+		{
+			if(first == 0 && g_conPos != UINT32_MAX && g_conPos>>8 == row - 1) buf[pos++] = '\n';
+			else pos = ee_sprintf(buf, "\x1b[%lu;%luH", row + 1, first + 1);
+		}
+		u8 curColor = g_conColor;
+		for(u32 col = first; col <= last; col++)
+		{
+			const u8 color = colors[col];
+			if(color != curColor && text[col] != ' ')
+			{
+				pos += ee_sprintf(&buf[pos], "\x1b[0;3%u%sm", color & 7u, (color & 8u ? ";1" : ""));
+				curColor = color;
+			}
+			buf[pos++] = text[col];
+		}
+		buf[pos] = '\0';
+		ee_printf("%s", buf);
+		g_conColor = curColor;
+		g_conPos   = row<<8 | (last + 1);
+
+		memcpy(shownText, text, TG_COLS);
+		memcpy(shownColors, colors, TG_COLS);
+	}
+}
@@ -30,7 +30,8 @@ const char* oafResult2String(Result res)
 	static const char *const oafResultStrings[] =
 	{
 		"ROM too big. Max 32 MiB",
-		"Invalid patch file"
+		"Invalid patch file",
+		"Patched ROM checksum mismatch"
 	};
 
 	return (res < CUSTOM_ERR_OFFSET ? result2String(res) : oafResultStrings[res - CUSTOM_ERR_OFFSET]);
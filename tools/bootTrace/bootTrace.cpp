@@ -0,0 +1,196 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "arm11/boot_trace.h"
+#include "arm11/gfx_stats.h"
+
+
+#define BUF_SIZE  (32 + TRACE_MAX_EVENTS * (32 + 64)) // Same as traceDump().
+
+
+struct Event
+{
+	std::string name;
+	char phase;
+	u32 ts;
+};
+
+
+
+// Names are stored as pointers so they need to outlive the trace.
+static const char *eventName(const u32 i)
+{
+	static char names[512][32];
+	snprintf(names[i], sizeof(names[0]), "event%" PRIu32, i);
+	return names[i];
+}
+
+// Independent of traceTicksToUs().
+static u32 refUs(const u32 ticks)
+{
+	return (u32)((unsigned __int128)ticks * 64 * 1000000 / 268111856);
+}
+
+// Strict parser for the exact layout traceSerialize() writes.
+static bool parseTrace(const char *const json, const u32 len, std::vector<Event> &events)
+{
+	events.clear();
+	if(strlen(json) != len) return false;
+
+	static const char head[] = "{\"traceEvents\":[\n";
+	if(strncmp(json, head, sizeof(head) - 1) != 0) return false;
+	const char *p = json + sizeof(head) - 1;
+
+	bool last = false;
+	while(strcmp(p, "]}\n") != 0)
+	{
+		if(last) return false; // Event after one without comma.
+
+		char name[64], phase[2];
+		u32 ts;
+		int used = 0;
+		if(sscanf(p, "{\"name\":\"%63[^\"]\",\"ph\":\"%1[BE]\",\"ts\":%" SCNu32 ",\"pid\":0,\"tid\":0}%n",
+		          name, phase, &ts, &used) != 3 || used == 0) return false;
+		p += used;
+		if(*p == ',') p++;
+		else last = true;
+		if(*p++ != '\n') return false;
+
+		events.push_back({name, phase[0], ts});
+	}
+
+	return (last || events.empty());
+}
+
+// Records n events 1000 + i ticks apart and checks the serialized window.
+static void checkRun(const char *const name, const u32 n, const u32 startTicks = 0)
+{
+	traceInit();
+	g_hostTicks = startTicks;
+
+	std::vector<Event> ref;
+	for(u32 i = 0; i < n; i++)
+	{
+		g_hostTicks += 1000 + i;
+		const char phase = (i & 1 ? 'E' : 'B');
+		traceEvent(eventName(i), phase);
+		ref.push_back({eventName(i), phase, refUs(g_hostTicks)});
+	}
+	if(ref.size() > TRACE_MAX_EVENTS) ref.erase(ref.begin(), ref.end() - TRACE_MAX_EVENTS);
+
+	std::vector<char> buf(BUF_SIZE);
+	const u32 len = traceSerialize(buf.data(), BUF_SIZE);
+	std::vector<Event> events;
+	bool ok = parseTrace(buf.data(), len, events) && events.size() == ref.size();
+	for(size_t i = 0; ok && i < ref.size(); i++)
+	{
+		ok = events[i].name == ref[i].name && events[i].phase == ref[i].phase && events[i].ts == ref[i].ts;
+	}
+	check(name, ok);
+}
+
+static void testSerialize(void)
+{
+	g_hostTicks = 1234;
+	traceInit();
+	check("traceInit() resets the clock", g_hostTicks == 0);
+
+	checkRun("Empty trace", 0);
+	checkRun("1 event", 1);
+	checkRun("127 events", TRACE_MAX_EVENTS - 1);
+	checkRun("128 events fill the ring", TRACE_MAX_EVENTS);
+	checkRun("129 events drop the oldest", TRACE_MAX_EVENTS + 1);
+	checkRun("300 events keep the last 128 in order", 300);
+	checkRun("Large tick values convert without overflow", 200, 0xFFF00000u);
+
+	// Worst case: longest names and 10 digit timestamps must fit the buffer.
+	static const char longName[] = "0123456789012345678901234567890";
+	traceInit();
+	for(u32 i = 0; i < TRACE_MAX_EVENTS; i++)
+	{
+		g_hostTicks = 0xFFFFFFFFu;
+		traceEvent(longName, 'B');
+	}
+	std::vector<char> buf(BUF_SIZE + 1, '\xAA');
+	const u32 len = traceSerialize(buf.data(), BUF_SIZE);
+	std::vector<Event> events;
+	check("Worst case fits the buffer",
+	      len > 0 && len < BUF_SIZE && buf[BUF_SIZE] == '\xAA' && parseTrace(buf.data(), len, events) &&
+	      events.size() == TRACE_MAX_EVENTS);
+	check("Too small buffer returns 0", traceSerialize(buf.data(), BUF_SIZE - 1) == 0);
+
+	check("traceTicksToUs() of 1 s", traceTicksToUs(TRACE_CPU_HZ / TRACE_TICK_DIV) == refUs(TRACE_CPU_HZ / TRACE_TICK_DIV));
+}
+
+static void testDump(void)
+{
+	traceInit();
+	for(u32 i = 0; i < 10; i++)
+	{
+		g_hostTicks += 4189; // About 1 ms.
+		traceEvent(eventName(i), (i & 1 ? 'E' : 'B'));
+	}
+	std::vector<char> buf(BUF_SIZE);
+	const u32 len = traceSerialize(buf.data(), BUF_SIZE);
+
+	hostFsResetStats();
+	const Result res = traceDump("boot_trace.json");
+	std::vector<char> file(BUF_SIZE);
+	FILE *const f = fopen(hostFsPath("boot_trace.json"), "rb");
+	const size_t read = (f != NULL ? fread(file.data(), 1, BUF_SIZE, f) : 0);
+	if(f != NULL) fclose(f);
+	check("traceDump() writes the serialized trace", res == RES_OK && read == len && memcmp(file.data(), buf.data(), len) == 0);
+	check("traceDump() is a single write", g_hostFsStats.writes == 1 && hostFsOpenHandles() == 0);
+}
+
+static void testGfxStamp(void)
+{
+	g_hostTicks = 12345;
+	GFXSTATS_STAMP(GFX_STAMP_SUBMIT);
+	check("GFXSTATS_STAMP() reads the host clock", g_gfxStamps[GFX_STAMP_SUBMIT] == 12345);
+}
+
+int main(const int argc, char *const argv[])
+{
+	if(argc != 2 || strcmp(argv[1], "test") != 0)
+	{
+		printf("Usage: %s test\n"
+		       "Checks the trace ring buffer wraparound and Chrome\n"
+		       "trace JSON output with a fake cycle counter.\n",
+		       argv[0]);
+		return 1;
+	}
+
+	if(hostTestDirCreate("bootTrace") == NULL) return 1;
+
+	testSerialize();
+	testDump();
+	testGfxStamp();
+
+	hostTestDirRemove();
+
+	return hostTestResult();
+}
@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# Builds boot_trace.c and gfx_stats.c unmodified against ../hostStubs.
+# TRACE_HOST_CLOCK replaces the CP15 cycle counter with g_hostTicks.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+
+rm ./bootTrace
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DTRACE_HOST_CLOCK $INCLUDES -c ../hostStubs/hostStubs.c ../../source/arm11/boot_trace.c ../../source/arm11/gfx_stats.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DTRACE_HOST_CLOCK $INCLUDES -Wl,--gc-sections ./bootTrace.cpp ./hostStubs.o ./boot_trace.o ./gfx_stats.o -lpthread -o ./bootTrace
+rm ./*.o
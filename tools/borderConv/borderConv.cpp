@@ -0,0 +1,262 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "lodepng.h"
+
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+
+
+// See include/arm11/border.h.
+#define BORDER_MAGIC     (0x52445242u) // "BRDR"
+#define BORDER_VERSION   (1u)
+#define FB_WIDTH         (240u) // Framebuffer layout. The screen is rotated.
+#define FB_HEIGHT        (400u)
+#define BORDER_RAW_SIZE  (FB_WIDTH * FB_HEIGHT * 3)
+#define BENCH_RUNS       (100u)
+
+typedef struct
+{
+	u32 magic;
+	u16 version;
+	u16 reserved;
+	u32 rawSize;
+	u32 dataSize;
+} BorderHeader;
+static_assert(sizeof(BorderHeader) == 16);
+
+
+
+static bool loadPng(const char *const path, u8 *const fb)
+{
+	unsigned char *inBuf;
+	u32 width, height;
+	u32 lpngErr;
+	if((lpngErr = lodepng_decode24_file(&inBuf, &width, &height, path)))
+	{
+		fprintf(stderr, "lodepng error: %s\n", lodepng_error_text(lpngErr));
+		return false;
+	}
+
+	if(width != FB_HEIGHT || height != FB_WIDTH)
+	{
+		fputs("Error: Border must be 400x240.\n", stderr);
+		free(inBuf);
+		return false;
+	}
+
+	// Rotate RGB into the BGR8 framebuffer layout (same as border.bgr).
+	for(u32 y = 0; y < height; y++)
+	{
+		for(u32 x = 0; x < width; x++)
+		{
+			const u8 *const src = &inBuf[(y * width + x) * 3];
+			u8 *const dst = &fb[(x * FB_WIDTH + (FB_WIDTH - 1 - y)) * 3];
+			dst[0] = src[2];
+			dst[1] = src[1];
+			dst[2] = src[0];
+		}
+	}
+	free(inBuf);
+
+	return true;
+}
+
+static bool loadBgr(const char *const path, u8 *const fb)
+{
+	FILE *const f = fopen(path, "rb");
+	if(f == nullptr)
+	{
+		fprintf(stderr, "Error: Can't open \"%s\".\n", path);
+		return false;
+	}
+
+	const size_t read = fread(fb, 1, BORDER_RAW_SIZE, f);
+	const bool trailing = fgetc(f) != EOF;
+	fclose(f);
+	if(read != BORDER_RAW_SIZE || trailing)
+	{
+		fputs("Error: .bgr borders must be exactly 288000 bytes.\n", stderr);
+		return false;
+	}
+
+	return true;
+}
+
+// Same layout GX_displayTransfer() produces with PPF_OUT_TILED:
+// 8x8 tiles in rows, pixels inside a tile in Morton order.
+static void tileFramebuffer(const u8 *const linear, u8 *const tiled)
+{
+	for(u32 y = 0; y < FB_HEIGHT; y++)
+	{
+		for(u32 x = 0; x < FB_WIDTH; x++)
+		{
+			u32 morton = 0;
+			for(u32 b = 0; b < 3; b++)
+				morton |= ((x>>b & 1u)<<(2 * b)) | ((y>>b & 1u)<<(2 * b + 1));
+
+			const u32 dstIdx = (y & ~7u) * FB_WIDTH + (x & ~7u) * 8 + morton;
+			memcpy(&tiled[dstIdx * 3], &linear[(y * FB_WIDTH + x) * 3], 3);
+		}
+	}
+}
+
+static u32 runLength(const u8 *const pixels, const u32 pos, const u32 numPixels)
+{
+	u32 len = 1;
+	while(len < 128 && pos + len < numPixels &&
+	      memcmp(&pixels[pos * 3], &pixels[(pos + len) * 3], 3) == 0) len++;
+
+	return len;
+}
+
+static std::vector<u8> compress(const u8 *const pixels)
+{
+	const u32 numPixels = BORDER_RAW_SIZE / 3;
+	std::vector<u8> out;
+	u32 pos = 0;
+	while(pos < numPixels)
+	{
+		const u32 run = runLength(pixels, pos, numPixels);
+		if(run >= 2)
+		{
+			out.push_back(0x80u | (run - 1));
+			out.insert(out.end(), &pixels[pos * 3], &pixels[(pos + 1) * 3]);
+			pos += run;
+			continue;
+		}
+
+		// Literals until the next run or 128 pixels.
+		u32 lits = 1;
+		while(lits < 128 && pos + lits < numPixels && runLength(pixels, pos + lits, numPixels) < 2) lits++;
+		out.push_back(lits - 1);
+		out.insert(out.end(), &pixels[pos * 3], &pixels[(pos + lits) * 3]);
+		pos += lits;
+	}
+
+	return out;
+}
+
+// Same as borderDecode() in source/arm11/border.c.
+static bool decompress(const u8 *in, const u8 *const inEnd, u8 *dst)
+{
+	u8 *const dstEnd = dst + BORDER_RAW_SIZE;
+	while(in < inEnd)
+	{
+		const u32 ctrl = *in++;
+		const u32 pixels = (ctrl & 0x7Fu) + 1;
+		const u32 bytes = pixels * 3;
+		if((u32)(dstEnd - dst) < bytes) return false;
+
+		if(ctrl & 0x80u)
+		{
+			if(inEnd - in < 3) return false;
+
+			for(u32 i = 0; i < pixels; i++, dst += 3) memcpy(dst, in, 3);
+			in += 3;
+		}
+		else
+		{
+			if((u32)(inEnd - in) < bytes) return false;
+
+			memcpy(dst, in, bytes);
+			in += bytes;
+			dst += bytes;
+		}
+	}
+
+	return dst == dstEnd;
+}
+
+// Compile with "./compile.sh" (needs the lodepng submodule in tools/lgyFbScaler).
+int main(int argc, char const *argv[])
+{
+	if(argc != 3)
+	{
+		fputs("Usage: borderConv <border.png|border.bgr> <border.rle>\n", stderr);
+		return 1;
+	}
+
+	std::unique_ptr<u8[]> linear(new(std::nothrow) u8[BORDER_RAW_SIZE]);
+	std::unique_ptr<u8[]> tiled(new(std::nothrow) u8[BORDER_RAW_SIZE]);
+	std::unique_ptr<u8[]> check(new(std::nothrow) u8[BORDER_RAW_SIZE]);
+	if(!linear || !tiled || !check)
+	{
+		fputs("Error: Out of memory.\n", stderr);
+		return 2;
+	}
+
+	const size_t pathLen = strlen(argv[1]);
+	const bool isBgr = pathLen >= 4 && strcmp(&argv[1][pathLen - 4], ".bgr") == 0;
+	if(!(isBgr ? loadBgr(argv[1], linear.get()) : loadPng(argv[1], linear.get()))) return 3;
+
+	tileFramebuffer(linear.get(), tiled.get());
+	const std::vector<u8> data = compress(tiled.get());
+
+	// The firmware reads the file into a framebuffer sized buffer.
+	const u32 fileSize = sizeof(BorderHeader) + data.size();
+	if(fileSize > BORDER_RAW_SIZE)
+	{
+		fputs("Error: Border doesn't compress. Use a raw border.bgr instead.\n", stderr);
+		return 4;
+	}
+
+	// Verify and time the decoder against a plain copy of the raw border.
+	const auto start = std::chrono::steady_clock::now();
+	bool ok = true;
+	for(u32 i = 0; i < BENCH_RUNS; i++) ok &= decompress(data.data(), data.data() + data.size(), check.get());
+	const auto mid = std::chrono::steady_clock::now();
+	for(u32 i = 0; i < BENCH_RUNS; i++)
+	{
+		memcpy(check.get(), tiled.get(), BORDER_RAW_SIZE);
+		asm volatile("" : : "r"(check.get()) : "memory");
+	}
+	const auto end = std::chrono::steady_clock::now();
+	if(!ok || !decompress(data.data(), data.data() + data.size(), check.get()) ||
+	   memcmp(check.get(), tiled.get(), BORDER_RAW_SIZE) != 0)
+	{
+		fputs("Error: Decoder self test failed.\n", stderr);
+		return 5;
+	}
+
+	const BorderHeader header = {BORDER_MAGIC, BORDER_VERSION, 0, BORDER_RAW_SIZE, (u32)data.size()};
+	FILE *const f = fopen(argv[2], "wb");
+	if(f == nullptr || fwrite(&header, sizeof(header), 1, f) != 1 ||
+	   fwrite(data.data(), 1, data.size(), f) != data.size())
+	{
+		fprintf(stderr, "Error: Can't write \"%s\".\n", argv[2]);
+		if(f != nullptr) fclose(f);
+		return 6;
+	}
+	fclose(f);
+
+	const double decodeUs = std::chrono::duration<double, std::micro>(mid - start).count() / BENCH_RUNS;
+	const double copyUs   = std::chrono::duration<double, std::micro>(end - mid).count() / BENCH_RUNS;
+	printf("Bytes read: %" PRIu32 " (raw %" PRIu32 ", %.1f%%)\nDecode: %.1f us (raw copy %.1f us)\n",
+	       fileSize, BORDER_RAW_SIZE, 100.0 * fileSize / BORDER_RAW_SIZE, decodeUs, copyUs);
+
+	return 0;
+}
@@ -0,0 +1,4 @@
+#!/bin/bash
+
+rm ./borderConv
+g++ -std=c++17 -s -flto -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -I../lgyFbScaler/lodepng -Wl,--gc-sections ../lgyFbScaler/lodepng/lodepng.cpp ./borderConv.cpp -o ./borderConv
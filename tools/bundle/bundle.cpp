@@ -0,0 +1,433 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "fs.h"
+#include "fsutil.h"
+#include "arm11/border.h"
+#include "arm11/bundle.h"
+
+
+#define MATRIX_SIZE  (6u * 8 * 2 * 2) // s16 matrix[6 * 8 * 2] in oaf_video.c.
+#define HEADER_SIZE  (16u)
+#define ENTRY_SIZE   (32u)
+
+
+// One boot asset in the loose and bundled version.
+struct Asset
+{
+	const char *name;
+	std::string loose;
+	std::string bundled;
+};
+
+
+
+extern "C"
+{
+// Boot assets are read into buffers bigger than the file. Short reads are fine there.
+Result __wrap_fsQuickRead(const char *const path, void *const buf, u32 size)
+{
+	FHandle f;
+	Result res = fOpen(&f, path, FA_OPEN_EXISTING | FA_READ);
+	if(res != RES_OK) return res;
+
+	res = fRead(f, buf, size, NULL);
+	fClose(f);
+
+	return res;
+}
+}
+
+
+
+static std::string g_tmpDir;
+static u32 g_rng = 0x424E444Cu;
+static std::vector<Asset> g_assets;
+
+static u32 rnd(void)
+{
+	// xorshift32.
+	g_rng ^= g_rng<<13;
+	g_rng ^= g_rng>>17;
+	g_rng ^= g_rng<<5;
+	return g_rng;
+}
+
+static std::string hostPath(const std::string &path)
+{
+	return hostFsPath(path.c_str());
+}
+
+static std::string readFile(const std::string &path)
+{
+	std::string data;
+	FILE *const f = fopen(hostPath(path).c_str(), "rb");
+	if(f == NULL) return data;
+
+	char buf[4096];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0) data.append(buf, n);
+	fclose(f);
+
+	return data;
+}
+
+static void writeFile(const std::string &path, const std::string &data)
+{
+	FILE *const f = fopen(hostPath(path).c_str(), "wb");
+	if(f == NULL || fwrite(data.data(), 1, data.size(), f) != data.size() || fclose(f) != 0) hostTestFail();
+}
+
+static std::string randomData(const u32 size)
+{
+	std::string data(size, '\0');
+	for(char &c : data) c = rnd();
+	return data;
+}
+
+// Runs bundle.py. args are file[=name] pairs relative to the work dir.
+static bool pack(const std::string &out, const std::vector<std::string> &args)
+{
+	std::string cmd = "python3 ./bundle.py '" + hostPath(out) + "'";
+	for(const std::string &arg : args)
+	{
+		const size_t eq = arg.find('=');
+		cmd += " '" + hostPath(arg.substr(0, eq)) + (eq != std::string::npos ? arg.substr(eq) : "") + "'";
+	}
+
+	return system((cmd + " >/dev/null 2>&1").c_str()) == 0;
+}
+
+// Packs the bundled versions of all boot assets.
+static bool packAssets(const char *const skip = NULL)
+{
+	std::vector<std::string> args;
+	for(const Asset &a : g_assets)
+	{
+		if(skip != NULL && strcmp(a.name, skip) == 0) continue;
+		writeFile(std::string("src/") + a.name, a.bundled);
+		args.push_back(std::string("src/") + a.name + "=" + a.name);
+	}
+
+	return pack(OAF_BUNDLE_PATH, args);
+}
+
+// The asset reads of oafInitAndRun() and OAF_videoInit() in boot order.
+static std::vector<std::string> bootReads(void)
+{
+	std::vector<std::string> out;
+	std::vector<char> buf(BORDER_RAW_SIZE + 1, '\0');
+
+	// parseOafConfig().
+	if(bundleQuickRead("config.ini", buf.data(), 1023) == RES_OK) out.push_back(buf.data());
+	else out.push_back("");
+
+	char path[512];
+	out.push_back(bundleLoadPathFromFile("autoboot.txt", path) == RES_OK ? path : "");
+
+	std::fill(buf.begin(), buf.end(), '\0');
+	if(bundleQuickRead("gba_scaler_matrix.bin", buf.data(), MATRIX_SIZE) == RES_OK) out.push_back(std::string(buf.data(), MATRIX_SIZE));
+	else out.push_back("");
+
+	u32 size;
+	if(bundleRead(BORDER_RLE_PATH, buf.data(), BORDER_RAW_SIZE, &size) == RES_OK) out.push_back(std::string(buf.data(), size));
+	else out.push_back("");
+
+	return out;
+}
+
+static bool sameAssets(const std::vector<std::string> &read, const bool bundled)
+{
+	for(u32 i = 0; i < g_assets.size(); i++)
+	{
+		std::string want = (bundled ? g_assets[i].bundled : g_assets[i].loose);
+		if(i == 1) want = want.substr(0, want.find_first_of("\r\n")); // autoboot.txt
+		if(read[i] != want) return false;
+	}
+
+	return true;
+}
+
+static void makeAssets(void)
+{
+	g_assets.push_back({"config.ini", "[general]\nbacklight=20\n", "[general]\nbacklight=10\nuseGbaDb=false\n"});
+	g_assets.push_back({"autoboot.txt", "sdmc:/roms/loose.gba\n", "sdmc:/roms/bundled.gba\r\nextra line"});
+	g_assets.push_back({"gba_scaler_matrix.bin", randomData(MATRIX_SIZE), randomData(MATRIX_SIZE)});
+	g_assets.push_back({BORDER_RLE_PATH, randomData(3000), randomData(5000)});
+	for(const Asset &a : g_assets) writeFile(a.name, a.loose);
+}
+
+static void testBoot(void)
+{
+	check("bundle.py packs the boot assets", packAssets());
+
+	hostFsResetStats();
+	const bool opened = bundleOpen(OAF_BUNDLE_PATH) == RES_OK;
+	std::vector<std::string> read = bootReads();
+	bundleClose();
+	check("Bundled boot reads the bundled assets", opened && sameAssets(read, true));
+	check("  ...with 1 open, 6 reads and 4 seeks", g_hostFsStats.opens == 1 && g_hostFsStats.reads == 6 &&
+	      g_hostFsStats.seeks == 4);
+	check("  ...and closes the bundle", hostFsOpenHandles() == 0);
+
+	unlink(hostPath(OAF_BUNDLE_PATH).c_str());
+	hostFsResetStats();
+	const Result res = bundleOpen(OAF_BUNDLE_PATH);
+	read = bootReads();
+	bundleClose();
+	check("Without a bundle the loose files are read", res == RES_FR_NO_FILE && sameAssets(read, false));
+	check("  ...with 5 opens and 4 reads", g_hostFsStats.opens == 5 && g_hostFsStats.reads == 4);
+
+	// Missing entries fall back to the loose file.
+	packAssets(BORDER_RLE_PATH);
+	bundleOpen(OAF_BUNDLE_PATH);
+	read = bootReads();
+	bundleClose();
+	check("Entries not in the bundle are read loose", read[0] == g_assets[0].bundled && read[3] == g_assets[3].loose);
+
+	packAssets();
+	bundleOpen(OAF_BUNDLE_PATH);
+	char small[6] = {0};
+	check("Small buffers get the start of the entry", bundleQuickRead("config.ini", small, 5) == RES_OK &&
+	      std::string(small) == g_assets[0].bundled.substr(0, 5));
+	bundleClose();
+	check("No handles left open", hostFsOpenHandles() == 0);
+}
+
+static void patch(std::string &data, const u32 offset, const u32 val, const u32 size)
+{
+	memcpy(&data[offset], &val, size);
+}
+
+static void testCorrupt(void)
+{
+	packAssets();
+	const std::string good = readFile(OAF_BUNDLE_PATH);
+	const u32 fileSize = good.size();
+
+	struct Corruption
+	{
+		const char *name;
+		std::string data;
+	};
+	std::vector<Corruption> corruptions;
+	std::string d = good;
+	patch(d, 0, 0x12345678u, 4);
+	corruptions.push_back({"Wrong magic", d});
+	d = good;
+	patch(d, 4, BUNDLE_VERSION + 1, 2);
+	corruptions.push_back({"Wrong version", d});
+	d = good;
+	patch(d, 6, 0, 2);
+	corruptions.push_back({"No entries", d});
+	d = good;
+	patch(d, 6, BUNDLE_MAX_ENTRIES + 1, 2);
+	corruptions.push_back({"Too many entries", d});
+	corruptions.push_back({"Truncated directory", good.substr(0, HEADER_SIZE + ENTRY_SIZE * 2)});
+	d = good;
+	patch(d, HEADER_SIZE + ENTRY_SIZE + 24, 0x7FFFFFFFu, 4);
+	corruptions.push_back({"Offset past the end", d});
+	d = good;
+	patch(d, HEADER_SIZE + ENTRY_SIZE * 3 + 28, fileSize, 4);
+	corruptions.push_back({"Size past the end", d});
+	d = good;
+	std::swap_ranges(&d[HEADER_SIZE], &d[HEADER_SIZE + ENTRY_SIZE], &d[HEADER_SIZE + ENTRY_SIZE * 2]);
+	corruptions.push_back({"Unsorted names", d});
+	d = good;
+	memcpy(&d[HEADER_SIZE + ENTRY_SIZE], &d[HEADER_SIZE], BUNDLE_NAME_LEN);
+	corruptions.push_back({"Duplicate names", d});
+
+	for(const Corruption &c : corruptions)
+	{
+		writeFile(OAF_BUNDLE_PATH, c.data);
+		const Result res = bundleOpen(OAF_BUNDLE_PATH);
+		const bool noLeak = hostFsOpenHandles() == 0;
+		const std::vector<std::string> read = bootReads();
+		bundleClose();
+
+		check((std::string(c.name) + " is rejected").c_str(), res == RES_INVALID_ARG && noLeak);
+		check("  ...and the loose files are used", sameAssets(read, false));
+	}
+
+	// Only the patches made it invalid.
+	writeFile(OAF_BUNDLE_PATH, good);
+	check("The unpatched bundle opens", bundleOpen(OAF_BUNDLE_PATH) == RES_OK);
+	bundleClose();
+}
+
+static void testLookup(void)
+{
+	// Packed in random order. bundle.py sorts them.
+	std::vector<u32> order;
+	for(u32 i = 0; i < BUNDLE_MAX_ENTRIES; i++) order.push_back(i);
+	for(u32 i = BUNDLE_MAX_ENTRIES - 1; i > 0; i--) std::swap(order[i], order[rnd() % (i + 1)]);
+
+	std::vector<std::string> args;
+	for(const u32 i : order)
+	{
+		char name[16];
+		snprintf(name, sizeof(name), "e%02" PRIu32, i);
+		writeFile(std::string("src/") + name, name);
+		args.push_back(std::string("src/") + name);
+	}
+	check("bundle.py packs 64 entries", pack(OAF_BUNDLE_PATH, args));
+
+	bundleOpen(OAF_BUNDLE_PATH);
+	bool ok = true;
+	hostFsResetStats();
+	for(u32 i = 0; i < BUNDLE_MAX_ENTRIES; i++)
+	{
+		char name[16], buf[16] = {0};
+		snprintf(name, sizeof(name), "e%02" PRIu32, i);
+		ok &= bundleQuickRead(name, buf, 3) == RES_OK && strcmp(buf, name) == 0;
+	}
+	check("Every entry is found", ok && g_hostFsStats.opens == 0 && g_hostFsStats.reads == BUNDLE_MAX_ENTRIES);
+
+	char buf[16];
+	ok = true;
+	for(const char *const name : {"e64", "e0", "e000", "a", "f", "e63_very_long_entry_name_x"})
+		ok &= bundleQuickRead(name, buf, 3) == RES_FR_NO_FILE;
+	check("Other names fall back to missing loose files", ok);
+	bundleClose();
+
+	// bundle.py refusals.
+	args.push_back("src/e00=e64");
+	check("bundle.py refuses more than 64 entries", !pack("big.bin", args));
+	writeFile("src/x", "x");
+	check("  ...files the firmware writes", !pack("x.bin", {"src/x=lastdir.txt"}) && !pack("x.bin", {"src/x=color_lut.bin"}));
+	check("  ...names longer than 24 chars", !pack("x.bin", {"src/x=abcdefghijklmnopqrstuvwxy"}) &&
+	      pack("x.bin", {"src/x=abcdefghijklmnopqrstuvwx"}));
+	check("  ...duplicate names", !pack("x.bin", {"src/x=a", "src/e00=a"}));
+	check("No handles left open", hostFsOpenHandles() == 0);
+}
+
+// RLE border of runs with one color per row of tiles.
+static std::string makeRleBorder(void)
+{
+	std::string data;
+	for(u32 pixels = 0; pixels < 240 * 400; pixels += 128)
+	{
+		data += (char)0xFF;
+		data += randomData(3);
+	}
+
+	std::string file(sizeof(BorderHeader), '\0');
+	const BorderHeader hdr = {BORDER_MAGIC, BORDER_VERSION, 0, BORDER_RAW_SIZE, (u32)data.size()};
+	memcpy(&file[0], &hdr, sizeof(hdr));
+
+	return file + data;
+}
+
+// The border loading of OAF_videoInit(). buf holds whatever was in the frame buffer before.
+static const char* loadBorder(std::vector<u8> &buf, std::vector<u8> &out)
+{
+	u32 size;
+	if(bundleRead(BORDER_RLE_PATH, buf.data(), BORDER_RAW_SIZE, &size) == RES_OK &&
+	   borderDecode(buf.data(), size, out.data())) return "rle";
+	if(bundleQuickRead("border.bgr", buf.data(), BORDER_RAW_SIZE) == RES_OK) return "bgr";
+
+	return "none";
+}
+
+static void testBorder(void)
+{
+	std::vector<u8> buf(BORDER_RAW_SIZE), out(BORDER_RAW_SIZE);
+	const std::string rle = makeRleBorder();
+	writeFile("border.bgr", randomData(BORDER_RAW_SIZE));
+	for(const bool bundled : {false, true})
+	{
+		writeFile(bundled ? "src/border.rle" : BORDER_RLE_PATH, rle);
+		if(bundled) pack(OAF_BUNDLE_PATH, {"src/border.rle=border.rle"});
+		else unlink(hostPath(OAF_BUNDLE_PATH).c_str());
+		bundleOpen(OAF_BUNDLE_PATH);
+
+		u32 size = 0;
+		const bool sizeOk = bundleRead(BORDER_RLE_PATH, buf.data(), BORDER_RAW_SIZE, &size) == RES_OK && size == rle.size();
+		check(bundled ? "Bundled border.rle size is the entry size" : "Loose border.rle size is the file size", sizeOk);
+		check("  ...and it is decoded", strcmp(loadBorder(buf, out), "rle") == 0);
+
+		// Cut off with the complete file still in the buffer from before.
+		const std::string cut = rle.substr(0, rle.size() / 2);
+		bundleClose();
+		writeFile(bundled ? "src/border.rle" : BORDER_RLE_PATH, cut);
+		if(bundled) pack(OAF_BUNDLE_PATH, {"src/border.rle=border.rle"});
+		bundleOpen(OAF_BUNDLE_PATH);
+		memcpy(buf.data(), rle.data(), rle.size());
+		check("  ...truncated one falls back to border.bgr", strcmp(loadBorder(buf, out), "bgr") == 0);
+		bundleClose();
+	}
+
+	// Too big for the buffer. The decoder must not see a cut off file as complete.
+	std::string big = makeRleBorder();
+	big.resize(BORDER_RAW_SIZE + 100, '\0');
+	writeFile(BORDER_RLE_PATH, big);
+	u32 size = 0;
+	check("Oversized files are cut at the buffer size",
+	      bundleRead(BORDER_RLE_PATH, buf.data(), BORDER_RAW_SIZE, &size) == RES_OK && size == BORDER_RAW_SIZE);
+	writeFile(BORDER_RLE_PATH, g_assets[3].loose);
+	unlink(hostPath("border.bgr").c_str());
+	check("No handles left open", hostFsOpenHandles() == 0);
+}
+
+static int runTests(void)
+{
+	if(mkdir((g_tmpDir + "/src").c_str(), 0755) != 0) return 1;
+
+	makeAssets();
+	testBoot();
+	testCorrupt();
+	testLookup();
+	testBorder();
+
+	return hostTestResult();
+}
+
+int main(const int argc, char *const argv[])
+{
+	if(argc != 2 || strcmp(argv[1], "test") != 0)
+	{
+		printf("Usage: %s test\n"
+		       "Packs bundles with bundle.py and checks the FS calls of the boot asset reads,\n"
+		       "the loose file fallback, lookups, corrupt or unsorted bundles and border.rle\n"
+		       "sizes.\n",
+		       argv[0]);
+		return 1;
+	}
+
+	const char *const tmpDir = hostTestDirCreate("bundle");
+	if(tmpDir == NULL) return 1;
+	g_tmpDir = tmpDir;
+
+	const int res = runTests();
+
+	hostTestDirRemove();
+
+	return res;
+}
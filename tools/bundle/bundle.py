@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+
+# open_agb_firm bundle.bin packer
+#
+# Packs small per-boot assets (config.ini, autoboot.txt, gba_scaler_matrix.bin,
+# border.rle/border.bgr) into a single file so the firmware only opens one file at boot.
+# See include/arm11/bundle.h for the format.
+#
+# Usage: bundle.py <output> <file>[=<name>] ...
+# Without =<name> the file name (without directories) is used as entry name.
+#
+# Copyright (C) 2024 profi200
+# SPDX-License-Identifier: GPL-3.0-or-later
+
+import os
+import struct
+import sys
+
+BUNDLE_MAGIC = 0x4C444E42 # "BNDL"
+BUNDLE_VERSION = 1
+BUNDLE_ALIGN = 512
+BUNDLE_NAME_LEN = 24
+BUNDLE_MAX_ENTRIES = 64
+HEADER_SIZE = 16
+ENTRY_SIZE = 32
+
+# Written by the firmware at runtime. Packing them would hide updates.
+LOOSE_ONLY = {'lastdir.txt', 'color_lut.bin', 'library.bin', 'boot_trace.json'}
+
+
+def align(value):
+	return (value + BUNDLE_ALIGN - 1) & ~(BUNDLE_ALIGN - 1)
+
+
+def main(argv):
+	if len(argv) < 3:
+		print(f'Usage: {argv[0]} <output> <file>[=<name>] ...', file=sys.stderr)
+		return 1
+
+	entries = {}
+	for arg in argv[2:]:
+		path, sep, name = arg.partition('=')
+		if not sep:
+			name = os.path.basename(path)
+
+		encoded = name.encode('ascii')
+		if len(encoded) > BUNDLE_NAME_LEN:
+			print(f'Error: Entry name "{name}" is longer than {BUNDLE_NAME_LEN} characters.', file=sys.stderr)
+			return 1
+		if name in LOOSE_ONLY:
+			print(f'Error: "{name}" is written by open_agb_firm and must stay a loose file.', file=sys.stderr)
+			return 1
+		if encoded in entries:
+			print(f'Error: Duplicate entry "{name}".', file=sys.stderr)
+			return 1
+
+		with open(path, 'rb') as f:
+			entries[encoded] = f.read()
+
+	if len(entries) > BUNDLE_MAX_ENTRIES:
+		print(f'Error: More than {BUNDLE_MAX_ENTRIES} entries.', file=sys.stderr)
+		return 1
+
+	# The firmware binary searches the zero padded names.
+	names = sorted(entries, key=lambda n: n.ljust(BUNDLE_NAME_LEN, b'\0'))
+	offset = align(HEADER_SIZE + ENTRY_SIZE * len(names))
+	directory = bytearray()
+	payload = bytearray()
+	for name in names:
+		data = entries[name]
+		directory += struct.pack('<24sII', name, offset, len(data))
+		payload += data.ljust(align(len(data)), b'\0')
+		offset += align(len(data))
+
+	header = struct.pack('<IHH8x', BUNDLE_MAGIC, BUNDLE_VERSION, len(names))
+	with open(argv[1], 'wb') as f:
+		f.write(header)
+		f.write(directory)
+		f.write(b'\0' * (align(HEADER_SIZE + len(directory)) - HEADER_SIZE - len(directory)))
+		f.write(payload)
+
+	for name in names:
+		print(f'{name.decode("ascii")}: {len(entries[name])} bytes')
+
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))
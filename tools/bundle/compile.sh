@@ -0,0 +1,11 @@
+#!/bin/bash
+
+# Builds bundle.c and border.c unmodified against ../hostStubs. The tests pack
+# bundles with ./bundle.py. fsQuickRead() is wrapped because boot
+# assets are read into buffers bigger than the file.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+
+rm ./bundle
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DNDEBUG $INCLUDES -c ../hostStubs/hostStubs.c ../../source/arm11/bundle.c ../../source/arm11/border.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -Wl,--gc-sections -Wl,--wrap=fsQuickRead ./bundle.cpp ./*.o -lpthread -o ./bundle
+rm ./*.o
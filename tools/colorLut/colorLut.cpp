@@ -0,0 +1,316 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "util.h"
+#include "arm11/config.h"
+#include "arm11/color_lut.h"
+
+
+#define LUT_ENTRIES  (COLOR_LUT_SIZE / 4)
+#define BENCH_RUNS   (5u)
+
+
+// color_lut.c reads its settings from here. config.c isn't linked.
+OafConfig g_oafConfig;
+
+struct LutSettings
+{
+	float contrast;
+	float brightness;
+	float saturation;
+};
+
+// Default first. Negative brightness is left out because the
+// old path fed NaN into lroundf() for it.
+static const LutSettings g_settings[] =
+{
+	{1.f,  0.f,   1.f},
+	{0.8f, 0.f,   1.f},
+	{1.f,  0.1f,  1.f},
+	{1.f,  0.f,   0.5f},
+	{1.f,  0.f,   0.f},
+	{0.9f, 0.05f, 1.3f},
+	{0.5f, 0.3f,  0.8f}
+};
+
+
+
+static inline float clampFloat(const float x, const float min, const float max)
+{
+	return (x < min ? min : (x > max ? max : x));
+}
+
+// makeColorLut() before the separable tables. Kept as reference.
+static void makeColorLutFloat(const ColorProfile *const p, u32 *const colorLut)
+{
+	const float targetGamma    = p->targetGamma;
+	const float contrast       = g_oafConfig.contrast;
+	const float brightness     = g_oafConfig.brightness / contrast;
+	const float targetContrast = powf(contrast, targetGamma);
+
+	const float sat   = g_oafConfig.saturation;
+	const float rwgt  = (1.f - sat) * 0.2126f;
+	const float gwgt  = (1.f - sat) * 0.7152f;
+	const float bwgt  = (1.f - sat) * 0.0722f;
+
+	for(u32 i = 0; i < 32768; i++)
+	{
+		float b = (float)rgbFive2Eight(i & 31u) / 255;
+		float g = (float)rgbFive2Eight((i>>5) & 31u) / 255;
+		float r = (float)rgbFive2Eight(i>>10) / 255;
+
+		b = powf(b + brightness, targetGamma);
+		g = powf(g + brightness, targetGamma);
+		r = powf(r + brightness, targetGamma);
+
+		const float lum = p->lum;
+		b = clampFloat(b * lum, 0.f, 1.f);
+		g = clampFloat(g * lum, 0.f, 1.f);
+		r = clampFloat(r * lum, 0.f, 1.f);
+
+		float tmpB = p->rb * r + p->gb * g + p->b  * b;
+		float tmpG = p->rg * r + p->g  * g + p->bg * b;
+		float tmpR = p->r  * r + p->gr * g + p->br * b;
+
+		b = rwgt         * tmpR + gwgt         * tmpG + (bwgt + sat) * tmpB;
+		g = rwgt         * tmpR + (gwgt + sat) * tmpG + bwgt         * tmpB;
+		r = (rwgt + sat) * tmpR + gwgt         * tmpG + bwgt         * tmpB;
+
+		b = (b < 0.f ? 0.f : b);
+		g = (g < 0.f ? 0.f : g);
+		r = (r < 0.f ? 0.f : r);
+
+		const float displayGamma = p->displayGamma;
+		b = powf(targetContrast * b, displayGamma);
+		g = powf(targetContrast * g, displayGamma);
+		r = powf(targetContrast * r, displayGamma);
+
+		u32 entry = 255;
+		entry |= clamp_s32(lroundf(b * 255), 0, 255)<<8;
+		entry |= clamp_s32(lroundf(g * 255), 0, 255)<<16;
+		entry |= clamp_s32(lroundf(r * 255), 0, 255)<<24;
+		colorLut[i] = entry;
+	}
+}
+
+static void applySettings(const LutSettings &s)
+{
+	g_oafConfig.contrast   = s.contrast;
+	g_oafConfig.brightness = s.brightness;
+	g_oafConfig.saturation = s.saturation;
+}
+
+// Returns the largest per channel difference. Counts differing entries.
+static u32 compareLuts(const u32 *const a, const u32 *const b, u32 &diffEntries)
+{
+	u32 maxDiff = 0;
+	diffEntries = 0;
+	for(u32 i = 0; i < LUT_ENTRIES; i++)
+	{
+		if(a[i] == b[i]) continue;
+
+		diffEntries++;
+		for(u32 shift = 0; shift < 32; shift += 8)
+		{
+			const s32 d = abs((s32)(a[i]>>shift & 0xFF) - (s32)(b[i]>>shift & 0xFF));
+			maxDiff = ((u32)d > maxDiff ? d : maxDiff);
+		}
+	}
+
+	return maxDiff;
+}
+
+static int runTests(void)
+{
+	std::unique_ptr<u32[]> lut(new u32[LUT_ENTRIES]);
+	std::unique_ptr<u32[]> ref(new u32[LUT_ENTRIES]);
+
+	for(const LutSettings &s : g_settings)
+	{
+		applySettings(s);
+		printf("contrast %.2f brightness %.2f saturation %.2f\n", s.contrast, s.brightness, s.saturation);
+		for(u32 p = 0; p < arrayEntries(g_colorProfiles); p++)
+		{
+			makeColorLut(&g_colorProfiles[p], lut.get());
+			makeColorLutFloat(&g_colorProfiles[p], ref.get());
+
+			u32 diffEntries;
+			const u32 maxDiff = compareLuts(lut.get(), ref.get(), diffEntries);
+			char name[64];
+			snprintf(name, sizeof(name), "  profile %" PRIu32 ": %5" PRIu32 " entries differ, max %" PRIu32 " LSB",
+			         p + 1, diffEntries, maxDiff);
+			check(name, maxDiff <= 1);
+		}
+	}
+
+	// Used to be NaN. Must not crash and black must stay black.
+	applySettings({1.f, -0.2f, 1.f});
+	makeColorLut(&g_colorProfiles[0], lut.get());
+	check("negative brightness", lut[0] == 255);
+
+	return hostTestResult();
+}
+
+// Loads the lut through the cache and checks hit/miss and the result.
+static void checkLoad(const char *const what, const ColorProfile &p, const bool expectHit, u8 *const tmpBuf)
+{
+	std::unique_ptr<u32[]> lut(new u32[LUT_ENTRIES]);
+	std::unique_ptr<u32[]> ref(new u32[LUT_ENTRIES]);
+	makeColorLut(&p, ref.get());
+
+	hostFsResetStats();
+	loadColorLut(&p, lut.get(), tmpBuf);
+	const bool hit = g_hostFsStats.writes == 0; // Misses rewrite the cache.
+	char name[64];
+	snprintf(name, sizeof(name), "%-28s %s", what, (hit ? "hit" : "miss"));
+	check(name, hit == expectHit && memcmp(lut.get(), ref.get(), COLOR_LUT_SIZE) == 0);
+}
+
+// Patches color_lut.bin directly.
+static void patchCacheFile(const u32 offset, const u8 xorVal, const long truncateTo = -1)
+{
+	const char *const path = hostFsPath(LUT_CACHE_PATH);
+	FILE *const f = fopen(path, "r+b");
+	if(f == NULL) return;
+	if(xorVal != 0 && fseek(f, offset, SEEK_SET) == 0)
+	{
+		const int c = fgetc(f);
+		fseek(f, offset, SEEK_SET);
+		fputc(c ^ xorVal, f);
+	}
+	fclose(f);
+	if(truncateTo >= 0 && truncate(path, truncateTo) != 0) fprintf(stderr, "truncate() failed.\n");
+}
+
+static int runCacheTests(void)
+{
+	if(hostTestDirCreate("colorLut") == NULL) return 1;
+
+	std::unique_ptr<u8[]> tmpBuf(new u8[LUT_CACHE_BUF_SIZE]);
+	applySettings(g_settings[0]);
+	const ColorProfile base = g_colorProfiles[0];
+	checkLoad("no cache file", base, false, tmpBuf.get());
+	checkLoad("same settings", base, true, tmpBuf.get());
+
+	// Fields makeColorLut() doesn't use must not invalidate.
+	g_oafConfig.scaler = 1;
+	g_oafConfig.volume = 10;
+	checkLoad("unrelated config fields", base, true, tmpBuf.get());
+
+	// Every input of makeColorLut() must invalidate.
+	float *const cfgFields[3] = {&g_oafConfig.contrast, &g_oafConfig.brightness, &g_oafConfig.saturation};
+	static const char *const cfgNames[3] = {"contrast", "brightness", "saturation"};
+	for(u32 i = 0; i < 3; i++)
+	{
+		const float old = *cfgFields[i];
+		*cfgFields[i] = old * 0.75f + 0.01f;
+		checkLoad(cfgNames[i], base, false, tmpBuf.get());
+		*cfgFields[i] = old;
+		checkLoad("  back to default", base, false, tmpBuf.get());
+	}
+
+	static const char *const profileNames[] =
+	{
+		"targetGamma", "lum", "r", "gr", "br", "rg", "g", "bg", "rb", "gb", "b", "displayGamma"
+	};
+	static_assert(sizeof(profileNames) / sizeof(*profileNames) == sizeof(ColorProfile) / sizeof(float));
+	for(u32 i = 0; i < arrayEntries(profileNames); i++)
+	{
+		ColorProfile p = base;
+		float *const field = (float*)&p + i;
+		*field = *field * 0.9f + 0.01f;
+		checkLoad((std::string("profile.") + profileNames[i]).c_str(), p, false, tmpBuf.get());
+	}
+	checkLoad("original profile", base, false, tmpBuf.get());
+	for(u32 i = 1; i < arrayEntries(g_colorProfiles); i++)
+		checkLoad(("switch to profile " + std::to_string(i + 1)).c_str(), g_colorProfiles[i], false, tmpBuf.get());
+
+	// Broken files.
+	checkLoad("profile 1", base, false, tmpBuf.get());
+	patchCacheFile(0, 0x01);
+	checkLoad("bad magic", base, false, tmpBuf.get());
+	patchCacheFile(4, 0x01);
+	checkLoad("bad version", base, false, tmpBuf.get());
+	patchCacheFile(8, 0x80);
+	checkLoad("bad digest", base, false, tmpBuf.get());
+	patchCacheFile(28, 0x01);
+	checkLoad("bad lut size", base, false, tmpBuf.get());
+	patchCacheFile(sizeof(LutCacheHeader) + 12345, 0x10);
+	checkLoad("corrupt lut entry", base, false, tmpBuf.get());
+	patchCacheFile(0, 0, LUT_CACHE_BUF_SIZE - 4);
+	checkLoad("truncated file", base, false, tmpBuf.get());
+	checkLoad("rewritten", base, true, tmpBuf.get());
+
+	hostTestDirRemove();
+
+	return hostTestResult();
+}
+
+static int runBench(void)
+{
+	std::unique_ptr<u32[]> lut(new u32[LUT_ENTRIES]);
+
+	applySettings(g_settings[0]);
+	printf("Best of %u runs per profile:\n", BENCH_RUNS);
+	double totalNew = 0, totalOld = 0;
+	for(u32 p = 0; p < arrayEntries(g_colorProfiles); p++)
+	{
+		double bestNew = 1e30, bestOld = 1e30;
+		for(u32 i = 0; i < BENCH_RUNS; i++)
+		{
+			u64 t = hostNowNs();
+			makeColorLut(&g_colorProfiles[p], lut.get());
+			bestNew = std::min(bestNew, (hostNowNs() - t) / 1e6);
+
+			t = hostNowNs();
+			makeColorLutFloat(&g_colorProfiles[p], lut.get());
+			bestOld = std::min(bestOld, (hostNowNs() - t) / 1e6);
+		}
+		printf("  profile %" PRIu32 ": float %8.3f ms, tables %8.3f ms, %6.1fx\n", p + 1, bestOld, bestNew, bestOld / bestNew);
+		totalNew += bestNew;
+		totalOld += bestOld;
+	}
+	printf("Total: float %.3f ms, tables %.3f ms, %.1fx\n", totalOld, totalNew, totalOld / totalNew);
+
+	return 0;
+}
+
+int main(const int argc, char *const argv[])
+{
+	if(argc == 2 && strcmp(argv[1], "test") == 0) return runTests();
+	if(argc == 2 && strcmp(argv[1], "cache") == 0) return runCacheTests();
+	if(argc == 2 && strcmp(argv[1], "bench") == 0) return runBench();
+
+	printf("Usage: %s test|cache|bench\n"
+	       "test:  Compares makeColorLut() against the old float path.\n"
+	       "cache: Checks color_lut.bin is invalidated by every lut input.\n"
+	       "bench: Times both for all color profiles.\n",
+	       argv[0]);
+
+	return 1;
+}
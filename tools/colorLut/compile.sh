@@ -0,0 +1,9 @@
+#!/bin/bash
+
+# Builds color_lut.c unmodified against ../hostStubs.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+
+rm ./colorLut
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DNDEBUG $INCLUDES -c ../hostStubs/hostStubs.c ../../source/arm11/color_lut.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -Wl,--gc-sections ./colorLut.cpp ./hostStubs.o ./color_lut.o -lm -lpthread -o ./colorLut
+rm ./*.o
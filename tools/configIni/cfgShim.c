@@ -0,0 +1,58 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Builds config.c unmodified and exports its internals to the tests.
+#include "../../source/arm11/config.c"
+#include "cfgShim.h"
+
+
+
+bool cfgSchemaUnique(void)
+{
+	for(unsigned s = 0; s < arrayEntries(g_cfgSections); s++)
+	{
+		if(!optionsUnique(&g_cfgSections[s])) return false;
+	}
+
+	return true;
+}
+
+bool cfgKeysUnique(const char *const *const keys, const u32 num)
+{
+	CfgOption options[32] = {0};
+	if(num > arrayEntries(options)) return false;
+	for(u32 i = 0; i < num; i++) options[i].key = keys[i];
+
+	const CfgSection section = {"test", options, 4, num};
+	return optionsUnique(&section);
+}
+
+const OafConfig* cfgDefaults(void)
+{
+	return &g_defaultConfig;
+}
+
+int cfgParseString(const char *const ini, OafConfig *const cfg)
+{
+	return ini_parse_string(ini, cfgIniCallback, cfg);
+}
+
+Result cfgWrite(const char *const path, const OafConfig *const cfg)
+{
+	return writeConfig(path, cfg);
+}
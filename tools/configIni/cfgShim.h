@@ -0,0 +1,44 @@
+#pragma once
+
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Test access to the static internals of config.c.
+
+#include "types.h"
+#include "error_codes.h"
+#include "arm11/config.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// The debug check for duplicate X-macro keys on the real tables and on keys.
+bool cfgSchemaUnique(void);
+bool cfgKeysUnique(const char *const *const keys, const u32 num);
+
+const OafConfig* cfgDefaults(void);
+// ini_parse_string() with the config callback. Returns the first bad line or 0.
+int cfgParseString(const char *const ini, OafConfig *const cfg);
+// writeConfig(). Options at their default value are only written if new configs have them.
+Result cfgWrite(const char *const path, const OafConfig *const cfg);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,11 @@
+#!/bin/bash
+
+# Builds config.c (through cfgShim.c) and bundle.c unmodified against ../hostStubs.
+# No NDEBUG so the duplicate key assert is built. fsQuickRead() is wrapped because
+# config files are read into a buffer bigger than the file.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+
+rm ./configIni
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -c ../hostStubs/hostStubs.c ./cfgShim.c ../../source/arm11/bundle.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -Wl,--gc-sections -Wl,--wrap=fsQuickRead ./configIni.cpp ./*.o -lpthread -o ./configIni
+rm ./*.o
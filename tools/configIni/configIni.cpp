@@ -0,0 +1,478 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "fs.h"
+#include "fsutil.h"
+#include "util.h"
+#include "inih/ini.h"
+#include "cfgShim.h"
+
+
+#define RANDOM_CONFIGS  (2000u)
+#define BENCH_PARSES    (20000u)
+#define BENCH_RUNS      (5u)
+
+
+// New configs before the schema table. All options must keep their values.
+static const char g_oldDefaultIni[] =
+	"[general]\n"
+	"backlight=64\n"
+	"backlightSteps=5\n"
+	"directBoot=false\n"
+	"useGbaDb=true\n"
+	"useSavesFolder=true\n\n"
+	"[video]\n"
+	"scaler=matrix\n"
+	"colorProfile=none\n"
+	"contrast=1.0\n"
+	"brightness=0.0\n"
+	"saturation=1.0\n\n"
+	"[audio]\n"
+	"audioOut=auto\n"
+	"volume=127\n\n"
+	"[advanced]\n"
+	"saveOverride=false\n"
+	"defaultSave=sram_256k";
+
+static const char *const g_buttonStrs[32] =
+{
+	"A", "B", "SELECT", "START", "RIGHT", "LEFT", "UP", "DOWN",
+	"R", "L", "X", "Y", "", "", "ZL", "ZR",
+	"", "", "", "", "TOUCH", "", "", "",
+	"CS_RIGHT", "CS_LEFT", "CS_UP", "CS_DOWN", "CP_RIGHT", "CP_LEFT", "CP_UP", "CP_DOWN"
+};
+
+static const char *const g_saveTypeStrs[16] =
+{
+	"eeprom_8k", "rom_256m_eeprom_8k", "eeprom_64k", "rom_256m_eeprom_64k", "flash_512k_atmel_rtc",
+	"flash_512k_atmel", "flash_512k_sst_rtc", "flash_512k_sst", "flash_512k_panasonic_rtc",
+	"flash_512k_panasonic", "flash_1m_macronix_rtc", "flash_1m_macronix", "flash_1m_sanyo_rtc",
+	"flash_1m_sanyo", "sram_256k", "none"
+};
+
+
+
+extern "C"
+{
+// config.c reads files into a buffer bigger than the file. Short reads are fine there.
+Result __wrap_fsQuickRead(const char *const path, void *const buf, u32 size)
+{
+	FHandle f;
+	Result res = fOpen(&f, path, FA_OPEN_EXISTING | FA_READ);
+	if(res != RES_OK) return res;
+
+	res = fRead(f, buf, size, NULL);
+	fClose(f);
+
+	return res;
+}
+}
+
+
+
+static u32 g_rng = 0x434F4E46u;
+
+static u32 rnd(void)
+{
+	// xorshift32.
+	g_rng ^= g_rng<<13;
+	g_rng ^= g_rng>>17;
+	g_rng ^= g_rng<<5;
+	return g_rng;
+}
+
+// The parser before the schema table. Kept as reference.
+static u32 oldParseButtons(const char *str)
+{
+	if(str == NULL || *str == '\0') return 0;
+
+	char buf[32];
+	buf[31] = '\0';
+	strncpy(buf, str, 31);
+
+	char *bufPtr = buf;
+	u32 map = 0;
+	while(1)
+	{
+		char *const nextDelimiter = strchr(bufPtr, ',');
+		if(nextDelimiter != NULL) *nextDelimiter = '\0';
+
+		unsigned i = 0;
+		while(i < 32 && strcmp(g_buttonStrs[i], bufPtr) != 0) ++i;
+		if(i == 32) break;
+		map |= 1u<<i;
+
+		if(nextDelimiter == NULL) break;
+
+		bufPtr = nextDelimiter + 1;
+	}
+
+	return map & ~(1u<<12);
+}
+
+static u8 oldEnum(const char *const value, const char *const *const strs, const u32 num, const u8 old)
+{
+	for(u32 i = 0; i < num; i++)
+	{
+		if(strcmp(value, strs[i]) == 0) return i;
+	}
+
+	return old;
+}
+
+static int oldIniCallback(void *user, const char *section, const char *name, const char *value)
+{
+	static const char *const scalers[] = {"none", "bilinear", "matrix"};
+	static const char *const profiles[] = {"none", "gba", "gb_micro", "gba_sp101", "nds", "ds_lite", "nso", "vba", "identity"};
+	static const char *const audioOuts[] = {"auto", "speakers", "headphones"};
+	OafConfig *const config = (OafConfig*)user;
+
+	if(strcmp(section, "general") == 0)
+	{
+		if(strcmp(name, "backlight") == 0)           config->backlight = (u8)strtoul(value, NULL, 10);
+		else if(strcmp(name, "backlightSteps") == 0) config->backlightSteps = (u8)strtoul(value, NULL, 10);
+		else if(strcmp(name, "directBoot") == 0)     config->directBoot = strcmp(value, "false") != 0;
+		else if(strcmp(name, "useGbaDb") == 0)       config->useGbaDb = strcmp(value, "true") == 0;
+		else if(strcmp(name, "useSavesFolder") == 0) config->useSavesFolder = strcmp(value, "true") == 0;
+		else if(strcmp(name, "sortNatural") == 0)    config->sortNatural = strcmp(value, "true") == 0;
+		else if(strcmp(name, "sortIgnoreCase") == 0) config->sortIgnoreCase = strcmp(value, "true") == 0;
+	}
+	else if(strcmp(section, "video") == 0)
+	{
+		if(strcmp(name, "scaler") == 0)            config->scaler = oldEnum(value, scalers, 3, config->scaler);
+		else if(strcmp(name, "colorProfile") == 0) config->colorProfile = oldEnum(value, profiles, 9, config->colorProfile);
+		else if(strcmp(name, "contrast") == 0)     config->contrast = str2float(value);
+		else if(strcmp(name, "brightness") == 0)   config->brightness = str2float(value);
+		else if(strcmp(name, "saturation") == 0)   config->saturation = str2float(value);
+	}
+	else if(strcmp(section, "audio") == 0)
+	{
+		if(strcmp(name, "audioOut") == 0)    config->audioOut = oldEnum(value, audioOuts, 3, config->audioOut);
+		else if(strcmp(name, "volume") == 0) config->volume = (s8)strtol(value, NULL, 10);
+	}
+	else if(strcmp(section, "input") == 0)
+	{
+		const u32 button = oldParseButtons(name) & 0x3FFu;
+		if(button != 0) config->buttonMaps[31u - __builtin_clz(button)] = oldParseButtons(value);
+	}
+	else if(strcmp(section, "game") == 0)
+	{
+		if(strcmp(name, "saveSlot") == 0) config->saveSlot = (u8)strtoul(value, NULL, 10);
+		if(strcmp(name, "saveType") == 0)
+			config->saveType = (strcmp(value, "auto") == 0 ? 255 : oldEnum(value, g_saveTypeStrs, 16, config->saveType));
+	}
+	else if(strcmp(section, "advanced") == 0)
+	{
+		if(strcmp(name, "saveOverride") == 0) config->saveOverride = strcmp(value, "false") != 0;
+		if(strcmp(name, "defaultSave") == 0)  config->defaultSave = oldEnum(value, g_saveTypeStrs, 16, config->defaultSave);
+	}
+	else return 0;
+
+	return 1;
+}
+
+static bool sameConfig(const OafConfig &a, const OafConfig &b)
+{
+	return a.backlight == b.backlight && a.backlightSteps == b.backlightSteps && a.directBoot == b.directBoot &&
+	       a.useGbaDb == b.useGbaDb && a.useSavesFolder == b.useSavesFolder && a.sortNatural == b.sortNatural &&
+	       a.sortIgnoreCase == b.sortIgnoreCase && a.scaler == b.scaler && a.colorProfile == b.colorProfile &&
+	       a.contrast == b.contrast && a.brightness == b.brightness && a.saturation == b.saturation &&
+	       a.audioOut == b.audioOut && a.volume == b.volume &&
+	       memcmp(a.buttonMaps, b.buttonMaps, sizeof(a.buttonMaps)) == 0 && a.saveSlot == b.saveSlot &&
+	       a.saveType == b.saveType && a.saveOverride == b.saveOverride && a.defaultSave == b.defaultSave;
+}
+
+static std::string readFile(const char *const path)
+{
+	std::string data;
+	FILE *const f = fopen(hostFsPath(path), "rb");
+	if(f == NULL) return data;
+
+	char buf[4096];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0) data.append(buf, n);
+	fclose(f);
+
+	return data;
+}
+
+static bool writeFile(const char *const path, const std::string &data)
+{
+	FILE *const f = fopen(hostFsPath(path), "wb");
+	if(f == NULL) return false;
+	const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+
+	return (fclose(f) == 0 && ok);
+}
+
+// Up to 3 buttons. parseButtons() only reads 31 chars of a mapping.
+static u32 randomButtonMap(void)
+{
+	u32 map = 0;
+	u32 len = 0;
+	for(u32 n = 1 + rnd() % 3; n > 0; n--)
+	{
+		const u32 bit = rnd() % 32;
+		const u32 nameLen = strlen(g_buttonStrs[bit]);
+		if(nameLen == 0 || len + nameLen + 1 > 31) continue;
+		map |= 1u<<bit;
+		len += nameLen + 1;
+	}
+
+	return map;
+}
+
+// Random config with every option in range. Floats have 3 decimals like the writer.
+static OafConfig randomConfig(void)
+{
+	OafConfig cfg = *cfgDefaults();
+	cfg.backlight      = rnd();
+	cfg.backlightSteps = rnd();
+	cfg.directBoot     = rnd() & 1;
+	cfg.useGbaDb       = rnd() & 1;
+	cfg.useSavesFolder = rnd() & 1;
+	cfg.sortNatural    = rnd() & 1;
+	cfg.sortIgnoreCase = rnd() & 1;
+	cfg.scaler         = rnd() % 3;
+	cfg.colorProfile   = rnd() % 9;
+	cfg.contrast       = (float)(rnd() % 1001) / 1000.f;
+	cfg.brightness     = (float)(rnd() % 1001) / 1000.f;
+	cfg.saturation     = (float)(rnd() % 1001) / 1000.f;
+	cfg.audioOut       = rnd() % 3;
+	cfg.volume         = (s8)rnd();
+	for(u32 i = 0; i < 10; i++) cfg.buttonMaps[i] = (rnd() % 3 == 0 ? randomButtonMap() : 0);
+	cfg.saveSlot       = rnd() % 10;
+	cfg.saveType       = (rnd() % 17 == 16 ? 255 : rnd() % 16);
+	cfg.saveOverride   = rnd() & 1;
+	cfg.defaultSave    = rnd() % 16;
+
+	return cfg;
+}
+
+static void testSchema(void)
+{
+	check("Option keys are unique", cfgSchemaUnique());
+
+	static const char *const unique[] = {"audioOut", "saveSlot", "backlight", "saveType", "volume"};
+	static const char *const dupe[] = {"audioOut", "backlight", "volume", "backlight"};
+	check("  ...the check catches duplicate keys", cfgKeysUnique(unique, 5) && !cfgKeysUnique(dupe, 4));
+
+	// saveSlot and saveType have the same length.
+	OafConfig cfg = *cfgDefaults();
+	cfgParseString("[game]\nsaveSlo=1\nsaveSlot2=2\nsaveSlot=3\nsaveType=none\n", &cfg);
+	check("Keys only match with the same length", cfg.saveSlot == 3 && cfg.saveType == 15);
+	check("Sections only match with the same length", cfgParseString("[gam]\nsaveSlot=1\n", &cfg) == 2 &&
+	      cfgParseString("[games]\nsaveSlot=1\n", &cfg) == 2 && cfg.saveSlot == 3);
+}
+
+static void testDefaults(void)
+{
+	OafConfig cfg = *cfgDefaults();
+	unlink(hostFsPath("config.ini"));
+	check("Missing config.ini is created", parseOafConfig("config.ini", &cfg, true) == RES_OK &&
+	      sameConfig(cfg, *cfgDefaults()));
+
+	// Same options as the hardcoded default config. The order may differ.
+	const std::string written = readFile("config.ini");
+	// Starting from zeros catches options missing in either.
+	OafConfig oldParsed;
+	memset(&oldParsed, 0, sizeof(OafConfig));
+	OafConfig newParsed = oldParsed;
+	ini_parse_string(g_oldDefaultIni, oldIniCallback, &oldParsed);
+	ini_parse_string(written.c_str(), oldIniCallback, &newParsed);
+	check("  ...with the options of the old default", sameConfig(oldParsed, newParsed));
+
+	u32 keys = 0;
+	for(const char c : written) keys += c == '=';
+	check("  ...and nothing else", keys == 14);
+
+	hostFsResetStats();
+	cfg = *cfgDefaults();
+	check("Existing config.ini is not rewritten", parseOafConfig("config.ini", &cfg, true) == RES_OK &&
+	      g_hostFsStats.writes == 0);
+
+	cfg = *cfgDefaults();
+	check("Per-game ini is never created", parseOafConfig("roms/none.ini", &cfg, false) != RES_OK &&
+	      readFile("roms/none.ini").empty());
+}
+
+static void testRoundTrip(void)
+{
+	bool written = true, same = true, oldSame = true;
+	for(u32 i = 0; i < RANDOM_CONFIGS; i++)
+	{
+		const OafConfig cfg = randomConfig();
+		written &= cfgWrite("config.ini", &cfg) == RES_OK;
+
+		OafConfig parsed = *cfgDefaults();
+		same &= parseOafConfig("config.ini", &parsed, false) == RES_OK && sameConfig(parsed, cfg);
+
+		OafConfig oldParsed = *cfgDefaults();
+		ini_parse_string(readFile("config.ini").c_str(), oldIniCallback, &oldParsed);
+		oldSame &= sameConfig(oldParsed, cfg);
+	}
+	check("Random configs are written", written);
+	check("  ...and parse back unchanged", same);
+	check("  ...the old parser reads the same", oldSame);
+
+	// Per-game files only change some options of the loaded config.
+	bool gameSame = true;
+	for(u32 i = 0; i < RANDOM_CONFIGS; i++)
+	{
+		const OafConfig base = randomConfig();
+		const OafConfig game = randomConfig();
+		std::string ini = "[game]\nsaveSlot=" + std::to_string(game.saveSlot) + "\n";
+		ini += std::string("saveType=") + (game.saveType == 255 ? "auto" : g_saveTypeStrs[game.saveType]) + "\n";
+		if(rnd() & 1) ini += "\n[video]\ncolorProfile=gb_micro\nscaler=none\n";
+		if(rnd() & 1) ini += "\n[input]\nA=B\nL=R,X\n";
+		if(rnd() & 1) ini += "\n[advanced]\nsaveOverride=true\n";
+		writeFile("roms/game.ini", ini);
+
+		OafConfig parsed = base;
+		OafConfig oldParsed = base;
+		gameSame &= parseOafConfig("roms/game.ini", &parsed, false) == RES_OK;
+		ini_parse_string(ini.c_str(), oldIniCallback, &oldParsed);
+		gameSame &= sameConfig(parsed, oldParsed) && parsed.saveSlot == game.saveSlot && parsed.saveType == game.saveType;
+	}
+	check("Per-game ini overrides like the old parser", gameSame);
+}
+
+static void testValues(void)
+{
+	OafConfig cfg = *cfgDefaults();
+	cfgParseString("[general]\nbacklight=300\ndirectBoot=yes\nuseGbaDb=yes\n"
+	               "[audio]\nvolume=-200\n[game]\nsaveSlot=12\n", &cfg);
+	check("Integers are clamped to their range", cfg.backlight == 255 && cfg.volume == -128 && cfg.saveSlot == 9);
+	check("Bools keep their old meaning", cfg.directBoot && !cfg.useGbaDb);
+
+	cfg = *cfgDefaults();
+	cfg.scaler = 1;
+	cfgParseString("[video]\nscaler=bicubic\nsharpness=2\n[advanced]\ndefaultSave=auto\n", &cfg);
+	check("Unknown values and keys are ignored", cfg.scaler == 1 && cfg.defaultSave == cfgDefaults()->defaultSave);
+
+	cfg = *cfgDefaults();
+	check("Unknown sections are errors", cfgParseString("[general]\nbacklight=10\n[gfx]\nx=1\n", &cfg) == 4 &&
+	      cfg.backlight == 10);
+
+	cfg = *cfgDefaults();
+	cfg.contrast   = 0.125f;
+	cfg.brightness = 0.5f;
+	cfgWrite("config.ini", &cfg);
+	const std::string ini = readFile("config.ini");
+	check("Floats are written with up to 3 decimals", ini.find("contrast=0.125\n") != std::string::npos &&
+	      ini.find("brightness=0.5\n") != std::string::npos && ini.find("saturation=1.0\n") != std::string::npos);
+
+	// Every button on every key doesn't fit into the 1 KiB parse buffer.
+	for(u32 i = 0; i < 10; i++) cfg.buttonMaps[i] = 0xFF30CFFFu;
+	writeFile("config.ini", "old");
+	check("Configs too big to parse are not written", cfgWrite("config.ini", &cfg) == RES_OUT_OF_RANGE &&
+	      readFile("config.ini") == "old");
+	check("No handles left open", hostFsOpenHandles() == 0);
+}
+
+static int runTests(void)
+{
+	testSchema();
+	testDefaults();
+	testRoundTrip();
+	testValues();
+
+	return hostTestResult();
+}
+
+// Best of BENCH_RUNS in µs per parse.
+template<typename Parse> static double bestOf(Parse parse)
+{
+	double best = 1e30;
+	for(u32 r = 0; r < BENCH_RUNS; r++)
+	{
+		const u64 t = hostNowNs();
+		for(u32 i = 0; i < BENCH_PARSES; i++) parse();
+		best = std::min(best, (hostNowNs() - t) / 1e3 / BENCH_PARSES);
+	}
+
+	return best;
+}
+
+static int runBench(void)
+{
+	OafConfig full = randomConfig();
+	for(u32 i = 0; i < 10; i++) full.buttonMaps[i] = randomButtonMap();
+	full.sortNatural = full.sortIgnoreCase = true;
+	cfgWrite("full.ini", &full);
+
+	static const char gameIni[] = "[game]\nsaveSlot=2\nsaveType=flash_1m_macronix_rtc\n\n[video]\ncolorProfile=gba_sp101\n";
+	writeFile("game.ini", gameIni);
+	const OafConfig base = *cfgDefaults();
+	cfgWrite("default.ini", &base);
+
+	printf("Best of %u runs, %u parses each. µs per file.\n", BENCH_RUNS, BENCH_PARSES);
+	printf("%-22s %10s %10s %8s %14s\n", "", "old", "schema", "", "file+schema");
+	const struct
+	{
+		const char *name;
+		const char *path;
+	} files[] = {{"default config.ini", "default.ini"}, {"full config.ini", "full.ini"}, {"per-game ini", "game.ini"}};
+	for(const auto &file : files)
+	{
+		const std::string ini = readFile(file.path);
+		OafConfig cfg = base;
+		const double tOld = bestOf([&]{ cfg = base; ini_parse_string(ini.c_str(), oldIniCallback, &cfg); });
+		const double tNew = bestOf([&]{ cfg = base; cfgParseString(ini.c_str(), &cfg); });
+		const double tFile = bestOf([&]{ cfg = base; parseOafConfig(file.path, &cfg, false); });
+		printf("%-22s %10.3f %10.3f %7.2fx %14.3f\n", file.name, tOld, tNew, tOld / tNew, tFile);
+	}
+
+	return 0;
+}
+
+int main(const int argc, char *const argv[])
+{
+	const bool test = argc == 2 && strcmp(argv[1], "test") == 0;
+	const bool bench = argc == 2 && strcmp(argv[1], "bench") == 0;
+	if(!test && !bench)
+	{
+		printf("Usage: %s test|bench\n"
+		       "test:  Checks the key lookup, the default config.ini, random config and\n"
+		       "       per-game ini round trips against the old parser and value parsing.\n"
+		       "bench: Parse time of config.ini and per-game ini files, old vs schema.\n",
+		       argv[0]);
+		return 1;
+	}
+
+	const char *const tmpDir = hostTestDirCreate("configIni");
+	if(tmpDir == NULL) return 1;
+	if(mkdir((std::string(tmpDir) + "/roms").c_str(), 0755) != 0) return 1;
+
+	const int res = (test ? runTests() : runBench());
+
+	hostTestDirRemove();
+
+	return res;
+}
@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# Builds filebrowser.c unmodified against ../hostStubs. fbShim.c includes
+# it to reach its static functions. The UI is stubbed in fileBrowser.cpp.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+
+rm ./fileBrowser
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DNDEBUG $INCLUDES -c ../hostStubs/hostStubs.c ./fbShim.c ../../source/arm11/arena.c ../../source/arm11/library.c ../../source/arm11/rom_cache.c ../../source/arm11/save_type.c ../../source/arm11/crc32.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -Wl,--gc-sections ./fileBrowser.cpp ./*.o -lpthread -o ./fileBrowser
+rm ./*.o
@@ -0,0 +1,183 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Builds filebrowser.c unmodified and exports its internals to the tests.
+#include "../../source/arm11/filebrowser.c"
+#include "fbShim.h"
+
+
+struct FbDir
+{
+	char path[512];
+	DirList list;
+	DirScan scan;
+};
+
+static_assert(FB_ENT_FILE == ENT_TYPE_FILE && FB_ENT_DIR == ENT_TYPE_DIR);
+static_assert(FB_SORT_NATURAL == SORT_NATURAL && FB_SORT_IGNORE_CASE == SORT_IGNORE_CASE);
+static_assert(FB_PREVIEW_DELAY == PREVIEW_DELAY && FB_PREVIEW_LRU_SIZE == PREVIEW_LRU_SIZE);
+static_assert(FB_DIR_CACHE_MAX == DIR_CACHE_MAX && FB_DIR_CACHE_EVICT == DIR_CACHE_EVICT);
+
+struct FbPreview
+{
+	PreviewCache cache;
+};
+
+
+
+void fbSetSortFlags(const u8 flags)
+{
+	g_sortFlags = flags;
+}
+
+void fbSortEntries(char **const ptrs, const u32 num)
+{
+	sortEntries(ptrs, num);
+}
+
+u64 fbSortKey(const char *const name)
+{
+	return makeSortKey((const u8*)name);
+}
+
+int fbCompareNames(const char *const a, const char *const b)
+{
+	return compareNames((const u8*)a, (const u8*)b);
+}
+
+FbDir* fbDirNew(void)
+{
+	FbDir *const dir = (FbDir*)calloc(1, sizeof(FbDir));
+	if(dir == NULL) return NULL;
+
+	dlistInit(&dir->list);
+	dir->scan.mode   = SCAN_IDLE;
+	dir->scan.filter = ".gba";
+	dir->scan.fis    = (FILINFO*)malloc(sizeof(FILINFO) * DIR_READ_BLOCKS);
+	if(dir->scan.fis == NULL)
+	{
+		free(dir);
+		return NULL;
+	}
+
+	return dir;
+}
+
+void fbDirDelete(FbDir *const dir)
+{
+	scanStop(&dir->scan);
+	free(dir->scan.fis);
+	dlistFree(&dir->list);
+	free(dir);
+}
+
+Result fbDirOpen(FbDir *const dir, const char *const path)
+{
+	safeStrcpy(dir->path, path, sizeof(dir->path));
+	return openDir(dir->path, &dir->list, &dir->scan);
+}
+
+bool fbDirStep(FbDir *const dir, const u32 blocks, u32 *const cursorPos)
+{
+	return scanStep(&dir->scan, dir->path, &dir->list, blocks, cursorPos);
+}
+
+bool fbDirScanning(const FbDir *const dir)
+{
+	return dir->scan.mode != SCAN_IDLE;
+}
+
+void fbDirFinish(FbDir *const dir)
+{
+	u32 cursorPos = 0;
+	while(fbDirScanning(dir)) fbDirStep(dir, DIR_SCAN_STEP, &cursorPos);
+}
+
+bool fbDirPush(FbDir *const dir, const u32 pending, const char *const name, const bool isDir)
+{
+	FILINFO fi;
+	fi.fattrib = (isDir ? AM_DIR : 0);
+	safeStrcpy(fi.fname, name, sizeof(fi.fname));
+
+	return dlistPush(&dir->list, pending, &fi);
+}
+
+void fbDirMerge(FbDir *const dir, const u32 pending)
+{
+	dlistMerge(&dir->list, pending);
+}
+
+u32 fbDirNum(const FbDir *const dir)
+{
+	return dir->list.num;
+}
+
+const char* fbDirEntry(const FbDir *const dir, const u32 i)
+{
+	return dir->list.ptrs[i];
+}
+
+void fbDirShow(const FbDir *const dir, const u32 start, const u32 cursorPos)
+{
+	showDirList(&dir->list, start, cursorPos, NULL);
+}
+
+u32 fbDirMemory(const FbDir *const dir)
+{
+	u32 bytes = sizeof(char*) * dir->list.cap;
+	for(const ArenaChunk *chunk = dir->list.arena.first; chunk != NULL; chunk = chunk->next)
+		bytes += sizeof(ArenaChunk) + chunk->size;
+
+	return bytes;
+}
+
+void fbDirCachePath(const char *const path, char cachePath[32])
+{
+	makeDirCachePath(path, cachePath);
+}
+
+FbPreview* fbPreviewNew(void)
+{
+	FbPreview *const preview = (FbPreview*)calloc(1, sizeof(FbPreview));
+	if(preview != NULL) romCacheLoad();
+
+	return preview;
+}
+
+void fbPreviewDelete(FbPreview *const preview)
+{
+	previewReset(&preview->cache);
+	free(preview);
+}
+
+bool fbPreviewStep(FbPreview *const preview, const FbDir *const dir, const u32 cursorPos)
+{
+	return previewStep(&preview->cache, dir->path, &dir->list, cursorPos);
+}
+
+bool fbPreviewShown(const FbPreview *const preview, bool *const valid, char *const title, u8 *const dbSaveType)
+{
+	const RomPreview *const shown = preview->cache.shown;
+	if(shown == NULL) return false;
+
+	*valid = shown->valid;
+	memcpy(title, shown->title, sizeof(shown->title));
+	title[sizeof(shown->title)] = '\0';
+	*dbSaveType = shown->dbSaveType;
+
+	return true;
+}
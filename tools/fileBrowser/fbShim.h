@@ -0,0 +1,99 @@
+#pragma once
+
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Test access to the static internals of filebrowser.c.
+
+#include "types.h"
+#include "error_codes.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Entry type byte in front of each name.
+#define FB_ENT_FILE  (0)
+#define FB_ENT_DIR   (1)
+
+// Sort options.
+#define FB_SORT_NATURAL      (1u)
+#define FB_SORT_IGNORE_CASE  (1u<<1)
+
+#define FB_PREVIEW_DELAY     (15u)
+#define FB_PREVIEW_LRU_SIZE  (16u)
+#define FB_DIR_CACHE_MAX     (64u)
+#define FB_DIR_CACHE_EVICT   (8u)
+
+// qsort() comparator for pointers to entries. Not static in filebrowser.c.
+int dlistCompare(const void *a, const void *b);
+
+// sortEntries(), makeSortKey() and compareNames() with the current sort options.
+void fbSortEntries(char **const ptrs, const u32 num);
+u64 fbSortKey(const char *const name);
+int fbCompareNames(const char *const a, const char *const b);
+
+// A DirList plus the DirScan browseFiles() uses on it.
+typedef struct FbDir FbDir;
+
+
+
+void fbSetSortFlags(const u8 flags);
+
+FbDir* fbDirNew(void);
+void fbDirDelete(FbDir *const dir);
+
+// openDir(). Shows the cached list or scans the first page.
+Result fbDirOpen(FbDir *const dir, const char *const path);
+// scanStep() like one VBlank in browseFiles().
+bool fbDirStep(FbDir *const dir, const u32 blocks, u32 *const cursorPos);
+bool fbDirScanning(const FbDir *const dir);
+// Scans until the list is complete.
+void fbDirFinish(FbDir *const dir);
+
+// dlistPush() and dlistMerge() on the list without a scan.
+bool fbDirPush(FbDir *const dir, const u32 pending, const char *const name, const bool isDir);
+void fbDirMerge(FbDir *const dir, const u32 pending);
+
+u32 fbDirNum(const FbDir *const dir);
+// Entry type byte followed by the name.
+const char* fbDirEntry(const FbDir *const dir, const u32 i);
+
+// showDirList() for one keypress.
+void fbDirShow(const FbDir *const dir, const u32 start, const u32 cursorPos);
+// Bytes malloc()ed for the list. Arena chunks including headers plus the pointer array.
+u32 fbDirMemory(const FbDir *const dir);
+
+// Cache file path of a directory relative to the work dir.
+void fbDirCachePath(const char *const path, char cachePath[32]);
+
+// The ROM header preview LRU and fetch scheduler of browseFiles().
+typedef struct FbPreview FbPreview;
+
+// Loads the ROM cache like browseFiles().
+FbPreview* fbPreviewNew(void);
+void fbPreviewDelete(FbPreview *const preview);
+// previewStep() like one VBlank in browseFiles().
+bool fbPreviewStep(FbPreview *const preview, const FbDir *const dir, const u32 cursorPos);
+// False if no preview is shown. title needs 13 chars.
+bool fbPreviewShown(const FbPreview *const preview, bool *const valid, char *const title, u8 *const dbSaveType);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,989 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <random>
+#include <string>
+#include <strings.h>
+#include <sys/stat.h>
+#include <utime.h>
+#include <unistd.h>
+#include <vector>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "arm11/config.h"
+#include "arm11/rom_cache.h"
+#include "arm11/save_type.h"
+#include "fbShim.h"
+
+
+// Directory timestamps are pinned like FAT which doesn't update
+// them when entries are added, removed or renamed.
+#define DIR_TIME    (1700000000)
+#define BENCH_RUNS  (5u)
+
+
+typedef std::vector<std::string> Names; // 'D' or 'F' + name.
+
+static u32 g_tgPrints = 0; // Rows sent to the text grid.
+
+extern "C"
+{
+OafConfig g_oafConfig;
+
+// UI. Only browseFiles() and the library view use it.
+void hidScanInput(void) {}
+u32 hidKeysDown(void) { return 0; }
+u32 hidGetExtraKeys(UNUSED u32 clear) { return 0; }
+void GFX_waitForVBlank0(void) {}
+void GFX_flushBuffers(void) {}
+void tgClear(void) {}
+void tgBeginFrame(void) {}
+void tgPrint(UNUSED const u32 row, UNUSED const u32 col, UNUSED const u8 color, UNUSED const char *str) { g_tgPrints++; }
+void tgScrollUp(UNUSED const u32 top, UNUSED const u32 bottom) {}
+void tgPresent(void) {}
+void printErrorWaitInput(UNUSED Result res, UNUSED u32 waitKeys) {}
+}
+
+
+
+static u32 g_rng = 0x42524F57u;
+
+static u32 rnd(void)
+{
+	// xorshift32.
+	g_rng ^= g_rng<<13;
+	g_rng ^= g_rng>>17;
+	g_rng ^= g_rng<<5;
+	return g_rng;
+}
+
+static std::string hostPath(const std::string &path)
+{
+	return hostFsPath(path.c_str());
+}
+
+static void setDirTime(const std::string &dir, const time_t mtime = DIR_TIME)
+{
+	const utimbuf times = {mtime, mtime};
+	if(utime(hostPath(dir).c_str(), &times) != 0) hostTestFail();
+}
+
+static void touch(const std::string &path)
+{
+	FILE *const f = fopen(hostPath(path).c_str(), "wb");
+	if(f == NULL || fclose(f) != 0) hostTestFail();
+}
+
+static void makeDir(const std::string &path)
+{
+	if(mkdir(hostPath(path).c_str(), 0755) != 0) hostTestFail();
+}
+
+static std::string cacheFile(const char *const dir)
+{
+	char cachePath[32];
+	fbDirCachePath(dir, cachePath);
+	return hostPath(cachePath);
+}
+
+static bool fileExists(const std::string &hostFile)
+{
+	struct stat st;
+	return stat(hostFile.c_str(), &st) == 0;
+}
+
+static std::string ent(const char type, const std::string &name)
+{
+	return (type == FB_ENT_DIR ? "D" : "F") + name;
+}
+
+static Names listed(const FbDir *const dir)
+{
+	Names names;
+	for(u32 i = 0; i < fbDirNum(dir); i++)
+	{
+		const char *const entry = fbDirEntry(dir, i);
+		names.push_back(ent(*entry, &entry[1]));
+	}
+	return names;
+}
+
+// The browser order without sort options. Dirs first, then bytewise.
+static Names sorted(Names names)
+{
+	std::sort(names.begin(), names.end(), [](const std::string &a, const std::string &b)
+	{
+		if(a[0] != b[0]) return a[0] == 'D';
+		return strcmp(a.c_str() + 1, b.c_str() + 1) < 0;
+	});
+	return names;
+}
+
+
+// Opens dir and reports whether the list came from the cache.
+static bool openFromCache(FbDir *const dir, const char *const path)
+{
+	hostFsResetStats();
+	if(fbDirOpen(dir, path) != RES_OK) return false;
+
+	// A scan without the cache reads the directory before returning.
+	return g_hostFsStats.dirReads == 0 && fbDirScanning(dir);
+}
+
+// No-Intro like name of ROM number i.
+static std::string romName(const u32 i)
+{
+	static const char *const words[] =
+	{
+		"Super", "Mario", "Advance", "Pokemon", "Zelda", "Castlevania", "Metroid", "Golden", "Sun",
+		"Fire", "Emblem", "Kirby", "Wario", "Land", "Tactics", "Street", "Fighter", "Racing", "World"
+	};
+	static const char *const regions[] = {"(USA)", "(Europe) (En,Fr,De,Es,It)", "(Japan)", "(USA, Europe)"};
+
+	std::string name = std::to_string(i + 1) + " - ";
+	for(u32 w = 2 + rnd() % 3; w > 0; w--) name += std::string(words[rnd() % arrayEntries(words)]) + " ";
+	return name + regions[rnd() % arrayEntries(regions)] + ".gba";
+}
+
+// Returns the total name bytes.
+static u32 makeRomDir(const std::string &path, const u32 num, Names *const ref = NULL)
+{
+	makeDir(path);
+	u32 nameBytes = 0;
+	for(u32 i = 0; i < num; i++)
+	{
+		const std::string name = romName(i);
+		touch(path + "/" + name);
+		nameBytes += name.size() + 1;
+		if(ref != NULL) ref->push_back(ent(FB_ENT_FILE, name));
+	}
+	setDirTime(path);
+
+	return nameBytes;
+}
+
+static void testLargeDir(void)
+{
+	fbSetSortFlags(0);
+	Names ref;
+	makeRomDir("sdmc:/large", 5000, &ref);
+	ref = sorted(ref);
+
+	FbDir *const dir = fbDirNew();
+	fbDirOpen(dir, "sdmc:/large");
+	fbDirFinish(dir);
+	check("5000 entries are all listed", listed(dir) == ref);
+	check("  ...and cached", openFromCache(dir, "sdmc:/large") && listed(dir) == ref);
+	fbDirFinish(dir);
+
+	bool ok = true;
+	for(u32 i = 0; i < ref.size(); i += 997)
+	{
+		g_tgPrints = 0;
+		fbDirShow(dir, i, i);
+		ok &= g_tgPrints == std::min<u32>(24, ref.size() - i) + 1; // + cursor.
+	}
+	check("Only the visible rows are drawn", ok);
+
+	fbDirDelete(dir);
+}
+
+static bool isSorted(const FbDir *const dir)
+{
+	for(u32 i = 1; i < fbDirNum(dir); i++)
+	{
+		const char *a = fbDirEntry(dir, i - 1), *b = fbDirEntry(dir, i);
+		if(dlistCompare(&a, &b) >= 0) return false;
+	}
+	return true;
+}
+
+// One shot qsort() of the same entries like the scan before streaming.
+static Names qsorted(const Names &names)
+{
+	std::vector<std::string> ents;
+	for(const std::string &name : names) ents.push_back(std::string(1, name[0] == 'D' ? FB_ENT_DIR : FB_ENT_FILE) + name.substr(1));
+	std::vector<const char*> ptrs;
+	for(const std::string &e : ents) ptrs.push_back(e.c_str());
+	qsort(ptrs.data(), ptrs.size(), sizeof(char*), dlistCompare);
+
+	Names res;
+	for(const char *const e : ptrs) res.push_back(ent(*e, &e[1]));
+	return res;
+}
+
+// Names that differ only in case, leading zeros or digit run length.
+static std::string randomName(void)
+{
+	static const char *const parts[] = {"game", "Game", "GAME", "a", "B", "0", "00", "1", "01", "2", "10", "9", "099",
+	                                    "123456789012", " ", "-", "_", "Z", "z", "~"};
+	std::string name;
+	for(u32 n = 1 + rnd() % 5; n > 0; n--) name += parts[rnd() % arrayEntries(parts)];
+	return name;
+}
+
+static void testMerge(void)
+{
+	static const u8 flagSets[4] = {0, FB_SORT_NATURAL, FB_SORT_IGNORE_CASE, FB_SORT_NATURAL | FB_SORT_IGNORE_CASE};
+	static const char *const flagNames[4] = {"bytewise", "natural", "no case", "natural, no case"};
+
+	for(u32 f = 0; f < 4; f++)
+	{
+		fbSetSortFlags(flagSets[f]);
+		bool ok = true, alwaysSorted = true;
+		for(u32 round = 0; round < 200 && ok; round++)
+		{
+			// Unique names like in a directory.
+			std::vector<std::string> unique;
+			const u32 num = 1 + rnd() % (round < 100 ? 40 : 2000);
+			for(u32 i = 0; i < num; i++)
+			{
+				const std::string name = randomName() + (rnd() % 2 ? ".gba" : "");
+				if(std::find(unique.begin(), unique.end(), name) == unique.end()) unique.push_back(name);
+			}
+
+			// Push in random bursts like scanStep() and merge each burst.
+			FbDir *const dir = fbDirNew();
+			Names all;
+			for(size_t i = 0; i < unique.size();)
+			{
+				const u32 burst = std::min<size_t>(1 + rnd() % (rnd() % 4 == 0 ? 300 : 12), unique.size() - i);
+				for(u32 p = 0; p < burst; p++, i++)
+				{
+					const bool isDir = rnd() % 8 == 0;
+					ok &= fbDirPush(dir, p, unique[i].c_str(), isDir);
+					all.push_back(ent(isDir ? FB_ENT_DIR : FB_ENT_FILE, unique[i]));
+				}
+				fbDirMerge(dir, burst);
+				alwaysSorted &= isSorted(dir);
+			}
+			ok &= listed(dir) == qsorted(all);
+			fbDirDelete(dir);
+		}
+
+		const std::string name = std::string("Merged bursts == qsort(), ") + flagNames[f];
+		check(name.c_str(), ok);
+		check("  ...and stay sorted after each merge", alwaysSorted);
+	}
+	fbSetSortFlags(0);
+}
+
+// Baseline dlistCompare() with unsigned char like on ARM.
+static int oldCompare(const void *a, const void *b)
+{
+	const u8 *entA = *(const u8**)a;
+	const u8 *entB = *(const u8**)b;
+	if(*entA != *entB) return (int)*entB - *entA;
+
+	int res;
+	do
+	{
+		res = *++entA - *++entB;
+	} while(res == 0 && *entA != '\0' && *entB != '\0');
+
+	return res;
+}
+
+static u32 g_refFlags = 0;
+
+static u32 refFold(const u8 c)
+{
+	return (g_refFlags & FB_SORT_IGNORE_CASE && c >= 'A' && c <= 'Z' ? c + 32 : c);
+}
+
+// Independent order definition. Ignore case is strcasecmp(). Natural
+// ordering compares digit runs by value without leading zeros and
+// sorts a digit run against any other character like a digit.
+static int refCompareNames(const char *const nameA, const char *const nameB)
+{
+	if(!(g_refFlags & FB_SORT_NATURAL))
+		return (g_refFlags & FB_SORT_IGNORE_CASE ? strcasecmp(nameA, nameB) : strcmp(nameA, nameB));
+
+	const u8 *a = (const u8*)nameA, *b = (const u8*)nameB;
+	while(*a != '\0' || *b != '\0')
+	{
+		const bool digitA = isdigit(*a), digitB = isdigit(*b);
+		if(digitA && digitB)
+		{
+			std::string runA, runB;
+			while(isdigit(*a)) runA += *a++;
+			while(isdigit(*b)) runB += *b++;
+			runA.erase(0, std::min(runA.find_first_not_of('0'), runA.size() - 1));
+			runB.erase(0, std::min(runB.find_first_not_of('0'), runB.size() - 1));
+			if(runA.size() != runB.size()) return (runA.size() < runB.size() ? -1 : 1);
+			if(runA != runB) return (runA < runB ? -1 : 1);
+			continue;
+		}
+
+		const u32 ca = (digitA ? '0' : refFold(*a)), cb = (digitB ? '0' : refFold(*b));
+		if(ca != cb) return (ca < cb ? -1 : 1);
+		a++;
+		b++;
+	}
+
+	return 0;
+}
+
+static bool refLess(const std::string &a, const std::string &b)
+{
+	if(a[0] != b[0]) return a[0] == FB_ENT_DIR;
+	const int res = refCompareNames(&a[1], &b[1]);
+	if(res != 0) return res < 0;
+	return strcmp(&a[1], &b[1]) < 0;
+}
+
+static int sign(const int x)
+{
+	return (x > 0) - (x < 0);
+}
+
+static void testSortKeys(void)
+{
+	static const u8 flagSets[4] = {0, FB_SORT_NATURAL, FB_SORT_IGNORE_CASE, FB_SORT_NATURAL | FB_SORT_IGNORE_CASE};
+	static const char *const flagNames[4] = {"bytewise", "natural", "no case", "natural, no case"};
+
+	for(u32 f = 0; f < 4; f++)
+	{
+		fbSetSortFlags(flagSets[f]);
+		g_refFlags = flagSets[f];
+
+		// Pairwise. Keys must never contradict the full comparison.
+		bool cmpOk = true, keyOk = true;
+		for(u32 i = 0; i < 200000; i++)
+		{
+			const std::string a = randomName(), b = (rnd() % 4 == 0 ? a + randomName() : randomName());
+			const int res = fbCompareNames(a.c_str(), b.c_str());
+			cmpOk &= sign(res) == sign(refCompareNames(a.c_str(), b.c_str()));
+
+			const u64 keyA = fbSortKey(a.c_str()), keyB = fbSortKey(b.c_str());
+			if(keyA != keyB) keyOk &= (keyA < keyB) == (res < 0);
+		}
+		std::string name = std::string("compareNames() == ref, ") + flagNames[f];
+		check(name.c_str(), cmpOk);
+		name = std::string("  ...sort keys agree with it");
+		check(name.c_str(), keyOk);
+
+		// Whole lists through the qsort() and radix paths.
+		bool sortOk = true, oldOk = true;
+		for(const u32 num : {2u, 10u, 63u, 64u, 65u, 500u, 5000u})
+		{
+			std::vector<std::string> ents;
+			for(u32 i = 0; i < num; i++)
+			{
+				const std::string e = std::string(1, rnd() % 8 == 0 ? FB_ENT_DIR : FB_ENT_FILE) + randomName();
+				if(std::find(ents.begin(), ents.end(), e) == ents.end()) ents.push_back(e);
+			}
+			std::vector<char*> ptrs;
+			for(std::string &e : ents) ptrs.push_back(&e[0]);
+			std::shuffle(ptrs.begin(), ptrs.end(), std::default_random_engine(rnd()));
+			fbSortEntries(ptrs.data(), ptrs.size());
+
+			std::vector<std::string> ref = ents;
+			std::sort(ref.begin(), ref.end(), refLess);
+			for(size_t i = 0; i < ref.size(); i++) sortOk &= ref[i] == std::string(ptrs[i], 1 + strlen(&ptrs[i][1]));
+
+			if(flagSets[f] == 0)
+			{
+				std::vector<char*> old = ptrs;
+				qsort(old.data(), old.size(), sizeof(char*), oldCompare);
+				oldOk &= old == ptrs;
+			}
+		}
+		check("  ...sortEntries() == reference", sortOk);
+		if(flagSets[f] == 0) check("  ...and == the baseline qsort() order", oldOk);
+	}
+
+	g_refFlags = 0;
+	fbSetSortFlags(0);
+}
+
+static void testStreaming(void)
+{
+	fbSetSortFlags(FB_SORT_NATURAL | FB_SORT_IGNORE_CASE);
+	Names ref;
+	makeRomDir("sdmc:/stream", 3000, &ref);
+	for(u32 i = 0; i < 40; i++)
+	{
+		const std::string name = "Folder " + std::to_string(i);
+		makeDir("sdmc:/stream/" + name);
+		ref.push_back(ent(FB_ENT_DIR, name));
+	}
+	setDirTime("sdmc:/stream");
+
+	FbDir *const dir = fbDirNew();
+	hostFsResetStats();
+	fbDirOpen(dir, "sdmc:/stream");
+	check("First page after a few dir reads", fbDirNum(dir) >= 24 && fbDirNum(dir) < 100 && g_hostFsStats.dirReads < 10);
+	check("  ...is sorted", isSorted(dir));
+
+	// The cursor follows its entry while entries are merged in front of it.
+	bool ok = true;
+	u32 cursorPos = fbDirNum(dir) / 2, merges = 0;
+	while(fbDirScanning(dir))
+	{
+		const std::string cursorEnt = &fbDirEntry(dir, cursorPos)[1];
+		if(fbDirStep(dir, 1, &cursorPos))
+		{
+			merges++;
+			ok &= isSorted(dir) && cursorEnt == &fbDirEntry(dir, cursorPos)[1];
+		}
+	}
+	check("Sorted with the cursor kept after each merge", ok);
+	check("Merges are batched", merges > 1 && merges < 30);
+	check("Final list matches one shot qsort()", listed(dir) == qsorted(ref));
+
+	fbDirDelete(dir);
+	fbSetSortFlags(0);
+}
+
+static void testDirCache(void)
+{
+	fbSetSortFlags(0);
+	makeDir("sdmc:/roms");
+	Names ref;
+	for(u32 i = 0; i < 100; i++)
+	{
+		const std::string name = "Game " + std::to_string(i * 7919 % 1000) + ".gba";
+		touch("sdmc:/roms/" + name);
+		ref.push_back(ent(FB_ENT_FILE, name));
+	}
+	for(const char *const name : {"readme.txt", "save.sav", ".hidden.gba", "x.GBA"}) touch(std::string("sdmc:/roms/") + name);
+	for(const char *const name : {"sub b", "Sub a"})
+	{
+		makeDir(std::string("sdmc:/roms/") + name);
+		ref.push_back(ent(FB_ENT_DIR, name));
+	}
+	ref = sorted(ref);
+	setDirTime("sdmc:/roms");
+
+	FbDir *const dir = fbDirNew();
+	check("Cold open scans the directory", !openFromCache(dir, "sdmc:/roms") && fbDirNum(dir) >= 24);
+	fbDirFinish(dir);
+	check("Filtered and sorted", listed(dir) == ref);
+	check("Cache file written", fileExists(cacheFile("sdmc:/roms")));
+
+	check("Warm open shows the cached list", openFromCache(dir, "sdmc:/roms") && listed(dir) == ref);
+	hostFsResetStats();
+	u32 cursorPos = 5;
+	bool changed = false;
+	while(fbDirScanning(dir)) changed |= fbDirStep(dir, 1, &cursorPos);
+	check("Unchanged dir is only checked", !changed && cursorPos == 5 && g_hostFsStats.writes == 0);
+
+	// Added entry. FAT keeps the dir timestamp.
+	touch("sdmc:/roms/Added.gba");
+	setDirTime("sdmc:/roms");
+	ref.push_back(ent(FB_ENT_FILE, "Added.gba"));
+	ref = sorted(ref);
+	check("Added entry: stale list shown first", openFromCache(dir, "sdmc:/roms") && fbDirNum(dir) == ref.size() - 1);
+	const std::string cursorEnt = &fbDirEntry(dir, 50)[1];
+	cursorPos = 50;
+	changed = false;
+	while(fbDirScanning(dir)) changed |= fbDirStep(dir, 1, &cursorPos);
+	check("  ...replaced once the rescan completes", changed && listed(dir) == ref);
+	check("  ...cursor stays on its entry", cursorEnt == &fbDirEntry(dir, cursorPos)[1]);
+	check("  ...and the cache is updated", openFromCache(dir, "sdmc:/roms") && listed(dir) == ref);
+	fbDirFinish(dir);
+
+	// Same count and timestamp. Only the name hash changes.
+	rename(hostPath("sdmc:/roms/Added.gba").c_str(), hostPath("sdmc:/roms/Renamed.gba").c_str());
+	setDirTime("sdmc:/roms");
+	std::replace(ref.begin(), ref.end(), ent(FB_ENT_FILE, "Added.gba"), ent(FB_ENT_FILE, "Renamed.gba"));
+	ref = sorted(ref);
+	openFromCache(dir, "sdmc:/roms");
+	fbDirFinish(dir);
+	check("Renamed entry is detected", listed(dir) == ref);
+
+	// Filtered entries count too. Listing is the same but the stamp is not.
+	touch("sdmc:/roms/notes.txt");
+	setDirTime("sdmc:/roms");
+	openFromCache(dir, "sdmc:/roms");
+	fbDirFinish(dir);
+	check("Filtered entry changes revalidate", listed(dir) == ref && openFromCache(dir, "sdmc:/roms"));
+	fbDirFinish(dir);
+	hostFsResetStats();
+	openFromCache(dir, "sdmc:/roms");
+	fbDirFinish(dir);
+	check("  ...and are cached afterwards", g_hostFsStats.writes == 0);
+
+	// Changed timestamp. The cache is not shown at all.
+	unlink(hostPath("sdmc:/roms/Renamed.gba").c_str());
+	setDirTime("sdmc:/roms", DIR_TIME + 60);
+	ref.erase(std::find(ref.begin(), ref.end(), ent(FB_ENT_FILE, "Renamed.gba")));
+	check("Changed timestamp rescans right away", !openFromCache(dir, "sdmc:/roms"));
+	fbDirFinish(dir);
+	check("  ...with the new list", listed(dir) == ref);
+
+	// Lists sorted with other options can't be reused.
+	fbSetSortFlags(FB_SORT_NATURAL | FB_SORT_IGNORE_CASE);
+	check("Sort option change ignores the cache", !openFromCache(dir, "sdmc:/roms"));
+	fbDirFinish(dir);
+	check("  ...and the new order is cached", openFromCache(dir, "sdmc:/roms"));
+	fbDirFinish(dir);
+	fbSetSortFlags(0);
+	openFromCache(dir, "sdmc:/roms");
+	fbDirFinish(dir);
+
+	// Broken cache files.
+	if(truncate(cacheFile("sdmc:/roms").c_str(), 40 + 10) != 0) hostTestFail();
+	check("Truncated cache file is ignored", !openFromCache(dir, "sdmc:/roms"));
+	fbDirFinish(dir);
+	check("  ...and rewritten", listed(dir) == ref && openFromCache(dir, "sdmc:/roms"));
+	fbDirFinish(dir);
+
+	// Flip a name byte. Size and stamp still match.
+	FILE *const f = fopen(cacheFile("sdmc:/roms").c_str(), "r+b");
+	const u8 bad = 'X';
+	if(f == NULL || fseek(f, 40 + 4, SEEK_SET) != 0 || fwrite(&bad, 1, 1, f) != 1 || fclose(f) != 0) hostTestFail();
+	check("Corrupted entry is detected", !openFromCache(dir, "sdmc:/roms"));
+	fbDirFinish(dir);
+	check("  ...and rewritten", listed(dir) == ref && openFromCache(dir, "sdmc:/roms") && listed(dir) == ref);
+	fbDirFinish(dir);
+
+	// Every directory has its own cache file.
+	makeDir("sdmc:/roms/sub b/deeper");
+	touch("sdmc:/roms/sub b/deeper/Only.gba");
+	setDirTime("sdmc:/roms/sub b/deeper");
+	openFromCache(dir, "sdmc:/roms/sub b/deeper");
+	fbDirFinish(dir);
+	check("Other dirs get their own cache file",
+	      cacheFile("sdmc:/roms") != cacheFile("sdmc:/roms/sub b/deeper") &&
+	      openFromCache(dir, "sdmc:/roms/sub b/deeper") && listed(dir) == Names{ent(FB_ENT_FILE, "Only.gba")});
+	fbDirFinish(dir);
+	check("  ...without touching the first one", openFromCache(dir, "sdmc:/roms") && listed(dir) == ref);
+
+	fbDirDelete(dir);
+	check("No handles left open", hostFsOpenHandles() == 0);
+}
+
+static u32 fsOps(void)
+{
+	return g_hostFsStats.opens + g_hostFsStats.reads + g_hostFsStats.writes + g_hostFsStats.stats +
+	       g_hostFsStats.dirOpens + g_hostFsStats.dirReads + g_hostFsStats.unlinks + g_hostFsStats.mkdirs;
+}
+
+static std::string prevRom(const u32 i)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "sdmc:/prev/Rom %02" PRIu32 ".gba", i);
+	return name;
+}
+
+// ROM with a valid header.
+static void makeHeaderRom(const std::string &path, const std::string &title)
+{
+	u8 rom[0x400]{};
+	memcpy(&rom[0xA0], title.data(), std::min<size_t>(title.size(), 12));
+	memcpy(&rom[0xAC], "AXVE01", 6);
+	rom[0xB2] = 0x96;
+
+	FILE *const f = fopen(hostPath(path).c_str(), "wb");
+	if(f == NULL || fwrite(rom, 1, sizeof(rom), f) != sizeof(rom) || fclose(f) != 0) hostTestFail();
+}
+
+static u32 indexOf(const FbDir *const dir, const std::string &name)
+{
+	for(u32 i = 0; i < fbDirNum(dir); i++)
+	{
+		if(name == &fbDirEntry(dir, i)[1]) return i;
+	}
+
+	hostTestFail();
+	return 0;
+}
+
+struct FetchStats
+{
+	u32 delayOps; // FS calls before the fetch started.
+	u32 maxOps;   // Most FS calls in one frame.
+	u32 frames;   // Frames from the end of the delay until shown. 0 on timeout.
+};
+
+// Rests the cursor on entry cursorPos like browseFiles() until its preview is shown.
+static FetchStats fetch(FbPreview *const preview, const FbDir *const dir, const u32 cursorPos)
+{
+	FetchStats stats{};
+	hostFsResetStats();
+	for(u32 f = 0; f < FB_PREVIEW_DELAY; f++) fbPreviewStep(preview, dir, cursorPos);
+	stats.delayOps = fsOps();
+
+	for(u32 f = 1; f <= 10; f++)
+	{
+		const u32 before = fsOps();
+		const bool shown = fbPreviewStep(preview, dir, cursorPos);
+		stats.maxOps = std::max(stats.maxOps, fsOps() - before);
+		if(shown)
+		{
+			stats.frames = f;
+			break;
+		}
+	}
+
+	return stats;
+}
+
+// Shown right away without any FS access.
+static bool isInstant(FbPreview *const preview, const FbDir *const dir, const u32 cursorPos)
+{
+	bool valid;
+	char title[13];
+	u8 saveType;
+	hostFsResetStats();
+	return fbPreviewStep(preview, dir, cursorPos) && fbPreviewShown(preview, &valid, title, &saveType) && fsOps() == 0;
+}
+
+static void testPreview(void)
+{
+	fbSetSortFlags(0);
+	makeDir("sdmc:/prev");
+	makeDir("sdmc:/prev/Sub");
+	for(u32 i = 0; i < 40; i++) makeHeaderRom(prevRom(i), "TITLE" + std::to_string(i));
+	touch("sdmc:/prev/Bad.gba");
+	setDirTime("sdmc:/prev");
+	makeDir("saves");
+
+	// ROM 3 was launched before. The ROM loader looked up ROM 7 last.
+	RomFingerprint fp3{}, fp7{}, out;
+	fp3.romSize    = 0x400;
+	fp3.dbSaveType = 5;
+	fp7.romSize    = 0x400;
+	fp7.dbSaveType = 9;
+	romCacheLookup(prevRom(3).c_str(), &out);
+	romCacheStore(&fp3);
+	romCacheLookup(prevRom(7).c_str(), &out);
+
+	FbDir *const dir = fbDirNew();
+	fbDirOpen(dir, "sdmc:/prev");
+	fbDirFinish(dir);
+
+	hostFsResetStats();
+	FbPreview *preview = fbPreviewNew();
+	check("ROM cache is read once per browser", g_hostFsStats.opens == 1 && g_hostFsStats.reads == 1);
+	unlink(hostPath("saves/rom_cache.bin").c_str()); // Lookups must come from memory now.
+
+	bool shown = false;
+	hostFsResetStats();
+	for(u32 f = 0; f < 4 * FB_PREVIEW_DELAY; f++) shown |= fbPreviewStep(preview, dir, indexOf(dir, "Sub"));
+	check("Dirs are never fetched", !shown && fsOps() == 0);
+
+	bool valid;
+	char title[13];
+	u8 saveType;
+	const u32 rom0 = indexOf(dir, "Rom 00.gba");
+	FetchStats stats = fetch(preview, dir, rom0);
+	check("Nothing is read before the delay", stats.delayOps == 0);
+	check("One FS call per frame", stats.frames == 3 && stats.maxOps == 1);
+	check("  ...open and read without a cache entry", g_hostFsStats.opens == 1 && g_hostFsStats.reads == 1 && fsOps() == 2);
+	check("  ...shows the header", fbPreviewShown(preview, &valid, title, &saveType) && valid &&
+	      strcmp(title, "TITLE0") == 0 && saveType == GBA_DB_SAVE_UNKNOWN);
+
+	stats = fetch(preview, dir, indexOf(dir, "Rom 03.gba"));
+	check("Cached ROM is stat'ed once", stats.frames == 3 && stats.maxOps == 1 && g_hostFsStats.stats == 1);
+	check("  ...db save type from the loaded cache", fbPreviewShown(preview, &valid, title, &saveType) && saveType == 5);
+
+	stats = fetch(preview, dir, indexOf(dir, "Bad.gba"));
+	check("Short file has no valid header", stats.frames != 0 && fbPreviewShown(preview, &valid, title, &saveType) && !valid);
+	check("Moving to a dir hides the preview", fbPreviewStep(preview, dir, indexOf(dir, "Sub")) &&
+	      !fbPreviewShown(preview, &valid, title, &saveType));
+
+	// Scrolling never rests long enough.
+	hostFsResetStats();
+	shown = false;
+	for(u32 k = 0; k < 8; k++)
+	{
+		for(u32 f = 0; f < FB_PREVIEW_DELAY; f++) shown |= fbPreviewStep(preview, dir, indexOf(dir, (k & 1 ? "Rom 01.gba" : "Rom 02.gba")));
+	}
+	check("Moving the cursor restarts the delay", !shown && fsOps() == 0);
+
+	// Leaving in the middle of a fetch.
+	const u32 rom4 = indexOf(dir, "Rom 04.gba");
+	for(u32 f = 0; f <= FB_PREVIEW_DELAY; f++) fbPreviewStep(preview, dir, rom4);
+	const bool wasOpen = hostFsOpenHandles() == 1;
+	shown = fbPreviewStep(preview, dir, indexOf(dir, "Rom 05.gba"));
+	check("Moving on cancels the fetch", wasOpen && !shown && hostFsOpenHandles() == 0);
+	stats = fetch(preview, dir, rom4);
+	check("  ...and it restarts on return", stats.frames == 3 &&
+	      fbPreviewShown(preview, &valid, title, &saveType) && strcmp(title, "TITLE4") == 0);
+
+	check("Revisits are shown without FS calls", isInstant(preview, dir, rom0) &&
+	      fbPreviewShown(preview, &valid, title, &saveType) && strcmp(title, "TITLE0") == 0);
+
+	// The ROM loader still stores ROM 7.
+	romCacheStore(&fp7);
+	check("Previews keep the ROM loader's key", romCacheLookup(prevRom(7).c_str(), &out) && out.dbSaveType == 9 &&
+	      romCacheLookup(prevRom(3).c_str(), &out) && out.dbSaveType == 5);
+	fbPreviewDelete(preview);
+
+	// LRU.
+	preview = fbPreviewNew();
+	bool ok = true;
+	for(u32 i = 10; i < 10 + FB_PREVIEW_LRU_SIZE; i++) ok &= fetch(preview, dir, indexOf(dir, &prevRom(i)[11])).frames != 0;
+	for(u32 i = 10; i < 10 + FB_PREVIEW_LRU_SIZE; i++) ok &= isInstant(preview, dir, indexOf(dir, &prevRom(i)[11]));
+	check("16 previews stay cached", ok);
+
+	// ROM 10 is used again so ROM 11 is the least recently used.
+	isInstant(preview, dir, indexOf(dir, "Rom 10.gba"));
+	ok = fetch(preview, dir, indexOf(dir, "Rom 30.gba")).frames != 0;
+	fbPreviewStep(preview, dir, indexOf(dir, "Rom 11.gba"));
+	check("17th preview evicts the least recently used", ok && !fbPreviewShown(preview, &valid, title, &saveType));
+	ok = true;
+	for(u32 i = 12; i < 10 + FB_PREVIEW_LRU_SIZE; i++) ok &= isInstant(preview, dir, indexOf(dir, &prevRom(i)[11]));
+	check("  ...and keeps the others", ok && isInstant(preview, dir, indexOf(dir, "Rom 10.gba")) &&
+	      isInstant(preview, dir, indexOf(dir, "Rom 30.gba")));
+
+	fbPreviewDelete(preview);
+	fbDirDelete(dir);
+	check("No handles left open", hostFsOpenHandles() == 0);
+}
+
+static std::vector<std::string> cacheFiles(void)
+{
+	std::vector<std::string> names;
+	DIR *const d = opendir(hostPath("dircache").c_str());
+	if(d == NULL) return names;
+
+	for(const dirent *e = readdir(d); e != NULL; e = readdir(d))
+	{
+		if(e->d_name[0] != '.') names.push_back(e->d_name);
+	}
+	closedir(d);
+
+	return names;
+}
+
+static void setFileTime(const std::string &hostFile, const time_t mtime)
+{
+	const utimbuf times = {mtime, mtime};
+	if(utime(hostFile.c_str(), &times) != 0) hostTestFail();
+}
+
+static std::string manyDir(const u32 i)
+{
+	return "sdmc:/many/d" + std::to_string(i);
+}
+
+// Scans a new dir with one ROM and dates its cache file.
+static void visitNewDir(FbDir *const dir, const std::string &path, const time_t cacheTime)
+{
+	makeDir(path);
+	touch(path + "/Rom.gba");
+	setDirTime(path);
+	fbDirOpen(dir, path.c_str());
+	fbDirFinish(dir);
+	setFileTime(cacheFile(path.c_str()), cacheTime);
+}
+
+static void testDirCacheCap(void)
+{
+	for(const std::string &name : cacheFiles()) unlink(hostPath("dircache/" + name).c_str());
+	fbSetSortFlags(0);
+	makeDir("sdmc:/many");
+
+	// FAT timestamps have 2 s resolution.
+	FbDir *const dir = fbDirNew();
+	const u32 num = FB_DIR_CACHE_MAX + 6;
+	for(u32 i = 0; i < num; i++) visitNewDir(dir, manyDir(i), DIR_TIME + i * 10);
+	check("Cache files are capped", cacheFiles().size() == FB_DIR_CACHE_MAX);
+	bool ok = true;
+	for(u32 i = 0; i < num; i++) ok &= fileExists(cacheFile(manyDir(i).c_str())) == (i >= 6);
+	check("  ...the least recently written are deleted", ok);
+
+	// Updating an existing cache file deletes nothing.
+	touch(manyDir(40) + "/New.gba");
+	setDirTime(manyDir(40));
+	check("Stale dir shows its cached list first", openFromCache(dir, manyDir(40).c_str()));
+	fbDirFinish(dir);
+	check("  ...without evicting", fbDirNum(dir) == 2 && cacheFiles().size() == FB_DIR_CACHE_MAX &&
+	      g_hostFsStats.unlinks == 0);
+
+	// Far over the limit, e.g. from older versions. The oldest go first.
+	const u32 junk = 80;
+	for(u32 i = 0; i < junk; i++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "dircache/%016" PRIX32 ".bin", i);
+		touch(name);
+		setFileTime(hostPath(name), DIR_TIME - 1000 - i * 10);
+	}
+	hostFsResetStats();
+	visitNewDir(dir, "sdmc:/many/new", DIR_TIME + 10000);
+	check("Big cache dir shrinks a few files per save",
+	      g_hostFsStats.unlinks == FB_DIR_CACHE_EVICT && cacheFiles().size() == FB_DIR_CACHE_MAX + junk - FB_DIR_CACHE_EVICT + 1);
+	ok = true;
+	for(u32 i = 0; i < junk; i++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "dircache/%016" PRIX32 ".bin", i);
+		ok &= fileExists(hostPath(name)) == (i < junk - FB_DIR_CACHE_EVICT);
+	}
+	check("  ...oldest first", ok && fileExists(cacheFile("sdmc:/many/new")));
+
+	fbDirDelete(dir);
+	check("No handles left open", hostFsOpenHandles() == 0);
+}
+
+static int runTests(void)
+{
+	testDirCache();
+	testLargeDir();
+	testMerge();
+	testStreaming();
+	testSortKeys();
+	testPreview();
+	testDirCacheCap();
+
+	return hostTestResult();
+}
+
+static double msSince(const u64 start)
+{
+	return (hostNowNs() - start) / 1e6;
+}
+
+static void benchDir(const u32 num)
+{
+	const std::string path = "sdmc:/bench" + std::to_string(num);
+	const u32 nameBytes = makeRomDir(path, num);
+	const std::string cachePath = cacheFile(path.c_str());
+
+	double firstPage = 1e30, scan = 1e30, cached = 1e30, scroll = 1e30;
+	u32 memory = 0;
+	for(u32 run = 0; run < BENCH_RUNS; run++)
+	{
+		// Without cache. openDir() returns once the first page can be shown.
+		unlink(cachePath.c_str());
+		FbDir *const dir = fbDirNew();
+		u64 start = hostNowNs();
+		fbDirOpen(dir, path.c_str());
+		firstPage = std::min(firstPage, msSince(start));
+		fbDirFinish(dir);
+		scan = std::min(scan, msSince(start));
+		memory = fbDirMemory(dir);
+
+		// Scrolling through the list one row per keypress like browseFiles().
+		const u32 presses = std::min(num, 10000u);
+		u32 windowPos = 0;
+		start = hostNowNs();
+		for(u32 cursorPos = 0; cursorPos < presses; cursorPos++)
+		{
+			if(cursorPos >= windowPos + 24) windowPos = cursorPos - 23;
+			fbDirShow(dir, windowPos, cursorPos);
+		}
+		scroll = std::min(scroll, msSince(start) * 1000 / presses);
+		fbDirDelete(dir);
+
+		// From the cache. The check scan runs later between VBlanks.
+		FbDir *const dir2 = fbDirNew();
+		start = hostNowNs();
+		fbDirOpen(dir2, path.c_str());
+		cached = std::min(cached, msSince(start));
+		fbDirDelete(dir2);
+	}
+
+	printf("%6" PRIu32 " %11.2f %10.2f %10.2f %11.3f %10" PRIu32 " %10" PRIu32 "\n",
+	       num, firstPage, scan, cached, scroll, nameBytes / 1024, memory / 1024);
+}
+
+template<typename Sort> static double bestSortMs(const std::vector<char*> &shuffled, Sort sort)
+{
+	double best = 1e30;
+	for(u32 run = 0; run < BENCH_RUNS; run++)
+	{
+		std::vector<char*> ptrs = shuffled;
+		const u64 start = hostNowNs();
+		sort(ptrs.data(), ptrs.size());
+		best = std::min(best, msSince(start));
+	}
+	return best;
+}
+
+static void benchSort(void)
+{
+	static const u8 flagSets[4] = {0, FB_SORT_NATURAL, FB_SORT_IGNORE_CASE, FB_SORT_NATURAL | FB_SORT_IGNORE_CASE};
+	static const char *const flagNames[4] = {"bytewise", "natural", "no case", "natural, no case"};
+
+	printf("Sort, best of %u runs. Shuffled No-Intro like names, 1 in 16 dirs.\n"
+	       "The baseline is qsort() with the old bytewise dlistCompare().\n\n"
+	       "%6s %-16s %11s %11s %11s %8s\n",
+	       BENCH_RUNS, "Entries", "Options", "Baseline ms", "qsort() ms", "Keys ms", "Speedup");
+	for(const u32 num : {100u, 1000u, 10000u, 50000u})
+	{
+		std::vector<std::string> ents;
+		for(u32 i = 0; i < num; i++) ents.push_back(std::string(1, i % 16 == 0 ? FB_ENT_DIR : FB_ENT_FILE) + romName(rnd() % (num * 4)));
+		std::vector<char*> shuffled;
+		for(std::string &e : ents) shuffled.push_back(&e[0]);
+		std::shuffle(shuffled.begin(), shuffled.end(), std::default_random_engine(rnd()));
+
+		const double tOld = bestSortMs(shuffled, [](char **p, u32 n) { qsort(p, n, sizeof(char*), oldCompare); });
+		for(u32 f = 0; f < 4; f++)
+		{
+			fbSetSortFlags(flagSets[f]);
+			const double tQsort = bestSortMs(shuffled, [](char **p, u32 n) { qsort(p, n, sizeof(char*), dlistCompare); });
+			const double tKeys = bestSortMs(shuffled, fbSortEntries);
+			printf("%6" PRIu32 " %-16s %11.3f %11.3f %11.3f %7.2fx\n", num, flagNames[f], tOld, tQsort, tKeys, tOld / tKeys);
+		}
+	}
+	putchar('\n');
+}
+
+static int runBench(void)
+{
+	benchSort();
+
+	fbSetSortFlags(FB_SORT_NATURAL | FB_SORT_IGNORE_CASE);
+
+	printf("Best of %u runs at host FS speed. Memory is arena chunks plus pointers\n"
+	       "(8 bytes each on the host, 4 on the 3DS).\n"
+	       "The old fixed DirList was 203 KiB and capped at 1000 entries.\n\n"
+	       "%6s %11s %10s %10s %11s %10s %10s\n",
+	       BENCH_RUNS, "Entries", "1st page ms", "Scan ms", "Cached ms", "Scroll us/k", "Names KiB", "Mem KiB");
+	for(const u32 num : {100u, 1000u, 10000u, 50000u}) benchDir(num);
+
+	return 0;
+}
+
+int main(const int argc, char *const argv[])
+{
+	const bool test = argc == 2 && strcmp(argv[1], "test") == 0;
+	const bool bench = argc == 2 && strcmp(argv[1], "bench") == 0;
+	if(!test && !bench)
+	{
+		printf("Usage: %s test|bench\n"
+		       "test:  Checks directory cache invalidation and size limit, large directories,\n"
+		       "       the streamed scan merges against one shot qsort() and the ROM preview\n"
+		       "       LRU and fetch scheduler.\n"
+		       "bench: Sort speed and scan, cached open, scroll and memory\n"
+		       "       with 100 to 50k entries.\n",
+		       argv[0]);
+		return 1;
+	}
+
+	if(hostTestDirCreate("fileBrowser") == NULL) return 1;
+
+	const int res = (test ? runTests() : runBench());
+
+	hostTestDirRemove();
+
+	return res;
+}
@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# The kernel is ARM asm so frameConv.cpp has a C++ port of it.
+# Builds color_lut.c unmodified against ../hostStubs for the profile checks.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+
+rm ./frameConv
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DNDEBUG $INCLUDES -c ../hostStubs/hostStubs.c ../../source/arm11/color_lut.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -Wl,--gc-sections ./frameConv.cpp ./*.o -lm -lpthread -o ./frameConv
+rm ./*.o
@@ -0,0 +1,548 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "types.h"
+#include "hostTest.h"
+#include "util.h"
+#include "arm11/config.h"
+#include "arm11/color_lut.h"
+
+
+// See source/arm11/fast_frame_convert.s.
+#define TEX_WIDTH       (512u)
+#define BLOCK_LINES     (8u)
+#define TEX_IN_SIZE     (TEX_WIDTH * TEX_WIDTH * 2) // A1BGR5.
+#define TEX_OUT_SIZE    (TEX_WIDTH * TEX_WIDTH * 4) // RGBA8.
+#define LUT_ENTRIES     (32768u)
+#define LUT_SIZE        (LUT_ENTRIES * 4)
+#define PADDING_MAGIC   (0xA5u)
+#define LUT_FRAC_BITS   (24u) // Same as color_lut.c.
+
+// Timing model. GBA frames are 228 lines of which 160 are visible.
+#define ARM11_HZ        (268111856.0)
+#define GBA_FPS         (59.7275)
+#define GBA_LINES       (228u)
+#define GBA_VISIBLE     (160u)
+#define SIM_FRAMES      (600u)  // 10 seconds.
+#define SIM_CPP         (8.0)   // Default cycles per pixel. Calibrate on hardware.
+#define SIM_FLUSH       (4096u) // Cycles for the D-Cache clean + IPI.
+
+typedef struct
+{
+	u32 width;
+	u32 height;
+} Geometry;
+
+// Instantiated in fast_frame_convert.s plus a few the macro supports.
+static const Geometry g_testGeometries[] =
+{
+	{240, 160}, // convert160pFrameFast.
+	{360, 240}, // convert240pFrameFast.
+	{400, 240},
+	{256, 192},
+	{8,   16}
+};
+
+
+
+typedef struct
+{
+	double start;  // Converter started reading the block (µs from frame start).
+	double done;   // Block fully captured (µs from frame start).
+	double finish; // Converter finished the block.
+} BlockTiming;
+
+typedef struct
+{
+	double worstLag[TEX_WIDTH / BLOCK_LINES];
+	double sumLag[TEX_WIDTH / BLOCK_LINES];
+	double worstSlack;
+	double sumDone;
+	u32 frames;
+	u32 lostIrqs;
+	u32 incomplete; // Frames ending with less than height / 8 blocks.
+	u32 torn;       // Blocks read before LgyCap finished writing them.
+} SimResult;
+
+
+
+// color_lut.c reads its settings from here. config.c isn't linked.
+OafConfig g_oafConfig;
+
+// LgyCap raises a DREQ IRQ each time 8 more lines were written.
+// The line count in REG_LGYCAP_STAT is 0 for the first one.
+// IRQ sources for convertFrameRef(). This one has no timing.
+struct SeqIrqSource
+{
+	u32 height;
+	u32 next;
+	u32 irqs;
+
+	u32 waitIrq(void)
+	{
+		const u32 line = next;
+		next = (line + BLOCK_LINES < height ? line + BLOCK_LINES : 0);
+		irqs++;
+
+		return line;
+	}
+
+	bool blockStart(void) { return true; }
+	void blockEnd(void) {}
+};
+
+// Replays the IRQ stream of a running capture against a cycle cost model.
+// IRQ L of a frame fires once lines 0 to L + 7 are written. Like the GIC
+// only one IRQ can be pending. Others arriving meanwhile are lost.
+// The line count is read at acknowledge time just like the asm does.
+struct TimedIrqSource
+{
+	u32 blocksPerFrame;
+	double period;    // µs.
+	double lineTime;  // µs per captured line.
+	double blockCost; // µs per converted block.
+	double now;       // Converter time in µs.
+	u64 nextIrq;      // Index of the first IRQ not arrived yet at now.
+	u32 frame;        // Frame the converter is working on.
+	u32 block;        // Blocks converted in this frame.
+	double blockDone; // Capture finished time of the current block.
+	SimResult *res;
+
+	double irqTime(const u64 idx) const
+	{
+		return idx / blocksPerFrame * period + (idx % blocksPerFrame + 1) * BLOCK_LINES * lineTime;
+	}
+
+	u32 waitIrq(void)
+	{
+		u32 arrived = 0;
+		while(irqTime(nextIrq) <= now)
+		{
+			nextIrq++;
+			arrived++;
+		}
+		if(arrived == 0)
+		{
+			// wfi.
+			now = irqTime(nextIrq++);
+			arrived = 1;
+		}
+		res->lostIrqs += arrived - 1;
+
+		return (nextIrq - 1) % blocksPerFrame * BLOCK_LINES;
+	}
+
+	// Returns false once the converter would run off the end of the texture.
+	// Happens when a lost IRQ made it miss the line sentinel.
+	bool blockStart(void)
+	{
+		if(block >= TEX_WIDTH / BLOCK_LINES) return false;
+
+		blockDone = frame * period + (block + 1) * BLOCK_LINES * lineTime;
+		if(now < blockDone) res->torn++;
+
+		return true;
+	}
+
+	void blockEnd(void)
+	{
+		now += blockCost;
+		const double lag = now - blockDone;
+		if(lag > res->worstLag[block]) res->worstLag[block] = lag;
+		res->sumLag[block] += lag;
+		block++;
+	}
+};
+
+static bool checkGeometry(const Geometry &geo)
+{
+	// Same checks as the .error in CONVERT_FRAME_FAST.
+	return geo.width % BLOCK_LINES == 0 && geo.height % BLOCK_LINES == 0 && geo.width <= TEX_WIDTH &&
+	       geo.height <= TEX_WIDTH && geo.height >= 2 * BLOCK_LINES;
+}
+
+static u32 load32(const u8 *const p)
+{
+	return p[0] | p[1]<<8 | p[2]<<16 | (u32)p[3]<<24;
+}
+
+static void store32(u8 *const p, const u32 val)
+{
+	p[0] = val;
+	p[1] = val>>8;
+	p[2] = val>>16;
+	p[3] = val>>24;
+}
+
+// Port of one frame of CONVERT_FRAME_FAST. Same walk over memory,
+// same 2 pixels per word extraction and same line sentinel logic.
+template<typename IrqSource>
+static void convertFrameRef(const Geometry &geo, const u8 *const texIn, u8 *const texOut, const u32 *const lut, IrqSource &irq)
+{
+	const u32 blockSize = geo.width * BLOCK_LINES * 2;
+	const u32 inSkip    = (TEX_WIDTH - geo.width) * BLOCK_LINES * 2;
+	const u32 outSkip   = (TEX_WIDTH - geo.width) * BLOCK_LINES * 4;
+	const u32 lastBlock = geo.height - BLOCK_LINES;
+
+	const u8 *in = texIn;
+	u8 *out = texOut;
+	u32 line;
+	do
+	{
+		// Ignore DREQ IRQ for line 0.
+		do
+		{
+			line = irq.waitIrq();
+		} while(line == 0);
+
+		while(1)
+		{
+			if(!irq.blockStart()) return;
+			for(u32 left = blockSize; left != 0; left -= 16)
+			{
+				for(u32 i = 0; i < 4; i++)
+				{
+					const u32 pair = load32(&in[i * 4]);
+					store32(&out[i * 8], lut[pair>>1 & 0x7FFFu]);
+					store32(&out[i * 8 + 4], lut[pair>>17]);
+				}
+				in  += 16;
+				out += 32;
+			}
+			in  += inSkip;
+			out += outSkip;
+			irq.blockEnd();
+
+			// The last 8 lines never get their own IRQ.
+			if(line != lastBlock) break;
+			line = geo.height;
+		}
+	} while(line <= lastBlock);
+}
+
+// Straight per pixel model of the swizzled textures. 8x8 tiles
+// in rows, pixels inside a tile in Morton order.
+static u32 texPixelIndex(const u32 x, const u32 y)
+{
+	u32 morton = 0;
+	for(u32 b = 0; b < 3; b++)
+		morton |= ((x>>b & 1u)<<(2 * b)) | ((y>>b & 1u)<<(2 * b + 1));
+
+	return (y / 8 * (TEX_WIDTH / 8) + x / 8) * 64 + morton;
+}
+
+static void convertFrameGolden(const Geometry &geo, const u8 *const texIn, u8 *const texOut, const u32 *const lut)
+{
+	for(u32 y = 0; y < geo.height; y++)
+	{
+		for(u32 x = 0; x < geo.width; x++)
+		{
+			const u32 idx = texPixelIndex(x, y);
+			const u16 pixel = texIn[idx * 2] | texIn[idx * 2 + 1]<<8;
+			store32(&texOut[idx * 4], lut[pixel>>1]); // Alpha bit dropped.
+		}
+	}
+}
+
+static u32 xorshift32(u32 &state)
+{
+	u32 x = state;
+	x ^= x<<13;
+	x ^= x>>17;
+	x ^= x<<5;
+	state = x;
+
+	return x;
+}
+
+// Golden color of one pixel without lut and thresholds. Config defaults
+// so brightness and contrast drop out and the saturation matrix is 1.
+static u32 colorGolden(const ColorProfile &p, const u32 r, const u32 g, const u32 b)
+{
+	const float corr[3][3] =
+	{
+		{p.r,  p.gr, p.br},
+		{p.rg, p.g,  p.bg},
+		{p.rb, p.gb, p.b}
+	};
+	const u32 in[3] = {r, g, b};
+
+	u32 entry = 255;
+	for(u32 o = 0; o < 3; o++)
+	{
+		// Summed in fixed-point like makeColorLut().
+		s32 sum = 0;
+		for(u32 i = 0; i < 3; i++)
+		{
+			const float lin = fminf(powf((float)rgbFive2Eight(in[i]) / 255, p.targetGamma) * p.lum, 1.f);
+			sum += lroundf(corr[o][i] * lin * (1u<<LUT_FRAC_BITS));
+		}
+
+		const float x = fmaxf((float)sum * (1.f / (1u<<LUT_FRAC_BITS)), 0.f);
+		const long level = lroundf(powf(x, p.displayGamma) * 255);
+		entry |= (u32)(level > 255 ? 255 : level)<<(24 - o * 8);
+	}
+
+	return entry;
+}
+
+// Converts a 240x160 frame containing all 32768 colors with every
+// profile and checks each output pixel against colorGolden().
+static void runProfileTests(u8 *const texIn, u8 *const texOut, u32 *const lut)
+{
+	static const char *const names[8] = {"gba", "gb_micro", "gba_sp101", "nds", "ds_lite", "nso", "vba", "identity"};
+	g_oafConfig.contrast   = 1.f;
+	g_oafConfig.brightness = 0.f;
+	g_oafConfig.saturation = 1.f;
+
+
+	const Geometry geo = {240, 160};
+	u32 seed = 0x4C555421u;
+	memset(texIn, 0, TEX_IN_SIZE);
+	for(u32 y = 0; y < geo.height; y++)
+	{
+		for(u32 x = 0; x < geo.width; x++)
+		{
+			// Random alpha bit. The converter must ignore it.
+			const u32 idx = texPixelIndex(x, y);
+			const u16 pixel = ((y * geo.width + x) & 0x7FFFu)<<1 | (xorshift32(seed) & 1u);
+			texIn[idx * 2]     = pixel;
+			texIn[idx * 2 + 1] = pixel>>8;
+		}
+	}
+
+	for(u32 i = 0; i < 8; i++)
+	{
+		makeColorLut(&g_colorProfiles[i], lut);
+
+		memset(texOut, 0, TEX_OUT_SIZE);
+		SeqIrqSource sim{geo.height, 0, 0};
+		convertFrameRef(geo, texIn, texOut, lut, sim);
+
+		u32 bad = 0;
+		for(u32 y = 0; y < geo.height; y++)
+		{
+			for(u32 x = 0; x < geo.width; x++)
+			{
+				const u32 color = (y * geo.width + x) & 0x7FFFu;
+				const u32 golden = colorGolden(g_colorProfiles[i], color>>10, color>>5 & 31u, color & 31u);
+				if(load32(&texOut[texPixelIndex(x, y) * 4]) != golden) bad++;
+			}
+		}
+
+		char name[64];
+		snprintf(name, sizeof(name), "Profile %s matches colorGolden()", names[i]);
+		check(name, bad == 0);
+	}
+}
+
+static SimResult simulate(const Geometry &geo, const double cyclesPerPixel, const u32 frames,
+                          const u8 *const texIn, u8 *const texOut, const u32 *const lut)
+{
+	SimResult res{};
+	res.worstSlack = INFINITY;
+
+	TimedIrqSource irq{};
+	irq.blocksPerFrame = geo.height / BLOCK_LINES;
+	irq.period         = 1000000 / GBA_FPS;
+	irq.lineTime       = irq.period * GBA_VISIBLE / GBA_LINES / geo.height; // The scaler stretches 160 lines.
+	irq.blockCost      = geo.width * BLOCK_LINES * cyclesPerPixel * 1000000 / ARM11_HZ;
+	irq.res            = &res;
+	for(u32 f = 0; f < frames; f++)
+	{
+		irq.frame = f;
+		irq.block = 0;
+		convertFrameRef(geo, texIn, texOut, lut, irq);
+
+		// D-Cache flush and IPI to core 0.
+		irq.now += SIM_FLUSH * 1000000 / ARM11_HZ;
+		if(irq.block != irq.blocksPerFrame) res.incomplete++;
+
+		const double done = irq.now - f * irq.period;
+		res.sumDone += done;
+		if(irq.period - done < res.worstSlack) res.worstSlack = irq.period - done;
+	}
+	res.frames = frames;
+
+	return res;
+}
+
+static bool simOk(const SimResult &res)
+{
+	return res.lostIrqs == 0 && res.incomplete == 0 && res.torn == 0 && res.worstSlack >= 0;
+}
+
+static int runSim(const double cyclesPerPixel)
+{
+	std::unique_ptr<u8[]> texIn(new u8[TEX_IN_SIZE]);
+	std::unique_ptr<u8[]> texOut(new u8[TEX_OUT_SIZE]);
+	std::unique_ptr<u32[]> lut(new u32[LUT_ENTRIES]);
+	u32 seed = 0x53494D21u;
+	for(u32 i = 0; i < TEX_IN_SIZE; i++) texIn[i] = xorshift32(seed);
+	g_oafConfig.contrast   = 1.f;
+	g_oafConfig.saturation = 1.f;
+	makeColorLut(&g_colorProfiles[0], lut.get());
+
+	const double period = 1000000 / GBA_FPS;
+	int failed = 0;
+	for(u32 i = 0; i < 2; i++) // The 2 geometries used by the firmware.
+	{
+		const Geometry &geo = g_testGeometries[i];
+		const u32 blocks = geo.height / BLOCK_LINES;
+
+		const auto start = std::chrono::steady_clock::now();
+		const SimResult res = simulate(geo, cyclesPerPixel, SIM_FRAMES, texIn.get(), texOut.get(), lut.get());
+		const auto end = std::chrono::steady_clock::now();
+		const double hostUs = std::chrono::duration<double, std::micro>(end - start).count();
+
+		// Largest cost per pixel that still keeps up.
+		double lo = 0, hi = 1024;
+		for(u32 step = 0; step < 24; step++)
+		{
+			const double mid = (lo + hi) / 2;
+			if(simOk(simulate(geo, mid, 60, texIn.get(), texOut.get(), lut.get()))) lo = mid;
+			else                                                                     hi = mid;
+		}
+
+		printf("%" PRIu32 "x%" PRIu32 " @ %.1f cycles/px: %s\n", geo.width, geo.height, cyclesPerPixel,
+		       (simOk(res) ? "OK" : "FAILED"));
+		printf("  block cost %.1f us, IRQ interval %.1f us, break-even %.1f cycles/px\n",
+		       geo.width * BLOCK_LINES * cyclesPerPixel * 1000000 / ARM11_HZ,
+		       period * GBA_VISIBLE / GBA_LINES / geo.height * BLOCK_LINES, lo);
+		printf("  frame done avg %.1f us, worst slack %.1f us of %.1f us\n", res.sumDone / res.frames,
+		       res.worstSlack, period);
+		printf("  model throughput %.1f Mpx/s, host C model %.1f Mpx/s\n", ARM11_HZ / cyclesPerPixel / 1000000,
+		       (double)geo.width * geo.height * SIM_FRAMES / hostUs);
+		printf("  lost IRQs %" PRIu32 ", incomplete frames %" PRIu32 ", torn blocks %" PRIu32 "\n",
+		       res.lostIrqs, res.incomplete, res.torn);
+		printf("  lag behind capture per block in us (avg/worst):\n");
+		for(u32 b = 0; b < blocks; b++)
+			printf("    %2" PRIu32 ": %8.1f %8.1f\n", b, res.sumLag[b] / res.frames, res.worstLag[b]);
+
+		if(!simOk(res)) failed = 1;
+	}
+
+	return failed;
+}
+
+static int runTests(void)
+{
+	std::unique_ptr<u8[]> texIn(new u8[TEX_IN_SIZE]);
+	std::unique_ptr<u8[]> refOut(new u8[TEX_OUT_SIZE]);
+	std::unique_ptr<u8[]> goldenOut(new u8[TEX_OUT_SIZE]);
+	std::unique_ptr<u32[]> lut(new u32[LUT_ENTRIES]);
+
+	u32 seed = 0x4F414621u;
+	for(u32 i = 0; i < TEX_IN_SIZE; i++) texIn[i] = xorshift32(seed);
+	for(u32 i = 0; i < LUT_ENTRIES; i++) lut[i] = xorshift32(seed);
+
+	for(const Geometry &geo : g_testGeometries)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "%" PRIu32 "x%" PRIu32 " is supported", geo.width, geo.height);
+		const bool supported = checkGeometry(geo);
+		check(name, supported);
+		if(!supported) continue;
+
+		// Padding must stay untouched. The GPU samples it.
+		memset(refOut.get(), PADDING_MAGIC, TEX_OUT_SIZE);
+		memset(goldenOut.get(), PADDING_MAGIC, TEX_OUT_SIZE);
+
+		SeqIrqSource sim{geo.height, 0, 0};
+		convertFrameRef(geo, texIn.get(), refOut.get(), lut.get(), sim);
+		convertFrameGolden(geo, texIn.get(), goldenOut.get(), lut.get());
+
+		// The kernel must end right after the last DREQ IRQ of the frame.
+		check("  ...matches the tiled model", memcmp(refOut.get(), goldenOut.get(), TEX_OUT_SIZE) == 0);
+		check("  ...with one IRQ per block", sim.irqs == geo.height / BLOCK_LINES && sim.next == 0);
+	}
+
+	runProfileTests(texIn.get(), refOut.get(), lut.get());
+
+	return hostTestResult();
+}
+
+static bool readFile(const char *const path, u8 *const buf, const u32 size, const bool lastBytes)
+{
+	FILE *const f = fopen(path, "rb");
+	if(f == NULL) return false;
+
+	// color_lut.bin has a header in front of the table.
+	bool ok = true;
+	if(lastBytes) ok = fseek(f, -(long)size, SEEK_END) == 0;
+	ok = ok && fread(buf, 1, size, f) == size;
+	fclose(f);
+
+	return ok;
+}
+
+int main(const int argc, char *const argv[])
+{
+	if(argc == 2 && strcmp(argv[1], "test") == 0) return runTests();
+	if((argc == 2 || argc == 3) && strcmp(argv[1], "sim") == 0)
+		return runSim(argc == 3 ? strtod(argv[2], NULL) : SIM_CPP);
+	if(argc != 6)
+	{
+		printf("Usage: %s test\n"
+		       "       %s sim [CYCLES_PER_PIXEL]\n"
+		       "       %s WIDTH HEIGHT TEXTURE.bin LUT.bin OUT.bin\n"
+		       "TEXTURE.bin is a 512x512 swizzled A1BGR5 texture dump.\n"
+		       "LUT.bin is a raw 32768 entry table or color_lut.bin.\n",
+		       argv[0], argv[0], argv[0]);
+		return 1;
+	}
+
+	const Geometry geo = {(u32)strtoul(argv[1], NULL, 0), (u32)strtoul(argv[2], NULL, 0)};
+	if(!checkGeometry(geo))
+	{
+		fprintf(stderr, "Unsupported geometry.\n");
+		return 2;
+	}
+
+	std::unique_ptr<u8[]> texIn(new u8[TEX_IN_SIZE]);
+	std::unique_ptr<u8[]> texOut(new u8[TEX_OUT_SIZE]());
+	std::unique_ptr<u8[]> lutBuf(new u8[LUT_SIZE]);
+	if(!readFile(argv[3], texIn.get(), TEX_IN_SIZE, false) || !readFile(argv[4], lutBuf.get(), LUT_SIZE, true))
+	{
+		fprintf(stderr, "Failed to read input files.\n");
+		return 3;
+	}
+
+	std::unique_ptr<u32[]> lut(new u32[LUT_ENTRIES]);
+	for(u32 i = 0; i < LUT_ENTRIES; i++) lut[i] = load32(&lutBuf[i * 4]);
+
+	SeqIrqSource sim{geo.height, 0, 0};
+	convertFrameRef(geo, texIn.get(), texOut.get(), lut.get(), sim);
+
+	FILE *const f = fopen(argv[5], "wb");
+	if(f == NULL || fwrite(texOut.get(), 1, TEX_OUT_SIZE, f) != TEX_OUT_SIZE)
+	{
+		fprintf(stderr, "Failed to write output file.\n");
+		if(f != NULL) fclose(f);
+		return 4;
+	}
+	fclose(f);
+
+	return 0;
+}
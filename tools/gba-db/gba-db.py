@@ -1,6 +1,6 @@
 #!/usr/bin/env python3
 
-# open_agb_firm gba_db.bin Builder v4.0
+# open_agb_firm gba_db.bin Builder v5.0
 # By HTV04
 #
 # This script parses MAME's "gba.xml" (https://github.com/mamedev/mame/blob/master/hash/gba.xml)
@@ -40,6 +40,13 @@ import sys
 import re
 import xml.etree.ElementTree
 import csv
+import struct
+
+# gba_db.bin v1 header. See GbaDbHeader in include/arm11/save_type.h.
+DB_MAGIC = 0x42444247 # "GBDB"
+DB_VERSION = 1
+DB_ENTRY_SIZE = 28
+DB_HEADER_SIZE = 16 + 257 * 4
 
 class Entry:
 	def __init__(self):
@@ -157,6 +164,10 @@ class Database:
 
 		log('Starting log...\n\n')
 
+		if '--convert' in sys.argv:
+			self.load(sys.argv[sys.argv.index('--convert') + 1], log)
+			return
+
 		fail_count = 0
 		count = 0
 
@@ -202,15 +213,53 @@ class Database:
 
 		log('Compiled with ' + str(count) + ' entries, ' + str(fail_count) + ' failures.\n')
 
-	def compile(self, out):
-		for entry in sorted(self.entries, key=lambda a: int.from_bytes(a.sha1[:8], byteorder='little')):
+	def load(self, path, log):
+		# Load entries from an existing gba_db.bin in either format.
+		with open(path, 'rb') as f:
+			data = f.read()
+
+		start = 0
+		if len(data) >= DB_HEADER_SIZE:
+			magic, version, entry_size, num_entries = struct.unpack_from('<IHHI', data)
+			if magic == DB_MAGIC and version == DB_VERSION and entry_size == DB_ENTRY_SIZE and \
+			   len(data) == DB_HEADER_SIZE + num_entries * DB_ENTRY_SIZE:
+				start = DB_HEADER_SIZE
+		if (len(data) - start) % DB_ENTRY_SIZE != 0:
+			raise Exception('Database size is not a multiple of 28')
+
+		for offset in range(start, len(data), DB_ENTRY_SIZE):
+			entry = Entry()
+			entry.sha1 = data[offset:offset + 20]
+			entry.serial = data[offset + 20:offset + 24]
+			entry.attr = data[offset + 24:offset + 28]
+			self.entries.append(entry)
+
+		log('Converted "' + path + '" with ' + str(len(self.entries)) + ' entries.\n')
+
+	def compile(self, out, legacy=False):
+		if legacy:
+			# Headerless, sorted by the first 8 SHA-1 bytes as little endian integer.
+			entries = sorted(self.entries, key=lambda a: int.from_bytes(a.sha1[:8], byteorder='little'))
+		else:
+			# Sorted by SHA-1 bytes with a fan-out table over the first byte.
+			entries = sorted(self.entries, key=lambda a: a.sha1)
+			fanout = [0] * 257
+			for entry in entries:
+				fanout[entry.sha1[0] + 1] += 1
+			for i in range(256):
+				fanout[i + 1] += fanout[i]
+
+			out(struct.pack('<IHHII', DB_MAGIC, DB_VERSION, DB_ENTRY_SIZE, len(entries), 0))
+			out(struct.pack('<257I', *fanout))
+
+		for entry in entries:
 			out(entry.sha1)
 			out(entry.serial)
 			out(entry.attr)
 
 if __name__ == '__main__':
 	if '--help' in sys.argv:
-		print('open_agb_firm gba_db.bin Builder v4.0')
+		print('open_agb_firm gba_db.bin Builder v5.0')
 		print('By HTV04')
 		print()
 		print('Usage: gba-db.py [options]')
@@ -219,7 +268,10 @@ if __name__ == '__main__':
 		print('  --dat: Use No-Intro "gba.dat" for verification')
 		print('  --csv: Use "gba.csv" for additional entries and overrides')
 		print()
+		print('  --convert [file]: Use entries from an existing gba_db.bin instead of "gba.xml"')
+		print()
 		print('  --out [file]: Output to [file] instead of "gba_db.bin"')
+		print('  --legacy: Output the old headerless format')
 		print()
 		print('  --help: Display this help message and exit')
 
@@ -236,4 +288,4 @@ if __name__ == '__main__':
 	if '--out' in sys.argv:
 		out = sys.argv[sys.argv.index('--out') + 1]
 	with open(out, 'wb') as f:
-		db.compile(f.write)
+		db.compile(f.write, '--legacy' in sys.argv)
@@ -0,0 +1,343 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "arm11/config.h"
+#include "arm11/save_type.h"
+
+
+#define DB_ENTRIES    (3000u) // About the size of the real gba_db.bin.
+#define BENCH_RUNS    (5u)
+#define AUTO_SAVE     (14u)   // Returned by getSaveType() if the db has no entry.
+#define SAVE_PATH     "sdmc:/missing.sav"
+
+
+// getSaveType() only shows its menu with saveOverride set which
+// these tests never do. Fail loudly if it ever gets there.
+extern "C"
+{
+static u32 g_errorsShown = 0;
+void printErrorWaitInput(UNUSED Result res, UNUSED u32 waitKeys) { g_errorsShown++; }
+static void menuReached(void) { fprintf(stderr, "Save type menu reached!\n"); exit(3); }
+void tgClear(void) { menuReached(); }
+void tgBeginFrame(void) { menuReached(); }
+void tgPrint(UNUSED const u32 row, UNUSED const u32 col, UNUSED const u8 color, UNUSED const char *str) { menuReached(); }
+void tgPresent(void) { menuReached(); }
+void GFX_flushBuffers(void) { menuReached(); }
+void GFX_waitForVBlank0(void) { menuReached(); }
+void hidScanInput(void) { menuReached(); }
+u32 hidGetExtraKeys(UNUSED u32 clear) { menuReached(); return 0; }
+u32 hidKeysDown(void) { menuReached(); return 0; }
+}
+
+struct IoCount
+{
+	u64 lookups;
+	u64 opens;
+	u64 reads;
+	u64 seeks;
+	u64 bytesRead;
+	u32 maxReads;
+	double ms;
+};
+
+
+
+static std::string g_tmpDir;
+static u32 g_rng = 0x47424442u;
+
+static u32 rnd(void)
+{
+	// xorshift32.
+	g_rng ^= g_rng<<13;
+	g_rng ^= g_rng>>17;
+	g_rng ^= g_rng<<5;
+	return g_rng;
+}
+
+static u64 sha1Prefix(const GbaDbEntry &e)
+{
+	u64 x;
+	memcpy(&x, e.sha1, 8);
+	return x;
+}
+
+static std::vector<GbaDbEntry> makeEntries(const u32 num)
+{
+	std::vector<GbaDbEntry> entries(num);
+	for(GbaDbEntry &e : entries)
+	{
+		for(u32 i = 0; i < 20; i++) e.sha1[i] = rnd();
+		for(u32 i = 0; i < 4; i++) e.serial[i] = 'A' + rnd() % 26;
+		e.attr = rnd() % 14; // Save type in the low 4 bits. Never AUTO_SAVE so misses stand out.
+	}
+
+	return entries;
+}
+
+static bool writeFile(const std::string &name, const std::vector<u8> &data)
+{
+	FILE *const f = fopen((g_tmpDir + "/" + name).c_str(), "wb");
+	if(f == NULL) return false;
+	const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+
+	return (fclose(f) == 0 && ok);
+}
+
+static bool readFile(const std::string &name, std::vector<u8> &data)
+{
+	FILE *const f = fopen((g_tmpDir + "/" + name).c_str(), "rb");
+	if(f == NULL) return false;
+	data.clear();
+	u8 buf[4096];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+
+	return fclose(f) == 0;
+}
+
+// Same layouts gba-db.py writes.
+static std::vector<u8> buildLegacy(std::vector<GbaDbEntry> entries)
+{
+	std::sort(entries.begin(), entries.end(),
+	          [](const GbaDbEntry &a, const GbaDbEntry &b) { return sha1Prefix(a) < sha1Prefix(b); });
+
+	std::vector<u8> out(sizeof(GbaDbEntry) * entries.size());
+	memcpy(out.data(), entries.data(), out.size());
+	return out;
+}
+
+static std::vector<u8> buildIndexed(std::vector<GbaDbEntry> entries)
+{
+	std::sort(entries.begin(), entries.end(),
+	          [](const GbaDbEntry &a, const GbaDbEntry &b) { return memcmp(a.sha1, b.sha1, 20) < 0; });
+
+	GbaDbHeader header{};
+	header.magic = GBA_DB_MAGIC;
+	header.version = GBA_DB_VERSION;
+	header.entrySize = sizeof(GbaDbEntry);
+	header.numEntries = entries.size();
+	for(const GbaDbEntry &e : entries) header.fanout[e.sha1[0] + 1]++;
+	for(u32 i = 0; i < 256; i++) header.fanout[i + 1] += header.fanout[i];
+
+	std::vector<u8> out(sizeof(header) + sizeof(GbaDbEntry) * entries.size());
+	memcpy(out.data(), &header, sizeof(header));
+	memcpy(out.data() + sizeof(header), entries.data(), sizeof(GbaDbEntry) * entries.size());
+	return out;
+}
+
+// Runs one getSaveType() lookup like the ROM loader does and
+// counts the gba_db.bin accesses. The save file fStat() is excluded.
+static u16 lookup(const u64 x, u8 &dbSaveType, IoCount &io)
+{
+	static OafConfig cfg{}; // saveOverride = false.
+
+	dbSaveType = GBA_DB_SAVE_UNKNOWN;
+	hostFsResetStats();
+	const u64 t = hostNowNs();
+	const u16 saveType = getSaveType(&cfg, 0x1000000, AUTO_SAVE, x, &dbSaveType, SAVE_PATH);
+	io.ms += (hostNowNs() - t) / 1e6;
+
+	io.lookups++;
+	io.opens += g_hostFsStats.opens;
+	io.reads += g_hostFsStats.reads;
+	io.seeks += g_hostFsStats.seeks;
+	io.bytesRead += g_hostFsStats.bytesRead;
+	io.maxReads = std::max(io.maxReads, g_hostFsStats.reads);
+
+	return saveType;
+}
+
+// Looks up every entry and as many misses. Returns the number of wrong results.
+static u32 lookupAll(const std::vector<GbaDbEntry> &entries, const std::vector<u64> &misses, IoCount &hits, IoCount &miss)
+{
+	u32 failed = 0;
+	for(const GbaDbEntry &e : entries)
+	{
+		u8 dbSaveType;
+		const u16 saveType = lookup(sha1Prefix(e), dbSaveType, hits);
+		failed += saveType != (e.attr & 0xFu) || dbSaveType != (e.attr & 0xFu);
+	}
+	for(const u64 x : misses)
+	{
+		u8 dbSaveType;
+		const u16 saveType = lookup(x, dbSaveType, miss);
+		failed += saveType != AUTO_SAVE || dbSaveType != GBA_DB_SAVE_NOT_FOUND;
+	}
+
+	return failed + (hostFsOpenHandles() != 0);
+}
+
+static std::vector<u64> makeMisses(const std::vector<GbaDbEntry> &entries)
+{
+	// Random prefixes plus near misses sharing the first byte or 7 bytes.
+	std::vector<u64> misses;
+	for(u32 i = 0; i < entries.size(); i++)
+	{
+		u64 x = sha1Prefix(entries[i]);
+		if(i % 3 == 0)      x = (u64)rnd()<<32 | rnd();
+		else if(i % 3 == 1) x ^= (u64)rnd()<<8 | 1u<<8;
+		else                x ^= 1ull<<63;
+		misses.push_back(x);
+	}
+
+	std::vector<u64> known;
+	for(const GbaDbEntry &e : entries) known.push_back(sha1Prefix(e));
+	std::sort(known.begin(), known.end());
+	misses.erase(std::remove_if(misses.begin(), misses.end(),
+	             [&](const u64 x) { return std::binary_search(known.begin(), known.end(), x); }), misses.end());
+
+	return misses;
+}
+
+// Converts with tools/gba-db/gba-db.py --convert [--legacy].
+static bool runConverter(const char *const script, const std::string &in, const std::string &out, const bool legacy)
+{
+	const std::string cmd = std::string("python3 ") + script + " --convert " + g_tmpDir + "/" + in +
+	                        " --out " + g_tmpDir + "/" + out + (legacy ? " --legacy" : "");
+	return system(cmd.c_str()) == 0;
+}
+
+static int runTests(const char *const script)
+{
+	const std::vector<GbaDbEntry> entries = makeEntries(DB_ENTRIES);
+	const std::vector<u64> misses = makeMisses(entries);
+	const std::vector<u8> legacy = buildLegacy(entries);
+	const std::vector<u8> indexed = buildIndexed(entries);
+	if(!writeFile("legacy.bin", legacy) || !writeFile("indexed.bin", indexed))
+	{
+		fprintf(stderr, "Failed to write dbs.\n");
+		return 1;
+	}
+
+	// Both directions must reproduce the other format byte for byte.
+	std::vector<u8> conv;
+	check("gba-db.py --convert legacy.bin", runConverter(script, "legacy.bin", "conv_indexed.bin", false) &&
+	      readFile("conv_indexed.bin", conv) && conv == indexed);
+	check("gba-db.py --convert indexed.bin --legacy", runConverter(script, "indexed.bin", "conv_legacy.bin", true) &&
+	      readFile("conv_legacy.bin", conv) && conv == legacy);
+
+	static const char *const formats[2] = {"legacy.bin", "indexed.bin"};
+	for(const char *const format : formats)
+	{
+		const std::string db = g_tmpDir + "/gba_db.bin";
+		if(rename((g_tmpDir + "/" + format).c_str(), db.c_str()) != 0) return 1;
+
+		IoCount hits{}, miss{};
+		const u32 wrong = lookupAll(entries, misses, hits, miss);
+		char name[64];
+		snprintf(name, sizeof(name), "%-11s %" PRIu64 " hits, %" PRIu64 " misses", format, hits.lookups, miss.lookups);
+		check(name, wrong == 0);
+
+		if(rename(db.c_str(), (g_tmpDir + "/" + format).c_str()) != 0) return 1;
+	}
+
+	// Broken indexed dbs fall back to the legacy search and must not crash.
+	// Missing dbs show an error and use the autodetected save type.
+	std::vector<u8> broken = indexed;
+	GbaDbHeader *const header = (GbaDbHeader*)broken.data();
+	header->fanout[100] = header->fanout[101] + 1;
+	writeFile("gba_db.bin", broken);
+	IoCount io{};
+	u8 dbSaveType;
+	lookup(sha1Prefix(entries[0]), dbSaveType, io);
+	check("Broken fan-out table", dbSaveType != GBA_DB_SAVE_UNKNOWN && hostFsOpenHandles() == 0);
+
+	unlink((g_tmpDir + "/gba_db.bin").c_str());
+	check("Missing gba_db.bin", lookup(sha1Prefix(entries[0]), dbSaveType, io) == AUTO_SAVE && g_errorsShown == 1 &&
+	      dbSaveType == GBA_DB_SAVE_UNKNOWN && hostFsOpenHandles() == 0);
+
+	return hostTestResult();
+}
+
+static void printIo(const char *const name, const IoCount &io)
+{
+	const double n = io.lookups;
+	printf("%-17s %5.2f opens %6.2f seeks %6.2f reads (max %2" PRIu32 ") %8.1f bytes %8.2f us per lookup\n",
+	       name, io.opens / n, io.seeks / n, io.reads / n, io.maxReads, io.bytesRead / n, io.ms * 1000 / n);
+}
+
+static int runBench(const u32 numEntries)
+{
+	const std::vector<GbaDbEntry> entries = makeEntries(numEntries);
+	const std::vector<u64> misses = makeMisses(entries);
+
+	printf("%" PRIu32 " entries. Host time is the sum of best runs and only a rough hint,\n"
+	       "on the 3DS every read and seek costs SD card latency.\n", numEntries);
+	static const char *const names[2][2] = {{"legacy hit", "legacy miss"}, {"indexed hit", "indexed miss"}};
+	for(u32 f = 0; f < 2; f++)
+	{
+		if(!writeFile("gba_db.bin", (f == 0 ? buildLegacy(entries) : buildIndexed(entries)))) return 1;
+
+		IoCount hits{}, miss{};
+		double bestHits = 1e30, bestMiss = 1e30;
+		u32 failed = 0;
+		for(u32 i = 0; i < BENCH_RUNS; i++)
+		{
+			const double h = hits.ms, m = miss.ms;
+			failed += lookupAll(entries, misses, hits, miss);
+			bestHits = std::min(bestHits, hits.ms - h);
+			bestMiss = std::min(bestMiss, miss.ms - m);
+		}
+		hits.ms = bestHits * BENCH_RUNS;
+		miss.ms = bestMiss * BENCH_RUNS;
+		printIo(names[f][0], hits);
+		printIo(names[f][1], miss);
+		if(failed != 0) printf("%" PRIu32 " lookups FAILED\n", failed);
+	}
+
+	return 0;
+}
+
+int main(const int argc, char *const argv[])
+{
+	const bool test = argc >= 2 && strcmp(argv[1], "test") == 0;
+	const bool bench = argc >= 2 && strcmp(argv[1], "bench") == 0;
+	if((!test && !bench) || argc > 3)
+	{
+		printf("Usage: %s test [gba-db.py]\n"
+		       "       %s bench [ENTRIES]\n"
+		       "test:  Round-trips gba_db.bin through gba-db.py --convert [--legacy]\n"
+		       "       and checks getSaveType() lookups on both formats.\n"
+		       "       gba-db.py defaults to ../gba-db/gba-db.py.\n"
+		       "bench: SD card accesses per lookup for the legacy and indexed format.\n",
+		       argv[0], argv[0]);
+		return 1;
+	}
+
+	const char *const tmpDir = hostTestDirCreate("gbaDbIo");
+	if(tmpDir == NULL) return 1;
+	g_tmpDir = tmpDir;
+
+	int res;
+	if(test) res = runTests(argc > 2 ? argv[2] : "../gba-db/gba-db.py");
+	else     res = runBench(argc > 2 ? strtoul(argv[2], NULL, 0) : DB_ENTRIES);
+
+	hostTestDirRemove();
+
+	return res;
+}
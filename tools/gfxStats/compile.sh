@@ -0,0 +1,11 @@
+#!/bin/bash
+
+# Builds gfx_stats.c unmodified against ../hostStubs.
+# memcpy() is wrapped to add frames in the middle of a snapshot.
+# -fno-builtin-memcpy keeps gcc from inlining the snapshot copy.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+
+rm ./gfxStats
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DTRACE_HOST_CLOCK -fno-builtin-memcpy $INCLUDES -c ../hostStubs/hostStubs.c ../../source/arm11/gfx_stats.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DTRACE_HOST_CLOCK $INCLUDES -Wl,--gc-sections,--wrap=memcpy ./gfxStats.cpp ./hostStubs.o ./gfx_stats.o -lpthread -o ./gfxStats
+rm ./*.o
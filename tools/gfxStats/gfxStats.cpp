@@ -0,0 +1,420 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "arm11/gfx_stats.h"
+
+
+#define SERIALIZE_SIZE  (96u * (GFX_STAGE_NUM + 3)) // SERIALIZE_SIZE in gfx_stats.c.
+#define STAGE_TICKS     (100u)                       // Per stage in makeStamps().
+#define BENCH_RUNS      (5u)
+#define BENCH_FRAMES    (1000000u)
+
+
+static const char *const g_stageNames[GFX_STAGE_NUM] = {"submit", "p3d", "ppf", "swap", "total", "interval"};
+
+
+
+static u32 g_rng = 0x47465853u;
+
+// Copy to hook in __wrap_memcpy() and what to run in the middle of it.
+static const void *g_hookSrc = NULL;
+static void (*g_hookFn)(void) = NULL;
+static u32 g_hookCopies = 0;
+
+extern "C" void* __real_memcpy(void *dst, const void *src, size_t n);
+extern "C" void* __wrap_memcpy(void *dst, const void *src, size_t n)
+{
+	if(src != g_hookSrc || n != sizeof(GfxStats)) return __real_memcpy(dst, src, n);
+
+	// Like the gfx handler preempting the dump task half way through the copy.
+	g_hookCopies++;
+	__real_memcpy(dst, src, n / 2);
+	if(g_hookFn != NULL)
+	{
+		void (*const fn)(void) = g_hookFn;
+		g_hookFn = NULL;
+		fn();
+	}
+	__real_memcpy((u8*)dst + n / 2, (const u8*)src + n / 2, n - n / 2);
+
+	return dst;
+}
+
+static u32 rnd(void)
+{
+	// xorshift32.
+	g_rng ^= g_rng<<13;
+	g_rng ^= g_rng>>17;
+	g_rng ^= g_rng<<5;
+	return g_rng;
+}
+
+// Upper bound of the bucket holding ticks. 8 buckets per power of 2 up to 2^24.
+// The last bucket (15 * 2^20 and up) also holds everything above.
+static u32 refUpperBound(const u32 ticks)
+{
+	if(ticks < 8) return ticks;
+	if(ticks >= 15u<<20) return UINT32_MAX;
+
+	const u32 shift = 31 - __builtin_clz(ticks) - 3;
+	return ticks | ((1u<<shift) - 1);
+}
+
+static u32 refPercentile(std::vector<u32> samples, const u32 permille)
+{
+	std::sort(samples.begin(), samples.end());
+	const u32 rank = std::max<u64>(((u64)samples.size() * permille + 999) / 1000, 1);
+	return std::min(refUpperBound(samples[rank - 1]), samples.back());
+}
+
+// Stamps for a frame starting at ready with STAGE_TICKS per stage.
+static void makeStamps(const u32 ready, u32 stamps[GFX_STAMP_NUM])
+{
+	for(u32 i = 0; i < GFX_STAMP_NUM; i++) stamps[i] = ready + i * STAGE_TICKS;
+}
+
+// Every frame from makeStamps() adds the same amount to each stage.
+static bool isConsistent(const GfxStats &stats)
+{
+	const u32 frames = stats.hist[GFX_STAGE_SUBMIT].count;
+	bool ok = stats.seq % 2 == 0 && frames > 0;
+	for(u32 i = 0; i < GFX_STAGE_TOTAL; i++)
+	{
+		ok &= stats.hist[i].count == frames && stats.hist[i].sum == (u64)frames * STAGE_TICKS;
+	}
+	ok &= stats.hist[GFX_STAGE_TOTAL].count == frames && stats.hist[GFX_STAGE_TOTAL].sum == (u64)frames * STAGE_TICKS * 4;
+	ok &= stats.hist[GFX_STAGE_INTERVAL].count == frames - 1;
+
+	return ok;
+}
+
+static void testBuckets(void)
+{
+	static const u32 values[] =
+	{
+		0, 1, 7, 8, 9, 15, 16, 17, 31, 32, 33, 255, 256, 257, 1000, 4095, 4096, 4097,
+		GFXSTATS_FRAME_TICKS, (1u<<23) - 1, 1u<<23, (15u<<20) - 1, 15u<<20, 1u<<24, 1u<<30, UINT32_MAX - 1
+	};
+
+	// The max sample makes the percentile report the bucket bound instead of the max.
+	bool ok = true;
+	for(const u32 v : values)
+	{
+		GfxHist hist{};
+		gfxHistAdd(&hist, v);
+		gfxHistAdd(&hist, UINT32_MAX);
+		const u32 upper = gfxHistPercentile(&hist, 500);
+		if(upper != refUpperBound(v))
+		{
+			printf("%" PRIu32 ": bucket bound %" PRIu32 ", expected %" PRIu32 "\n", v, upper, refUpperBound(v));
+			ok = false;
+		}
+	}
+	check("Bucket upper bounds match the reference", ok);
+
+	ok = true;
+	for(u32 v = 8; v < 15u<<20; v += 1 + v / 64) ok &= refUpperBound(v) - v <= v / 8;
+	check("Bucket error stays within 12.5%", ok);
+
+	GfxHist hist{};
+	check("Empty histogram percentile is 0", gfxHistPercentile(&hist, 990) == 0);
+	gfxHistAdd(&hist, 1000);
+	check("Single sample percentiles are the sample",
+	      gfxHistPercentile(&hist, 0) == 1000 && gfxHistPercentile(&hist, 990) == 1000 &&
+	      gfxHistPercentile(&hist, 1000) == 1000);
+	gfxHistAdd(&hist, 5);
+	gfxHistAdd(&hist, 1u<<26);
+	check("Min, max and sum", hist.count == 3 && hist.min == 5 && hist.max == 1u<<26 && hist.sum == 1005 + (1u<<26));
+	check("Overflow bucket reports the max", gfxHistPercentile(&hist, 1000) == 1u<<26);
+}
+
+static void testPercentiles(void)
+{
+	static const u32 permilles[] = {0, 1, 250, 500, 900, 990, 999, 1000};
+	static const u32 counts[] = {1, 2, 3, 10, 99, 1000, 12345};
+
+	bool ok = true;
+	for(const u32 count : counts)
+	{
+		for(u32 dist = 0; dist < 3; dist++)
+		{
+			GfxHist hist{};
+			std::vector<u32> samples;
+			for(u32 i = 0; i < count; i++)
+			{
+				// Uniform, steady with rare spikes and log uniform.
+				u32 v;
+				if(dist == 0)      v = rnd() % 100000;
+				else if(dist == 1) v = 25000 + rnd() % 500 + (rnd() % 100 == 0 ? rnd() % 500000 : 0);
+				else               v = rnd() >> (rnd() % 32);
+				gfxHistAdd(&hist, v);
+				samples.push_back(v);
+			}
+
+			for(const u32 p : permilles)
+			{
+				const u32 res = gfxHistPercentile(&hist, p);
+				const u32 ref = refPercentile(samples, p);
+				if(res != ref)
+				{
+					printf("%" PRIu32 " samples, distribution %" PRIu32 ", p%" PRIu32 ": %" PRIu32 ", expected %" PRIu32 "\n",
+					       count, dist, p, res, ref);
+					ok = false;
+				}
+			}
+		}
+	}
+	check("Percentiles match sorted samples", ok);
+}
+
+static void testWraparound(void)
+{
+	GfxStats stats{};
+	u32 stamps[GFX_STAMP_NUM];
+
+	// Stages across the 32 bit counter wrap.
+	makeStamps(UINT32_MAX - 150, stamps);
+	gfxStatsFrame(&stats, stamps);
+	makeStamps(UINT32_MAX - 150 + GFXSTATS_FRAME_TICKS, stamps);
+	gfxStatsFrame(&stats, stamps);
+	check("Stage times across the counter wrap", isConsistent(stats) && stats.hist[GFX_STAGE_TOTAL].max == STAGE_TICKS * 4);
+	check("Frame interval across the counter wrap",
+	      stats.hist[GFX_STAGE_INTERVAL].min == GFXSTATS_FRAME_TICKS && stats.late == 0 && stats.dup == 0);
+
+	// A READY stamp of 0 must not look like the first frame again.
+	stats = GfxStats{};
+	makeStamps(0u - GFXSTATS_FRAME_TICKS, stamps);
+	gfxStatsFrame(&stats, stamps);
+	makeStamps(0, stamps);
+	gfxStatsFrame(&stats, stamps);
+	makeStamps(GFXSTATS_FRAME_TICKS, stamps);
+	gfxStatsFrame(&stats, stamps);
+	check("READY stamp 0 still counts intervals", stats.hist[GFX_STAGE_INTERVAL].count == 2);
+
+	// Late and duplicate frames.
+	stats = GfxStats{};
+	static const u32 intervals[] =
+	{
+		GFXSTATS_FRAME_TICKS, GFXSTATS_FRAME_TICKS * 2, GFXSTATS_FRAME_TICKS / 3, GFXSTATS_FRAME_TICKS + GFXSTATS_FRAME_TICKS / 2,
+		GFXSTATS_FRAME_TICKS + GFXSTATS_FRAME_TICKS / 2 + 1, GFXSTATS_FRAME_TICKS / 2, GFXSTATS_FRAME_TICKS / 2 - 1
+	};
+	u32 ready = 1000;
+	makeStamps(ready, stamps);
+	gfxStatsFrame(&stats, stamps);
+	for(const u32 interval : intervals)
+	{
+		ready += interval;
+		makeStamps(ready, stamps);
+		gfxStatsFrame(&stats, stamps);
+	}
+	check("Late and duplicate frame counts", stats.late == 2 && stats.dup == 2 && isConsistent(stats));
+}
+
+static void testSerialize(void)
+{
+	GfxStats stats{};
+	u32 stamps[GFX_STAMP_NUM];
+	for(u32 i = 0; i < 100; i++)
+	{
+		makeStamps(i * GFXSTATS_FRAME_TICKS, stamps);
+		stamps[GFX_STAMP_P3D] += rnd() % 5000;
+		stamps[GFX_STAMP_PPF] += stamps[GFX_STAMP_P3D] - stamps[GFX_STAMP_SUBMIT];
+		stamps[GFX_STAMP_SWAP] = stamps[GFX_STAMP_PPF] + STAGE_TICKS;
+		gfxStatsFrame(&stats, stamps);
+	}
+	stats.late = 3;
+	stats.dup = 4000000000u;
+
+	std::string expected = "stage,count,min_us,avg_us,p99_us,max_us\n";
+	for(u32 i = 0; i < GFX_STAGE_NUM; i++)
+	{
+		const GfxHist &h = stats.hist[i];
+		char line[128];
+		snprintf(line, sizeof(line), "%s,%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n", g_stageNames[i],
+		         h.count, traceTicksToUs(h.min), traceTicksToUs(h.sum / h.count),
+		         traceTicksToUs(gfxHistPercentile(&h, 990)), traceTicksToUs(h.max));
+		expected += line;
+	}
+	expected += "late,3\ndup,4000000000\n";
+
+	char buf[SERIALIZE_SIZE + 1];
+	memset(buf, 0, sizeof(buf));
+	const u32 len = gfxStatsSerialize(&stats, buf, SERIALIZE_SIZE);
+	check("CSV matches the expected table", len == expected.size() && expected == buf);
+
+	// Worst case line lengths must fit.
+	for(GfxHist &h : stats.hist)
+	{
+		h.count = UINT32_MAX;
+		h.min = h.max = UINT32_MAX;
+		h.sum = (u64)UINT32_MAX * UINT32_MAX;
+	}
+	stats.late = UINT32_MAX;
+	memset(buf, 0xA5, sizeof(buf));
+	const u32 maxLen = gfxStatsSerialize(&stats, buf, SERIALIZE_SIZE);
+	check("Worst case CSV fits", maxLen > 0 && maxLen < SERIALIZE_SIZE && strlen(buf) == maxLen && (u8)buf[SERIALIZE_SIZE] == 0xA5);
+	check("Too small buffer returns 0", gfxStatsSerialize(&stats, buf, SERIALIZE_SIZE - 1) == 0);
+
+	stats = GfxStats{};
+	check("Empty stats serialize", gfxStatsSerialize(&stats, buf, SERIALIZE_SIZE) > 0 && strstr(buf, "total,0,0,0,0,0\n") != NULL);
+}
+
+static GfxStats g_stats;
+static u32 g_nextReady;
+
+static void addFrame(void)
+{
+	u32 stamps[GFX_STAMP_NUM];
+	makeStamps(g_nextReady, stamps);
+	g_nextReady += GFXSTATS_FRAME_TICKS;
+	gfxStatsFrame(&g_stats, stamps);
+}
+
+// Finishes a frame that was half added when the snapshot started.
+static void finishFrame(void)
+{
+	g_stats.hist[GFX_STAGE_P3D].count++;
+	g_stats.hist[GFX_STAGE_P3D].sum += STAGE_TICKS;
+	g_stats.seq++;
+}
+
+static void testSnapshot(void)
+{
+	g_stats = GfxStats{};
+	g_nextReady = 1000;
+	for(u32 i = 0; i < 10; i++) addFrame();
+
+	GfxStats snap;
+	g_hookSrc = &g_stats;
+	g_hookCopies = 0;
+	gfxStatsSnapshot(&g_stats, &snap);
+	check("Snapshot without frames copies once", g_hookCopies == 1 && memcmp(&snap, &g_stats, sizeof(GfxStats)) == 0);
+
+	// A frame added in the middle of the copy.
+	g_hookCopies = 0;
+	g_hookFn = addFrame;
+	gfxStatsSnapshot(&g_stats, &snap);
+	check("Frame during the copy retries", g_hookCopies == 2 && isConsistent(snap) && snap.hist[GFX_STAGE_SUBMIT].count == 11);
+
+	// Snapshot started while the gfx handler was preempted mid frame.
+	g_stats.seq++;
+	g_stats.hist[GFX_STAGE_SUBMIT].count++;
+	g_stats.hist[GFX_STAGE_SUBMIT].sum += STAGE_TICKS;
+	g_hookCopies = 0;
+	g_hookFn = finishFrame;
+	gfxStatsSnapshot(&g_stats, &snap);
+	check("Half added frame is waited for", g_hookCopies == 2 && snap.seq % 2 == 0 &&
+	      snap.hist[GFX_STAGE_SUBMIT].count == 12 && snap.hist[GFX_STAGE_P3D].count == 12);
+	g_hookSrc = NULL;
+
+	// Same on real threads.
+	g_stats = GfxStats{};
+	g_nextReady = 1000;
+	addFrame();
+	std::atomic<bool> done{false};
+	std::thread gfx([&done]()
+	{
+		for(u32 i = 0; i < 200000; i++) addFrame();
+		done = true;
+	});
+	u32 snapshots = 0;
+	bool ok = true;
+	while(!done || snapshots == 0)
+	{
+		gfxStatsSnapshot(&g_stats, &snap);
+		ok &= isConsistent(snap);
+		snapshots++;
+	}
+	gfx.join();
+	check("Snapshots while another thread adds frames", ok);
+}
+
+static int runTests(void)
+{
+	testBuckets();
+	testPercentiles();
+	testWraparound();
+	testSerialize();
+	testSnapshot();
+
+	return hostTestResult();
+}
+
+static int runBench(void)
+{
+	double bestFrame = 1e30, bestSnapshot = 1e30, bestSerialize = 1e30;
+	static GfxStats stats, snap;
+	static char buf[SERIALIZE_SIZE];
+	for(u32 r = 0; r < BENCH_RUNS; r++)
+	{
+		stats = GfxStats{};
+		u32 stamps[GFX_STAMP_NUM];
+		u64 t = hostNowNs();
+		for(u32 i = 0; i < BENCH_FRAMES; i++)
+		{
+			const u32 ready = i * GFXSTATS_FRAME_TICKS;
+			stamps[GFX_STAMP_READY]  = ready;
+			stamps[GFX_STAMP_SUBMIT] = ready + 40 + (i & 15);
+			stamps[GFX_STAMP_P3D]    = ready + 400 + (i * 7 & 255);
+			stamps[GFX_STAMP_PPF]    = ready + 700 + (i * 13 & 127);
+			stamps[GFX_STAMP_SWAP]   = ready + 720 + (i * 13 & 127);
+			gfxStatsFrame(&stats, stamps);
+		}
+		bestFrame = std::min(bestFrame, (hostNowNs() - t) / (double)BENCH_FRAMES);
+
+		t = hostNowNs();
+		for(u32 i = 0; i < 1000; i++) gfxStatsSnapshot(&stats, &snap);
+		bestSnapshot = std::min(bestSnapshot, (hostNowNs() - t) / 1000.);
+
+		t = hostNowNs();
+		for(u32 i = 0; i < 1000; i++) gfxStatsSerialize(&snap, buf, sizeof(buf));
+		bestSerialize = std::min(bestSerialize, (hostNowNs() - t) / 1000.);
+	}
+
+	printf("Best of %u runs.\n", BENCH_RUNS);
+	printf("gfxStatsFrame():     %8.1f ns per frame\n", bestFrame);
+	printf("gfxStatsSnapshot():  %8.1f ns\n", bestSnapshot);
+	printf("gfxStatsSerialize(): %8.1f ns\n", bestSerialize);
+
+	return 0;
+}
+
+int main(const int argc, char *const argv[])
+{
+	if(argc == 2 && strcmp(argv[1], "test") == 0) return runTests();
+	if(argc == 2 && strcmp(argv[1], "bench") == 0) return runBench();
+
+	printf("Usage: %s test|bench\n"
+	       "test:  Checks histogram bucket bounds, percentiles, counter wraparound,\n"
+	       "       late/dup counting, CSV output and torn snapshots.\n"
+	       "bench: Cost of recording a frame, taking a snapshot and serializing.\n",
+	       argv[0]);
+
+	return 1;
+}
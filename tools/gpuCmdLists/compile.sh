@@ -0,0 +1,11 @@
+#!/bin/bash
+
+# Builds gpu_cmd_lists.cpp unmodified against ../hostStubs.
+# gpu_cmd_lists_old.c is the list before the constexpr builder.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+
+rm ./gpuCmdLists
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DNDEBUG $INCLUDES -c ../hostStubs/hostStubs.c ./gpu_cmd_lists_old.c
+g++ -std=c++23 -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DNDEBUG $INCLUDES -c ../../source/arm11/gpu_cmd_lists.cpp
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -Wl,--gc-sections ./gpuCmdLists.cpp ./*.o -lpthread -o ./gpuCmdLists
+rm ./*.o
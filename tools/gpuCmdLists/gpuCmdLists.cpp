@@ -0,0 +1,101 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "types.h"
+#include "hostTest.h"
+#include "arm11/gpu_cmd_lists.h"
+#include "gpu_cmd_lists_old.h"
+
+
+
+// Prints the first differing word so a mismatch can be found in the builder.
+static bool sameList(const char *const name, const u8 *const ref, const u32 refSize, const u32 *const list, const u32 listSize)
+{
+	if(listSize != refSize)
+	{
+		printf("%s: size %" PRIu32 ", expected %" PRIu32 "\n", name, listSize, refSize);
+		return false;
+	}
+
+	for(u32 i = 0; i < refSize; i += 4)
+	{
+		u32 expected;
+		memcpy(&expected, &ref[i], 4);
+		if(list[i / 4] != expected)
+		{
+			printf("%s: offset %" PRIu32 " is 0x%08" PRIX32 ", expected 0x%08" PRIX32 "\n", name, i, list[i / 4], expected);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static int runTests(void)
+{
+	// patchGbaGpuCmdList() patches in place so every combination starts from the pristine lists.
+	static u8 initOrig[GBA_INIT_LIST_SIZE], list2Orig[GBA_LIST2_SIZE];
+	memcpy(initOrig, gbaGpuInitList, sizeof(initOrig));
+	memcpy(list2Orig, gbaGpuList2, sizeof(list2Orig));
+
+	static const char *const scalerNames[3] = {"none", "bilinear", "matrix"};
+	for(u8 scaler = 0; scaler < 3; scaler++)
+	{
+		for(u32 tex = 0; tex < 2; tex++)
+		{
+			memcpy(gbaGpuInitList, initOrig, sizeof(initOrig));
+			memcpy(gbaGpuList2, list2Orig, sizeof(list2Orig));
+			patchGbaGpuCmdList(scaler, tex != 0);
+
+			char name[64];
+			snprintf(name, sizeof(name), "scaler %u (%s), texture %" PRIu32, scaler, scalerNames[scaler], tex + 1);
+			const GbaGpuCmdLists *const lists = getGbaGpuCmdLists(scaler, tex != 0);
+			const bool initOk = sameList(name, gbaGpuInitList, sizeof(gbaGpuInitList), lists->initList, lists->initListSize);
+			const bool listOk = sameList(name, gbaGpuList2, sizeof(gbaGpuList2), lists->list, lists->listSize);
+
+			char checkName[96];
+			snprintf(checkName, sizeof(checkName), "%s init list", name);
+			check(checkName, initOk);
+			snprintf(checkName, sizeof(checkName), "%s frame list", name);
+			check(checkName, listOk);
+			snprintf(checkName, sizeof(checkName), "%s 16 byte aligned", name);
+			check(checkName, ((uintptr_t)lists->initList & 15) == 0 && ((uintptr_t)lists->list & 15) == 0);
+		}
+	}
+
+	// Out of range scalers fell through to the unpatched lists.
+	check("Scaler 3 uses the matrix lists", getGbaGpuCmdLists(3, false) == getGbaGpuCmdLists(2, false) &&
+	      getGbaGpuCmdLists(3, true) == getGbaGpuCmdLists(2, true));
+
+	return hostTestResult();
+}
+
+int main(const int argc, char *const argv[])
+{
+	if(argc == 2 && strcmp(argv[1], "test") == 0) return runTests();
+
+	printf("Usage: %s test\n"
+	       "Compares the constexpr GPU command lists for all scalers and textures\n"
+	       "byte for byte against the old patched lists.\n",
+	       argv[0]);
+
+	return 1;
+}
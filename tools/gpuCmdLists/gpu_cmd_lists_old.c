@@ -16,9 +16,12 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+// source/arm11/gpu_cmd_lists.c from before the constexpr command lists
+// (commit 1a343a8). Only the header include differs. Test reference.
+
 #include <string.h>
 #include "types.h"
-#include "arm11/gpu_cmd_lists.h"
+#include "gpu_cmd_lists_old.h"
 #include "drivers/cache.h"
 
 
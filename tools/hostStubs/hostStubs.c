@@ -0,0 +1,843 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "types.h"
+#include "error_codes.h"
+#include "fs.h"
+#include "fsutil.h"
+#include "util.h"
+#include "kernel.h"
+#include "kevent.h"
+#include "drivers/sha.h"
+#include "drivers/cache.h"
+#include "drivers/lgy_common.h"
+#include "arm11/fmt.h"
+#include "inih/ini.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+
+
+#define MAX_HANDLES  (16u)
+
+
+HostFsStats g_hostFsStats;
+u32 g_hostFsReadBps;
+u32 g_hostTicks;
+bool g_hostQuiet;
+void (*g_hostConsole)(const char *const str, const u32 len);
+
+// The ROM area plus ROM_SCRATCH_LOC after it.
+static u8 g_hostRom[LGY_MAX_ROM_SIZE * 2] __attribute__((aligned(64)));
+u8 *g_hostRomLoc = g_hostRom;
+
+static char g_root[256] = ".";
+static char g_cwd[512]  = ""; // Relative to g_root.
+static FILE *g_files[MAX_HANDLES];
+static DIR *g_dirs[MAX_HANDLES];
+
+
+
+// --------------------------------------------------------------------------
+// FS
+// --------------------------------------------------------------------------
+
+void hostFsSetRoot(const char *const dir)
+{
+	snprintf(g_root, sizeof(g_root), "%s", dir);
+	g_cwd[0] = '\0';
+}
+
+void hostFsResetStats(void)
+{
+	memset(&g_hostFsStats, 0, sizeof(g_hostFsStats));
+}
+
+const char* hostFsPath(const char *const path)
+{
+	static char buf[1024];
+
+	if(strncmp(path, "sdmc:/", 6) == 0)
+		snprintf(buf, sizeof(buf), "%s/%s", g_root, path + 6);
+	else if(path[0] == '/')
+		snprintf(buf, sizeof(buf), "%s%s", g_root, path);
+	else
+		snprintf(buf, sizeof(buf), "%s/%s%s%s", g_root, g_cwd, (g_cwd[0] != '\0' ? "/" : ""), path);
+
+	return buf;
+}
+
+u32 hostFsOpenHandles(void)
+{
+	u32 open = 0;
+	for(u32 i = 0; i < MAX_HANDLES; i++) open += (g_files[i] != NULL) + (g_dirs[i] != NULL);
+	return open;
+}
+
+static Result errno2Result(void)
+{
+	switch(errno)
+	{
+		case ENOENT:  return RES_FR_NO_FILE;
+		case ENOTDIR: return RES_FR_NO_PATH;
+		case EEXIST:  return RES_FR_EXIST;
+		case EACCES:
+		case EISDIR:  return RES_FR_DENIED;
+		case ENOSPC:  return RES_DISK_FULL;
+		default:      return RES_FR_DISK_ERR;
+	}
+}
+
+Result fOpen(FHandle *const hOut, const char *const path, u8 mode)
+{
+	u32 h = 0;
+	while(h < MAX_HANDLES && g_files[h] != NULL) h++;
+	if(h == MAX_HANDLES) return RES_FR_INT_ERR;
+
+	g_hostFsStats.opens++;
+	const char *const hostPath = hostFsPath(path);
+	const char *fmode = "rb";
+	if(mode & FA_WRITE)
+	{
+		if(mode & FA_CREATE_NEW)
+		{
+			if(access(hostPath, F_OK) == 0) return RES_FR_EXIST;
+			fmode = "w+b";
+		}
+		else if(mode & FA_CREATE_ALWAYS) fmode = "w+b";
+		else if(mode & FA_OPEN_ALWAYS)   fmode = (access(hostPath, F_OK) == 0 ? "r+b" : "w+b");
+		else                             fmode = "r+b";
+	}
+
+	FILE *const f = fopen(hostPath, fmode);
+	if(f == NULL) return errno2Result();
+
+	g_files[h] = f;
+	*hOut = h;
+
+	return RES_OK;
+}
+
+Result fRead(FHandle h, void *const buf, u32 size, u32 *const bytesRead)
+{
+	g_hostFsStats.reads++;
+	const u64 start = hostNowNs();
+	const size_t read = fread(buf, 1, size, g_files[h]);
+	g_hostFsStats.bytesRead += read;
+
+	if(g_hostFsReadBps != 0)
+	{
+		// Small reads only add to the simulated card time. Sleeping for
+		// each of them would measure the host scheduler instead.
+		static u64 busyUntil = 0;
+		busyUntil = (busyUntil > start ? busyUntil : start) + (u64)read * 1000000000u / g_hostFsReadBps;
+		const u64 now = hostNowNs();
+		if(busyUntil > now + 1000000u)
+		{
+			const struct timespec ts = {(busyUntil - now) / 1000000000u, (busyUntil - now) % 1000000000u};
+			nanosleep(&ts, NULL);
+		}
+	}
+	if(bytesRead != NULL) *bytesRead = read;
+
+	return (ferror(g_files[h]) ? RES_FR_DISK_ERR : RES_OK);
+}
+
+Result fWrite(FHandle h, const void *const buf, u32 size, u32 *const bytesWritten)
+{
+	g_hostFsStats.writes++;
+	const size_t written = fwrite(buf, 1, size, g_files[h]);
+	g_hostFsStats.bytesWritten += written;
+	if(bytesWritten != NULL) *bytesWritten = written;
+
+	return (written == size ? RES_OK : RES_DISK_FULL);
+}
+
+Result fSync(FHandle h)
+{
+	return (fflush(g_files[h]) == 0 ? RES_OK : RES_FR_DISK_ERR);
+}
+
+Result fLseek(FHandle h, u32 off)
+{
+	g_hostFsStats.seeks++;
+	return (fseek(g_files[h], off, SEEK_SET) == 0 ? RES_OK : RES_FR_DISK_ERR);
+}
+
+u32 fTell(FHandle h)
+{
+	return ftell(g_files[h]);
+}
+
+u32 fSize(FHandle h)
+{
+	struct stat st;
+	fflush(g_files[h]);
+	if(fstat(fileno(g_files[h]), &st) != 0) return 0;
+	return st.st_size;
+}
+
+Result fClose(FHandle h)
+{
+	const int err = fclose(g_files[h]);
+	g_files[h] = NULL;
+
+	return (err == 0 ? RES_OK : RES_FR_DISK_ERR);
+}
+
+Result fExpand(UNUSED FHandle h, UNUSED u32 size)
+{
+	return RES_OK;
+}
+
+static void stat2Filinfo(const struct stat *const st, const char *const name, FILINFO *const fi)
+{
+	struct tm tm;
+	localtime_r(&st->st_mtime, &tm);
+
+	fi->fsize   = (S_ISDIR(st->st_mode) ? 0 : st->st_size);
+	fi->fdate   = (tm.tm_year - 80)<<9 | (tm.tm_mon + 1)<<5 | tm.tm_mday;
+	fi->ftime   = tm.tm_hour<<11 | tm.tm_min<<5 | tm.tm_sec / 2;
+	fi->fattrib = (S_ISDIR(st->st_mode) ? AM_DIR : 0);
+	fi->altname[0] = '\0';
+	snprintf(fi->fname, sizeof(fi->fname), "%s", name);
+}
+
+Result fStat(const char *const path, FILINFO *const fi)
+{
+	g_hostFsStats.stats++;
+	struct stat st;
+	if(stat(hostFsPath(path), &st) != 0) return errno2Result();
+
+	const char *name = strrchr(path, '/');
+	stat2Filinfo(&st, (name != NULL ? name + 1 : path), fi);
+
+	return RES_OK;
+}
+
+Result fChdir(const char *const path)
+{
+	struct stat st;
+	if(stat(hostFsPath(path), &st) != 0) return errno2Result();
+	if(!S_ISDIR(st.st_mode)) return RES_FR_NO_PATH;
+
+	// Only absolute paths are used by the firmware.
+	if(strncmp(path, "sdmc:/", 6) == 0) snprintf(g_cwd, sizeof(g_cwd), "%s", path + 6);
+	else if(path[0] == '/')            snprintf(g_cwd, sizeof(g_cwd), "%s", path + 1);
+	else return RES_INVALID_ARG;
+
+	return RES_OK;
+}
+
+Result fOpenDir(DHandle *const hOut, const char *const path)
+{
+	u32 h = 0;
+	while(h < MAX_HANDLES && g_dirs[h] != NULL) h++;
+	if(h == MAX_HANDLES) return RES_FR_INT_ERR;
+
+	g_hostFsStats.dirOpens++;
+	DIR *const d = opendir(hostFsPath(path));
+	if(d == NULL) return (errno == ENOENT ? RES_FR_NO_PATH : errno2Result());
+
+	g_dirs[h] = d;
+	*hOut = h;
+
+	return RES_OK;
+}
+
+Result fReadDir(DHandle h, FILINFO *const fi, u32 num, u32 *const entriesRead)
+{
+	g_hostFsStats.dirReads++;
+
+	const int dfd = dirfd(g_dirs[h]);
+	u32 read = 0;
+	while(read < num)
+	{
+		const struct dirent *const e = readdir(g_dirs[h]);
+		if(e == NULL) break;
+		if(strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+
+		struct stat st;
+		if(fstatat(dfd, e->d_name, &st, 0) != 0) return errno2Result();
+		stat2Filinfo(&st, e->d_name, &fi[read++]);
+	}
+	*entriesRead = read;
+
+	return RES_OK;
+}
+
+Result fCloseDir(DHandle h)
+{
+	closedir(g_dirs[h]);
+	g_dirs[h] = NULL;
+
+	return RES_OK;
+}
+
+Result fMkdir(const char *const path)
+{
+	g_hostFsStats.mkdirs++;
+	return (mkdir(hostFsPath(path), 0777) == 0 ? RES_OK : errno2Result());
+}
+
+Result fRename(const char *const old, const char *const _new)
+{
+	char oldHost[1024];
+	snprintf(oldHost, sizeof(oldHost), "%s", hostFsPath(old));
+	return (rename(oldHost, hostFsPath(_new)) == 0 ? RES_OK : errno2Result());
+}
+
+Result fUnlink(const char *const path)
+{
+	g_hostFsStats.unlinks++;
+	const char *const hostPath = hostFsPath(path);
+	if(unlink(hostPath) == 0 || (errno == EISDIR && rmdir(hostPath) == 0)) return RES_OK;
+
+	return errno2Result();
+}
+
+Result fUnmount(UNUSED FsDrive d)
+{
+	return RES_OK;
+}
+
+// Like libn3ds short reads are errors.
+Result fsQuickRead(const char *const path, void *const buf, u32 size)
+{
+	FHandle f;
+	Result res = fOpen(&f, path, FA_OPEN_EXISTING | FA_READ);
+	if(res != RES_OK) return res;
+
+	u32 read;
+	res = fRead(f, buf, size, &read);
+	if(res == RES_OK && read != size) res = RES_FR_DENIED;
+	fClose(f);
+
+	return res;
+}
+
+Result fsQuickWrite(const char *const path, const void *const buf, u32 size)
+{
+	FHandle f;
+	Result res = fOpen(&f, path, FA_CREATE_ALWAYS | FA_WRITE);
+	if(res != RES_OK) return res;
+
+	res = fWrite(f, buf, size, NULL);
+	fClose(f);
+
+	return res;
+}
+
+Result fsMakePath(const char *const path)
+{
+	char tmp[1024];
+	snprintf(tmp, sizeof(tmp), "%s", hostFsPath(path));
+
+	g_hostFsStats.mkdirs++;
+	for(char *p = tmp + strlen(g_root) + 1; ; p++)
+	{
+		const char c = *p;
+		if(c == '/' || c == '\0')
+		{
+			*p = '\0';
+			if(mkdir(tmp, 0777) != 0 && errno != EEXIST) return errno2Result();
+			*p = c;
+		}
+		if(c == '\0') break;
+	}
+
+	return RES_OK;
+}
+
+Result fsLoadPathFromFile(const char *const path, char outPath[512])
+{
+	FHandle f;
+	Result res = fOpen(&f, path, FA_OPEN_EXISTING | FA_READ);
+	if(res != RES_OK) return res;
+
+	u32 read;
+	res = fRead(f, outPath, 511, &read);
+	fClose(f);
+	if(res != RES_OK) return res;
+
+	outPath[read] = '\0';
+	char *const nl = strpbrk(outPath, "\r\n");
+	if(nl != NULL) *nl = '\0';
+
+	return RES_OK;
+}
+
+
+// --------------------------------------------------------------------------
+// Kernel
+// --------------------------------------------------------------------------
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool oneShot;
+	bool signaled;
+} HostEvent;
+
+typedef struct
+{
+	TaskFunc entry;
+	void *arg;
+} HostTask;
+
+static void* taskTrampoline(void *arg)
+{
+	HostTask task = *(HostTask*)arg;
+	free(arg);
+	task.entry(task.arg);
+
+	return NULL;
+}
+
+// Tasks are real threads. Priorities are ignored.
+KHandle createTask(UNUSED size_t stackSize, UNUSED u8 priority, TaskFunc entry, void *taskArg)
+{
+	HostTask *const task = malloc(sizeof(HostTask));
+	if(task == NULL) return 0;
+	task->entry = entry;
+	task->arg   = taskArg;
+
+	pthread_t thread;
+	if(pthread_create(&thread, NULL, taskTrampoline, task) != 0)
+	{
+		free(task);
+		return 0;
+	}
+	pthread_detach(thread);
+
+	return (KHandle)thread;
+}
+
+void yieldTask(void)
+{
+	sched_yield();
+}
+
+void taskExit(void)
+{
+	pthread_exit(NULL);
+}
+
+KHandle createEvent(bool oneShot)
+{
+	HostEvent *const e = calloc(1, sizeof(HostEvent));
+	if(e == NULL) return 0;
+	pthread_mutex_init(&e->lock, NULL);
+	pthread_cond_init(&e->cond, NULL);
+	e->oneShot = oneShot;
+
+	return (KHandle)e;
+}
+
+void deleteEvent(const KHandle kevent)
+{
+	HostEvent *const e = (HostEvent*)kevent;
+	pthread_cond_destroy(&e->cond);
+	pthread_mutex_destroy(&e->lock);
+	free(e);
+}
+
+KRes waitForEvent(const KHandle kevent)
+{
+	HostEvent *const e = (HostEvent*)kevent;
+	pthread_mutex_lock(&e->lock);
+	while(!e->signaled) pthread_cond_wait(&e->cond, &e->lock);
+	if(e->oneShot) e->signaled = false;
+	pthread_mutex_unlock(&e->lock);
+
+	return KRES_OK;
+}
+
+void signalEvent(const KHandle kevent, UNUSED bool reschedule)
+{
+	HostEvent *const e = (HostEvent*)kevent;
+	pthread_mutex_lock(&e->lock);
+	e->signaled = true;
+	pthread_cond_broadcast(&e->cond);
+	pthread_mutex_unlock(&e->lock);
+}
+
+void clearEvent(const KHandle kevent)
+{
+	HostEvent *const e = (HostEvent*)kevent;
+	pthread_mutex_lock(&e->lock);
+	e->signaled = false;
+	pthread_mutex_unlock(&e->lock);
+}
+
+u64 hostNowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Replace the CP15 cycle counter in boot_trace.h with -DTRACE_HOST_CLOCK.
+// Tests advance g_hostTicks themselves.
+void traceStartClock(void)
+{
+	g_hostTicks = 0;
+}
+
+u32 traceGetTicks(void)
+{
+	return g_hostTicks;
+}
+
+
+// --------------------------------------------------------------------------
+// SHA-1 (the only mode the firmware uses). Big endian in and out.
+// --------------------------------------------------------------------------
+
+typedef struct
+{
+	u32 h[5];
+	u64 len;
+	u8 buf[64];
+	u32 bufLen;
+} Sha1Ctx;
+
+static Sha1Ctx g_sha;
+
+static inline u32 rol32(const u32 x, const u32 n)
+{
+	return x<<n | x>>(32 - n);
+}
+
+static void sha1Block(u32 h[5], const u8 *const p)
+{
+	u32 w[80];
+	for(u32 i = 0; i < 16; i++) w[i] = (u32)p[i * 4]<<24 | (u32)p[i * 4 + 1]<<16 | (u32)p[i * 4 + 2]<<8 | p[i * 4 + 3];
+	for(u32 i = 16; i < 80; i++) w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	u32 a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+	for(u32 i = 0; i < 80; i++)
+	{
+		u32 f, k;
+		if(i < 20)      f = (b & c) | (~b & d),          k = 0x5A827999;
+		else if(i < 40) f = b ^ c ^ d,                   k = 0x6ED9EBA1;
+		else if(i < 60) f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+		else            f = b ^ c ^ d,                   k = 0xCA62C1D6;
+
+		const u32 t = rol32(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = rol32(b, 30);
+		b = a;
+		a = t;
+	}
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+}
+
+void SHA_start(UNUSED u16 params)
+{
+	static const u32 init[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+	memcpy(g_sha.h, init, sizeof(init));
+	g_sha.len    = 0;
+	g_sha.bufLen = 0;
+}
+
+void SHA_update(const u32 *data, u32 size)
+{
+	const u8 *p = (const u8*)data;
+	g_sha.len += size;
+	while(size > 0)
+	{
+		if(g_sha.bufLen == 0 && size >= 64)
+		{
+			sha1Block(g_sha.h, p);
+			p += 64;
+			size -= 64;
+			continue;
+		}
+
+		const u32 n = (64 - g_sha.bufLen < size ? 64 - g_sha.bufLen : size);
+		memcpy(&g_sha.buf[g_sha.bufLen], p, n);
+		g_sha.bufLen += n;
+		p += n;
+		size -= n;
+		if(g_sha.bufLen == 64)
+		{
+			sha1Block(g_sha.h, g_sha.buf);
+			g_sha.bufLen = 0;
+		}
+	}
+}
+
+void SHA_finish(u32 *const hash, UNUSED u16 endianess)
+{
+	const u64 bits = g_sha.len * 8;
+	u8 pad[72] = {0x80};
+	const u32 padLen = (g_sha.bufLen < 56 ? 56 - g_sha.bufLen : 120 - g_sha.bufLen);
+	for(u32 i = 0; i < 8; i++) pad[padLen + i] = bits>>(56 - i * 8);
+	SHA_update((const u32*)pad, padLen + 8);
+
+	u8 *const out = (u8*)hash;
+	for(u32 i = 0; i < 5; i++)
+	{
+		out[i * 4]     = g_sha.h[i]>>24;
+		out[i * 4 + 1] = g_sha.h[i]>>16;
+		out[i * 4 + 2] = g_sha.h[i]>>8;
+		out[i * 4 + 3] = g_sha.h[i];
+	}
+}
+
+void sha(const u32 *data, u32 size, u32 *const hash, u16 params, u16 hashEndianess)
+{
+	SHA_start(params);
+	SHA_update(data, size);
+	SHA_finish(hash, hashEndianess);
+}
+
+
+// --------------------------------------------------------------------------
+// Misc. libn3ds functions
+// --------------------------------------------------------------------------
+
+const char* result2String(Result res)
+{
+	static char buf[16];
+	snprintf(buf, sizeof(buf), "error %" PRIu32, res);
+	return buf;
+}
+
+u32 ee_printf(const char *const fmt, ...)
+{
+	if(g_hostQuiet) return 0;
+
+	va_list args;
+	va_start(args, fmt);
+	int n;
+	if(g_hostConsole != NULL)
+	{
+		char buf[4096];
+		n = vsnprintf(buf, sizeof(buf), fmt, args);
+		g_hostConsole(buf, (n < (int)sizeof(buf) ? n : (int)sizeof(buf) - 1));
+	}
+	else n = vprintf(fmt, args);
+	va_end(args);
+
+	return n;
+}
+
+u32 ee_puts(const char *const str)
+{
+	if(g_hostQuiet) return 0;
+	if(g_hostConsole == NULL) return printf("%s\n", str);
+
+	const u32 len = strlen(str);
+	g_hostConsole(str, len);
+	g_hostConsole("\n", 1);
+
+	return len + 1;
+}
+
+u32 ee_sprintf(char *const buf, const char *const fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	const int n = vsprintf(buf, fmt, args);
+	va_end(args);
+
+	return n;
+}
+
+u32 ee_snprintf(char *const buf, u32 size, const char *const fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	const int n = vsnprintf(buf, size, fmt, args);
+	va_end(args);
+
+	return n;
+}
+
+u32 nextPow2(u32 x)
+{
+	x--;
+	x |= x>>1;
+	x |= x>>2;
+	x |= x>>4;
+	x |= x>>8;
+	x |= x>>16;
+
+	return x + 1;
+}
+
+char* safeStrcpy(char *dst, const char *src, size_t n)
+{
+	if(n == 0) return dst;
+	strncpy(dst, src, n - 1);
+	dst[n - 1] = '\0';
+
+	return dst;
+}
+
+float str2float(const char *s)
+{
+	return strtof(s, NULL);
+}
+
+void flushDCacheRange(UNUSED const void *p, UNUSED u32 s) {}
+void invalidateDCacheRange(UNUSED const void *p, UNUSED u32 s) {}
+
+// Host version of fast_rom_padding.s. Halfwords hold their address>>1.
+void makeOpenBusPaddingFast(u32 *romEnd)
+{
+	u16 *p = (u16*)romEnd;
+	u32 off = (uintptr_t)romEnd - LGY_ROM_LOC;
+	for(; off < LGY_MAX_ROM_SIZE; off += 2) *p++ = off>>1;
+}
+
+// Same rules as inih with its default options.
+int ini_parse_string(const char* string, ini_handler handler, void* user)
+{
+	char section[64] = "";
+	char line[512];
+	int lineNum = 0;
+	int error = 0;
+
+	while(*string != '\0')
+	{
+		size_t len = strcspn(string, "\n");
+		const size_t copy = (len < sizeof(line) - 1 ? len : sizeof(line) - 1);
+		memcpy(line, string, copy);
+		line[copy] = '\0';
+		string += len + (string[len] == '\n');
+		lineNum++;
+
+		// Strip inline comments and surrounding whitespace.
+		for(char *c = line; *c != '\0'; c++)
+		{
+			if(*c == ';' && (c == line || isspace((unsigned char)c[-1])))
+			{
+				*c = '\0';
+				break;
+			}
+		}
+		char *start = line;
+		while(isspace((unsigned char)*start)) start++;
+		char *end = start + strlen(start);
+		while(end > start && isspace((unsigned char)end[-1])) *--end = '\0';
+
+		if(*start == '\0' || *start == '#') continue;
+		if(*start == '[')
+		{
+			char *const close = strchr(start, ']');
+			if(close == NULL)
+			{
+				if(error == 0) error = lineNum;
+				continue;
+			}
+			*close = '\0';
+			snprintf(section, sizeof(section), "%s", start + 1);
+			continue;
+		}
+
+		char *const eq = strpbrk(start, "=:");
+		if(eq == NULL)
+		{
+			if(error == 0) error = lineNum;
+			continue;
+		}
+		*eq = '\0';
+		char *nameEnd = eq;
+		while(nameEnd > start && isspace((unsigned char)nameEnd[-1])) *--nameEnd = '\0';
+		char *value = eq + 1;
+		while(isspace((unsigned char)*value)) value++;
+
+		if(!handler(user, section, start, value) && error == 0) error = lineNum;
+	}
+
+	return error;
+}
+
+
+
+// --------------------------------------------------------------------------
+// Test scaffold (hostTest.h)
+// --------------------------------------------------------------------------
+
+static u32 g_testFailed;
+static char g_testDir[64];
+
+void check(const char *const name, const bool ok)
+{
+	printf("%-44s %s\n", name, (ok ? "OK" : "FAIL"));
+	g_testFailed += !ok;
+}
+
+void hostTestFail(void)
+{
+	g_testFailed++;
+}
+
+u32 hostTestFailed(void)
+{
+	return g_testFailed;
+}
+
+int hostTestResult(void)
+{
+	printf("%" PRIu32 " failed.\n", g_testFailed);
+	return (g_testFailed != 0 ? 2 : 0);
+}
+
+const char* hostTestDirCreate(const char *const name)
+{
+	snprintf(g_testDir, sizeof(g_testDir), "/tmp/%sXXXXXX", name);
+	if(mkdtemp(g_testDir) == NULL)
+	{
+		g_testDir[0] = '\0';
+		return NULL;
+	}
+	hostFsSetRoot(g_testDir);
+
+	return g_testDir;
+}
+
+void hostTestDirRemove(void)
+{
+	if(g_testDir[0] == '\0') return;
+
+	char cmd[80];
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", g_testDir);
+	if(system(cmd) != 0) fprintf(stderr, "Failed to remove %s.\n", g_testDir);
+	g_testDir[0] = '\0';
+}
@@ -0,0 +1,75 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Host side of the stub layer in ./include. Firmware modules are built
+// unmodified against it. The FS is backed by a host directory and counts
+// every call so tests can check how often a module touches the SD card.
+
+#include "types.h"
+
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct
+{
+	u32 opens;      // fOpen() including fsQuick*().
+	u32 reads;      // fRead() calls.
+	u32 writes;     // fWrite() calls.
+	u32 seeks;      // fLseek() calls.
+	u32 stats;      // fStat() calls.
+	u32 dirOpens;   // fOpenDir() calls.
+	u32 dirReads;   // fReadDir() calls.
+	u32 unlinks;    // fUnlink() calls.
+	u32 mkdirs;     // fMkdir() and fsMakePath() calls.
+	u64 bytesRead;
+	u64 bytesWritten;
+} HostFsStats;
+
+extern HostFsStats g_hostFsStats;
+// Simulated SD card read speed in bytes per second. 0 = host speed.
+// fRead() sleeps like the SD driver so other tasks can run meanwhile.
+extern u32 g_hostFsReadBps;
+
+
+// Sets the host directory "sdmc:/" maps to and resets the work dir to it.
+void hostFsSetRoot(const char *const dir);
+void hostFsResetStats(void);
+// Host path for a firmware path. Returns a static buffer.
+const char* hostFsPath(const char *const path);
+// Number of fOpen()/fOpenDir() handles not closed yet.
+u32 hostFsOpenHandles(void);
+
+// Monotonic clock in nanoseconds.
+u64 hostNowNs(void);
+
+// Suppresses ee_printf()/ee_puts() console output.
+extern bool g_hostQuiet;
+// Receives ee_printf()/ee_puts() output instead of stdout if set.
+extern void (*g_hostConsole)(const char *const str, const u32 len);
+
+// Fake cycle counter returned by traceGetTicks() in host builds.
+extern u32 g_hostTicks;
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
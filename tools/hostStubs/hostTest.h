@@ -0,0 +1,47 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Shared scaffold of the tools/ test programs. Implemented in hostStubs.c.
+
+#include "types.h"
+
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Prints one "name OK/FAIL" line and counts failures.
+void check(const char *const name, const bool ok);
+// Counts a failure without a line. For test setup that went wrong.
+void hostTestFail(void);
+u32 hostTestFailed(void);
+// Prints "N failed." and returns the exit code (0 or 2).
+int hostTestResult(void);
+
+// Creates /tmp/<name>XXXXXX and maps "sdmc:/" to it.
+// Returns the host path or NULL on error.
+const char* hostTestDirCreate(const char *const name);
+// Deletes the directory from hostTestDirCreate() with everything in it.
+void hostTestDirRemove(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+void consoleClear(void);
+void consoleInit(u8 screen, void *c);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
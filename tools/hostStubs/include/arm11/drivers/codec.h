@@ -0,0 +1,13 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+void CODEC_setAudioOutput(u8); void CODEC_setVolumeOverride(s8); void CODEC_runHeadphoneDetection(void); void CODEC_deinit(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+#include "types.h"
+#include "drivers/gfx.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define PPF_DIM(w,h) ((h)<<16|(w))
+#define PPF_O_FMT(f) ((f)<<12)
+#define PPF_I_FMT(f) ((f)<<8)
+#define PPF_CROP_EN (1u<<2)
+#define PPF_OUT_TILED (1u<<1)
+enum { GX_BGR8 = 1, GX_A1BGR5 = 3 }; enum { PSC_FILL_32_BITS = 2<<8 };
+typedef struct { struct { u32 color_lut_data; } pdc0; } GxRegs; GxRegs *getGxRegs(void);
+void GX_displayTransfer(const u32 *in, u32 indim, u32 *out, u32 outdim, u32 flags);
+void GX_memoryFill(u32 *buf0a, u32 buf0v, u32 buf0Sz, u32 val0, u32 *buf1a, u32 buf1v, u32 buf1Sz, u32 val1);
+void GX_processCommandList(u32 size, const u32 *list);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
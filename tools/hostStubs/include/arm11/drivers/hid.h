@@ -0,0 +1,15 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum { KEY_A=1, KEY_B=2, KEY_SELECT=4, KEY_START=8, KEY_DRIGHT=16, KEY_DLEFT=32, KEY_DUP=64, KEY_DDOWN=128, KEY_R=256, KEY_L=512, KEY_X=1024, KEY_Y=2048 };
+enum { KEY_POWER=1, KEY_POWER_HELD=2 };
+void hidScanInput(void); u32 hidKeysHeld(void); u32 hidKeysDown(void); u32 hidKeysUp(void); u32 hidGetExtraKeys(u32 clear);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,13 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum { IRQ_IPI15 = 15 }; typedef void (*IrqIsr)(u32); void IRQ_registerIsr(u32 id, u8 prio, u8 cpu, IrqIsr isr);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
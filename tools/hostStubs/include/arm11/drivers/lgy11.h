@@ -0,0 +1,13 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+void LGY11_selectInput(u16); void LGY11_switchMode(void); void LGY11_setInputState(u16); void LGY11_deinit(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+#include "types.h"
+#include "kernel.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum { LGYCAP_DEV_TOP };
+#define LGYCAP_SWIZZLE 1
+#define LGYCAP_ROT_NONE 0
+#define LGYCAP_FMT_A1BGR5 0
+#define LGYCAP_HSCALE_EN 2
+#define LGYCAP_VSCALE_EN 4
+#define LGYCAP_IRQ_DMA_REQ 1
+typedef struct { u32 cnt; u16 w, h; u32 irq; u8 vLen, vPatt; s16 vMatrix[48]; u8 hLen, hPatt; s16 hMatrix[48]; } LgyCapCfg;
+KHandle LGYCAP_init(u8 dev, const LgyCapCfg *cfg); void LGYCAP_deinit(u8 dev); KRes LGYCAP_captureFrameUnscaled(u8 dev); void LGYCAP_start(u8 dev);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,15 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum { SYS_MODEL_2DS = 3 };
+typedef struct { u8 sec, min, hour, dow, day, mon, year; } RtcTimeDate;
+u8 MCU_getSystemModel(void); void MCU_getRtcTimeDate(RtcTimeDate *td);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+#include "types.h"
+#include <stdarg.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+u32 ee_printf(const char *const fmt, ...);
+u32 ee_puts(const char *const str);
+u32 ee_sprintf(char *const buf, const char *const fmt, ...);
+u32 ee_snprintf(char *const buf, u32 size, const char *const fmt, ...);
+#ifdef NDEBUG
+#define debug_printf(...) ((void)0)
+#else
+#define debug_printf(...) ee_printf(__VA_ARGS__)
+#endif
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
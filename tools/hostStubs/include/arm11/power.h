@@ -0,0 +1,13 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+void power_off(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
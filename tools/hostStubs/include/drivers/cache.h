@@ -0,0 +1,13 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+void flushDCacheRange(const void *p, u32 s); void invalidateDCacheRange(const void *p, u32 s);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
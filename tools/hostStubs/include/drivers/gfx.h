@@ -0,0 +1,16 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum { GFX_LCD_TOP, GFX_LCD_BOT } GfxLcd; typedef enum { GFX_SIDE_LEFT } GfxSide; typedef enum {GFX_BL_TOP=1, GFX_BL_BOT=2} GfxBl;
+enum { GFX_BGR8, GFX_BGR565, GFX_TOP_2D };
+void GFX_flushBuffers(void); void GFX_waitForVBlank0(void); void *GFX_getBuffer(GfxLcd l, GfxSide s); void GFX_waitForPPF(void); void GFX_waitForP3D(void); void GFX_waitForPSC0(void); void GFX_swapBuffers(void);
+void GFX_setLcdLuminance(u32 l); void GFX_powerOffBacklight(GfxBl); void GFX_powerOnBacklight(GfxBl); void GFX_setForceBlack(bool, bool); void GFX_init(int,int,int); void GFX_deinit(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
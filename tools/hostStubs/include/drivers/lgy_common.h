@@ -0,0 +1,20 @@
+#pragma once
+#include "error_codes.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// The GBA ROM area lives in a host buffer (see hostStubs.c).
+extern u8 *g_hostRomLoc;
+#define LGY_ROM_LOC      ((uintptr_t)g_hostRomLoc)
+#define LGY_MAX_ROM_SIZE (0x2000000u)
+
+Result LGY_prepareGbaMode(bool directBoot, u16 saveType, const char *const savePath);
+enum { SAVE_TYPE_EEPROM_8k = 0, SAVE_TYPE_EEPROM_8k_2, SAVE_TYPE_EEPROM_64k, SAVE_TYPE_EEPROM_64k_2, SAVE_TYPE_FLASH_512k_AML_RTC, SAVE_TYPE_FLASH_512k_AML, SAVE_TYPE_FLASH_512k_SST_RTC, SAVE_TYPE_FLASH_512k_SST,
+ SAVE_TYPE_FLASH_512k_PSC_RTC, SAVE_TYPE_FLASH_512k_PSC, SAVE_TYPE_FLASH_1m_MRX_RTC, SAVE_TYPE_FLASH_1m_MRX, SAVE_TYPE_FLASH_1m_SNO_RTC, SAVE_TYPE_FLASH_1m_SNO, SAVE_TYPE_SRAM_256k, SAVE_TYPE_NONE };
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
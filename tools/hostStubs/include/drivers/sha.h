@@ -0,0 +1,19 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SHA_IN_BIG (1u<<3)
+#define SHA_1_MODE (1u<<4)
+#define SHA_OUT_BIG 1u
+void SHA_start(u16 params);
+void SHA_update(const u32 *data, u32 size);
+void SHA_finish(u32 *const hash, u16 endianess);
+void sha(const u32 *data, u32 size, u32 *const hash, u16 params, u16 hashEndianess);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef u32 Result;
+enum { RES_OK = 0, RES_SD_CARD_REMOVED, RES_DISK_FULL, RES_INVALID_ARG, RES_OUT_OF_MEM, RES_OUT_OF_RANGE, RES_NOT_FOUND, RES_PATH_TOO_LONG,
+ RES_FR_DISK_ERR, RES_FR_INT_ERR, RES_FR_NOT_READY, RES_FR_NO_FILE, RES_FR_NO_PATH, RES_FR_INVALID_NAME, RES_FR_DENIED, RES_FR_EXIST, RES_FR_INVALID_OBJECT,
+ CUSTOM_ERR_OFFSET = 200 };
+const char* result2String(Result res);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
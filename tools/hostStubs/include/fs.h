@@ -0,0 +1,40 @@
+#pragma once
+#include "error_codes.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef u8 FHandle; typedef u8 DHandle;
+typedef struct { u64 fsize; u16 fdate; u16 ftime; u8 fattrib; char altname[13]; char fname[256]; } FILINFO;
+#define FA_READ 1
+#define FA_WRITE 2
+#define FA_OPEN_EXISTING 0
+#define FA_CREATE_NEW 4
+#define FA_CREATE_ALWAYS 8
+#define FA_OPEN_ALWAYS 0x10
+#define AM_DIR 0x10
+typedef enum { FS_DRIVE_SDMC = 0 } FsDrive;
+Result fOpen(FHandle *const hOut, const char *const path, u8 mode);
+Result fRead(FHandle h, void *const buf, u32 size, u32 *const bytesRead);
+Result fWrite(FHandle h, const void *const buf, u32 size, u32 *const bytesWritten);
+Result fSync(FHandle h);
+Result fLseek(FHandle h, u32 off);
+u32 fTell(FHandle h);
+u32 fSize(FHandle h);
+Result fClose(FHandle h);
+Result fExpand(FHandle h, u32 size);
+Result fStat(const char *const path, FILINFO *const fi);
+Result fChdir(const char *const path);
+Result fOpenDir(DHandle *const hOut, const char *const path);
+Result fReadDir(DHandle h, FILINFO *const fi, u32 num, u32 *const entriesRead);
+Result fCloseDir(DHandle h);
+Result fMkdir(const char *const path);
+Result fRename(const char *const old, const char *const _new);
+Result fUnlink(const char *const path);
+Result fUnmount(FsDrive d);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+#include "error_codes.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+Result fsQuickRead(const char *const path, void *const buf, u32 size);
+Result fsQuickWrite(const char *const path, const void *const buf, u32 size);
+Result fsMakePath(const char *const path);
+Result fsLoadPathFromFile(const char *const path, char outPath[512]);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
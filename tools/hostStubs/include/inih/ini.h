@@ -0,0 +1,13 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef int (*ini_handler)(void* user, const char* section, const char* name, const char* value);
+int ini_parse_string(const char* string, ini_handler handler, void* user);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
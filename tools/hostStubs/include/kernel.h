@@ -0,0 +1,16 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef uintptr_t KHandle; typedef void (*TaskFunc)(void*);
+typedef enum { KRES_OK = 0 } KRes;
+KHandle createTask(size_t stackSize, u8 priority, TaskFunc entry, void *taskArg);
+void yieldTask(void); void taskExit(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
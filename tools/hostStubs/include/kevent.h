@@ -0,0 +1,13 @@
+#pragma once
+#include "kernel.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+KHandle createEvent(bool oneShot); void deleteEvent(const KHandle e); KRes waitForEvent(const KHandle e); void signalEvent(const KHandle e, bool reschedule); void clearEvent(const KHandle e);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,13 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+void __systemBootCore1(void (*entry)(void));
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
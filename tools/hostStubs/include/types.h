@@ -0,0 +1,25 @@
+#pragma once
+// Minimal stand-ins for the libn3ds headers so firmware modules build on the host.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+#include <inttypes.h>
+typedef uint8_t u8; typedef uint16_t u16; typedef uint32_t u32; typedef uint64_t u64;
+typedef int8_t s8; typedef int16_t s16; typedef int32_t s32; typedef int64_t s64;
+typedef volatile u8 vu8; typedef volatile u16 vu16; typedef volatile u32 vu32; typedef volatile u64 vu64;
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+#define NOINLINE __attribute__((noinline))
+#define UNUSED __attribute__((unused))
+#define PACKED __attribute__((packed))
+#define NAKED __attribute__((naked))
+#define TARGET_ARM
+#define arrayEntries(a) (sizeof(a)/sizeof(*(a)))
+
+// Older host compilers lack these C23 keywords.
+#if !defined(__cplusplus) && __STDC_VERSION__ < 202311L
+#include <stdalign.h>
+#ifndef constexpr
+#define constexpr const
+#endif
+#endif
@@ -0,0 +1,15 @@
+#pragma once
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+u32 nextPow2(u32 x); char* safeStrcpy(char *dst, const char *src, size_t n); float str2float(const char *s);
+ALWAYS_INLINE s32 clamp_s32(s32 x, s32 mn, s32 mx) { return x < mn ? mn : (x > mx ? mx : x); }
+ALWAYS_INLINE u8 rgbFive2Eight(u8 c) { return c<<3 | c>>2; }
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
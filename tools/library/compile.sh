@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# Builds library.c unmodified against ../hostStubs.
+# malloc()/realloc() are wrapped to count allocations while indexing.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+
+rm ./library
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DNDEBUG $INCLUDES -c ../hostStubs/hostStubs.c ../../source/arm11/library.c ../../source/arm11/arena.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -Wl,--gc-sections -Wl,--wrap=malloc,--wrap=realloc ./library.cpp ./*.o -lpthread -o ./library
+rm ./*.o
@@ -0,0 +1,404 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "arm11/library.h"
+
+
+#define BENCH_RUNS  (5u)
+
+
+// What the index should contain for one ROM.
+struct RomInfo
+{
+	char title[12];
+	char gameCode[4];
+	char maker[2];
+};
+
+typedef std::map<std::string, RomInfo> RomMap; // Keyed by full path.
+
+
+
+static std::string g_tmpDir;
+static u32 g_rng = 0x4C494252u;
+static bool g_countAllocs = false;
+static u32 g_allocs = 0;
+
+extern "C"
+{
+void* __real_malloc(size_t size);
+void* __real_realloc(void *ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+	g_allocs += g_countAllocs;
+	return __real_malloc(size);
+}
+
+void* __wrap_realloc(void *ptr, size_t size)
+{
+	g_allocs += g_countAllocs;
+	return __real_realloc(ptr, size);
+}
+}
+
+static u32 rnd(void)
+{
+	// xorshift32.
+	g_rng ^= g_rng<<13;
+	g_rng ^= g_rng>>17;
+	g_rng ^= g_rng<<5;
+	return g_rng;
+}
+
+static void makeDir(const std::string &path)
+{
+	if(mkdir(hostFsPath(path.c_str()), 0755) != 0) hostTestFail();
+}
+
+static void writeFile(const std::string &path, const void *const data, const u32 size)
+{
+	FILE *const f = fopen(hostFsPath(path.c_str()), "wb");
+	if(f == NULL || fwrite(data, 1, size, f) != size || fclose(f) != 0) hostTestFail();
+}
+
+static std::string join(const std::string &dir, const std::string &name)
+{
+	return dir + (dir.back() == '/' ? "" : "/") + name;
+}
+
+static u32 foldCase(const u32 c)
+{
+	return (c >= 'a' && c <= 'z' ? c - 32 : c);
+}
+
+// Random title with mixed case, NUL padded like real headers.
+static void randomTitle(char title[12])
+{
+	static const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789 -";
+	memset(title, 0, 12);
+	const u32 len = 1 + rnd() % 12;
+	for(u32 i = 0; i < len; i++) title[i] = chars[rnd() % (sizeof(chars) - 1)];
+}
+
+// Writes a ROM with a valid header. Returns what the index must say about it.
+static RomInfo makeRom(const std::string &path)
+{
+	u8 rom[0x200] = {};
+	RomInfo info;
+	randomTitle(info.title);
+	for(u32 i = 0; i < 4; i++) info.gameCode[i] = 'A' + rnd() % 26;
+	for(u32 i = 0; i < 2; i++) info.maker[i] = '0' + rnd() % 10;
+	memcpy(&rom[0xA0], info.title, 12);
+	memcpy(&rom[0xAC], info.gameCode, 4);
+	memcpy(&rom[0xB0], info.maker, 2);
+	rom[0xB2] = 0x96;
+	writeFile(path, rom, 0xC0 + rnd() % 0x40);
+
+	return info;
+}
+
+// ROM without a valid header. The title is the upper case file name.
+static RomInfo makeBadRom(const std::string &dir, const std::string &name)
+{
+	u8 rom[0xC0] = {};
+	writeFile(join(dir, name), rom, sizeof(rom));
+
+	RomInfo info{};
+	for(u32 i = 0; i < 12 && i < name.size() - 4; i++) info.title[i] = foldCase((u8)name[i]);
+	return info;
+}
+
+// Random tree with ROMs at every depth and everything the indexer must skip.
+static void makeTree(const std::string &dir, const u32 depth, RomMap &roms, u32 &romsLeft)
+{
+	const u32 numRoms = std::min(romsLeft, rnd() % 40);
+	for(u32 i = 0; i < numRoms; i++, romsLeft--)
+	{
+		const std::string name = "rom " + std::to_string(romsLeft) + ".gba";
+		if(rnd() % 10 == 0) roms[join(dir, name)] = makeBadRom(dir, name);
+		else                roms[join(dir, name)] = makeRom(join(dir, name));
+	}
+
+	const u8 small[0xBF] = {};
+	writeFile(join(dir, "small.gba"), small, sizeof(small)); // Too small for a header.
+	writeFile(join(dir, ".hidden.gba"), small, sizeof(small));
+	writeFile(join(dir, "upper.GBA"), small, sizeof(small));
+	writeFile(join(dir, "save.sav"), small, sizeof(small));
+	makeDir(join(dir, ".hiddenDir"));
+	makeRom(join(dir, ".hiddenDir/skipped.gba"));
+
+	if(depth == 0) return;
+	for(u32 n = 2 + rnd() % 4; n > 0 && romsLeft > 0; n--)
+	{
+		const std::string sub = join(dir, "dir " + std::to_string(rnd()));
+		makeDir(sub);
+		makeTree(sub, depth - 1, roms, romsLeft);
+	}
+}
+
+static std::string entryPath(const Library &lib, const u32 i)
+{
+	char path[512];
+	libGetPath(&lib, i, path);
+	return path;
+}
+
+static int refTitleCompare(const char *const a, const char *const b, const u32 n)
+{
+	for(u32 i = 0; i < n; i++)
+	{
+		const u32 ca = foldCase((u8)a[i]), cb = foldCase((u8)b[i]);
+		if(ca != cb) return (int)ca - (int)cb;
+		if(ca == '\0') break;
+	}
+	return 0;
+}
+
+static bool matchesTree(const Library &lib, const RomMap &roms)
+{
+	if(lib.num != roms.size()) return false;
+
+	std::map<std::string, bool> seen;
+	for(u32 i = 0; i < lib.num; i++)
+	{
+		const LibEntry &e = lib.entries[i];
+		const auto it = roms.find(entryPath(lib, i));
+		if(it == roms.end() || seen[it->first]) return false;
+		seen[it->first] = true;
+
+		const RomInfo &info = it->second;
+		if(memcmp(e.title, info.title, 12) != 0 || memcmp(e.gameCode, info.gameCode, 4) != 0 ||
+		   memcmp(e.maker, info.maker, 2) != 0) return false;
+		if(i > 0 && refTitleCompare(lib.entries[i - 1].title, e.title, 12) > 0) return false;
+	}
+
+	return true;
+}
+
+static bool abortAfter3(const u32, const char *const)
+{
+	static u32 calls = 0;
+	return ++calls < 3;
+}
+
+static void testIndex(void)
+{
+	RomMap roms;
+	u32 romsLeft = 2000;
+	makeTree("sdmc:/", 4, roms, romsLeft);
+	makeDir("sdmc:/Nintendo 3DS");
+	makeRom("sdmc:/Nintendo 3DS/skipped.gba");
+	makeDir("sdmc:/roms");
+	makeDir("sdmc:/roms/Nintendo 3DS"); // Only skipped in the root.
+	roms["sdmc:/roms/Nintendo 3DS/kept.gba"] = makeRom("sdmc:/roms/Nintendo 3DS/kept.gba");
+
+	// Path close to the 512 char limit.
+	std::string deep = "sdmc:/roms";
+	while(deep.size() < 470) { deep += "/" + std::string(40, 'd'); makeDir(deep); }
+	roms[deep + "/deep.gba"] = makeRom(deep + "/deep.gba");
+
+	hostFsResetStats();
+	g_allocs = 0;
+	g_countAllocs = true;
+	const Result res = libBuild("sdmc:/", NULL);
+	g_countAllocs = false;
+	const HostFsStats fs = g_hostFsStats;
+	check("Index build", res == RES_OK);
+	printf("  %zu ROMs, %" PRIu32 " dirs, %" PRIu32 " allocations\n", roms.size(), fs.dirOpens, g_allocs);
+	check("  ...allocations don't grow per file", g_allocs < 64);
+	check("  ...one header read per ROM", fs.opens == roms.size() + 1 && fs.reads == roms.size());
+
+	Library lib;
+	check("Index load", libLoad(&lib) == RES_OK);
+	check("  ...has every ROM with its header, sorted", matchesTree(lib, roms));
+
+	// Prefix search against a linear scan.
+	bool ok = true;
+	for(u32 i = 0; i < 5000 && ok; i++)
+	{
+		char prefix[14] = {};
+		if(rnd() % 2) memcpy(prefix, lib.entries[rnd() % lib.num].title, 1 + rnd() % 12);
+		else randomTitle(prefix);
+		for(char *c = prefix; *c != '\0'; c++) if(rnd() % 2) *c = foldCase((u8)*c) == (u8)*c ? tolower(*c) : toupper(*c);
+
+		const u32 len = std::min<u32>(strlen(prefix), 12);
+		u32 ref = 0;
+		while(ref < lib.num && refTitleCompare(lib.entries[ref].title, prefix, len) < 0) ref++;
+		ok &= libFindPrefix(&lib, prefix) == ref;
+	}
+	check("Prefix search == linear scan, any case", ok);
+	check("Empty prefix finds the first entry", libFindPrefix(&lib, "") == 0);
+	check("Prefix after all titles finds the end", libFindPrefix(&lib, "\x7F") == lib.num);
+	libFree(&lib);
+
+	// Aborting keeps the old index.
+	makeRom("sdmc:/new.gba");
+	check("Aborted build", libBuild("sdmc:/", abortAfter3) == RES_OK);
+	check("  ...keeps the old index", libLoad(&lib) == RES_OK && matchesTree(lib, roms));
+	libFree(&lib);
+	check("No handles left open", hostFsOpenHandles() == 0);
+}
+
+static void corruptIndex(const u32 offset, const void *const data, const u32 size)
+{
+	FILE *const f = fopen(hostFsPath(LIB_INDEX_PATH), "r+b");
+	if(f == NULL || fseek(f, offset, SEEK_SET) != 0 || fwrite(data, 1, size, f) != size || fclose(f) != 0) hostTestFail();
+}
+
+static void testCorrupt(void)
+{
+	static const u32 big = 0x7FFFFFFF;
+	static const u8 nonZero = 'x';
+	static const struct
+	{
+		const char *name;
+		u32 offset;
+		const void *data;
+		u32 size;
+	} corruptions[] =
+	{
+		{"Bad magic is rejected",             0,                       &big,     4},
+		{"Bad entry count is rejected",       8,                       &big,     4},
+		{"Bad pool size is rejected",         12,                      &big,     4},
+		{"Out of range dir offset rejected",  16 + 20,                 &big,     4},
+		{"Out of range name offset rejected", 16 + 24,                 &big,     4},
+		{"Unterminated pool is rejected",     UINT32_MAX,              &nonZero, 1}
+	};
+
+	for(const auto &c : corruptions)
+	{
+		if(libBuild("sdmc:/", NULL) != RES_OK) hostTestFail();
+		struct stat st;
+		stat(hostFsPath(LIB_INDEX_PATH), &st);
+		corruptIndex((c.offset == UINT32_MAX ? st.st_size - 1 : c.offset), c.data, c.size);
+
+		Library lib;
+		check(c.name, libLoad(&lib) != RES_OK && lib.num == 0 && lib.buf == NULL);
+	}
+
+	if(libBuild("sdmc:/", NULL) != RES_OK || truncate(hostFsPath(LIB_INDEX_PATH), 100) != 0) hostTestFail();
+	Library lib;
+	check("Truncated index is rejected", libLoad(&lib) != RES_OK);
+	check("No handles left open", hostFsOpenHandles() == 0);
+}
+
+static void testEmpty(void)
+{
+	const std::string root = g_tmpDir + "/empty";
+	if(mkdir(root.c_str(), 0755) != 0) hostTestFail();
+	hostFsSetRoot(root.c_str());
+
+	Library lib;
+	check("Missing index fails to load", libLoad(&lib) != RES_OK);
+	check("Empty SD card builds an empty index", libBuild("sdmc:/", NULL) == RES_OK && libLoad(&lib) == RES_OK && lib.num == 0);
+	check("  ...and searches in it", libFindPrefix(&lib, "A") == 0);
+	libFree(&lib);
+
+	hostFsSetRoot(g_tmpDir.c_str());
+}
+
+static int runTests(void)
+{
+	testIndex();
+	testCorrupt();
+	testEmpty();
+
+	return hostTestResult();
+}
+
+static int runBench(const u32 numRoms)
+{
+	RomMap roms;
+	u32 romsLeft = numRoms;
+	while(romsLeft > 0) makeTree("sdmc:/", 3, roms, romsLeft);
+
+	std::vector<std::string> prefixes;
+	for(u32 i = 0; i < 100000; i++)
+	{
+		char title[13] = {};
+		randomTitle(title);
+		title[1 + i % 4] = '\0';
+		prefixes.push_back(title);
+	}
+
+	double build = 1e30, load = 1e30, query = 1e30;
+	for(u32 run = 0; run < BENCH_RUNS; run++)
+	{
+		u64 start = hostNowNs();
+		if(libBuild("sdmc:/", NULL) != RES_OK) return 2;
+		build = std::min(build, (hostNowNs() - start) / 1e6);
+
+		Library lib;
+		start = hostNowNs();
+		if(libLoad(&lib) != RES_OK) return 2;
+		load = std::min(load, (hostNowNs() - start) / 1e6);
+
+		start = hostNowNs();
+		u32 sum = 0;
+		for(const std::string &prefix : prefixes) sum += libFindPrefix(&lib, prefix.c_str());
+		query = std::min(query, (hostNowNs() - start) / 1e3 / prefixes.size());
+		if(sum == UINT32_MAX) putchar(' '); // Keep the searches.
+		libFree(&lib);
+	}
+
+	struct stat st;
+	stat(hostFsPath(LIB_INDEX_PATH), &st);
+	printf("%zu ROMs, index %lld KiB. Best of %u runs at host FS speed.\n"
+	       "Build %.2f ms, load %.3f ms, prefix search %.3f us.\n",
+	       roms.size(), (long long)st.st_size / 1024, BENCH_RUNS, build, load, query);
+
+	return 0;
+}
+
+int main(const int argc, char *const argv[])
+{
+	const bool test = argc == 2 && strcmp(argv[1], "test") == 0;
+	const bool bench = (argc == 2 || argc == 3) && strcmp(argv[1], "bench") == 0;
+	if(!test && !bench)
+	{
+		printf("Usage: %s test|bench [ROMS]\n"
+		       "test:  Builds the library index from a generated SD card tree and\n"
+		       "       checks entries, prefix search and corrupt index files.\n"
+		       "bench: Build, load and prefix search times. Default 10000 ROMs.\n",
+		       argv[0]);
+		return 1;
+	}
+
+	const char *const tmpDir = hostTestDirCreate("library");
+	if(tmpDir == NULL) return 1;
+	g_tmpDir = tmpDir;
+
+	const int res = (test ? runTests() : runBench(argc == 3 ? strtoul(argv[2], NULL, 0) : 10000));
+
+	hostTestDirRemove();
+
+	return res;
+}
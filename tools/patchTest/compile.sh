@@ -0,0 +1,14 @@
+#!/bin/bash
+
+# Builds patch.c unmodified against ../hostStubs.
+# The old applier from the baseline commit is built as patchRomOld() for comparison.
+# -funsigned-char matches ARM where the old IPS offset math relies on it.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+CFLAGS="-std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -funsigned-char -Wall -Wextra -D__ARM11__ -DNDEBUG $INCLUDES"
+
+rm ./patchTest
+git show 1a343a8:source/arm11/patch.c > ./patch_old.c || exit 1
+gcc $CFLAGS -c ../hostStubs/hostStubs.c ../../source/arm11/patch.c ../../source/arm11/crc32.c ../../source/arm11/rom_load.c
+gcc $CFLAGS -DpatchRom=patchRomOld -w -c ./patch_old.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -Wl,--gc-sections ./patchTest.cpp ./*.o -lpthread -o ./patchTest
+rm ./*.o ./patch_old.c
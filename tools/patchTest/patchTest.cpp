@@ -0,0 +1,899 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "oaf_error_codes.h"
+#include "drivers/lgy_common.h"
+#include "arm11/drivers/hid.h"
+#include "arm11/patch.h"
+
+
+#define BENCH_RUNS   (5u)
+#define GAME_PATH    "sdmc:/game.gba"
+#define CORPUS_BASE  (0x180000u) // Trimmed 1.5 MiB ROM the corpus patches apply to.
+
+typedef std::vector<u8> Bytes;
+typedef Result (*PatchFunc)(const char *const, u32*);
+
+
+// The wrong base ROM prompt and the error prompt poll these.
+static u32 g_keysHeld = KEY_Y | KEY_DUP;
+static u32 g_keysDown = KEY_Y;
+static u32 g_prompts  = 0;
+
+extern "C"
+{
+Result patchRomOld(const char *const gamePath, u32 *romSize); // Baseline patch.c.
+
+void hidScanInput(void) {}
+u32 hidKeysHeld(void) { return g_keysHeld; }
+u32 hidKeysDown(void) { return g_keysDown; }
+u32 hidGetExtraKeys(UNUSED u32 clear) { return 0; }
+void GFX_waitForVBlank0(void) { g_prompts++; } // Only the wrong base ROM prompt waits.
+void power_off(void) { fprintf(stderr, "power_off() called!\n"); exit(3); }
+}
+
+struct IpsHunk
+{
+	u32 offset;
+	u32 rleLength; // 0 = normal hunk.
+	Bytes data;    // 1 byte for RLE hunks.
+};
+
+struct PatchRun
+{
+	Result res;
+	u32 romSize;
+	double ms;
+	HostFsStats fs;
+};
+
+
+
+static std::string g_tmpDir;
+static u32 g_rng = 0x50415443u;
+
+static u32 rnd(void)
+{
+	// xorshift32.
+	g_rng ^= g_rng<<13;
+	g_rng ^= g_rng>>17;
+	g_rng ^= g_rng<<5;
+	return g_rng;
+}
+
+static Bytes randomBytes(const u32 size)
+{
+	Bytes data(size);
+	for(u8 &x : data) x = rnd();
+	return data;
+}
+
+static bool writeFile(const std::string &name, const Bytes &data)
+{
+	FILE *const f = fopen((g_tmpDir + "/" + name).c_str(), "wb");
+	if(f == NULL) return false;
+	const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+
+	return (fclose(f) == 0 && ok);
+}
+
+// ROM size after fixRomPadding().
+static u32 paddedSize(const u32 size)
+{
+	u32 padded = 0x100000;
+	while(padded < size) padded <<= 1;
+	return padded;
+}
+
+// Applies a patch file to base like the ROM loader would.
+static PatchRun runPatch(const PatchFunc patchFunc, const char *const ext, const Bytes &base, const Bytes &patch)
+{
+	static const char *const exts[3] = {"ips", "bps", "ups"};
+	for(const char *const e : exts) unlink((g_tmpDir + "/game." + e).c_str());
+	writeFile(std::string("game.") + ext, patch);
+
+	u8 *const rom = (u8*)LGY_ROM_LOC;
+	memcpy(rom, base.data(), base.size());
+	memset(rom + base.size(), 0xFF, LGY_MAX_ROM_SIZE - base.size()); // Close enough to fixRomPadding().
+
+	PatchRun run;
+	run.romSize = paddedSize(base.size());
+	g_hostQuiet = true;
+	hostFsResetStats();
+	const u64 t = hostNowNs();
+	run.res = patchFunc(GAME_PATH, &run.romSize);
+	run.ms = (hostNowNs() - t) / 1e6;
+	run.fs = g_hostFsStats;
+	g_hostQuiet = false;
+
+	return run;
+}
+
+static bool romEquals(const Bytes &expected)
+{
+	return memcmp((void*)LGY_ROM_LOC, expected.data(), expected.size()) == 0;
+}
+
+// Checks result, ROM size and content. expected is the unpadded output.
+static bool checkRun(const PatchRun &run, const Result expectedRes, const Bytes &expected, const u32 expectedRomSize)
+{
+	if(run.res != expectedRes) return false;
+	if(expectedRes != RES_OK) return hostFsOpenHandles() == 0;
+
+	return run.romSize == expectedRomSize && romEquals(expected) && hostFsOpenHandles() == 0;
+}
+
+
+// --------------------------------------------------------------------------
+// IPS
+// --------------------------------------------------------------------------
+
+static void putBigEndian(Bytes &out, const u32 x, const u32 size)
+{
+	for(u32 i = size; i > 0; i--) out.push_back(x>>((i - 1) * 8));
+}
+
+// truncSize 0 = no truncation extension.
+static Bytes buildIps(const std::vector<IpsHunk> &hunks, const bool ips32, const u32 truncSize)
+{
+	const u32 offsetSize = (ips32 ? 4 : 3);
+	Bytes out;
+	const char *const magic = (ips32 ? "IPS32" : "PATCH");
+	out.insert(out.end(), magic, magic + 5);
+	for(const IpsHunk &h : hunks)
+	{
+		putBigEndian(out, h.offset, offsetSize);
+		if(h.rleLength != 0)
+		{
+			putBigEndian(out, 0, 2);
+			putBigEndian(out, h.rleLength, 2);
+			out.push_back(h.data[0]);
+		}
+		else
+		{
+			putBigEndian(out, h.data.size(), 2);
+			out.insert(out.end(), h.data.begin(), h.data.end());
+		}
+	}
+	const char *const eof = (ips32 ? "EEOF" : "EOF");
+	out.insert(out.end(), eof, eof + offsetSize);
+	if(truncSize != 0) putBigEndian(out, truncSize, offsetSize);
+
+	return out;
+}
+
+// Reference applier. Returns the unpadded output.
+static Bytes applyIps(const Bytes &base, const std::vector<IpsHunk> &hunks, const u32 truncSize)
+{
+	Bytes out = base;
+	for(const IpsHunk &h : hunks)
+	{
+		const u32 length = (h.rleLength != 0 ? h.rleLength : h.data.size());
+		if(h.offset + length > out.size()) out.resize(h.offset + length, 0);
+		if(h.rleLength != 0) memset(&out[h.offset], h.data[0], length);
+		else                 memcpy(&out[h.offset], h.data.data(), length);
+	}
+	if(truncSize != 0) out.resize(truncSize, 0);
+
+	return out;
+}
+
+// Random hunks inside [0, end). The IPS offset "EOF" is avoided.
+static std::vector<IpsHunk> randomIpsHunks(const u32 num, const u32 end, const u32 maxLength, const u32 rlePercent)
+{
+	std::vector<IpsHunk> hunks;
+	while(hunks.size() < num)
+	{
+		IpsHunk h;
+		const u32 length = 1 + rnd() % maxLength;
+		h.offset = rnd() % (end - length);
+		if(h.offset == 0x454F46u) continue;
+
+		if(rnd() % 100 < rlePercent)
+		{
+			h.rleLength = length;
+			h.data = randomBytes(1);
+		}
+		else
+		{
+			h.rleLength = 0;
+			h.data = randomBytes(length);
+		}
+		hunks.push_back(std::move(h));
+	}
+
+	return hunks;
+}
+
+static void testIps(void)
+{
+	const Bytes base = randomBytes(0x400000);
+
+	// Plain IPS works with the old applier too.
+	std::vector<IpsHunk> hunks = randomIpsHunks(3000, base.size(), 600, 10);
+	Bytes patch = buildIps(hunks, false, 0);
+	Bytes expected = applyIps(base, hunks, 0);
+	check("IPS hunks and RLE hunks", checkRun(runPatch(patchRom, "ips", base, patch), RES_OK, expected, base.size()));
+	check("IPS hunks and RLE hunks (old applier)", checkRun(runPatch(patchRomOld, "ips", base, patch), RES_OK, expected, base.size()));
+
+	// Growing the ROM. The gap is zero filled.
+	std::vector<IpsHunk> grow = randomIpsHunks(100, base.size(), 600, 10);
+	grow.push_back({0x500000, 0, randomBytes(100)});
+	grow.push_back({0x4FFF00, 300, {0x5A}});
+	expected = applyIps(base, grow, 0);
+	check("IPS hunks past the ROM end grow it",
+	      checkRun(runPatch(patchRom, "ips", base, buildIps(grow, false, 0)), RES_OK, expected, paddedSize(expected.size())));
+
+	hunks = randomIpsHunks(100, base.size(), 600, 10);
+	expected = applyIps(base, hunks, 0x2FFFF1);
+	check("IPS truncation extension",
+	      checkRun(runPatch(patchRom, "ips", base, buildIps(hunks, false, 0x2FFFF1)), RES_OK, expected, 0x400000));
+	expected = applyIps(base, hunks, 0x600000);
+	check("IPS truncation extension growing the ROM",
+	      checkRun(runPatch(patchRom, "ips", base, buildIps(hunks, false, 0x600000)), RES_OK, expected, 0x800000));
+
+	hunks = randomIpsHunks(100, base.size(), 600, 10);
+	hunks.push_back({0x1800000, 0, randomBytes(1000)});
+	hunks.push_back({0x1FFFF00, 0x100, {0x11}});
+	expected = applyIps(base, hunks, 0);
+	check("IPS32 hunks above 16 MiB",
+	      checkRun(runPatch(patchRom, "ips", base, buildIps(hunks, true, 0)), RES_OK, expected, LGY_MAX_ROM_SIZE));
+
+	hunks.push_back({0x1FFFF00, 0x101, {0x11}});
+	check("IPS32 hunk past 32 MiB",
+	      checkRun(runPatch(patchRom, "ips", base, buildIps(hunks, true, 0)), RES_ROM_TOO_BIG, {}, 0));
+
+	patch = buildIps(randomIpsHunks(100, base.size(), 600, 0), false, 0);
+	patch.resize(patch.size() / 2);
+	check("Truncated IPS patch", checkRun(runPatch(patchRom, "ips", base, patch), RES_INVALID_PATCH, {}, 0));
+	patch = buildIps(randomIpsHunks(100, base.size(), 600, 0), false, 0);
+	patch.resize(patch.size() - 3);
+	check("IPS patch without EOF marker", checkRun(runPatch(patchRom, "ips", base, patch), RES_INVALID_PATCH, {}, 0));
+	patch[0] = 'X';
+	check("IPS patch with wrong magic", checkRun(runPatch(patchRom, "ips", base, patch), RES_INVALID_PATCH, {}, 0));
+}
+
+
+// --------------------------------------------------------------------------
+// BPS
+// --------------------------------------------------------------------------
+
+// Bitwise CRC32 independent of crc32.c.
+static u32 refCrc32(const u8 *const data, const size_t size)
+{
+	u32 crc = 0xFFFFFFFFu;
+	for(size_t i = 0; i < size; i++)
+	{
+		crc ^= data[i];
+		for(u32 b = 0; b < 8; b++) crc = (crc>>1) ^ (0xEDB88320u & -(crc & 1u));
+	}
+
+	return ~crc;
+}
+
+static void putLittleEndian(Bytes &out, const u32 x)
+{
+	for(u32 i = 0; i < 4; i++) out.push_back(x>>(i * 8));
+}
+
+static void putNumber(Bytes &out, u64 x)
+{
+	while(1)
+	{
+		const u8 b = x & 0x7Fu;
+		x >>= 7;
+		if(x == 0)
+		{
+			out.push_back(0x80u | b);
+			break;
+		}
+		out.push_back(b);
+		x--;
+	}
+}
+
+static bool getNumber(const Bytes &in, size_t &pos, const size_t end, u64 &out)
+{
+	u64 data = 0, shift = 1;
+	while(pos < end)
+	{
+		const u8 x = in[pos++];
+		data += (x & 0x7Fu) * shift;
+		if(x & 0x80u)
+		{
+			out = data;
+			return true;
+		}
+		shift <<= 7;
+		data += shift;
+	}
+
+	return false;
+}
+
+// Encodes BPS actions and keeps track of the relative offsets.
+struct BpsWriter
+{
+	Bytes out;
+	u32 outputOffset = 0;
+	u32 sourceRel = 0;
+	u32 targetRel = 0;
+
+	BpsWriter(const u32 sourceSize, const u32 targetSize, const char *const metadata = "")
+	{
+		out.insert(out.end(), {'B', 'P', 'S', '1'});
+		putNumber(out, sourceSize);
+		putNumber(out, targetSize);
+		putNumber(out, strlen(metadata));
+		out.insert(out.end(), metadata, metadata + strlen(metadata));
+	}
+
+	void action(const u32 type, const u32 length)
+	{
+		putNumber(out, (u64)(length - 1)<<2 | type);
+		outputOffset += length;
+	}
+
+	void offset(u32 &rel, const u32 to)
+	{
+		const s64 d = (s64)to - rel;
+		putNumber(out, (u64)(d < 0 ? -d : d)<<1 | (d < 0));
+		rel = to;
+	}
+
+	void sourceRead(const u32 length) { action(0, length); }
+
+	void targetRead(const Bytes &data)
+	{
+		action(1, data.size());
+		out.insert(out.end(), data.begin(), data.end());
+	}
+
+	void sourceCopy(const u32 from, const u32 length)
+	{
+		action(2, length);
+		offset(sourceRel, from);
+		sourceRel += length;
+	}
+
+	void targetCopy(const u32 from, const u32 length)
+	{
+		action(3, length);
+		offset(targetRel, from);
+		targetRel += length;
+	}
+
+	// Appends source, target and patch CRC32.
+	Bytes finish(const Bytes &source, const Bytes &target)
+	{
+		Bytes patch = out;
+		putLittleEndian(patch, refCrc32(source.data(), source.size()));
+		putLittleEndian(patch, refCrc32(target.data(), target.size()));
+		putLittleEndian(patch, refCrc32(patch.data(), patch.size()));
+		return patch;
+	}
+};
+
+// Reference applier. Ignores the CRCs.
+static bool applyBpsRef(const Bytes &source, const Bytes &patch, Bytes &target)
+{
+	if(patch.size() < 4 + 3 + 12 || memcmp(patch.data(), "BPS1", 4) != 0) return false;
+
+	size_t pos = 4;
+	const size_t end = patch.size() - 12;
+	u64 sourceSize, targetSize, metadataSize;
+	if(!getNumber(patch, pos, end, sourceSize) || !getNumber(patch, pos, end, targetSize) ||
+	   !getNumber(patch, pos, end, metadataSize)) return false;
+	pos += metadataSize;
+	if(sourceSize > source.size()) return false;
+
+	target.assign(targetSize, 0);
+	u64 out = 0, sourceRel = 0, targetRel = 0;
+	while(pos < end)
+	{
+		u64 data;
+		if(!getNumber(patch, pos, end, data)) return false;
+		const u64 length = (data>>2) + 1;
+		if(out + length > targetSize) return false;
+
+		const u32 type = data & 3u;
+		if(type >= 2)
+		{
+			u64 o;
+			if(!getNumber(patch, pos, end, o)) return false;
+			u64 &rel = (type == 2 ? sourceRel : targetRel);
+			rel += (o & 1u ? -(o>>1) : o>>1);
+		}
+
+		for(u64 i = 0; i < length; i++, out++)
+		{
+			switch(type)
+			{
+				case 0:
+					if(out >= sourceSize) return false;
+					target[out] = source[out];
+					break;
+				case 1:
+					if(pos >= end) return false;
+					target[out] = patch[pos++];
+					break;
+				case 2:
+					if(sourceRel >= sourceSize) return false;
+					target[out] = source[sourceRel++];
+					break;
+				case 3:
+					if(targetRel >= out) return false;
+					target[out] = target[targetRel++];
+					break;
+			}
+		}
+	}
+
+	return out == targetSize;
+}
+
+// Random valid actions of all kinds. TargetCopy distances are often shorter than the length.
+static void randomBpsActions(BpsWriter &w, const Bytes &source, const u32 targetSize, const u32 maxLength)
+{
+	while(w.outputOffset < targetSize)
+	{
+		const u32 out = w.outputOffset;
+		const u32 length = 1 + rnd() % std::min(maxLength, std::min<u32>(targetSize - out, source.size()));
+		const u32 type = rnd() % 8;
+		if(type < 2 && out + length <= source.size()) w.sourceRead(length);
+		else if(type == 2)                            w.targetRead(randomBytes(std::min(length, 32u)));
+		else if(type < 6)                             w.sourceCopy(rnd() % (source.size() - length + 1), length);
+		else if(out > 0)                              w.targetCopy(out - 1 - rnd() % std::min(out, 4096u), length);
+	}
+}
+
+static Bytes corpusBase(const bool other = false)
+{
+	// Own generator so the corpus doesn't depend on test order.
+	u32 x = 0x42505331u;
+	Bytes base(CORPUS_BASE);
+	for(u8 &b : base)
+	{
+		x ^= x<<13;
+		x ^= x>>17;
+		x ^= x<<5;
+		b = x>>24;
+	}
+	if(other) base[0x1234] ^= 0xFF; // A different revision of the ROM.
+
+	return base;
+}
+
+static Bytes makeBps(const Bytes &source, const u32 targetSize, void (*const gen)(BpsWriter&, const Bytes&, u32))
+{
+	BpsWriter w(source.size(), targetSize, "open_agb_firm patchTest");
+	gen(w, source, targetSize);
+
+	Bytes target;
+	Bytes patch = w.finish(source, {});
+	if(!applyBpsRef(source, patch, target)) return {};
+
+	return w.finish(source, target);
+}
+
+static void genMixed(BpsWriter &w, const Bytes &source, const u32 targetSize)
+{
+	randomBpsActions(w, source, targetSize, 2048);
+}
+
+// Moves blocks around so most SourceCopy actions read data the output already overwrote.
+static void genSourceCopyBackward(BpsWriter &w, const Bytes &source, const u32 targetSize)
+{
+	while(w.outputOffset < targetSize)
+	{
+		const u32 out = w.outputOffset;
+		const u32 length = std::min<u32>(1 + rnd() % 8192, targetSize - out);
+		const u32 back = std::min(out, rnd() % 0x40000);
+		if(rnd() % 4 == 0 || out - back + length > source.size()) w.sourceRead(std::min<u32>(length, source.size() - out));
+		else w.sourceCopy(out - back, length);
+	}
+}
+
+// Short seeds repeated by overlapping TargetCopy actions.
+static void genTargetCopyOverlap(BpsWriter &w, UNUSED const Bytes &source, const u32 targetSize)
+{
+	static const u32 dists[] = {1, 2, 3, 7, 64, 1000, 4095};
+	u32 i = 0;
+	while(w.outputOffset < targetSize)
+	{
+		const u32 dist = dists[i++ % arrayEntries(dists)];
+		const u32 seed = std::min(dist, targetSize - w.outputOffset);
+		w.targetRead(randomBytes(seed));
+		const u32 left = targetSize - w.outputOffset;
+		if(left == 0) break;
+		w.targetCopy(w.outputOffset - dist, std::min<u32>(left, 1 + rnd() % 0x10000));
+	}
+}
+
+struct BpsCase
+{
+	const char *file;
+	const char *name;
+	Result res;      // Expected result.
+	bool declineBase; // Decline the wrong base ROM prompt.
+	bool otherBase;  // Patch made for a different revision of the base ROM.
+};
+
+static const BpsCase g_bpsCases[] =
+{
+	{"mixed.bps",                "BPS all actions",                    RES_OK,              false, false},
+	{"source_copy_backward.bps", "BPS SourceCopy behind the output",   RES_OK,              false, false},
+	{"target_copy_overlap.bps",  "BPS overlapping TargetCopy",         RES_OK,              false, false},
+	{"grow.bps",                 "BPS output larger than the input",   RES_OK,              false, false},
+	{"shrink.bps",               "BPS output smaller than the input",  RES_OK,              false, false},
+	{"bad_patch_crc.bps",        "BPS bad patch CRC",                  RES_INVALID_PATCH,   false, false},
+	{"bad_target_crc.bps",       "BPS bad target CRC",                 RES_PATCH_CHECKSUM,  false, false},
+	{"wrong_base.bps",           "BPS wrong base ROM, declined",       RES_INVALID_PATCH,   true,  true},
+	{"wrong_base.bps",           "BPS wrong base ROM, accepted",       RES_OK,              false, true},
+	{"truncated.bps",            "BPS truncated patch",                RES_INVALID_PATCH,   false, false},
+	{"source_out_of_range.bps",  "BPS SourceCopy past the input",      RES_INVALID_PATCH,   false, false},
+	{"target_too_big.bps",       "BPS output larger than 32 MiB",      RES_ROM_TOO_BIG,     false, false}
+};
+
+// Writes the committed corpus in tools/patchTest/corpus.
+static int writeCorpus(const char *const dir)
+{
+	const Bytes base = corpusBase();
+	std::vector<std::pair<const char*, Bytes>> files;
+	files.emplace_back("mixed.bps", makeBps(base, CORPUS_BASE, genMixed));
+	files.emplace_back("source_copy_backward.bps", makeBps(base, CORPUS_BASE, genSourceCopyBackward));
+	files.emplace_back("target_copy_overlap.bps", makeBps(base, CORPUS_BASE, genTargetCopyOverlap));
+	files.emplace_back("grow.bps", makeBps(base, 0x300000, genMixed));
+	files.emplace_back("shrink.bps", makeBps(base, 0x80000 + 77, genMixed));
+
+	Bytes patch = makeBps(base, CORPUS_BASE, genMixed);
+	patch[patch.size() - 1] ^= 1;
+	files.emplace_back("bad_patch_crc.bps", patch);
+
+	// Recompute the patch CRC after breaking the target CRC.
+	patch = makeBps(base, CORPUS_BASE, genMixed);
+	patch[patch.size() - 8] ^= 1;
+	patch.resize(patch.size() - 4);
+	putLittleEndian(patch, refCrc32(patch.data(), patch.size()));
+	files.emplace_back("bad_target_crc.bps", patch);
+
+	files.emplace_back("wrong_base.bps", makeBps(corpusBase(true), CORPUS_BASE, genMixed));
+
+	patch = makeBps(base, CORPUS_BASE, genMixed);
+	patch.resize(patch.size() * 2 / 3);
+	files.emplace_back("truncated.bps", patch);
+
+	BpsWriter w(base.size(), 0x1000);
+	w.sourceCopy(base.size() - 0x800, 0x1000);
+	files.emplace_back("source_out_of_range.bps", w.finish(base, Bytes(0x1000)));
+
+	BpsWriter big(base.size(), LGY_MAX_ROM_SIZE + 1);
+	big.targetRead(Bytes(16, 0x55));
+	files.emplace_back("target_too_big.bps", big.finish(base, {}));
+
+	for(const auto &f : files)
+	{
+		const std::string path = std::string(dir) + "/" + f.first;
+		FILE *const fp = fopen(path.c_str(), "wb");
+		if(fp == NULL || f.second.empty() || fwrite(f.second.data(), 1, f.second.size(), fp) != f.second.size())
+		{
+			fprintf(stderr, "Failed to write %s.\n", path.c_str());
+			return 1;
+		}
+		fclose(fp);
+		printf("%-26s %7zu bytes\n", f.first, f.second.size());
+	}
+
+	return 0;
+}
+
+static bool readCorpusFile(const std::string &path, Bytes &data)
+{
+	FILE *const f = fopen(path.c_str(), "rb");
+	if(f == NULL) return false;
+	data.clear();
+	u8 buf[4096];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+
+	return fclose(f) == 0;
+}
+
+static void testBps(const char *const corpusDir)
+{
+	const Bytes base = corpusBase();
+	for(const BpsCase &c : g_bpsCases)
+	{
+		Bytes patch;
+		if(!readCorpusFile(std::string(corpusDir) + "/" + c.file, patch))
+		{
+			printf("Missing %s/%s.\n", corpusDir, c.file);
+			hostTestFail();
+			continue;
+		}
+
+		Bytes expected;
+		const bool refOk = applyBpsRef(base, patch, expected);
+
+		g_keysHeld = (c.declineBase ? 0 : KEY_Y | KEY_DUP);
+		g_keysDown = (c.declineBase ? KEY_B : KEY_Y);
+		g_prompts  = 0;
+		const PatchRun run = runPatch(patchRom, "bps", base, patch);
+		g_keysHeld = KEY_Y | KEY_DUP;
+		g_keysDown = KEY_Y;
+
+		bool ok = run.res == c.res && hostFsOpenHandles() == 0 && g_prompts == (c.otherBase ? 1u : 0u);
+		if(c.res == RES_OK || c.res == RES_PATCH_CHECKSUM)
+			ok &= refOk && run.romSize == paddedSize(expected.size()) && romEquals(expected);
+		else
+			ok &= run.romSize == paddedSize(base.size()) && romEquals(base); // Rejected before touching the ROM.
+		check(c.name, ok);
+	}
+}
+
+
+// --------------------------------------------------------------------------
+// UPS
+// --------------------------------------------------------------------------
+
+// UPS numbers use the same encoding as BPS.
+static Bytes makeUps(const Bytes &input, const Bytes &output)
+{
+	Bytes patch{'U', 'P', 'S', '1'};
+	putNumber(patch, input.size());
+	putNumber(patch, output.size());
+
+	const size_t maxSize = std::max(input.size(), output.size());
+	auto at = [&](const size_t i) -> u8 { return (i < input.size() ? input[i] : 0) ^ (i < output.size() ? output[i] : 0); };
+	size_t pos = 0, last = 0;
+	while(pos < maxSize)
+	{
+		if(at(pos) == 0) { pos++; continue; }
+
+		putNumber(patch, pos - last);
+		while(pos < maxSize && at(pos) != 0) patch.push_back(at(pos++));
+		patch.push_back(0);
+		last = ++pos;
+	}
+
+	putLittleEndian(patch, refCrc32(input.data(), input.size()));
+	putLittleEndian(patch, refCrc32(output.data(), output.size()));
+	putLittleEndian(patch, refCrc32(patch.data(), patch.size()));
+	return patch;
+}
+
+// Replaces the patch CRC after editing the patch.
+static void fixUpsPatchCrc(Bytes &patch)
+{
+	patch.resize(patch.size() - 4);
+	putLittleEndian(patch, refCrc32(patch.data(), patch.size()));
+}
+
+// Random changes of random length. Large changes are rarely all non-zero XOR so they split into hunks.
+static Bytes modifiedCopy(const Bytes &input, const u32 outputSize, const u32 changes, const u32 maxLength)
+{
+	Bytes output = input;
+	output.resize(outputSize, 0);
+	for(u32 i = 0; i < changes; i++)
+	{
+		const u32 length = 1 + rnd() % maxLength;
+		const u32 offset = rnd() % (outputSize - length);
+		for(u32 j = 0; j < length; j++) output[offset + j] = rnd();
+	}
+
+	return output;
+}
+
+static void testUps(void)
+{
+	const Bytes base = randomBytes(0x180000);
+	Bytes expected = modifiedCopy(base, base.size(), 2000, 300);
+	Bytes patch = makeUps(base, expected);
+	check("UPS same size", checkRun(runPatch(patchRom, "ups", base, patch), RES_OK, expected, paddedSize(base.size())));
+	// The old applier stops once the file position reaches the footer and drops
+	// the hunks still in its 512 byte buffer. It's only compared in bench.
+
+	expected = modifiedCopy(base, 0x280000 + 3, 2000, 300);
+	check("UPS output larger than the input",
+	      checkRun(runPatch(patchRom, "ups", base, makeUps(base, expected)), RES_OK, expected, paddedSize(expected.size())));
+	expected = modifiedCopy(base, 0x90000, 500, 300);
+	check("UPS output smaller than the input",
+	      checkRun(runPatch(patchRom, "ups", base, makeUps(base, expected)), RES_OK, expected, paddedSize(expected.size())));
+
+	// Bad patches must be rejected before the ROM is touched.
+	struct
+	{
+		const char *name;
+		Bytes patch;
+		Result res;
+	} bad[4];
+	const Bytes good = makeUps(base, modifiedCopy(base, base.size(), 2000, 300));
+	bad[0] = {"UPS bad patch CRC", good, RES_INVALID_PATCH};
+	bad[0].patch[bad[0].patch.size() / 2] ^= 0x40;
+	bad[1] = {"UPS truncated patch", good, RES_INVALID_PATCH};
+	bad[1].patch.resize(good.size() * 2 / 3);
+	bad[2] = {"UPS hunk past the end", Bytes(good.begin(), good.end() - 12), RES_INVALID_PATCH};
+	putNumber(bad[2].patch, 0x200000);
+	bad[2].patch.insert(bad[2].patch.end(), {0x12, 0x00, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+	fixUpsPatchCrc(bad[2].patch);
+	Bytes big{'U', 'P', 'S', '1'};
+	putNumber(big, base.size());
+	putNumber(big, LGY_MAX_ROM_SIZE + 1);
+	big.insert(big.end(), 12, 0);
+	fixUpsPatchCrc(big);
+	bad[3] = {"UPS output larger than 32 MiB", big, RES_INVALID_PATCH};
+	for(const auto &b : bad)
+	{
+		const PatchRun run = runPatch(patchRom, "ups", base, b.patch);
+		check(b.name, run.res == b.res && run.romSize == paddedSize(base.size()) && romEquals(base) && hostFsOpenHandles() == 0);
+	}
+
+	// The output CRC is checked even if the wrong base ROM was accepted.
+	patch = good;
+	patch[patch.size() - 8] ^= 1;
+	fixUpsPatchCrc(patch);
+	check("UPS bad output CRC", runPatch(patchRom, "ups", base, patch).res == RES_PATCH_CHECKSUM);
+
+	Bytes other = base;
+	other[0x1234] ^= 0xFF;
+	expected = modifiedCopy(other, other.size(), 2000, 300);
+	patch = makeUps(other, expected);
+	g_prompts = 0;
+	const PatchRun forced = runPatch(patchRom, "ups", base, patch);
+	expected[0x1234] ^= 0xFF; // The difference to the other base ROM stays.
+	check("UPS wrong base ROM, accepted", forced.res == RES_PATCH_CHECKSUM && g_prompts == 1 && romEquals(expected));
+
+	g_keysHeld = 0;
+	g_keysDown = KEY_B;
+	g_prompts  = 0;
+	const PatchRun declined = runPatch(patchRom, "ups", base, patch);
+	g_keysHeld = KEY_Y | KEY_DUP;
+	g_keysDown = KEY_Y;
+	check("UPS wrong base ROM, declined", declined.res == RES_INVALID_PATCH && g_prompts == 1 && romEquals(base));
+}
+
+
+// --------------------------------------------------------------------------
+// Benchmarks
+// --------------------------------------------------------------------------
+
+static PatchRun bestOf(const PatchFunc patchFunc, const char *const ext, const Bytes &base, const Bytes &patch)
+{
+	PatchRun best{};
+	best.ms = 1e30;
+	for(u32 i = 0; i < BENCH_RUNS; i++)
+	{
+		const PatchRun run = runPatch(patchFunc, ext, base, patch);
+		if(run.ms < best.ms) best = run;
+	}
+
+	return best;
+}
+
+static void printBench(const char *const name, const PatchRun &run, const u32 patchSize)
+{
+	printf("  %-4s %8.2f ms %8.2f MiB/s %7" PRIu32 " fRead() calls %s\n", name, run.ms,
+	       patchSize / (1024. * 1024) * 1000 / run.ms, run.fs.reads, (run.res == RES_OK ? "" : "FAILED"));
+}
+
+// Compares both appliers on the same patch. Outputs must match.
+static void benchPair(const char *const name, const char *const ext, const Bytes &base, const Bytes &patch, const Bytes &expected)
+{
+	printf("%s, %.2f MiB patch:\n", name, patch.size() / (1024. * 1024));
+
+	const PatchRun oldRun = bestOf(patchRomOld, ext, base, patch);
+	const bool oldOk = romEquals(expected);
+	const PatchRun newRun = bestOf(patchRom, ext, base, patch);
+	const bool newOk = romEquals(expected);
+
+	printBench("old", oldRun, patch.size());
+	printBench("new", newRun, patch.size());
+	printf("  %.2fx%s%s\n", oldRun.ms / newRun.ms, (oldOk ? "" : " old output differs"), (newOk ? "" : " NEW OUTPUT MISMATCH"));
+}
+
+static int runBench(const double sdMiBps)
+{
+	g_hostFsReadBps = sdMiBps * 1024 * 1024;
+	char sdSpeed[32] = "host speed";
+	if(sdMiBps > 0) snprintf(sdSpeed, sizeof(sdSpeed), "%.1f MiB/s", sdMiBps);
+	printf("16 MiB ROM, SD %s, best of %u runs.\n", sdSpeed, BENCH_RUNS);
+
+	const Bytes base = randomBytes(0x1000000);
+
+	std::vector<IpsHunk> hunks = randomIpsHunks(60000, base.size(), 64, 5);
+	benchPair("IPS, 60000 small hunks", "ips", base, buildIps(hunks, false, 0), applyIps(base, hunks, 0));
+	hunks = randomIpsHunks(128, base.size(), 0xFFFF, 0);
+	benchPair("IPS, 128 large hunks", "ips", base, buildIps(hunks, false, 0), applyIps(base, hunks, 0));
+
+	Bytes output = modifiedCopy(base, base.size(), 60000, 64);
+	benchPair("UPS, 60000 small changes", "ups", base, makeUps(base, output), output);
+	output = modifiedCopy(base, base.size(), 64, 0x10000);
+	benchPair("UPS, 64 large changes", "ups", base, makeUps(base, output), output);
+
+	// No old BPS applier to compare with.
+	static const struct
+	{
+		const char *name;
+		void (*gen)(BpsWriter&, const Bytes&, u32);
+	} bpsBenches[3] =
+	{
+		{"BPS, all actions", genMixed},
+		{"BPS, SourceCopy behind the output", genSourceCopyBackward},
+		{"BPS, overlapping TargetCopy", genTargetCopyOverlap}
+	};
+	for(const auto &b : bpsBenches)
+	{
+		const Bytes patch = makeBps(base, base.size(), b.gen);
+		Bytes expected;
+		applyBpsRef(base, patch, expected);
+		const PatchRun run = bestOf(patchRom, "bps", base, patch);
+		printf("%s, %.2f MiB patch:\n", b.name, patch.size() / (1024. * 1024));
+		printBench("new", run, patch.size());
+		printf("  %.2f MiB/s ROM output%s\n", 16 * 1000 / run.ms, (romEquals(expected) ? "" : " OUTPUT MISMATCH"));
+	}
+
+	return 0;
+}
+
+int main(const int argc, char *const argv[])
+{
+	const bool test = (argc == 2 || argc == 3) && strcmp(argv[1], "test") == 0;
+	const bool bench = (argc == 2 || argc == 3) && strcmp(argv[1], "bench") == 0;
+	if(argc == 3 && strcmp(argv[1], "corpus") == 0) return writeCorpus(argv[2]);
+	if(!test && !bench)
+	{
+		printf("Usage: %s test [CORPUS_DIR]\n"
+		       "       %s bench [SD_MIB_PER_S]\n"
+		       "       %s corpus CORPUS_DIR\n"
+		       "test:   Applies generated IPS/UPS patches and the BPS corpus (default ./corpus)\n"
+		       "        with patchRom() and checks the results.\n"
+		       "bench:  Patch throughput of patchRom() and the old baseline applier.\n"
+		       "        SD_MIB_PER_S throttles reads to simulate the SD card. 0 = host speed.\n"
+		       "corpus: Regenerates the BPS corpus. The base ROM is generated, not stored.\n",
+		       argv[0], argv[0], argv[0]);
+		return 1;
+	}
+
+	const char *const tmpDir = hostTestDirCreate("patchTest");
+	if(tmpDir == NULL) return 1;
+	g_tmpDir = tmpDir;
+
+	int res;
+	if(test)
+	{
+		testIps();
+		testBps(argc > 2 ? argv[2] : "corpus");
+		testUps();
+		res = hostTestResult();
+	}
+	else res = runBench(argc > 2 ? strtod(argv[2], NULL) : 0);
+
+	hostTestDirRemove();
+
+	return res;
+}
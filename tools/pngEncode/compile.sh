@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# Builds png.c and crc32.c unmodified against ../hostStubs.
+# crc32() is renamed so the test checks chunk CRCs with zlib's own.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+
+rm ./pngEncode
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DNDEBUG -Dcrc32=oafCrc32 $INCLUDES -c ../hostStubs/hostStubs.c ../../source/arm11/png.c ../../source/arm11/crc32.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -Wl,--gc-sections ./pngEncode.cpp ./*.o -lz -lpthread -o ./pngEncode
+rm ./*.o
@@ -0,0 +1,272 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <zlib.h>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "arm11/png.h"
+
+
+#define WIDTH       (240u)
+#define HEIGHT      (160u)
+#define BMP_SIZE    (0x80u + WIDTH * HEIGHT * 2) // Old dumpFrameTex() BMP.
+#define CANARY      (0xA5u)
+#define CANARY_SIZE (256u)
+#define BENCH_RUNS  (5u)
+
+
+typedef enum
+{
+	FRAME_NOISE    = 0u,
+	FRAME_FLAT     = 1u,
+	FRAME_CHECKER  = 2u,
+	FRAME_GRADIENT = 3u,
+	FRAME_TILES    = 4u, // Repeated 8x8 tiles and a few sprites like most games.
+	FRAME_NUM      = 5u
+} FrameType;
+
+static const char *const g_frameNames[FRAME_NUM] = {"noise", "flat", "checkerboard", "gradient", "tiles"};
+
+
+
+static u32 g_rng = 0x504E4731u;
+
+static u32 rnd(void)
+{
+	// xorshift32.
+	g_rng ^= g_rng<<13;
+	g_rng ^= g_rng>>17;
+	g_rng ^= g_rng<<5;
+	return g_rng;
+}
+
+static u32 getBe32(const u8 *const p)
+{
+	return (u32)p[0]<<24 | (u32)p[1]<<16 | (u32)p[2]<<8 | p[3];
+}
+
+// The alpha bit is random everywhere. The encoder must ignore it.
+static void makeFrame(const FrameType type, const u32 w, const u32 h, u16 *const frame)
+{
+	u16 tiles[4][64];
+	for(auto &tile : tiles) for(u16 &px : tile) px = rnd() % 3 == 0 ? 0x7BDE : rnd();
+
+	for(u32 y = 0; y < h; y++)
+	{
+		for(u32 x = 0; x < w; x++)
+		{
+			u16 c;
+			switch(type)
+			{
+				case FRAME_NOISE:    c = rnd(); break;
+				case FRAME_FLAT:     c = 0x7BDEu<<1; break;
+				case FRAME_CHECKER:  c = ((x ^ y) & 1 ? 0xFFFE : 0); break;
+				case FRAME_GRADIENT: c = (x * 32 / w)<<11 | (y * 32 / h)<<6 | ((x + y) * 16 / (w + h))<<1; break;
+				default:             c = tiles[(x / 8 + y / 8 * 3) % 4][y % 8 * 8 + x % 8];
+			}
+			frame[y * w + x] = (c & ~1u) | (rnd() & 1u);
+		}
+	}
+
+	if(type == FRAME_TILES)
+	{
+		for(u32 i = 0; i < 16; i++) frame[rnd() % (w * h)] = rnd();
+	}
+}
+
+// Parses and inflates the PNG. Returns an error string or NULL if every pixel matches.
+static const char* verifyPng(const u8 *const png, const u32 size, const u16 *const frame, const u32 w, const u32 h)
+{
+	static const u8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	if(size < 8 || memcmp(png, signature, 8) != 0) return "bad signature";
+
+	static const char *const order[4] = {"IHDR", "sBIT", "IDAT", "IEND"};
+	std::vector<u8> idat;
+	u32 pos = 8;
+	for(const char *const type : order)
+	{
+		if(size - pos < 12) return "truncated chunk";
+		const u32 len = getBe32(&png[pos]);
+		if(len > size - pos - 12) return "chunk past the end";
+		if(memcmp(&png[pos + 4], type, 4) != 0) return "unexpected chunk";
+		if(getBe32(&png[pos + 8 + len]) != crc32(0, &png[pos + 4], 4 + len)) return "bad chunk CRC";
+
+		const u8 *const data = &png[pos + 8];
+		if(strcmp(type, "IHDR") == 0)
+		{
+			static const u8 tail[5] = {8, 2, 0, 0, 0}; // RGB8, deflate, no filter/interlace.
+			if(len != 13 || getBe32(data) != w || getBe32(&data[4]) != h || memcmp(&data[8], tail, 5) != 0)
+				return "bad IHDR";
+		}
+		else if(strcmp(type, "sBIT") == 0)
+		{
+			if(len != 3 || data[0] != 5 || data[1] != 5 || data[2] != 5) return "bad sBIT";
+		}
+		else if(strcmp(type, "IDAT") == 0) idat.assign(data, data + len);
+		else if(len != 0) return "bad IEND";
+
+		pos += 12 + len;
+	}
+	if(pos != size) return "data after IEND";
+
+	// uncompress() checks the zlib header and Adler32.
+	const u32 rawSize = h * (1 + w * 3);
+	std::vector<u8> raw(rawSize + 1);
+	uLongf rawLen = raw.size();
+	if(uncompress(raw.data(), &rawLen, idat.data(), idat.size()) != Z_OK) return "inflate failed";
+	if(rawLen != rawSize) return "wrong raw size";
+
+	const u8 *p = raw.data();
+	for(u32 y = 0; y < h; y++)
+	{
+		if(*p++ != 0) return "filter type not none";
+		for(u32 x = 0; x < w; x++, p += 3)
+		{
+			const u32 c = frame[y * w + x];
+			const u8 r = c>>11 & 0x1F, g = c>>6 & 0x1F, b = c>>1 & 0x1F;
+			if(p[0] != (r<<3 | r>>2) || p[1] != (g<<3 | g>>2) || p[2] != (b<<3 | b>>2)) return "pixel mismatch";
+		}
+	}
+
+	return NULL;
+}
+
+// Encodes into a buffer of exactly pngMaxSize() bytes followed by a canary.
+static u32 encode(const u16 *const frame, const u32 w, const u32 h, std::vector<u8> &buf, bool &canaryOk)
+{
+	const u32 maxSize = pngMaxSize(w, h);
+	buf.assign(maxSize + CANARY_SIZE, CANARY);
+	const u32 size = pngEncodeA1bgr5(frame, w, h, buf.data());
+	canaryOk = std::all_of(buf.begin() + maxSize, buf.end(), [](const u8 b) { return b == CANARY; });
+
+	return size;
+}
+
+static bool roundTrip(const char *const name, const FrameType type, const u32 w, const u32 h)
+{
+	std::vector<u16> frame(w * h);
+	makeFrame(type, w, h, frame.data());
+
+	std::vector<u8> buf;
+	bool canaryOk;
+	const u32 size = encode(frame.data(), w, h, buf, canaryOk);
+	const char *const err = (size <= pngMaxSize(w, h) ? verifyPng(buf.data(), size, frame.data(), w, h) : "over pngMaxSize()");
+	if(err != NULL) printf("%s: %s\n", name, err);
+	if(!canaryOk) printf("%s: wrote past pngMaxSize()\n", name);
+
+	return err == NULL && canaryOk;
+}
+
+static int runTests(void)
+{
+	char name[64];
+	for(u32 t = 0; t < FRAME_NUM; t++)
+	{
+		bool ok = true;
+		for(u32 i = 0; i < 8; i++) ok &= roundTrip(g_frameNames[t], (FrameType)t, WIDTH, HEIGHT);
+		snprintf(name, sizeof(name), "240x160 %s round trip", g_frameNames[t]);
+		check(name, ok);
+	}
+
+	// Odd sizes and single rows/columns for the bit writer and match limits.
+	static const u32 sizes[][2] = {{1, 1}, {1, 300}, {300, 1}, {3, 3}, {17, 5}, {360, 240}, {512, 64}};
+	for(const auto &s : sizes)
+	{
+		bool ok = true;
+		for(u32 t = 0; t < FRAME_NUM; t++) ok &= roundTrip(g_frameNames[t], (FrameType)t, s[0], s[1]);
+		snprintf(name, sizeof(name), "%" PRIu32 "x%" PRIu32 " all frame types round trip", s[0], s[1]);
+		check(name, ok);
+	}
+
+	// Noise repeating just past the 32 KiB window. Matches must not reach back that far.
+	std::vector<u16> frame(WIDTH * HEIGHT);
+	for(u32 i = 0; i < WIDTH * HEIGHT; i++) frame[i] = (i < 11000 ? rnd() : frame[i - 10923]) & ~1u;
+	std::vector<u8> buf;
+	bool canaryOk;
+	const u32 size = encode(frame.data(), WIDTH, HEIGHT, buf, canaryOk);
+	check("Matches at the window edge round trip", canaryOk && verifyPng(buf.data(), size, frame.data(), WIDTH, HEIGHT) == NULL);
+
+	makeFrame(FRAME_FLAT, WIDTH, HEIGHT, frame.data());
+	check("Flat frame is under 2 KiB", encode(frame.data(), WIDTH, HEIGHT, buf, canaryOk) < 2048);
+	makeFrame(FRAME_NOISE, WIDTH, HEIGHT, frame.data());
+	check("Noise frame stays under pngMaxSize()", encode(frame.data(), WIDTH, HEIGHT, buf, canaryOk) <= pngMaxSize(WIDTH, HEIGHT));
+
+	return hostTestResult();
+}
+
+static int runBench(void)
+{
+	printf("240x160, best of %u runs. Old BMP is %u bytes.\n", BENCH_RUNS, BMP_SIZE);
+	std::vector<u16> frame(WIDTH * HEIGHT);
+	std::vector<u8> buf(pngMaxSize(WIDTH, HEIGHT));
+	for(u32 t = 0; t < FRAME_NUM; t++)
+	{
+		makeFrame((FrameType)t, WIDTH, HEIGHT, frame.data());
+
+		u32 size = 0;
+		double best = 1e30;
+		for(u32 i = 0; i < BENCH_RUNS; i++)
+		{
+			const u64 start = hostNowNs();
+			size = pngEncodeA1bgr5(frame.data(), WIDTH, HEIGHT, buf.data());
+			best = std::min(best, (hostNowNs() - start) / 1e3);
+		}
+
+		// Same input through zlib level 9 for reference.
+		uLongf zSize = compressBound(HEIGHT * (1 + WIDTH * 3));
+		std::vector<u8> raw(HEIGHT * (1 + WIDTH * 3)), z(zSize);
+		for(u32 y = 0; y < HEIGHT; y++)
+		{
+			raw[y * (1 + WIDTH * 3)] = 0;
+			for(u32 x = 0; x < WIDTH; x++)
+			{
+				const u32 c = frame[y * WIDTH + x];
+				u8 *const p = &raw[y * (1 + WIDTH * 3) + 1 + x * 3];
+				p[0] = (c>>11 & 0x1F)<<3 | (c>>13 & 7);
+				p[1] = (c>>6 & 0x1F)<<3 | (c>>8 & 7);
+				p[2] = (c>>1 & 0x1F)<<3 | (c>>3 & 7);
+			}
+		}
+		compress2(z.data(), &zSize, raw.data(), raw.size(), 9);
+
+		printf("%-12s %7" PRIu32 " bytes (%5.1f%% of BMP), %8.1f us, zlib -9 IDAT %7lu bytes\n",
+		       g_frameNames[t], size, size * 100. / BMP_SIZE, best, (unsigned long)zSize);
+	}
+
+	return 0;
+}
+
+int main(const int argc, char *const argv[])
+{
+	if(argc == 2 && strcmp(argv[1], "test") == 0) return runTests();
+	if(argc == 2 && strcmp(argv[1], "bench") == 0) return runBench();
+
+	printf("Usage: %s test|bench\n"
+	       "test:  Inflates encoder output with zlib and compares every pixel\n"
+	       "       against its A1BGR5 source. Also checks chunk CRCs and bounds.\n"
+	       "bench: Encode time and size per frame type against the old BMP.\n",
+	       argv[0]);
+
+	return 1;
+}
@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# Builds rom_cache.c unmodified against ../hostStubs.
+# Unused hardware dependencies are dropped by --gc-sections.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+
+rm ./romCache
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DNDEBUG $INCLUDES -c ../hostStubs/hostStubs.c ../../source/arm11/rom_cache.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -Wl,--gc-sections ./romCache.cpp ./hostStubs.o ./rom_cache.o -lpthread -o ./romCache
+rm ./*.o
@@ -0,0 +1,295 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <utime.h>
+#include <unistd.h>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "arm11/config.h"
+#include "arm11/rom_cache.h"
+#include "arm11/save_type.h"
+
+
+#define CACHE_ENTRIES  (64u)                  // ROM_CACHE_ENTRIES in rom_cache.c.
+#define CACHE_FILE     "saves/rom_cache.bin"
+#define HEADER_SIZE    (24u)                  // offsetof(RomCache, entries).
+#define LUT_VER_OFFSET (16u)                  // RomCache.lutVersion.
+
+
+
+static std::string g_tmpDir;
+
+static std::string romPath(const u32 i)
+{
+	return "sdmc:/roms/game" + std::to_string(i) + ".gba";
+}
+
+// Creates a ROM file with the given size and FAT timestamp (2 s resolution).
+static bool makeRom(const std::string &path, const u32 size, const time_t mtime = 1700000000)
+{
+	const std::string hostPath = hostFsPath(path.c_str());
+	FILE *const f = fopen(hostPath.c_str(), "wb");
+	if(f == NULL) return false;
+	bool ok = ftruncate(fileno(f), size) == 0;
+	ok &= fclose(f) == 0;
+
+	const utimbuf times = {mtime, mtime};
+	return (ok && utime(hostPath.c_str(), &times) == 0);
+}
+
+static RomFingerprint makeFp(const u32 i)
+{
+	RomFingerprint fp{};
+	fp.sha1Prefix = 0x0123456789ABCDEFull * (i + 1);
+	fp.romSize    = 0x400000;
+	fp.scanStrIdx = i % 25;
+	fp.dbSaveType = i % 16;
+	fp.hasSha1    = true;
+
+	return fp;
+}
+
+static bool sameFp(const RomFingerprint &a, const RomFingerprint &b)
+{
+	return a.sha1Prefix == b.sha1Prefix && a.romSize == b.romSize && a.scanStrIdx == b.scanStrIdx &&
+	       a.dbSaveType == b.dbSaveType && a.hasSha1 == b.hasSha1;
+}
+
+// Looks up ROM i and stores fp on a miss like the ROM loader does.
+static bool lookupStore(const u32 i, RomFingerprint &fp)
+{
+	RomFingerprint cached;
+	if(romCacheLookup(romPath(i).c_str(), &cached))
+	{
+		fp = cached;
+		return true;
+	}
+
+	romCacheStore(&fp);
+	return false;
+}
+
+static bool isCached(const u32 i, RomFingerprint *const out = NULL)
+{
+	RomFingerprint fp;
+	const bool hit = romCacheLookup(romPath(i).c_str(), &fp);
+	if(out != NULL) *out = fp;
+
+	return hit;
+}
+
+static u32 cacheFileSize(void)
+{
+	struct stat st;
+	return (stat(hostFsPath(CACHE_FILE), &st) == 0 ? st.st_size : 0);
+}
+
+static bool patchCacheFile(const u32 offset, const void *const data, const u32 size)
+{
+	FILE *const f = fopen(hostFsPath(CACHE_FILE), "r+b");
+	if(f == NULL) return false;
+	bool ok = fseek(f, offset, SEEK_SET) == 0 && fwrite(data, 1, size, f) == size;
+
+	return (fclose(f) == 0 && ok);
+}
+
+static void resetCache(void)
+{
+	unlink(hostFsPath(CACHE_FILE));
+	unlink(hostFsPath("sdmc:/gba_db.bin"));
+}
+
+static void testBasic(void)
+{
+	resetCache();
+	makeRom(romPath(0), 0x400000);
+	RomFingerprint fp = makeFp(0), out;
+	check("Miss on an empty cache", !lookupStore(0, fp));
+	hostFsResetStats();
+	check("Hit after store", isCached(0, &out) && sameFp(out, fp));
+	check("Lookup is 1 open, 1 read, 2 stats",
+	      g_hostFsStats.opens == 1 && g_hostFsStats.reads == 1 && g_hostFsStats.stats == 2);
+
+	hostFsResetStats();
+	romCacheStore(&out);
+	check("Storing the MRU entry unchanged writes nothing", g_hostFsStats.writes == 0);
+
+	// Scan only results if gba_db.bin is not used.
+	makeRom(romPath(1), 0x400000);
+	RomFingerprint noSha = makeFp(1);
+	noSha.hasSha1 = false;
+	noSha.dbSaveType = GBA_DB_SAVE_UNKNOWN;
+	lookupStore(1, noSha);
+	noSha.sha1Prefix = 0;
+	check("Entry without SHA1 round trip", isCached(1, &out) && sameFp(out, noSha));
+
+	check("Missing ROM is a miss", !romCacheLookup("sdmc:/roms/none.gba", &out));
+	hostFsResetStats();
+	check("Store without a key writes nothing", romCacheStore(&fp) == RES_OK && g_hostFsStats.writes == 0);
+	check("No handles left open", hostFsOpenHandles() == 0);
+}
+
+static void testLru(void)
+{
+	resetCache();
+	for(u32 i = 0; i <= CACHE_ENTRIES; i++) makeRom(romPath(i), 0x400000);
+
+	bool ok = true;
+	for(u32 i = 0; i < CACHE_ENTRIES; i++)
+	{
+		RomFingerprint fp = makeFp(i);
+		ok &= !lookupStore(i, fp);
+	}
+	check("64 ROMs fill the cache", ok && cacheFileSize() == HEADER_SIZE + 32 * CACHE_ENTRIES);
+
+	ok = true;
+	for(u32 i = 0; i < CACHE_ENTRIES; i++)
+	{
+		RomFingerprint out;
+		ok &= isCached(i, &out) && sameFp(out, makeFp(i));
+	}
+	check("All 64 hit with their own data", ok);
+
+	// Touch the oldest so ROM 1 becomes the least recently used.
+	RomFingerprint fp = makeFp(0);
+	lookupStore(0, fp);
+	fp = makeFp(0);
+	romCacheStore(&fp);
+	fp = makeFp(CACHE_ENTRIES);
+	lookupStore(CACHE_ENTRIES, fp);
+	check("65th ROM evicts the least recently used", !isCached(1) && isCached(0) && isCached(CACHE_ENTRIES));
+	check("Entry count stays at 64", cacheFileSize() == HEADER_SIZE + 32 * CACHE_ENTRIES);
+
+	ok = true;
+	for(u32 i = 2; i < CACHE_ENTRIES; i++) ok &= isCached(i);
+	check("Other entries survive the eviction", ok);
+}
+
+static void testStale(void)
+{
+	resetCache();
+	makeRom(romPath(0), 0x400000);
+	RomFingerprint fp = makeFp(0);
+	lookupStore(0, fp);
+
+	makeRom(romPath(0), 0x400000 + 4);
+	check("Different file size is a miss", !isCached(0));
+	makeRom(romPath(0), 0x400000, 1700000100);
+	check("Different timestamp is a miss", !isCached(0));
+
+	// Restoring must overwrite the stale entry instead of adding one.
+	fp = makeFp(7);
+	lookupStore(0, fp);
+	RomFingerprint out;
+	check("Stale entry is replaced in place", isCached(0, &out) && sameFp(out, fp) && cacheFileSize() == HEADER_SIZE + 32);
+
+	// A changed gba_db.bin only invalidates the db save type.
+	makeRom("sdmc:/gba_db.bin", 28 * 100);
+	check("New gba_db.bin resets the db save type",
+	      isCached(0, &out) && out.dbSaveType == GBA_DB_SAVE_UNKNOWN && out.scanStrIdx == fp.scanStrIdx &&
+	      out.sha1Prefix == fp.sha1Prefix);
+	fp.dbSaveType = 3;
+	romCacheStore(&fp);
+	check("Same gba_db.bin keeps the db save type", isCached(0, &out) && out.dbSaveType == 3);
+	makeRom("sdmc:/gba_db.bin", 28 * 100, 1700000200);
+	check("Touched gba_db.bin resets the db save type", isCached(0, &out) && out.dbSaveType == GBA_DB_SAVE_UNKNOWN);
+}
+
+static void testCorrupt(void)
+{
+	static const struct
+	{
+		const char *name;
+		u32 offset;
+		u32 value;
+		u32 size;
+	} corruptions[] =
+	{
+		{"Wrong magic drops the cache",                0,              0x12345678u,               4},
+		{"Wrong version drops the cache",              4,              2,                         2},
+		{"Wrong save string lut version drops it",     LUT_VER_OFFSET, SAVE_TYPE_LUT_VERSION + 1, 4},
+		{"Too many entries drops the cache",           6,              CACHE_ENTRIES + 1,         2},
+		{"Entry count/size mismatch drops the cache",  6,              3,                         2}
+	};
+
+	for(const auto &c : corruptions)
+	{
+		resetCache();
+		makeRom(romPath(0), 0x400000);
+		makeRom(romPath(1), 0x400000);
+		RomFingerprint fp = makeFp(0);
+		lookupStore(0, fp);
+		fp = makeFp(1);
+		lookupStore(1, fp);
+
+		patchCacheFile(c.offset, &c.value, c.size);
+		check(c.name, !isCached(0) && !isCached(1));
+
+		// The cache must recover with the current version.
+		fp = makeFp(0);
+		lookupStore(0, fp);
+		check("  ...and recovers on the next store", isCached(0) && cacheFileSize() == HEADER_SIZE + 32);
+	}
+
+	resetCache();
+	makeRom(romPath(0), 0x400000);
+	RomFingerprint fp = makeFp(0);
+	lookupStore(0, fp);
+	if(truncate(hostFsPath(CACHE_FILE), HEADER_SIZE + 31) != 0) hostTestFail();
+	check("Truncated file drops the cache", !isCached(0));
+}
+
+static int runTests(void)
+{
+	if(mkdir((g_tmpDir + "/roms").c_str(), 0755) != 0 || mkdir((g_tmpDir + "/saves").c_str(), 0755) != 0) return 1;
+
+	testBasic();
+	testLru();
+	testStale();
+	testCorrupt();
+
+	return hostTestResult();
+}
+
+int main(const int argc, char *const argv[])
+{
+	if(argc != 2 || strcmp(argv[1], "test") != 0)
+	{
+		printf("Usage: %s test\n"
+		       "Checks rom_cache.bin LRU order, eviction, stale entries,\n"
+		       "gba_db.bin changes and corrupt or outdated cache files.\n",
+		       argv[0]);
+		return 1;
+	}
+
+	const char *const tmpDir = hostTestDirCreate("romCache");
+	if(tmpDir == NULL) return 1;
+	g_tmpDir = tmpDir;
+
+	const int res = runTests();
+
+	hostTestDirRemove();
+
+	return res;
+}
@@ -0,0 +1,228 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "drivers/lgy_common.h"
+#include "drivers/sha.h"
+#include "arm11/rom_load.h"
+#include "arm11/save_type.h"
+
+
+#define BENCH_RUNS  (5u)
+
+
+struct RomResult
+{
+	Result res;
+	u32 romSize;
+	u64 sha1[3];
+	u8 strIdx;
+};
+
+struct TestRom
+{
+	const char *name;
+	u32 size;
+	u32 strOffset; // Where the save string goes. 0 = none.
+	const char *saveStr;
+};
+
+// Trimmed, mirrored, chunk straddling and too big ROMs.
+static const TestRom g_testRoms[] =
+{
+	{"small.gba",    0x40000,        0x1000,        "SRAM_V113"},
+	{"trimmed.gba",  0x300000 + 123, 0x2FFFF0,      "FLASH1M_V103"},
+	{"straddle.gba", 0x400000,       0x80000 - 4,   "EEPROM_V124"},
+	{"nosave.gba",   0x1000000,      0,             NULL},
+	{"full.gba",     0x2000000,      0x1FFFFF0,     "FLASH512_V131"},
+	{"toobig.gba",   0x2000000 + 64, 0x1FFFF00,     "FLASH_V126"}
+};
+
+
+
+static std::string g_tmpDir;
+
+static bool makeRom(const TestRom &rom)
+{
+	std::unique_ptr<u8[]> buf(new u8[rom.size]);
+	u32 x = 0x12345678u ^ rom.size;
+	for(u32 i = 0; i < rom.size; i++)
+	{
+		// xorshift32. Never produces a valid save string by accident.
+		x ^= x<<13;
+		x ^= x>>17;
+		x ^= x<<5;
+		buf[i] = x;
+	}
+	if(rom.saveStr != NULL) memcpy(&buf[rom.strOffset], rom.saveStr, strlen(rom.saveStr));
+
+	const std::string path = g_tmpDir + "/" + rom.name;
+	FILE *const f = fopen(path.c_str(), "wb");
+	if(f == NULL) return false;
+	const bool ok = fwrite(buf.get(), 1, rom.size, f) == rom.size;
+
+	return (fclose(f) == 0 && ok);
+}
+
+// The old way. Load, then hash, then scan.
+static double loadSequential(const char *const path, RomResult &r, double stages[3])
+{
+	u64 t = hostNowNs();
+	r.res = loadGbaRom(path, &r.romSize, NULL, NULL);
+	stages[0] = (hostNowNs() - t) / 1e6;
+	if(r.res != RES_OK) return stages[0];
+
+	t = hostNowNs();
+	sha((u32*)LGY_ROM_LOC, r.romSize, (u32*)r.sha1, SHA_IN_BIG | SHA_1_MODE, SHA_OUT_BIG);
+	stages[1] = (hostNowNs() - t) / 1e6;
+
+	t = hostNowNs();
+	SaveScanState scan;
+	saveScanInit(&scan);
+	saveScanUpdate(&scan, r.romSize, true);
+	r.strIdx = scan.strIdx;
+	stages[2] = (hostNowNs() - t) / 1e6;
+
+	return stages[0] + stages[1] + stages[2];
+}
+
+static double loadPipelined(const char *const path, RomResult &r)
+{
+	const u64 t = hostNowNs();
+	SaveScanState scan;
+	r.res = loadGbaRom(path, &r.romSize, r.sha1, &scan);
+	r.strIdx = scan.strIdx;
+
+	return (hostNowNs() - t) / 1e6;
+}
+
+static int runTests(void)
+{
+	const u32 romBufSize = LGY_MAX_ROM_SIZE;
+	std::unique_ptr<u8[]> refRom(new u8[romBufSize]);
+
+	for(const TestRom &rom : g_testRoms)
+	{
+		if(!makeRom(rom))
+		{
+			fprintf(stderr, "Failed to create %s.\n", rom.name);
+			return 1;
+		}
+
+		const std::string path = std::string("sdmc:/") + rom.name;
+		RomResult seq{}, pipe{};
+		double stages[3];
+		loadSequential(path.c_str(), seq, stages);
+		memcpy(refRom.get(), (void*)LGY_ROM_LOC, romBufSize);
+		memset((void*)LGY_ROM_LOC, 0xAA, romBufSize);
+		loadPipelined(path.c_str(), pipe);
+
+		const bool ok = seq.res == RES_OK && pipe.res == RES_OK && seq.romSize == pipe.romSize &&
+		                memcmp(seq.sha1, pipe.sha1, 20) == 0 && seq.strIdx == pipe.strIdx &&
+		                (rom.saveStr == NULL) == (pipe.strIdx == 0xFF) &&
+		                memcmp(refRom.get(), (void*)LGY_ROM_LOC, romBufSize) == 0;
+		char name[64];
+		snprintf(name, sizeof(name), "%-13s romSize 0x%08" PRIX32 " strIdx %3u", rom.name, pipe.romSize, pipe.strIdx);
+		check(name, ok);
+	}
+
+	// Missing files must fail cleanly.
+	RomResult missing{};
+	check("missing.gba", loadPipelined("sdmc:/missing.gba", missing) >= 0 && missing.res != RES_OK && hostFsOpenHandles() == 0);
+
+	return hostTestResult();
+}
+
+static int runBench(const double sdMiBps, const char *const romPath)
+{
+	std::string path = "sdmc:/bench.gba";
+	if(romPath != NULL)
+	{
+		// Serve the given ROM from its own directory.
+		std::string dir(romPath);
+		const size_t slash = dir.rfind('/');
+		hostFsSetRoot(slash == std::string::npos ? "." : dir.substr(0, slash).c_str());
+		path = std::string("sdmc:/") + (slash == std::string::npos ? dir : dir.substr(slash + 1));
+	}
+	else if(!makeRom({"bench.gba", 0x1000000, 0xFFFFF0, "FLASH1M_V103"}))
+	{
+		fprintf(stderr, "Failed to create bench.gba.\n");
+		return 1;
+	}
+
+	g_hostFsReadBps = sdMiBps * 1024 * 1024;
+	double best[5] = {1e30, 1e30, 1e30, 1e30, 1e30}; // Read, SHA1, scan, sequential, pipelined.
+	RomResult r{};
+	for(u32 i = 0; i < BENCH_RUNS; i++)
+	{
+		double stages[3];
+		const double seq = loadSequential(path.c_str(), r, stages);
+		if(r.res != RES_OK)
+		{
+			fprintf(stderr, "Failed to load ROM.\n");
+			return 2;
+		}
+		for(u32 s = 0; s < 3; s++) best[s] = std::min(best[s], stages[s]);
+		best[3] = std::min(best[3], seq);
+		best[4] = std::min(best[4], loadPipelined(path.c_str(), r));
+	}
+
+	const double mib = r.romSize / (1024. * 1024);
+	static const char *const names[5] = {"read + pad", "SHA1", "save scan", "sequential", "pipelined"};
+	char sdSpeed[32] = "host speed";
+	if(sdMiBps > 0) snprintf(sdSpeed, sizeof(sdSpeed), "%.1f MiB/s", sdMiBps);
+	printf("ROM size 0x%08" PRIX32 ", SD %s, best of %u runs\n", r.romSize, sdSpeed, BENCH_RUNS);
+	for(u32 s = 0; s < 5; s++) printf("%-10s %9.2f ms %9.2f MiB/s\n", names[s], best[s], mib * 1000 / best[s]);
+	printf("Pipelining saves %.2f ms (%.1f%%).\n", best[3] - best[4], (best[3] - best[4]) * 100 / best[3]);
+
+	return 0;
+}
+
+int main(const int argc, char *const argv[])
+{
+	if(argc < 2 || (strcmp(argv[1], "test") != 0 && strcmp(argv[1], "bench") != 0) || argc > 4)
+	{
+		printf("Usage: %s test\n"
+		       "       %s bench [SD_MIB_PER_S] [ROM.gba]\n"
+		       "Times the ROM load stages sequentially and pipelined like loadGbaRom().\n"
+		       "SD_MIB_PER_S throttles reads to simulate the SD card. 0 = host speed.\n"
+		       "Tasks are host threads so the worker really runs in parallel here.\n",
+		       argv[0], argv[0]);
+		return 1;
+	}
+
+	const char *const tmpDir = hostTestDirCreate("romLoad");
+	if(tmpDir == NULL) return 1;
+	g_tmpDir = tmpDir;
+
+	int res;
+	if(strcmp(argv[1], "test") == 0) res = runTests();
+	else res = runBench((argc > 2 ? strtod(argv[2], NULL) : 0), (argc > 3 ? argv[3] : NULL));
+
+	hostTestDirRemove();
+
+	return res;
+}
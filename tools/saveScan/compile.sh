@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# Builds save_type.c unmodified against ../hostStubs.
+# Unused hardware dependencies are dropped by --gc-sections.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../../include"
+
+rm ./saveScan
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DNDEBUG $INCLUDES -c ../hostStubs/hostStubs.c ../../source/arm11/save_type.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -Wl,--gc-sections ./saveScan.cpp ./hostStubs.o ./save_type.o -lpthread -o ./saveScan
+rm ./*.o
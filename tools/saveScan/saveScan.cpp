@@ -0,0 +1,229 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "drivers/lgy_common.h"
+#include "arm11/save_type.h"
+
+
+#define TEST_IMAGES     (400u)
+#define TEST_ROM_SIZE   (0x100000u)
+#define BENCH_RUNS      (5u)
+
+
+// Same order as g_saveTypeLut in save_type.c.
+static const char *const g_saveStrs[25] =
+{
+	"EEPROM_V111", "EEPROM_V120", "EEPROM_V121", "EEPROM_V122", "EEPROM_V124", "EEPROM_V125", "EEPROM_V126",
+	"FLASH_V120", "FLASH_V121", "FLASH_V123", "FLASH_V124", "FLASH_V125", "FLASH_V126",
+	"FLASH512_V130", "FLASH512_V131", "FLASH512_V133", "FLASH1M_V102", "FLASH1M_V103",
+	"SRAM_F_V100", "SRAM_F_V102", "SRAM_F_V103",
+	"SRAM_V110", "SRAM_V111", "SRAM_V112", "SRAM_V113"
+};
+
+// Prefixes that send both matchers down the slow path without matching.
+static const char *const g_falsePrefixes[] =
+{
+	"EEPR", "FLAS", "SRAM", "EEPROM_V", "EEPROM_V12", "EEPROM_V127", "FLASH_V", "FLASH512_V13",
+	"FLASH1M_V104", "SRAM_F_V", "SRAM_V11", "SRAM_V114", "FLASH_V12"
+};
+
+
+
+static u32 g_rng = 0x53415645u;
+
+static u32 rnd(void)
+{
+	// xorshift32.
+	g_rng ^= g_rng<<13;
+	g_rng ^= g_rng>>17;
+	g_rng ^= g_rng<<5;
+	return g_rng;
+}
+
+// The scan before the trie. Kept as reference.
+static u8 scanMemcmp(const u32 romSize)
+{
+	const u32 *romPtr = (u32*)(LGY_ROM_LOC + 0xE4);
+	for(; romPtr < (u32*)(LGY_ROM_LOC + romSize); romPtr++)
+	{
+		const u32 tmp = *romPtr;
+
+		// "EEPR" "FLAS" "SRAM"
+		if(tmp == 0x52504545u || tmp == 0x53414C46u || tmp == 0x4D415253u)
+		{
+			for(u32 i = 0; i < 25; i++)
+			{
+				const char *const str = g_saveStrs[i];
+				if(memcmp(romPtr, str, strlen(str)) == 0) return i;
+			}
+		}
+	}
+
+	return 0xFF;
+}
+
+static u8 scanTrie(const u32 romSize, const u32 chunkSize)
+{
+	SaveScanState scan;
+	saveScanInit(&scan);
+	for(u32 end = chunkSize; end < romSize; end += chunkSize) saveScanUpdate(&scan, end, false);
+	saveScanUpdate(&scan, romSize, true);
+
+	return scan.strIdx;
+}
+
+static void putStr(u8 *const rom, const u32 offset, const char *const str, const u32 len)
+{
+	memcpy(&rom[offset], str, len);
+}
+
+// Random data with dense false prefixes. Optionally plants
+// complete, truncated and unaligned save strings.
+static void makeImage(const u32 romSize, const u32 prefixesPerMiB, const bool plant)
+{
+	u8 *const rom = (u8*)LGY_ROM_LOC;
+	for(u32 i = 0; i < romSize; i += 4)
+	{
+		const u32 x = rnd();
+		memcpy(&rom[i], &x, 4);
+	}
+	// Padding like fixRomPadding() so the reference may read past the end.
+	memset(&rom[romSize], 0xFF, 64);
+
+	const u32 numPrefixes = (u64)prefixesPerMiB * romSize / 0x100000;
+	for(u32 i = 0; i < numPrefixes; i++)
+	{
+		const char *const str = g_falsePrefixes[rnd() % arrayEntries(g_falsePrefixes)];
+		const u32 offset = 0xE4 + (rnd() % (romSize - 0xE4 - 16)) / 4 * 4;
+		putStr(rom, offset, str, strlen(str) + 1); // Terminated so random data can't complete it.
+	}
+	if(!plant) return;
+
+	// Not found by either. Unaligned strings and strings in the header.
+	putStr(rom, 0xE4 + (rnd() % (romSize / 2)) / 4 * 4 + 1 + rnd() % 3, "FLASH1M_V103", 12);
+	putStr(rom, 0xA0, "SRAM_V113", 9);
+
+	const u32 kind = rnd() % 4;
+	const char *const str = g_saveStrs[rnd() % 25];
+	const u32 len = strlen(str);
+	if(kind == 0) return;                                                        // None.
+	else if(kind == 1) putStr(rom, 0xE4 + (rnd() % (romSize - 0xE4 - 16)) / 4 * 4, str, len); // Anywhere.
+	else if(kind == 2) putStr(rom, (romSize - len) & ~3u, str, len);             // At the very end.
+	else putStr(rom, 0xE4 + (rnd() % (romSize - 0xE4 - 16)) / 4 * 4, str, len - 1 - rnd() % 3); // Truncated.
+}
+
+static int runTests(void)
+{
+	static const char *const chunkNames[4] = {"whole ROM", "512 KiB", "random", "4 byte"};
+	bool chunkOk[4] = {true, true, true, true};
+	u32 found = 0;
+	for(u32 i = 0; i < TEST_IMAGES; i++)
+	{
+		// Odd sizes for trimmed ROMs.
+		const u32 romSize = TEST_ROM_SIZE - (i % 3 == 0 ? rnd() % 64 : 0);
+		makeImage(romSize, 2000, true);
+
+		const u8 ref = scanMemcmp(romSize);
+		const u32 chunkSizes[4] = {romSize, 0x80000, 4 + (rnd() % 0x1000) / 4 * 4, 4};
+		for(u32 c = 0; c < 4; c++)
+		{
+			const u8 strIdx = scanTrie(romSize, chunkSizes[c]);
+			if(strIdx != ref)
+			{
+				printf("Image %" PRIu32 " chunk size %" PRIu32 ": trie %u, memcmp %u\n", i, chunkSizes[c], strIdx, ref);
+				chunkOk[c] = false;
+			}
+		}
+		found += ref != 0xFF;
+	}
+
+	printf("%u images, %" PRIu32 " with a save string.\n", TEST_IMAGES, found);
+	char name[64];
+	for(u32 c = 0; c < 4; c++)
+	{
+		snprintf(name, sizeof(name), "%s chunks match memcmp()", chunkNames[c]);
+		check(name, chunkOk[c]);
+	}
+
+	return hostTestResult();
+}
+
+static double bestOf(u8 (*const scan)(u32, u32), const u32 romSize, u8 &strIdx)
+{
+	double best = 1e30;
+	for(u32 i = 0; i < BENCH_RUNS; i++)
+	{
+		const u64 t = hostNowNs();
+		strIdx = scan(romSize, 0x80000);
+		best = std::min(best, (hostNowNs() - t) / 1e6);
+	}
+
+	return best;
+}
+
+static u8 scanMemcmpChunked(const u32 romSize, const u32)
+{
+	return scanMemcmp(romSize);
+}
+
+static int runBench(void)
+{
+	static const u32 sizes[3] = {0x400000, 0x1000000, 0x2000000 - 64};
+	static const u32 densities[2] = {0, 20000}; // False prefixes per MiB.
+
+	printf("Save string at the end, best of %u runs. Trie scanned in 512 KiB chunks.\n", BENCH_RUNS);
+	for(u32 d = 0; d < 2; d++)
+	{
+		for(u32 s = 0; s < 3; s++)
+		{
+			const u32 romSize = sizes[s];
+			makeImage(romSize, densities[d], false);
+			putStr((u8*)LGY_ROM_LOC, (romSize - 16) & ~3u, "FLASH1M_V103", 12);
+
+			u8 refIdx, trieIdx;
+			const double mib = romSize / (1024. * 1024);
+			const double tMemcmp = bestOf(scanMemcmpChunked, romSize, refIdx);
+			const double tTrie = bestOf(scanTrie, romSize, trieIdx);
+			printf("%2" PRIu32 " MiB, %5" PRIu32 " prefixes/MiB: memcmp %8.1f MiB/s, trie %8.1f MiB/s, %5.2fx %s\n",
+			       (romSize + 64) >> 20, densities[d], mib * 1000 / tMemcmp, mib * 1000 / tTrie, tMemcmp / tTrie,
+			       (refIdx == trieIdx ? "" : "MISMATCH"));
+		}
+	}
+
+	return 0;
+}
+
+int main(const int argc, char *const argv[])
+{
+	if(argc == 2 && strcmp(argv[1], "test") == 0) return runTests();
+	if(argc == 2 && strcmp(argv[1], "bench") == 0) return runBench();
+
+	printf("Usage: %s test|bench\n"
+	       "test:  Compares the trie scan against the old memcmp() loop.\n"
+	       "bench: MiB/s of both on synthetic 4/16/32 MiB ROMs.\n",
+	       argv[0]);
+
+	return 1;
+}
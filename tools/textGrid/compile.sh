@@ -0,0 +1,11 @@
+#!/bin/bash
+
+# Builds text_grid.c, filebrowser.c (through ../fileBrowser/fbShim.c) and
+# save_type.c unmodified against ../hostStubs. tgBeginFrame(), tgPrint()
+# and tgPresent() are wrapped so the test can check every presented frame.
+INCLUDES="-I../hostStubs/include -I../hostStubs -I../fileBrowser -I../../include"
+
+rm ./textGrid
+gcc -std=gnu2x -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ -DNDEBUG $INCLUDES -c ../hostStubs/hostStubs.c ../fileBrowser/fbShim.c ../../source/arm11/text_grid.c ../../source/arm11/arena.c ../../source/arm11/save_type.c ../../source/arm11/crc32.c
+g++ -std=c++17 -s -O2 -fstrict-aliasing -ffunction-sections -Wall -Wextra -D__ARM11__ $INCLUDES -Wl,--gc-sections -Wl,--wrap=tgBeginFrame,--wrap=tgPrint,--wrap=tgPresent ./textGrid.cpp ./*.o -lpthread -o ./textGrid
+rm ./*.o
@@ -0,0 +1,432 @@
+/*
+ *   Copyright (C) 2024 profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "types.h"
+#include "hostStubs.h"
+#include "hostTest.h"
+#include "arm11/config.h"
+#include "arm11/fmt.h"
+#include "arm11/drivers/hid.h"
+#include "arm11/save_type.h"
+#include "arm11/text_grid.h"
+#include "fbShim.h"
+
+
+#define CON_COLS     (53u) // Console size. TG_COLS leaves out the last column.
+#define SCREEN_ROWS  (24u) // Browser list rows.
+
+
+// Bottom screen console. Just enough of the escape sequences the menus use.
+struct Console
+{
+	char text[TG_ROWS][CON_COLS];
+	u8 color[TG_ROWS][CON_COLS];
+	u32 row, col;
+	u8 curColor;
+	std::string esc; // Pending escape sequence.
+	bool inEsc;
+
+	void clear()
+	{
+		memset(text, ' ', sizeof(text));
+		memset(color, TG_WHITE, sizeof(color));
+		row = col = 0;
+	}
+
+	void newline()
+	{
+		col = 0;
+		if(row + 1 < TG_ROWS) { row++; return; }
+
+		memmove(text[0], text[1], sizeof(text[0]) * (TG_ROWS - 1));
+		memmove(color[0], color[1], sizeof(color[0]) * (TG_ROWS - 1));
+		memset(text[TG_ROWS - 1], ' ', CON_COLS);
+		memset(color[TG_ROWS - 1], TG_WHITE, CON_COLS);
+	}
+
+	void escape(const std::string &seq)
+	{
+		const char cmd = seq.back();
+		const std::string params = seq.substr(0, seq.size() - 1);
+		if(cmd == 'J') clear();
+		else if(cmd == 'H')
+		{
+			u32 r = 1, c = 1;
+			sscanf(params.c_str(), "%" SCNu32 ";%" SCNu32, &r, &c);
+			row = std::min(r, TG_ROWS) - 1;
+			col = std::min(c, CON_COLS) - 1;
+		}
+		else if(cmd == 'm')
+		{
+			size_t pos = 0;
+			while(pos <= params.size())
+			{
+				const u32 p = strtoul(&params.c_str()[pos], NULL, 10);
+				if(p == 0)                curColor = TG_WHITE;
+				else if(p == 1)           curColor |= 8u;
+				else if(p >= 30 && p < 38) curColor = (curColor & 8u) | (p - 30);
+				const size_t next = params.find(';', pos);
+				if(next == std::string::npos) break;
+				pos = next + 1;
+			}
+		}
+	}
+
+	void put(const char c)
+	{
+		if(inEsc)
+		{
+			if(c != '[') esc += c;
+			if(isalpha((u8)c))
+			{
+				escape(esc);
+				inEsc = false;
+			}
+			return;
+		}
+		if(c == '\x1b')
+		{
+			inEsc = true;
+			esc.clear();
+			return;
+		}
+		if(c == '\n') { newline(); return; }
+
+		text[row][col] = c;
+		color[row][col] = curColor;
+		if(++col == CON_COLS) newline();
+	}
+};
+
+// The frame the menus asked for.
+struct Frame
+{
+	char text[TG_ROWS][TG_COLS];
+	u8 color[TG_ROWS][TG_COLS];
+};
+
+
+
+static Console g_con;
+static Frame g_frame;
+static u32 g_conBytes = 0;
+static u32 g_badFrames = 0;
+static u32 g_frames = 0;
+static std::deque<u32> g_keys;
+
+extern "C"
+{
+OafConfig g_oafConfig;
+
+void __real_tgBeginFrame(void);
+void __real_tgPrint(const u32 row, const u32 col, const u8 color, const char *str);
+void __real_tgPresent(void);
+
+void __wrap_tgBeginFrame(void)
+{
+	memset(g_frame.text, ' ', sizeof(g_frame.text));
+	memset(g_frame.color, TG_WHITE, sizeof(g_frame.color));
+	__real_tgBeginFrame();
+}
+
+void __wrap_tgPrint(const u32 row, const u32 col, const u8 color, const char *str)
+{
+	for(u32 i = col; row < TG_ROWS && i < TG_COLS && str[i - col] != '\0'; i++)
+	{
+		g_frame.text[row][i]  = str[i - col];
+		g_frame.color[row][i] = color;
+	}
+	__real_tgPrint(row, col, color, str);
+}
+
+// Checks that the console shows exactly the frame.
+void __wrap_tgPresent(void)
+{
+	__real_tgPresent();
+
+	bool ok = true;
+	for(u32 r = 0; r < TG_ROWS; r++)
+	{
+		for(u32 c = 0; c < TG_COLS; c++)
+		{
+			const char ch = g_frame.text[r][c];
+			ok &= g_con.text[r][c] == ch && (ch == ' ' || g_con.color[r][c] == g_frame.color[r][c]);
+		}
+	}
+	g_badFrames += !ok;
+	g_frames++;
+}
+
+// Keys are consumed one per frame by the menus.
+void hidScanInput(void) {}
+u32 hidKeysDown(void)
+{
+	if(g_keys.empty()) return KEY_A;
+	const u32 k = g_keys.front();
+	g_keys.pop_front();
+	return k;
+}
+u32 hidGetExtraKeys(UNUSED u32 clear) { return 0; }
+void GFX_waitForVBlank0(void) {}
+void GFX_flushBuffers(void) {}
+void printErrorWaitInput(UNUSED Result res, UNUSED u32 waitKeys) {}
+void consoleClear(void) { g_con.clear(); g_conBytes += 4; } // Counted like "\x1b[2J".
+}
+
+
+
+static void consoleSink(const char *const str, const u32 len)
+{
+	for(u32 i = 0; i < len; i++) g_con.put(str[i]);
+	g_conBytes += len;
+}
+
+// Browser navigation like browseFiles(). Returns the new cursor position.
+static u32 moveCursor(const u32 kDown, s32 cursorPos, const u32 num, u32 &windowPos)
+{
+	if(kDown & KEY_DRIGHT)
+	{
+		cursorPos += SCREEN_ROWS;
+		if((u32)cursorPos > num) cursorPos = num - 1;
+	}
+	if(kDown & KEY_DLEFT)
+	{
+		cursorPos -= SCREEN_ROWS;
+		if(cursorPos < -1) cursorPos = 0;
+	}
+	if(kDown & KEY_DUP)   cursorPos -= 1;
+	if(kDown & KEY_DDOWN) cursorPos += 1;
+
+	if(cursorPos < 0)              cursorPos = num - 1;
+	if((u32)cursorPos > (num - 1)) cursorPos = 0;
+
+	if((u32)cursorPos < windowPos)                windowPos = cursorPos;
+	if((u32)cursorPos >= windowPos + SCREEN_ROWS) windowPos = cursorPos - (SCREEN_ROWS - 1);
+
+	return cursorPos;
+}
+
+// Baseline showDirList() and cursor drawing from before the text grid.
+static void oldShowDirList(const FbDir *const dir, const u32 start)
+{
+	ee_printf("\x1b[2J");
+
+	const u32 num = fbDirNum(dir);
+	const u32 listLength = (num - start > SCREEN_ROWS ? start + SCREEN_ROWS : num);
+	for(u32 i = start; i < listLength; i++)
+	{
+		const char *const entry = fbDirEntry(dir, i);
+		const char *const printStr = (*entry == FB_ENT_FILE ? "\x1b[%lu;H\x1b[37;1m %.52s" : "\x1b[%lu;H\x1b[33;1m %.52s");
+		ee_printf(printStr, (unsigned long)(i - start + 1), &entry[1]);
+	}
+}
+
+struct StepBytes
+{
+	u32 cursor, down, up, page;      // Bytes per step kind.
+	u32 cursorN, downN, upN, pageN; // Number of steps.
+};
+
+static void addStep(StepBytes &sb, const u32 bytes, const u32 oldWindow, const u32 windowPos)
+{
+	if(windowPos == oldWindow)          { sb.cursor += bytes; sb.cursorN++; }
+	else if(windowPos == oldWindow + 1) { sb.down += bytes; sb.downN++; }
+	else if(windowPos + 1 == oldWindow) { sb.up += bytes; sb.upN++; }
+	else                                { sb.page += bytes; sb.pageN++; }
+}
+
+static void printSteps(const char *const name, const StepBytes &sb)
+{
+	printf("  %-7s cursor %4" PRIu32 "  scroll down %4" PRIu32 "  scroll up %4" PRIu32 "  page %4" PRIu32 " bytes/step\n", name,
+	       sb.cursor / std::max(sb.cursorN, 1u), sb.down / std::max(sb.downN, 1u), sb.up / std::max(sb.upN, 1u),
+	       sb.page / std::max(sb.pageN, 1u));
+}
+
+static std::deque<u32> browserKeys(void)
+{
+	std::deque<u32> keys;
+	for(u32 i = 0; i < 60; i++) keys.push_back(KEY_DDOWN); // Cursor moves, then scrolls by one.
+	for(u32 i = 0; i < 40; i++) keys.push_back(KEY_DUP);
+	for(u32 i = 0; i < 8; i++) keys.push_back(KEY_DRIGHT);
+	for(u32 i = 0; i < 4; i++) keys.push_back(KEY_DLEFT);
+	keys.push_back(KEY_DUP); // Wraps to the end.
+
+	return keys;
+}
+
+static void testBrowser(void)
+{
+	// Long names with dirs mixed in so rows differ in length and color.
+	if(mkdir(hostFsPath("sdmc:/roms"), 0755) != 0) hostTestFail();
+	for(u32 i = 0; i < 300; i++)
+	{
+		std::string name = "Game " + std::to_string(i) + std::string(i * 7 % 60, 'x');
+		if(i % 10 == 0) name = "Dir " + std::to_string(i);
+		else            name += ".gba";
+		const std::string path = hostFsPath(("sdmc:/roms/" + name).c_str());
+		if(i % 10 == 0 ? mkdir(path.c_str(), 0755) != 0 : fclose(fopen(path.c_str(), "wb")) != 0) hostTestFail();
+	}
+
+	FbDir *const dir = fbDirNew();
+	fbDirOpen(dir, "sdmc:/roms");
+	fbDirFinish(dir);
+	const u32 num = fbDirNum(dir);
+
+	// Text grid as used by browseFiles().
+	StepBytes newBytes{};
+	tgClear();
+	u32 windowPos = 0, shownWindow = UINT32_MAX;
+	s32 cursorPos = 0;
+	g_badFrames = g_frames = 0;
+	fbDirShow(dir, windowPos, cursorPos);
+	shownWindow = windowPos;
+	const u32 firstFrame = g_conBytes;
+	for(const u32 key : browserKeys())
+	{
+		const u32 oldWindow = windowPos;
+		cursorPos = moveCursor(key, cursorPos, num, windowPos);
+
+		g_conBytes = 0;
+		if(windowPos == shownWindow + 1) tgScrollUp(0, SCREEN_ROWS);
+		shownWindow = windowPos;
+		fbDirShow(dir, windowPos, cursorPos);
+		addStep(newBytes, g_conBytes, oldWindow, windowPos);
+	}
+	check("Every browser frame is shown correctly", g_badFrames == 0 && g_frames == browserKeys().size() + 1);
+
+	// Nothing changed. Nothing is sent.
+	g_conBytes = 0;
+	fbDirShow(dir, windowPos, cursorPos);
+	check("Unchanged frame sends nothing", g_conBytes == 0 && g_badFrames == 0);
+
+	// Baseline. Full redraw if the window moved and the cursor drawn on top.
+	StepBytes oldBytes{};
+	g_con.clear();
+	windowPos = 0;
+	cursorPos = 0;
+	s32 oldCursorPos = 0;
+	oldShowDirList(dir, 0);
+	for(const u32 key : browserKeys())
+	{
+		const u32 oldWindow = windowPos;
+		oldCursorPos = cursorPos;
+		cursorPos = moveCursor(key, cursorPos, num, windowPos);
+
+		g_conBytes = 0;
+		if(windowPos != oldWindow) oldShowDirList(dir, windowPos);
+		ee_printf("\x1b[%lu;H ", (unsigned long)(oldCursorPos - oldWindow + 1));
+		ee_printf("\x1b[%lu;H\x1b[37m>", (unsigned long)(cursorPos - windowPos + 1));
+		addStep(oldBytes, g_conBytes, oldWindow, windowPos);
+	}
+
+	printf("Browser, %" PRIu32 " entries. First frame %" PRIu32 " bytes.\n", num, firstFrame);
+	printSteps("Before:", oldBytes);
+	printSteps("After:", newBytes);
+	check("Scrolling down sends less than 1/4 of before", newBytes.down / newBytes.downN * 4 < oldBytes.down / oldBytes.downN);
+	check("Scrolling up sends less than before", newBytes.up / newBytes.upN < oldBytes.up / oldBytes.upN);
+	check("Page flips send no more than before", newBytes.page / newBytes.pageN <= oldBytes.page / oldBytes.pageN);
+	check("Cursor moves send under 40 bytes", newBytes.cursor / newBytes.cursorN < 40);
+
+	// Nothing changed. Nothing is sent.
+	fbDirDelete(dir);
+}
+
+static void testSaveMenu(void)
+{
+	FILE *const f = fopen(hostFsPath("sdmc:/test.sav"), "wb");
+	if(f == NULL || fclose(f) != 0) hostTestFail();
+
+	OafConfig cfg{};
+	cfg.saveOverride = true;
+	cfg.useGbaDb     = true;
+
+	std::deque<u32> keys;
+	for(u32 i = 0; i < 9; i++) keys.push_back(KEY_DDOWN); // The last one is at the end already.
+	for(u32 i = 0; i < 4; i++) keys.push_back(KEY_DUP);
+	keys.push_back(KEY_X);
+	const u32 steps = keys.size();
+
+	g_keys = keys;
+	g_con.clear();
+	g_badFrames = g_frames = 0;
+	g_conBytes = 0;
+	u8 dbSaveType = 14;
+	const u16 saveType = getSaveType(&cfg, 0x400000, 14, 0, &dbSaveType, "sdmc:/test.sav");
+	const u32 newBytes = g_conBytes;
+	check("Every save menu frame is shown correctly", g_badFrames == 0 && g_frames == steps + 1);
+	check("Save menu selection", saveType == 9);
+
+	// Baseline menu output for the same keys.
+	g_con.clear();
+	g_conBytes = 0;
+	consoleClear();
+	ee_printf("==Save Type Override Menu==\n"
+	          "Save file: %s\n"
+	          "Save type (autodetected): %u\n"
+	          "Save type (from gba_db.bin): ", "Found", 14);
+	ee_printf("%u\n", 14);
+	ee_puts("\n=Save Types=\n EEPROM 8k (0, 1)\n EEPROM 64k (2, 3)\n Flash 512k RTC (4, 6, 8)\n"
+	        " Flash 512k (5, 7, 9)\n Flash 1m RTC (10, 12)\n Flash 1m (11, 13)\n SRAM 256k (14)\n"
+	        " None (15)\n\n=Controls=\nUp/Down: Navigate\nA: Select\nX: Delete save file");
+	u8 cursor = 6, oldCursor = 0;
+	for(u32 i = 0; i <= steps; i++)
+	{
+		ee_printf("\x1b[%u;H ", oldCursor + 7);
+		ee_printf("\x1b[%u;H>", cursor + 7);
+		oldCursor = cursor;
+		if(i == steps) break;
+		if(keys[i] == KEY_DUP && cursor > 0)        cursor--;
+		else if(keys[i] == KEY_DDOWN && cursor < 7) cursor++;
+		else if(keys[i] == KEY_X)                   ee_printf("\x1b[1;11HDeleted  ");
+	}
+	const u32 oldBytes = g_conBytes;
+
+	printf("Save menu, %" PRIu32 " keys. Before %" PRIu32 " bytes, after %" PRIu32 " bytes.\n", steps, oldBytes, newBytes);
+	check("Save menu sends no more than before", newBytes <= oldBytes);
+}
+
+int main(const int argc, char *const argv[])
+{
+	if(argc != 2 || strcmp(argv[1], "test") != 0)
+	{
+		printf("Usage: %s test\n"
+		       "Checks browser and save menu frames on an emulated console\n"
+		       "and compares the bytes sent per step with the old renderers.\n",
+		       argv[0]);
+		return 1;
+	}
+
+	if(hostTestDirCreate("textGrid") == NULL) return 1;
+	g_con.clear();
+	g_hostConsole = consoleSink;
+
+	testBrowser();
+	testSaveMenu();
+
+	g_hostConsole = NULL;
+	hostTestDirRemove();
+
+	return hostTestResult();
+}